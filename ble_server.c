@@ -1,20 +1,47 @@
 #include "ble_server.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "btstack.h"
 #include "datalogger.h" // Generated from datalogger.gatt
-#include "hardware/rtc.h"
-#include "pico/util/datetime.h"
 #include "ff.h"         // For FatFs file operations
 #include "f_util.h"     // For FRESULT_str
+#include "scheduler.h"
+#include "sensor_health.h"
+#include "sensor_registry.h"
+#include "miflora_client.h"
+#include "log_store.h"
+#include "sd_logger.h"
+#include "reading_history.h"
+#include "time_util.h"
+#include "energy_profile.h"
+#include "trace.h"
+#include "hci_capture.h"
+#include "warm_restart.h"
+#include "boot_profile.h"
+#include "stack_probe.h"
+#include "irrigation.h"
+#include "clock_drift.h"
 
 // --- Server Role Globals ---
 static hci_con_handle_t server_con_handle = HCI_CON_HANDLE_INVALID; 
 extern uint8_t const profile_data[]; // From datalogger.h
 static bool rtc_is_synced = false;
-static FIL streaming_file;
+static log_store_day_t streaming_day; // Day being sent by GET: or SYNC:
 static bool is_streaming = false;
-static btstack_timer_source_t stream_timer;
+typedef enum {
+    STREAM_FROM_FILE,      // A day opened through the log store
+    STREAM_FROM_RESPONSE,  // A command reply in response_buffer
+    STREAM_FROM_LISTING,   // Day names, generated into response_buffer as it drains
+    STREAM_FROM_SYNC       // Records newer than a time from all days, framed (SYNC:)
+} stream_source_t;
+static stream_source_t stream_source;
+static uint32_t stream_bytes_sent = 0;
+static scheduler_task_t stream_task;
+static bool live_notify_enabled = false;
+static bool live_notify_pending = false;
+static bool cts_notify_enabled = false;
+static uint8_t cts_adjust_reason = 0; // Current Time Service: why the clock was last set
 extern void start_pump(void); // From main.c
 
 // Define our advertisement data
@@ -24,15 +51,56 @@ static uint8_t adv_data[] = {
     // Name
     0x0F, BLUETOOTH_DATA_TYPE_COMPLETE_LOCAL_NAME, 'M', 'i', 'F', 'l', 'o', 'r', 'a', ' ', 'L', 'o', 'g', 'g', 'e', 'r',
     // List of 16-bit Service UUIDs
-    0x03, BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_16_BIT_SERVICE_CLASS_UUIDS, 0xA0, 0xAA, // Our custom service 0xAAA0
+    0x05, BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_16_BIT_SERVICE_CLASS_UUIDS,
+    0xA0, 0xAA, // Our custom service 0xAAA0
+    0x05, 0x18, // Current Time Service 0x1805
 };
 static const uint8_t adv_data_len = sizeof(adv_data); 
 
 #define STREAM_CHUNK_SIZE 64 // Size of each data packet
 static uint8_t stream_buffer[STREAM_CHUNK_SIZE];
+#define STREAM_STALL_RETRY_MS 500 // Re-check the link if no can-send-now event arrives
+
+// Command replies generated in RAM are streamed from here
+#define RESPONSE_BUFFER_SIZE 1024 // Fits the ENERGY report and a full sensor registry
+static char response_buffer[RESPONSE_BUFFER_SIZE];
+static uint16_t response_len = 0;
+static uint16_t response_pos = 0;
+
+// SYNC stream: "#FILE:<day>" + the day's new records + "#END:<day>,<records>"
+// for each day, then "#HWM:<time>,<count>" with the newest record time sent and
+// how many records of that second the app has by then
+#define SYNC_TIME_LEN 19 // "YYYY-MM-DDTHH:MM:SS", also the start of every log line
+#define SYNC_SKIP_LINES 32 // Records the app already has, skipped per stream task run
+static uint32_t sync_since = 0;            // Records before this time are skipped,
+static uint32_t sync_since_count = 0;      // and this many of the records at it
+static uint32_t sync_since_skipped = 0;
+static uint32_t sync_high_water = 0;       // Newest record time sent so far
+static uint32_t sync_high_water_count = 0; // Records of that second the app has
+static bool sync_day_open = false;         // streaming_day holds sync_day
+static bool sync_skipping = false;         // Still looking for the open day's first new record
+static bool sync_done = false;             // Trailer queued
+static char sync_day[20];
+static uint32_t sync_day_records = 0;
+static char sync_line_head[SYNC_TIME_LEN]; // Start of the line being sent
+static uint8_t sync_line_head_len = 0;
+
+#define LIVE_READING_SIZE (READING_PACKED_SIZE + 8) // See datalogger.gatt for the layout
+static uint8_t live_reading[LIVE_READING_SIZE];
+static uint16_t live_reading_len = 0;
+
+// Recent readings page (0xAAA5): [sensor, page, available_L, available_H] + records, newest first
+#define HISTORY_VALUE_MAX 512 // Longest attribute value the ATT spec allows
+#define HISTORY_PAGE_HEADER_SIZE 4
+#define HISTORY_PAGE_RECORDS ((HISTORY_VALUE_MAX - HISTORY_PAGE_HEADER_SIZE) / READING_HISTORY_RECORD_SIZE)
+static uint8_t history_page[HISTORY_PAGE_HEADER_SIZE + HISTORY_PAGE_RECORDS * READING_HISTORY_RECORD_SIZE];
+static uint16_t history_page_len = 0;
+static uint8_t history_sensor = 0;      // Selected by a write to 0xAAA5
+static uint8_t history_page_index = 0;
 
 // --- Private Function Declarations ---
-static void stream_timer_handler(btstack_timer_source_t *ts);
+static void stream_task_handler(scheduler_task_t *task);
+static void stop_streaming(void);
 static uint16_t att_read_callback(hci_con_handle_t connection_handle, uint16_t att_handle, uint16_t offset, uint8_t * buffer, uint16_t buffer_size);
 static int att_write_callback(hci_con_handle_t connection_handle, uint16_t att_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size);
 
@@ -43,10 +111,14 @@ void ble_server_init(btstack_packet_handler_t att_packet_handler) {
     att_server_init(profile_data, att_read_callback, att_write_callback);
     // Register our HCI event handler to also receive ATT server events
     att_server_register_packet_handler(att_packet_handler);
+    scheduler_task_init(&stream_task, "stream", SCHEDULER_PRIORITY_NORMAL, stream_task_handler, NULL);
+    printf("Reading history: %d sensors x %d readings, %u bytes of RAM\n",
+           READING_HISTORY_SENSORS, READING_HISTORY_DEPTH, (unsigned)READING_HISTORY_RAM_BYTES);
 }
 
 void ble_server_start_advertising(void) {
-    printf("Starting BLE advertising...\n");
+    TRACE(ADV_START, 0, 0);
+    boot_profile_mark(BOOT_PHASE_ADVERTISING);
     uint16_t adv_int_min = 800; 
     uint16_t adv_int_max = 800; 
     uint8_t adv_type = 0;
@@ -56,16 +128,24 @@ void ble_server_start_advertising(void) {
     assert(adv_data_len <= 31); // ble limitation
     gap_advertisements_set_data(adv_data_len, (uint8_t*) adv_data); 
     gap_advertisements_enable(1); 
+    energy_profile_set(ENERGY_ADVERTISING, true);
 }
 
 void ble_server_stop_advertising(void) {
     gap_advertisements_enable(0); 
+    energy_profile_set(ENERGY_ADVERTISING, false);
 }
 
 bool ble_server_is_rtc_synced(void) {
     return rtc_is_synced;
 }
 
+void ble_server_set_rtc_synced(void) {
+    rtc_is_synced = true;
+    boot_profile_mark(BOOT_PHASE_CLOCK_SYNCED);
+    scheduler_signal(SCHEDULER_EVENT_RTC_SYNCED);
+}
+
 hci_con_handle_t ble_server_get_con_handle(void) {
     return server_con_handle;
 }
@@ -73,12 +153,18 @@ hci_con_handle_t ble_server_get_con_handle(void) {
 void ble_server_set_con_handle(hci_con_handle_t handle) {
     server_con_handle = handle;
 
+    // Subscriptions do not survive a reconnect
+    if (handle == HCI_CON_HANDLE_INVALID) {
+        energy_profile_set(ENERGY_SERVER_CONNECTION, false);
+        live_notify_enabled = false;
+        live_notify_pending = false;
+        cts_notify_enabled = false;
+    }
+
     // If the connection is dropped, stop any active stream
     if (handle == HCI_CON_HANDLE_INVALID && is_streaming) {
-        printf("Stream abort: Client disconnected.\n");
-        is_streaming = false;
-        f_close(&streaming_file);
-        btstack_run_loop_remove_timer(&stream_timer);
+        TRACE(STREAM_ABORT, TRACE_ABORT_DISCONNECTED, stream_bytes_sent);
+        stop_streaming();
     }
 
 }
@@ -92,65 +178,401 @@ void ble_server_handle_hci_event(uint8_t packet_type, uint16_t channel, uint8_t
         hci_event_le_meta_get_subevent_code(packet) == HCI_SUBEVENT_LE_CONNECTION_COMPLETE) {
         
         // This is a *server* connection *to* us (e.g., a phone)
-        printf("Client connected to our server. Staying in server mode.\n"); 
+        if (hci_subevent_le_connection_complete_get_status(packet) != ERROR_CODE_SUCCESS) {
+            return;
+        }
         server_con_handle = hci_subevent_le_connection_complete_get_connection_handle(packet); 
+        TRACE(SERVER_CONNECTED, server_con_handle, 0);
+        boot_profile_mark(BOOT_PHASE_FIRST_CONNECTION);
+        energy_profile_set(ENERGY_SERVER_CONNECTION, true);
         ble_server_stop_advertising(); 
     }
+
+    if (hci_event_packet_get_type(packet) == ATT_EVENT_CAN_SEND_NOW) {
+        if (live_notify_pending) {
+            // A deferred live notification goes first, the stream asks again
+            live_notify_pending = false;
+            att_server_notify(server_con_handle, ATT_CHARACTERISTIC_0xAAA4_01_VALUE_HANDLE, live_reading, live_reading_len);
+            if (is_streaming) {
+                att_server_request_can_send_now_event(server_con_handle);
+            }
+        } else {
+            scheduler_signal(SCHEDULER_EVENT_CAN_SEND_NOW);
+        }
+    }
+}
+
+/**
+ * @brief Store a time as [Year_L, Year_H, Month, Day, Hour, Min, Sec], all
+ * zero if it is 0 (clock not set).
+ */
+static void store_date_time(uint8_t *out, uint32_t epoch) {
+    if (epoch == 0) {
+        memset(out, 0, 7);
+        return;
+    }
+    int year, month, day, hour, min, sec;
+    time_util_from_epoch(epoch, &year, &month, &day, &hour, &min, &sec);
+    little_endian_store_16(out, 0, (uint16_t)year);
+    out[2] = (uint8_t)month;
+    out[3] = (uint8_t)day;
+    out[4] = (uint8_t)hour;
+    out[5] = (uint8_t)min;
+    out[6] = (uint8_t)sec;
+}
+
+void ble_server_notify_reading(const miflora_reading_t *reading) {
+    // Packed fixed-point values first (layout from reading_schema.h), then time and sensor
+    reading_pack(&reading->values, live_reading);
+
+    uint32_t time;
+    if (!clock_drift_port_now(&time)) {
+        time = 0;
+    }
+    uint8_t *tail = live_reading + READING_PACKED_SIZE;
+    store_date_time(tail, time);
+    tail[7] = reading->sensor_index;
+    // The sensor byte only with more than one sensor, so single-sensor apps see the old packet
+    live_reading_len = sensor_health_count() > 1 ? LIVE_READING_SIZE : LIVE_READING_SIZE - 1;
+
+    // Keep it for 0xAAA5 reads
+    reading_history_add(reading->sensor_index, time, &reading->values);
+
+    if (server_con_handle == HCI_CON_HANDLE_INVALID || !live_notify_enabled) {
+        return; // Nobody subscribed, value is still available for reads
+    }
+
+    // If the outgoing buffer is busy (e.g. during a file stream), send when the stack is ready
+    if (att_server_notify(server_con_handle, ATT_CHARACTERISTIC_0xAAA4_01_VALUE_HANDLE, live_reading, live_reading_len) != ERROR_CODE_SUCCESS) {
+        live_notify_pending = true;
+        att_server_request_can_send_now_event(server_con_handle);
+        TRACE(LIVE_DEFERRED, reading->sensor_index, 0);
+    }
 }
 
 
 // --- Private Functions (File Streaming) ---
 
+/**
+ * @brief Ends the current stream and releases its source.
+ */
+static void stop_streaming(void) {
+    if (is_streaming && stream_source == STREAM_FROM_FILE) {
+        log_store_close_day(&streaming_day);
+    }
+    if (is_streaming && stream_source == STREAM_FROM_SYNC && sync_day_open) {
+        log_store_close_day(&streaming_day);
+        sync_day_open = false;
+        sync_skipping = false;
+    }
+    is_streaming = false;
+    scheduler_cancel(&stream_task);
+}
+
+/**
+ * @brief Refills response_buffer with the next day names, one per line.
+ */
+static void fill_listing(void) {
+    char name[20];
+    response_len = 0;
+    response_pos = 0;
+    while (response_len + sizeof(name) <= RESPONSE_BUFFER_SIZE && log_store_list_next(name, sizeof(name))) {
+        response_len += snprintf(response_buffer + response_len, RESPONSE_BUFFER_SIZE - response_len, "%s\n", name);
+    }
+}
+
+// --- Private Functions (SYNC Stream) ---
+
+/**
+ * @brief Counts the records in data and tracks the newest time sent.
+ * Lines can be split across chunks, so the timestamp is collected as it passes.
+ */
+static void sync_scan(const uint8_t *data, UINT size) {
+    for (UINT i = 0; i < size; i++) {
+        if (data[i] == '\n') {
+            uint32_t time;
+            char head[SYNC_TIME_LEN + 1];
+            memcpy(head, sync_line_head, sync_line_head_len);
+            head[sync_line_head_len] = '\0';
+            if (sync_line_head_len == SYNC_TIME_LEN && time_util_parse_iso(head, &time)) {
+                sync_day_records++;
+                if (time > sync_high_water) {
+                    sync_high_water = time;
+                    sync_high_water_count = 1;
+                } else if (time == sync_high_water) {
+                    sync_high_water_count++;
+                }
+            }
+            sync_line_head_len = 0;
+        } else if (sync_line_head_len < SYNC_TIME_LEN) {
+            sync_line_head[sync_line_head_len++] = (char)data[i];
+        }
+    }
+}
+
+/**
+ * @brief Start time of a listed day, from its "YYYY-MM-DD.txt" name.
+ */
+static bool sync_day_start(const char *name, uint32_t *start) {
+    char iso[SYNC_TIME_LEN + 1];
+    snprintf(iso, sizeof(iso), "%.10sT00:00:00", name);
+    return time_util_parse_iso(iso, start);
+}
+
+/**
+ * @brief On the day that contains sync_since, skips the records the app already
+ * has and appends the first newer one to response_buffer. Records are appended
+ * in time order, so everything after it is sent as is. Several sensors can log
+ * in the same second, so records at sync_since are counted rather than all
+ * skipped: one logged in that second after the last SYNC is still sent.
+ * Skips at most SYNC_SKIP_LINES records per call; sync_skipping stays set
+ * until the first newer record or the end of the day is reached.
+ */
+static FRESULT sync_skip_old_records(void) {
+    for (int skipped = 0; skipped < SYNC_SKIP_LINES; skipped++) {
+        char *line = response_buffer + response_len;
+        energy_profile_set(ENERGY_SD_READ, true);
+        FRESULT fr = log_store_read_line(&streaming_day, line, RESPONSE_BUFFER_SIZE - response_len);
+        energy_profile_set(ENERGY_SD_READ, false);
+        if (fr != FR_OK) return fr;
+
+        if (line[0] == '\0') {
+            // Nothing new that day after all: drop its header
+            log_store_close_day(&streaming_day);
+            sync_day_open = false;
+            sync_skipping = false;
+            response_len = 0;
+            response_pos = 0;
+            return FR_OK;
+        }
+
+        uint32_t len = strlen(line);
+        uint32_t time;
+        if (!time_util_parse_iso(line, &time) || time > sync_since ||
+            (time == sync_since && sync_since_skipped++ >= sync_since_count)) {
+            sync_scan((const uint8_t *)line, len);
+            response_len += len;
+            sync_skipping = false;
+            return FR_OK;
+        }
+    }
+    return FR_OK; // More next run
+}
+
+/**
+ * @brief Parse a "YYYY-MM-DDTHH:MM:SS[,<count>]" mark as sent in #HWM:.
+ */
+static bool parse_sync_mark(const char *text, uint32_t *since, uint32_t *count) {
+    if (!time_util_parse_iso(text, since)) return false;
+    const char *rest = text + SYNC_TIME_LEN;
+    *count = 0;
+    if (*rest == '\0') return true;
+    if (rest[0] != ',' || rest[1] < '0' || rest[1] > '9') return false;
+    char *end;
+    *count = (uint32_t)strtoul(rest + 1, &end, 10);
+    return *end == '\0';
+}
+
+/**
+ * @brief Opens the next day with records newer than sync_since and queues its
+ * header, or queues the trailer once all days are done.
+ */
+static FRESULT sync_open_next_day(void) {
+    response_len = 0;
+    response_pos = 0;
+
+    char name[20];
+    uint32_t start;
+    while (log_store_list_next(name, sizeof(name))) {
+        if (!sync_day_start(name, &start) || start + 86400u <= sync_since) {
+            continue; // Nothing new that day
+        }
+
+        FRESULT fr = log_store_open_day(name, &streaming_day);
+        if (fr != FR_OK) {
+            printf("SYNC: cannot open '%s': %s\n", name, FRESULT_str(fr));
+            return fr; // No trailer, so the app keeps its old mark and retries
+        }
+        sync_day_open = true;
+        snprintf(sync_day, sizeof(sync_day), "%.10s", name);
+        sync_day_records = 0;
+        sync_line_head_len = 0;
+        response_len = snprintf(response_buffer, RESPONSE_BUFFER_SIZE, "#FILE:%s\n", sync_day);
+        sync_skipping = start <= sync_since; // The header waits for the first new record
+        return FR_OK;
+    }
+
+    int year, month, day, hour, min, sec;
+    time_util_from_epoch(sync_high_water, &year, &month, &day, &hour, &min, &sec);
+    response_len = snprintf(response_buffer, RESPONSE_BUFFER_SIZE, "#HWM:%04d-%02d-%02dT%02d:%02d:%02d,%lu\n",
+                            year, month, day, hour, min, sec, (unsigned long)sync_high_water_count);
+    sync_done = true;
+    return FR_OK;
+}
+
+/**
+ * @brief Next chunk of the SYNC stream: queued frame text first, then the open
+ * day's records, then the next day.
+ */
+static FRESULT read_sync_chunk(UINT *bytes_read) {
+    for (;;) {
+        if (sync_skipping) {
+            FRESULT fr = sync_skip_old_records();
+            if (fr != FR_OK || sync_skipping) {
+                *bytes_read = 0;
+                return fr;
+            }
+            continue;
+        }
+
+        if (response_pos < response_len) {
+            *bytes_read = btstack_min(STREAM_CHUNK_SIZE, response_len - response_pos);
+            memcpy(stream_buffer, response_buffer + response_pos, *bytes_read);
+            response_pos += *bytes_read;
+            return FR_OK;
+        }
+
+        if (sync_day_open) {
+            energy_profile_set(ENERGY_SD_READ, true);
+            FRESULT fr = log_store_read_day(&streaming_day, stream_buffer, STREAM_CHUNK_SIZE, bytes_read);
+            energy_profile_set(ENERGY_SD_READ, false);
+            if (fr != FR_OK) return fr;
+            if (*bytes_read > 0) {
+                sync_scan(stream_buffer, *bytes_read);
+                return FR_OK;
+            }
+            // Day done (a day cut short by its file counts as done)
+            log_store_close_day(&streaming_day);
+            sync_day_open = false;
+            response_len = snprintf(response_buffer, RESPONSE_BUFFER_SIZE, "#END:%s,%lu\n",
+                                    sync_day, (unsigned long)sync_day_records);
+            response_pos = 0;
+            continue;
+        }
+
+        if (sync_done) {
+            *bytes_read = 0;
+            return FR_OK;
+        }
+
+        FRESULT fr = sync_open_next_day();
+        if (fr != FR_OK) return fr;
+    }
+}
+
+/**
+ * @brief Reads the next chunk from the active source (file, response buffer, listing or SYNC).
+ * @return FR_OK with bytes_read == 0 at the end of the source, or while SYNC is
+ *         still skipping old records (sync_skipping).
+ */
+static FRESULT read_stream_chunk(UINT *bytes_read) {
+    if (stream_source == STREAM_FROM_FILE) {
+        // The log store stops at the day's end inside the month archive
+        energy_profile_set(ENERGY_SD_READ, true);
+        FRESULT fr = log_store_read_day(&streaming_day, stream_buffer, STREAM_CHUNK_SIZE, bytes_read);
+        energy_profile_set(ENERGY_SD_READ, false);
+        return fr;
+    }
+    if (stream_source == STREAM_FROM_SYNC) {
+        return read_sync_chunk(bytes_read);
+    }
+    if (stream_source == STREAM_FROM_LISTING && response_pos == response_len) {
+        fill_listing();
+    }
+    *bytes_read = btstack_min(STREAM_CHUNK_SIZE, response_len - response_pos);
+    memcpy(stream_buffer, response_buffer + response_pos, *bytes_read);
+    response_pos += *bytes_read;
+    return FR_OK;
+}
+
+/**
+ * @brief Sleep until the ATT server can take another notification.
+ * The wait is armed before the request: BTstack may emit CAN_SEND_NOW from
+ * inside the request, and a signal with no waiter is lost.
+ */
+static void wait_for_can_send(scheduler_task_t *task) {
+    scheduler_wait_event(task, SCHEDULER_EVENT_CAN_SEND_NOW, STREAM_STALL_RETRY_MS);
+    att_server_request_can_send_now_event(server_con_handle);
+}
+
 /**
  * @brief This is the main streaming logic.
- * It's called by a timer to send one chunk at a time.
+ * It's a scheduler task that sends one chunk per run, then sleeps until
+ * the ATT server reports it can take the next notification.
  */
-static void stream_timer_handler(btstack_timer_source_t *ts) {
+static void stream_task_send(scheduler_task_t *task) {
     if (!is_streaming) {
         return; // Stream was aborted
     }
 
     if (server_con_handle == HCI_CON_HANDLE_INVALID) {
-        printf("Stream abort: Connection lost.\n");
-        is_streaming = false;
-        f_close(&streaming_file);
+        TRACE(STREAM_ABORT, TRACE_ABORT_DISCONNECTED, stream_bytes_sent);
+        stop_streaming();
+        return;
+    }
+
+    // Outgoing buffers are full, wait for the stack instead of polling
+    if (!att_server_can_send_packet_now(server_con_handle)) {
+        wait_for_can_send(task);
+        TRACE(STREAM_STALL, stream_bytes_sent, 0);
         return;
     }
 
     UINT bytes_read;
-    FRESULT fr = f_read(&streaming_file, stream_buffer, STREAM_CHUNK_SIZE, &bytes_read);
+    FRESULT fr = read_stream_chunk(&bytes_read);
     
     if (fr != FR_OK) {
-        printf("Stream abort: File read error: %s\n", FRESULT_str(fr));
-        is_streaming = false;
-        f_close(&streaming_file);
+        TRACE(STREAM_ABORT, TRACE_ABORT_READ_ERROR, stream_bytes_sent);
+        stop_streaming();
+        return;
+    }
+
+    if (bytes_read == 0 && stream_source == STREAM_FROM_SYNC && sync_skipping) {
+        // Skipping a long day in slices, so BLE and the other tasks get to run
+        scheduler_run_in(task, LOG_STORE_SLICE_INTERVAL_MS);
         return;
     }
 
     if (bytes_read > 0) {
         // We have data, send it
         att_server_notify(server_con_handle, ATT_CHARACTERISTIC_0xAAA3_01_VALUE_HANDLE, stream_buffer, bytes_read);
+        stream_bytes_sent += bytes_read;
         
-        // Schedule the next chunk
-        btstack_run_loop_set_timer(ts, 1); // 1ms delay
-        btstack_run_loop_add_timer(ts);
+        // Schedule the next chunk for when the stack has room again
+        wait_for_can_send(task);
     } else {
         // End of file (bytes_read == 0)
-        printf("Stream complete. Sending EOT.\n");
+        TRACE(STREAM_END, stream_bytes_sent, 0);
         
         // Send EOT packet
         const char* eot_msg = "$$EOT$$";
         att_server_notify(server_con_handle, ATT_CHARACTERISTIC_0xAAA3_01_VALUE_HANDLE, (uint8_t*)eot_msg, strlen(eot_msg));
         
         // Clean up
-        is_streaming = false;
-        f_close(&streaming_file);
+        stop_streaming();
     }
 }
 
+static void stream_task_handler(scheduler_task_t *task) {
+    uint32_t start_us = trace_latency_begin();
+    stream_task_send(task);
+    trace_latency_end(TRACE_CALLBACK_STREAM_TASK, start_us);
+}
+
+/**
+ * @brief Marks a stream as active and kicks off the stream task.
+ */
+static void begin_stream(stream_source_t source) {
+    is_streaming = true;
+    stream_source = source;
+    stream_bytes_sent = 0;
+    TRACE(STREAM_START, source, source == STREAM_FROM_FILE ? streaming_day.left : response_len);
+    scheduler_run_in(&stream_task, 0);
+}
+
 /**
  * @brief Kicks off the file streaming process.
- * Opens the file and sets the first timer.
+ * Opens the day (monthly archive and/or text file) and starts the stream task.
  */
 static void start_streaming_file(const char* filename) {
     if (is_streaming) {
@@ -163,38 +585,289 @@ static void start_streaming_file(const char* filename) {
         return;
     }
 
-    FRESULT fr = f_open(&streaming_file, filename, FA_READ);
+    FRESULT fr = log_store_open_day(filename, &streaming_day);
     if (fr != FR_OK) {
         printf("Failed to open file '%s': %s\n", filename, FRESULT_str(fr));
         // TODO: Send an "ERROR:File Not Found" notification
         return;
     }
     
-    printf("Starting stream for file: %s\n", filename);
-    is_streaming = true;
-    
-    // Set up the timer
-    btstack_run_loop_set_timer_handler(&stream_timer, stream_timer_handler);
-    btstack_run_loop_set_timer(&stream_timer, 1); // 1ms delay to kick it off
-    btstack_run_loop_add_timer(&stream_timer);
+    begin_stream(STREAM_FROM_FILE);
+}
+
+/**
+ * @brief Streams the first len bytes of response_buffer, followed by EOT.
+ * Used for command replies that are generated in RAM.
+ */
+static void start_streaming_response(uint16_t len) {
+    if (is_streaming) {
+        printf("Stream already in progress. Ignoring new request.\n");
+        return;
+    }
+
+    if (server_con_handle == HCI_CON_HANDLE_INVALID) {
+        printf("Stream error: No valid connection.\n");
+        return;
+    }
+
+    response_len = len;
+    response_pos = 0;
+    begin_stream(STREAM_FROM_RESPONSE);
+}
+
+/**
+ * @brief Streams the names of all days on the card, followed by EOT.
+ */
+static void start_streaming_listing(void) {
+    if (is_streaming) {
+        printf("Stream already in progress. Ignoring new request.\n");
+        return;
+    }
+
+    if (server_con_handle == HCI_CON_HANDLE_INVALID) {
+        printf("Stream error: No valid connection.\n");
+        return;
+    }
+
+    log_store_list_begin();
+    response_len = 0;
+    response_pos = 0;
+    begin_stream(STREAM_FROM_LISTING);
+}
+
+/**
+ * @brief Streams every record from since on, except the first since_count at
+ * since, from all days as one framed stream, ending with the high-water mark
+ * for the app's next SYNC.
+ */
+static void start_streaming_sync(uint32_t since, uint32_t since_count) {
+    if (is_streaming) {
+        printf("Stream already in progress. Ignoring new request.\n");
+        return;
+    }
+
+    if (server_con_handle == HCI_CON_HANDLE_INVALID) {
+        printf("Stream error: No valid connection.\n");
+        return;
+    }
+
+    sync_since = since;
+    sync_since_count = since_count;
+    sync_since_skipped = 0;
+    sync_high_water = since;
+    sync_high_water_count = since_count;
+    sync_day_open = false;
+    sync_skipping = false;
+    sync_done = false;
+    log_store_list_begin();
+    response_len = 0;
+    response_pos = 0;
+    begin_stream(STREAM_FROM_SYNC);
 }
 
 // --- Private Functions (ATT Callbacks) ---
 
+/**
+ * @brief Fill history_page with the selected page of the selected sensor's readings.
+ */
+static void build_history_page(void) {
+    uint32_t total = reading_history_total(history_sensor);
+    uint16_t available = reading_history_count(history_sensor);
+    uint32_t first_age = (uint32_t)history_page_index * HISTORY_PAGE_RECORDS;
+
+    history_page[0] = history_sensor;
+    history_page[1] = history_page_index;
+    little_endian_store_16(history_page, 2, available);
+    history_page_len = HISTORY_PAGE_HEADER_SIZE;
+    for (uint32_t age = first_age; age < available && age < first_age + HISTORY_PAGE_RECORDS; age++) {
+        reading_history_get(history_sensor, total - 1 - age, history_page + history_page_len);
+        history_page_len += READING_HISTORY_RECORD_SIZE;
+    }
+}
+
+// --- Private Functions (Clock) ---
+
+#define CLOCK_STATUS_SIZE 12    // 0xAAA1 read, see datalogger.gatt
+#define CLOCK_STATUS_SYNCED 0x01
+#define CLOCK_STATUS_RESYNC 0x02
+#define CTS_CURRENT_TIME_SIZE 10 // Exact Time 256 + Adjust Reason
+#define CTS_ADJUST_EXTERNAL_REFERENCE 0x02
+#define CTS_ERROR_DATA_FIELD_IGNORED 0x80 // Current Time Service application error
+
+/**
+ * @brief 0xAAA1: corrected time, estimated error in ms and whether the
+ * error calls for a sync, so the app only writes the time when needed.
+ */
+static void build_clock_status(uint8_t *out) {
+    uint32_t now;
+    bool synced = clock_drift_port_now(&now);
+    uint32_t error_ms = clock_drift_port_error_ms();
+    store_date_time(out, synced ? now : 0);
+    little_endian_store_32(out, 7, error_ms);
+    out[11] = (synced ? CLOCK_STATUS_SYNCED : 0) |
+              (error_ms >= clock_drift_get()->resync_ms ? CLOCK_STATUS_RESYNC : 0);
+}
+
+/**
+ * @brief Current Time characteristic (0x2A2B) value: the corrected time,
+ * day of week (1 = Monday, 0 = unknown), fractions of 1/256 s (not kept)
+ * and the reason of the last adjustment.
+ */
+static void build_current_time(uint8_t *out) {
+    uint32_t now;
+    bool synced = clock_drift_port_now(&now);
+    store_date_time(out, synced ? now : 0);
+    out[7] = synced ? (uint8_t)((now / 86400u + 3) % 7 + 1) : 0; // 1970-01-01 was a Thursday
+    out[8] = 0;
+    out[9] = cts_adjust_reason;
+}
+
+/**
+ * @brief After a sync from either characteristic: logging may start, and
+ * Current Time subscribers hear about the new time.
+ */
+static void clock_synced(uint8_t adjust_reason) {
+    ble_server_set_rtc_synced();
+    cts_adjust_reason = adjust_reason;
+    if (server_con_handle != HCI_CON_HANDLE_INVALID && cts_notify_enabled) {
+        uint8_t value[CTS_CURRENT_TIME_SIZE];
+        build_current_time(value);
+        att_server_notify(server_con_handle, ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_CURRENT_TIME_01_VALUE_HANDLE,
+                          value, sizeof(value));
+    }
+}
+
 static uint16_t att_read_callback(hci_con_handle_t connection_handle, uint16_t att_handle, uint16_t offset, uint8_t * buffer, uint16_t buffer_size) {
     UNUSED(connection_handle); 
-    UNUSED(att_handle); 
-    UNUSED(offset); 
-    UNUSED(buffer); 
-    UNUSED(buffer_size); 
+
+    // Corrected time and error estimate
+    if (att_handle == ATT_CHARACTERISTIC_0xAAA1_01_VALUE_HANDLE) {
+        uint8_t status[CLOCK_STATUS_SIZE];
+        build_clock_status(status);
+        return att_read_callback_handle_blob(status, sizeof(status), offset, buffer, buffer_size);
+    }
+
+    // Current Time Service, for generic clients
+    if (att_handle == ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_CURRENT_TIME_01_VALUE_HANDLE) {
+        uint8_t value[CTS_CURRENT_TIME_SIZE];
+        build_current_time(value);
+        return att_read_callback_handle_blob(value, sizeof(value), offset, buffer, buffer_size);
+    }
+
+    // Latest reading, same layout as the live notification
+    if (att_handle == ATT_CHARACTERISTIC_0xAAA4_01_VALUE_HANDLE) {
+        return att_read_callback_handle_blob(live_reading, live_reading_len, offset, buffer, buffer_size);
+    }
+
+    // Recent readings: the page is built at the start of each read, so the
+    // blob reads of one long read all see the same records
+    if (att_handle == ATT_CHARACTERISTIC_0xAAA5_01_VALUE_HANDLE) {
+        if (offset == 0) {
+            build_history_page();
+        }
+        return att_read_callback_handle_blob(history_page, history_page_len, offset, buffer, buffer_size);
+    }
     return 0;
 }
 
-static int att_write_callback(hci_con_handle_t connection_handle, uint16_t att_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size) {
+/**
+ * @brief "ENERGY" streams the report, "ENERGY:RESET" clears the totals and
+ * "ENERGY:<state>=<uA>" (e.g. "ENERGY:scan=47000") or "ENERGY:battery=<mAh>"
+ * calibrates the model. Changes are saved with the totals every log cycle.
+ */
+static void handle_energy_command(const char *args) {
+    if (strcmp(args, ":RESET") == 0) {
+        energy_profile_reset();
+        printf("Energy totals cleared.\n");
+    } else if (args[0] == ':' && !energy_profile_configure(args + 1)) {
+        printf("ENERGY: invalid setting '%s'\n", args + 1);
+        return;
+    }
+    start_streaming_response(energy_profile_format(response_buffer, sizeof(response_buffer)));
+}
+
+/**
+ * @brief "CLOCK" streams the drift estimate, "CLOCK:RESET" forgets the
+ * measured rate and "CLOCK:resync_ms=<ms>" sets the error that calls for a
+ * sync. Changes are saved to the card right away.
+ */
+static void handle_clock_command(const char *args) {
+    if (strcmp(args, ":RESET") == 0) {
+        clock_drift_reset();
+    } else if (args[0] == ':' && !clock_drift_configure(args + 1)) {
+        printf("CLOCK: invalid setting '%s'\n", args + 1);
+        return;
+    }
+    if (args[0] == ':' && !clock_drift_port_save()) {
+        printf("CLOCK: not saved\n");
+    }
+    start_streaming_response(clock_drift_port_format(response_buffer, sizeof(response_buffer)));
+}
+
+/**
+ * @brief "IRRIGATE" streams the controller status. "IRRIGATE:ON" / "IRRIGATE:OFF"
+ * switch automatic watering, "IRRIGATE:RESET" clears faults and learned
+ * responses, and "IRRIGATE:<setting>=<value>" (e.g. "IRRIGATE:low=30") tunes
+ * it. Changes are saved to the card right away.
+ */
+static void handle_irrigate_command(const char *args) {
+    if (strcmp(args, ":ON") == 0 || strcmp(args, ":OFF") == 0) {
+        irrigation_set_enabled(args[2] == 'N');
+    } else if (strcmp(args, ":RESET") == 0) {
+        irrigation_reset();
+    } else if (args[0] == ':' && !irrigation_configure(args + 1)) {
+        printf("IRRIGATE: invalid setting '%s'\n", args + 1);
+        return;
+    }
+    if (args[0] == ':' && !irrigation_port_save()) {
+        printf("IRRIGATE: not saved\n");
+    }
+    start_streaming_response(irrigation_format(response_buffer, sizeof(response_buffer)));
+}
+
+static int handle_att_write(hci_con_handle_t connection_handle, uint16_t att_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size) {
     UNUSED(connection_handle); 
     UNUSED(transaction_mode); 
     UNUSED(offset); 
 
+    // Client (un)subscribing to live readings
+    if (att_handle == ATT_CHARACTERISTIC_0xAAA4_01_CLIENT_CONFIGURATION_HANDLE) {
+        if (buffer_size < 2) return ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
+        live_notify_enabled = little_endian_read_16(buffer, 0) == GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION;
+        TRACE(LIVE_SUBSCRIBED, live_notify_enabled, 0);
+        return 0;
+    }
+
+    // Client (un)subscribing to Current Time changes
+    if (att_handle == ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_CURRENT_TIME_01_CLIENT_CONFIGURATION_HANDLE) {
+        if (buffer_size < 2) return ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
+        cts_notify_enabled = little_endian_read_16(buffer, 0) == GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION;
+        return 0;
+    }
+
+    // Current Time Service write: [Year_L, Year_H, Month, Day, Hour, Min, Sec,
+    // Day of week, Fractions256, Adjust reason]
+    if (att_handle == ATT_CHARACTERISTIC_ORG_BLUETOOTH_CHARACTERISTIC_CURRENT_TIME_01_VALUE_HANDLE) {
+        if (buffer_size != CTS_CURRENT_TIME_SIZE) return ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
+        if (!clock_drift_port_sync(little_endian_read_16(buffer, 0), buffer[2], buffer[3], buffer[4], buffer[5],
+                                   buffer[6], (uint16_t)(buffer[8] * 1000u / 256u))) {
+            printf("Current Time: invalid time ignored.\n");
+            return CTS_ERROR_DATA_FIELD_IGNORED;
+        }
+        printf("Current Time: RTC has been synced.\n");
+        clock_synced(buffer[9] ? buffer[9] : CTS_ADJUST_EXTERNAL_REFERENCE);
+        return 0;
+    }
+
+    // Select which sensor and page 0xAAA5 reads return: [sensor, page]
+    if (att_handle == ATT_CHARACTERISTIC_0xAAA5_01_VALUE_HANDLE) {
+        if (buffer_size < 1 || buffer_size > 2) return ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
+        if (buffer[0] >= READING_HISTORY_SENSORS) return ATT_ERROR_VALUE_NOT_ALLOWED;
+        history_sensor = buffer[0];
+        history_page_index = buffer_size > 1 ? buffer[1] : 0;
+        return 0;
+    }
+
     // Check if the write is for our custom timestamp characteristic
     if (att_handle == ATT_CHARACTERISTIC_0xAAA1_01_VALUE_HANDLE) { 
         
@@ -204,23 +877,16 @@ static int att_write_callback(hci_con_handle_t connection_handle, uint16_t att_h
             return 0; // Error
         }
 
-        datetime_t t;
-        t.year  = little_endian_read_16(buffer, 0); 
-        t.month = buffer[2]; 
-        t.day   = buffer[3]; 
-        t.hour  = buffer[4]; 
-        t.min   = buffer[5]; 
-        t.sec   = buffer[6]; 
-        t.dotw  = 0; // Day of week is not critical
-
+        int year = little_endian_read_16(buffer, 0);
         printf("RTC Write: Received new time %04d-%02d-%02dT%02d:%02d:%02d\n",
-                t.year, t.month, t.day, t.hour, t.min, t.sec); 
+                year, buffer[2], buffer[3], buffer[4], buffer[5], buffer[6]); 
         
-        if (!rtc_set_datetime(&t)) { 
+        // Whole seconds: the reference is on average half a second past them
+        if (!clock_drift_port_sync(year, buffer[2], buffer[3], buffer[4], buffer[5], buffer[6], 500)) { 
             printf("RTC Write: FAILED to set new time.\n"); 
         } else {
             printf("RTC Write: SUCCESS. RTC has been synced.\n"); 
-            rtc_is_synced = true; // Set flag on success
+            clock_synced(CTS_ADJUST_EXTERNAL_REFERENCE); // Set flag on success
         }
         return 0;
     }
@@ -236,18 +902,93 @@ static int att_write_callback(hci_con_handle_t connection_handle, uint16_t att_h
 
         printf("Command received: %s\n", command_buffer);
 
+        // Core 1 may still be mounting the card, and most commands read or write it
+        if (!sd_logger_is_ready()) {
+            printf("Card not ready, command ignored.\n");
+            return 0;
+        }
+
         if (strncmp(command_buffer, "GET:", 4) == 0) {
             const char* filename = command_buffer + 4;
             start_streaming_file(filename);
         } else if (strncmp(command_buffer, "PUMP", 4) == 0) {
             printf("PUMP command received.\n");
             start_pump(); // Call the function from main.c
+        } else if (strncmp(command_buffer, "SCHED", 5) == 0) {
+            // Task run-time / lateness statistics as CSV
+            start_streaming_response(scheduler_format_stats(response_buffer, sizeof(response_buffer)));
+        } else if (strncmp(command_buffer, "HEALTH", 6) == 0) {
+            // Per-sensor success rate, RSSI, last-seen time and backoff as CSV
+            start_streaming_response(sensor_health_format(response_buffer, sizeof(response_buffer), btstack_run_loop_get_time_ms()));
         } else if (strncmp(command_buffer, "LIST", 4) == 0) {
-            // TODO: Implement file listing
-            printf("File listing not yet implemented.\n");
+            // One "YYYY-MM-DD.txt" line per day, whether loose or archived
+            start_streaming_listing();
+        } else if (strncmp(command_buffer, "SYNC", 4) == 0) {
+            // Records after the mark "SYNC:YYYY-MM-DDTHH:MM:SS,<count>" from all days. Without
+            // the count the whole second is sent again; plain "SYNC" sends everything
+            uint32_t since = 0;
+            uint32_t since_count = 0;
+            if (command_buffer[4] == ':' && !parse_sync_mark(command_buffer + 5, &since, &since_count)) {
+                printf("SYNC: invalid mark '%s'\n", command_buffer + 5);
+            } else {
+                start_streaming_sync(since, since_count);
+            }
+        } else if (strncmp(command_buffer, "DISCOVER", 8) == 0) {
+            // Scan for MiFloras (sensor_registry.h) and stream the table as known so far;
+            // DISCOVER:CLEAR forgets the discovered ones first
+            if (strcmp(command_buffer + 8, ":CLEAR") == 0) {
+                sensor_registry_clear_discovered();
+            }
+            miflora_client_discover(MIFLORA_DISCOVERY_TIME_MS);
+            start_streaming_response(sensor_registry_format(response_buffer, sizeof(response_buffer), btstack_run_loop_get_time_ms()));
+        } else if (strncmp(command_buffer, "ENROLL:", 7) == 0) {
+            // Poll this address from the next cycle on, also after a reset
+            if (miflora_client_enroll(command_buffer + 7) < 0) {
+                printf("ENROLL: cannot enroll '%s'\n", command_buffer + 7);
+            }
+            start_streaming_response(sensor_registry_format(response_buffer, sizeof(response_buffer), btstack_run_loop_get_time_ms()));
+        } else if (strncmp(command_buffer, "ENERGY", 6) == 0) {
+            // Time and charge per radio/SD/pump state, per cycle and per day, as CSV
+            handle_energy_command(command_buffer + 6);
+        } else if (strncmp(command_buffer, "TRACE", 5) == 0) {
+            // Callback run times and trace drops as CSV; TRACE:DUMP also dumps the ring to USB stdio
+            if (strcmp(command_buffer + 5, ":RESET") == 0) {
+                trace_latency_reset();
+            } else if (strcmp(command_buffer + 5, ":DUMP") == 0) {
+                trace_dump();
+            }
+            start_streaming_response(trace_format_latency(response_buffer, sizeof(response_buffer)));
+        } else if (strncmp(command_buffer, "CAPTURE", 7) == 0) {
+            // HCI capture to the card (hci_capture.h); CAPTURE:ON / CAPTURE:OFF set the mode
+            bool on = strcmp(command_buffer + 7, ":ON") == 0;
+            if (on || strcmp(command_buffer + 7, ":OFF") == 0) {
+                if (!hci_capture_set_mode(on)) printf("CAPTURE: mode not saved\n");
+            }
+            start_streaming_response(hci_capture_format_status(response_buffer, sizeof(response_buffer)));
+        } else if (strncmp(command_buffer, "BOOT", 4) == 0) {
+            // How the device came up (cold or warm restart), then the boot phase times
+            size_t used = warm_restart_format_status(response_buffer, sizeof(response_buffer));
+            used += boot_profile_format(response_buffer + used, sizeof(response_buffer) - used);
+            start_streaming_response(used);
+        } else if (strncmp(command_buffer, "CLOCK", 5) == 0) {
+            // RTC drift estimate and resync threshold (clock_drift.h)
+            handle_clock_command(command_buffer + 5);
+        } else if (strncmp(command_buffer, "IRRIGATE", 8) == 0) {
+            // Closed-loop watering per sensor (irrigation.h)
+            handle_irrigate_command(command_buffer + 8);
+        } else if (strncmp(command_buffer, "MEM", 3) == 0) {
+            // Stack high-water mark of each core (stack_probe.h)
+            start_streaming_response(stack_probe_format(response_buffer, sizeof(response_buffer)));
         }
         return 0;
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+static int att_write_callback(hci_con_handle_t connection_handle, uint16_t att_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size) {
+    uint32_t start_us = trace_latency_begin();
+    int result = handle_att_write(connection_handle, att_handle, transaction_mode, offset, buffer, buffer_size);
+    trace_latency_end(TRACE_CALLBACK_ATT_WRITE, start_us);
+    return result;
+}
@@ -3,6 +3,11 @@
 
 #include "btstack.h"
 #include <stdbool.h>
+#include "miflora_client.h" // For miflora_reading_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
  * @brief Initialize the ATT server with the profile data and callbacks.
@@ -26,14 +31,30 @@ void ble_server_stop_advertising(void);
  */
 bool ble_server_is_rtc_synced(void);
 
+/**
+ * @brief Mark the RTC as synced without a client, e.g. after it was restored
+ * on a warm restart, and wake the tasks waiting for the sync.
+ */
+void ble_server_set_rtc_synced(void);
+
 /**
  * @brief Handle HCI events related to the server role (connection, disconnection).
  */
 void ble_server_handle_hci_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 
+/**
+ * @brief Push a freshly logged reading to subscribed clients on the live characteristic (0xAAA4).
+ * @param reading Pointer to the reading that was just logged.
+ */
+void ble_server_notify_reading(const miflora_reading_t *reading);
+
 // --- State Management Functions ---
 hci_con_handle_t ble_server_get_con_handle(void);
 void ble_server_set_con_handle(hci_con_handle_t handle);
 
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // BLE_SERVER_H
\ No newline at end of file
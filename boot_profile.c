@@ -0,0 +1,96 @@
+#include "boot_profile.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "scheduler.h"
+#include "sd_logger.h"
+
+static const char * const phase_names[BOOT_NUM_PHASES] = {
+#define BOOT_X_NAME(id, name) name,
+    BOOT_PHASES(BOOT_X_NAME)
+#undef BOOT_X_NAME
+};
+
+// Milliseconds since reset plus one, 0 until reached. Zero in .bss, so core 1
+// can mark before boot_profile_init(); 32-bit, so a mark is a single store.
+static volatile uint32_t phase_stamp[BOOT_NUM_PHASES];
+static scheduler_task_t report_task;
+static bool print_pending = false;
+static bool save_pending = false;
+
+/**
+ * @brief Append the phases as one line to BOOT_PROFILE_FILE, with a header on a new file.
+ */
+static void save_profile(void) {
+    char line[16 * BOOT_NUM_PHASES];
+    size_t used = 0;
+    uint8_t probe;
+    if (sd_logger_read_file(BOOT_PROFILE_FILE, &probe, 1) == 0) {
+        for (int i = 0; i < BOOT_NUM_PHASES; i++) {
+            used += (size_t)snprintf(line + used, sizeof(line) - used, "%s%c", phase_names[i],
+                                     i + 1 < BOOT_NUM_PHASES ? ',' : '\n');
+        }
+        if (!sd_logger_append_file(BOOT_PROFILE_FILE, (const uint8_t *)line, used)) return;
+        used = 0;
+    }
+    for (int i = 0; i < BOOT_NUM_PHASES; i++) {
+        used += (size_t)snprintf(line + used, sizeof(line) - used, "%ld%c", (long)boot_profile_ms((boot_phase_t)i),
+                                 i + 1 < BOOT_NUM_PHASES ? ',' : '\n');
+    }
+    sd_logger_append_file(BOOT_PROFILE_FILE, (const uint8_t *)line, used);
+}
+
+/**
+ * @brief Prints the phases after the first connection and saves them after
+ * the first log, outside the BTstack callbacks that mark them.
+ */
+static void report_handler(scheduler_task_t *task) {
+    UNUSED(task);
+    if (print_pending) {
+        print_pending = false;
+        printf("Boot profile (ms since reset):");
+        for (int i = 0; i < BOOT_NUM_PHASES; i++) {
+            printf(" %s=%ld", phase_names[i], (long)boot_profile_ms((boot_phase_t)i));
+        }
+        printf("\n");
+    }
+    if (save_pending) {
+        save_pending = false;
+        save_profile();
+    }
+}
+
+// --- Public Function Implementations ---
+
+void boot_profile_init(void) {
+    scheduler_task_init(&report_task, "boot_report", SCHEDULER_PRIORITY_LOW, report_handler, NULL);
+}
+
+void boot_profile_mark(boot_phase_t phase) {
+    if (phase_stamp[phase] != 0) return;
+    phase_stamp[phase] = (uint32_t)(time_us_64() / 1000) + 1;
+
+    if (phase == BOOT_PHASE_FIRST_CONNECTION) {
+        print_pending = true;
+        scheduler_run_in(&report_task, 0);
+    } else if (phase == BOOT_PHASE_FIRST_LOG) {
+        save_pending = true;
+        scheduler_run_in(&report_task, 0);
+    }
+}
+
+int32_t boot_profile_ms(boot_phase_t phase) {
+    return (int32_t)phase_stamp[phase] - 1;
+}
+
+size_t boot_profile_format(char *buffer, size_t buffer_size) {
+    int n = snprintf(buffer, buffer_size, "phase,ms\n");
+    if (n < 0) return 0;
+    size_t used = (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+    for (int i = 0; i < BOOT_NUM_PHASES && used < buffer_size - 1; i++) {
+        n = snprintf(buffer + used, buffer_size - used, "%s,%ld\n", phase_names[i], (long)boot_profile_ms((boot_phase_t)i));
+        if (n < 0) break;
+        used += (size_t)n < buffer_size - used ? (size_t)n : buffer_size - used - 1;
+    }
+    return used;
+}
@@ -0,0 +1,69 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Boot phase timestamps.
+ *
+ * Each phase records the time since reset when it was first reached. The SD
+ * card mounts on core 1 while core 0 loads the radio firmware, so the phases
+ * do not come in a fixed order. On the first phone connection the table is
+ * printed. The BOOT command streams it, and the first logged reading appends
+ * it as one line to BOOT_PROFILE_FILE, so boot times can be compared across
+ * boots and firmware versions.
+ */
+
+#define BOOT_PROFILE_FILE "BOOT.CSV"
+
+// Phase ids and their names in reports
+#define BOOT_PHASES(X) \
+    X(MAIN,             "main")             /* main() entered, C runtime done */ \
+    X(RADIO_READY,      "radio_ready")      /* cyw43_arch_init(): WiFi/BT chip firmware loaded */ \
+    X(CARD_READY,       "card_ready")       /* Mount and recovery finished (core 1) */ \
+    X(STACK_UP,         "stack_up")         /* BTstack working, HCI powered on */ \
+    X(ADVERTISING,      "advertising")      /* First advertisement as "MiFlora Logger" */ \
+    X(FIRST_CONNECTION, "first_connection") /* First phone connection */ \
+    X(CLOCK_SYNCED,     "clock_synced")     /* RTC set by a phone or a warm restart */ \
+    X(FIRST_LOG,        "first_log")        /* First reading written to the card */
+
+typedef enum {
+#define BOOT_X_ENUM(id, name) BOOT_PHASE_##id,
+    BOOT_PHASES(BOOT_X_ENUM)
+#undef BOOT_X_ENUM
+    BOOT_NUM_PHASES
+} boot_phase_t;
+
+/**
+ * @brief Set up the report task. Call on core 0 before the scheduler runs.
+ */
+void boot_profile_init(void);
+
+/**
+ * @brief Record that a phase was reached; later calls for the same phase are ignored.
+ * Each phase is marked from one core only (CARD_READY from core 1).
+ */
+void boot_profile_mark(boot_phase_t phase);
+
+/**
+ * @brief Milliseconds from reset to the phase, or -1 if not reached yet.
+ */
+int32_t boot_profile_ms(boot_phase_t phase);
+
+/**
+ * @brief Format the phases as CSV text ("phase,ms", -1 if not reached).
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t boot_profile_format(char *buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_PROFILE_H
@@ -0,0 +1,45 @@
+#include "btsnoop.h"
+#include <string.h>
+
+static const uint8_t file_magic[8] = { 'b', 't', 's', 'n', 'o', 'o', 'p', 0 };
+
+static void put_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_be32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+void btsnoop_write_file_header(uint8_t out[BTSNOOP_FILE_HEADER_SIZE]) {
+    memcpy(out, file_magic, sizeof(file_magic));
+    put_be32(out + 8, 1); // Version
+    put_be32(out + 12, BTSNOOP_DATALINK_H4);
+}
+
+bool btsnoop_check_file_header(const uint8_t *data, size_t size) {
+    return size >= BTSNOOP_FILE_HEADER_SIZE &&
+           memcmp(data, file_magic, sizeof(file_magic)) == 0 &&
+           get_be32(data + 8) == 1 &&
+           get_be32(data + 12) == BTSNOOP_DATALINK_H4;
+}
+
+void btsnoop_write_record_header(const btsnoop_record_t *record, uint8_t out[BTSNOOP_RECORD_HEADER_SIZE]) {
+    put_be32(out, record->original_length);
+    put_be32(out + 4, record->included_length);
+    put_be32(out + 8, record->flags);
+    put_be32(out + 12, record->drops);
+    put_be32(out + 16, (uint32_t)(record->time_us >> 32));
+    put_be32(out + 20, (uint32_t)record->time_us);
+}
+
+void btsnoop_read_record_header(btsnoop_record_t *record, const uint8_t in[BTSNOOP_RECORD_HEADER_SIZE]) {
+    record->original_length = get_be32(in);
+    record->included_length = get_be32(in + 4);
+    record->flags = get_be32(in + 8);
+    record->drops = get_be32(in + 12);
+    record->time_us = (uint64_t)get_be32(in + 16) << 32 | get_be32(in + 20);
+}
@@ -0,0 +1,73 @@
+#ifndef BTSNOOP_H
+#define BTSNOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * BTSnoop packet capture format (as read by Wireshark), H4 datalink.
+ *
+ * File: 16-byte header ("btsnoop\0", version 1, datalink 1002), then records:
+ *   u32 original length, u32 included length, u32 flags, u32 cumulative drops,
+ *   i64 timestamp (us since 0000-01-01), then the H4 packet type byte and
+ *   the packet. All fields big endian.
+ *
+ * Portable: the firmware writes captures with it (hci_capture.c) and the
+ * host replay tool reads them.
+ */
+
+#define BTSNOOP_FILE_HEADER_SIZE   16
+#define BTSNOOP_RECORD_HEADER_SIZE 24
+#define BTSNOOP_DATALINK_H4        1002
+
+// Record flags
+#define BTSNOOP_FLAG_RECEIVED      0x01 // Controller to host
+#define BTSNOOP_FLAG_COMMAND_EVENT 0x02 // HCI command or event (not data)
+
+// H4 packet types (first byte of the record data)
+#define BTSNOOP_H4_COMMAND 0x01
+#define BTSNOOP_H4_ACL     0x02
+#define BTSNOOP_H4_SCO     0x03
+#define BTSNOOP_H4_EVENT   0x04
+
+// Timestamp of 1970-01-01 in the file's time base
+#define BTSNOOP_EPOCH_DELTA_US 0x00dcddb30f2f8000ull
+
+typedef struct {
+    uint32_t original_length; // Including the H4 type byte
+    uint32_t included_length; // Bytes stored (<= original_length)
+    uint32_t flags;
+    uint32_t drops;           // Packets lost since the capture began
+    uint64_t time_us;         // Since 0000-01-01
+} btsnoop_record_t;
+
+/**
+ * @brief Write the file header (BTSNOOP_FILE_HEADER_SIZE bytes).
+ */
+void btsnoop_write_file_header(uint8_t out[BTSNOOP_FILE_HEADER_SIZE]);
+
+/**
+ * @brief Check a file header: magic, version 1 and the H4 datalink.
+ */
+bool btsnoop_check_file_header(const uint8_t *data, size_t size);
+
+/**
+ * @brief Write a record header (BTSNOOP_RECORD_HEADER_SIZE bytes).
+ */
+void btsnoop_write_record_header(const btsnoop_record_t *record, uint8_t out[BTSNOOP_RECORD_HEADER_SIZE]);
+
+/**
+ * @brief Read a record header (BTSNOOP_RECORD_HEADER_SIZE bytes).
+ */
+void btsnoop_read_record_header(btsnoop_record_t *record, const uint8_t in[BTSNOOP_RECORD_HEADER_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSNOOP_H
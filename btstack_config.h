@@ -18,7 +18,7 @@
 // for the client
 #if RUNNING_AS_CLIENT
 #define ENABLE_LE_CENTRAL
-#define MAX_NR_GATT_CLIENTS 1
+#define MAX_NR_GATT_CLIENTS 3 // One per overlapped sensor read (MIFLORA_MAX_CONNECTIONS)
 #else
 #define MAX_NR_GATT_CLIENTS 0
 #endif
@@ -28,7 +28,8 @@
 #define HCI_OUTGOING_PRE_BUFFER_SIZE 4
 #define HCI_ACL_PAYLOAD_SIZE (255 + 4)
 #define HCI_ACL_CHUNK_SIZE_ALIGNMENT 4
-#define MAX_NR_HCI_CONNECTIONS 1
+// One phone (peripheral role) plus up to three MiFloras (central role) at the same time
+#define MAX_NR_HCI_CONNECTIONS 4
 #define MAX_NR_SM_LOOKUP_ENTRIES 3
 #define MAX_NR_WHITELIST_ENTRIES 16
 #define MAX_NR_LE_DEVICE_DB_ENTRIES 16
@@ -0,0 +1,31 @@
+#include "buffer_util.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+void buffer_util_append(char *buffer, size_t buffer_size, size_t *used, const char *format, ...) {
+    if (*used >= buffer_size - 1) return;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer + *used, buffer_size - *used, format, args);
+    va_end(args);
+    if (n < 0) return;
+    *used += (size_t)n < buffer_size - *used ? (size_t)n : buffer_size - *used - 1;
+}
+
+uint8_t *buffer_util_put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++, v >>= 8) *p++ = (uint8_t)v;
+    return p;
+}
+
+uint8_t *buffer_util_put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++, v >>= 8) *p++ = (uint8_t)v;
+    return p;
+}
+
+uint32_t buffer_util_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint64_t buffer_util_get_u64(const uint8_t *p) {
+    return (uint64_t)buffer_util_get_u32(p) | (uint64_t)buffer_util_get_u32(p + 4) << 32;
+}
@@ -0,0 +1,40 @@
+#ifndef BUFFER_UTIL_H
+#define BUFFER_UTIL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Buffer helpers shared by the modules that format CSV reports and save
+ * their state to the card. Saved blobs are little endian and end with a
+ * log_frame_crc16() of everything before it.
+ */
+
+/**
+ * @brief printf into buffer at *used, and advance *used. Output that does not
+ * fit is cut; the buffer stays terminated.
+ */
+void buffer_util_append(char *buffer, size_t buffer_size, size_t *used, const char *format, ...);
+
+/**
+ * @brief Store v little endian at p.
+ * @return The byte after it.
+ */
+uint8_t *buffer_util_put_u32(uint8_t *p, uint32_t v);
+uint8_t *buffer_util_put_u64(uint8_t *p, uint64_t v);
+
+/**
+ * @brief Read a little endian value at p.
+ */
+uint32_t buffer_util_get_u32(const uint8_t *p);
+uint64_t buffer_util_get_u64(const uint8_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BUFFER_UTIL_H
@@ -0,0 +1,241 @@
+#include "clock_drift.h"
+#include <stdlib.h>
+#include <string.h>
+#include "buffer_util.h"
+#include "log_frame.h"
+#include "time_util.h"
+
+static clock_drift_t state;
+static uint32_t added_error_ms = 0; // Not saved: a sync clears it, a warm restart carries it
+
+static uint32_t since_sync(uint32_t local) {
+    return local > state.synced_at ? local - state.synced_at : 0;
+}
+
+static uint32_t magnitude(int64_t value) {
+    return (uint32_t)(value < 0 ? -value : value);
+}
+
+// Restart the measurement at a sync
+static void restart_measurement(uint32_t reference) {
+    state.measure_from = reference;
+    state.measure_offset_ms = 0;
+}
+
+// Fold a measured rate into the estimate, weighted by the span it covers
+static void add_measurement(int32_t measured_ppb, uint32_t span_s) {
+    uint32_t quantization_ppb = (uint32_t)((uint64_t)CLOCK_DRIFT_OFFSET_MS * 1000000u / span_s);
+
+    if (state.uncertainty_ppb == 0) {
+        state.rate_ppb = measured_ppb;
+        state.wander_ppb = 0;
+        state.weight_s = span_s;
+    } else {
+        // Straying beyond what whole seconds explain is the rate changing
+        uint32_t deviation_ppb = magnitude((int64_t)measured_ppb - state.rate_ppb);
+        uint32_t excess_ppb = deviation_ppb > quantization_ppb ? deviation_ppb - quantization_ppb : 0;
+        state.rate_ppb = (int32_t)(((int64_t)state.rate_ppb * state.weight_s + (int64_t)measured_ppb * span_s) /
+                                   ((int64_t)state.weight_s + span_s));
+        state.wander_ppb = (3 * state.wander_ppb + excess_ppb) / 4;
+        state.weight_s = state.weight_s + span_s < CLOCK_DRIFT_MEMORY_S ? state.weight_s + span_s
+                                                                         : CLOCK_DRIFT_MEMORY_S;
+    }
+
+    // The whole seconds average out over all the time behind the rate
+    state.uncertainty_ppb = (uint32_t)((uint64_t)CLOCK_DRIFT_OFFSET_MS * 1000000u / state.weight_s);
+    if (state.uncertainty_ppb < state.wander_ppb) state.uncertainty_ppb = state.wander_ppb;
+    if (state.uncertainty_ppb < CLOCK_DRIFT_FLOOR_PPB) state.uncertainty_ppb = CLOCK_DRIFT_FLOOR_PPB;
+    state.measurements++;
+}
+
+// --- Public Function Implementations ---
+
+void clock_drift_init(void) {
+    memset(&state, 0, sizeof(state));
+    state.resync_ms = CLOCK_DRIFT_RESYNC_MS;
+    added_error_ms = 0;
+}
+
+void clock_drift_reset(void) {
+    state.rate_ppb = 0;
+    state.uncertainty_ppb = 0;
+    state.wander_ppb = 0;
+    state.weight_s = 0;
+    state.measurements = 0;
+    restart_measurement(state.synced_at);
+}
+
+bool clock_drift_configure(const char *setting) {
+    static const char name[] = "resync_ms=";
+    if (strncmp(setting, name, sizeof(name) - 1) != 0) return false;
+    const char *text = setting + sizeof(name) - 1;
+    if (*text < '0' || *text > '9') return false;
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (*end != '\0' || value < CLOCK_DRIFT_RESYNC_MIN_MS || value > CLOCK_DRIFT_RESYNC_MAX_MS) return false;
+    state.resync_ms = (uint32_t)value;
+    return true;
+}
+
+clock_drift_sync_t clock_drift_sync(uint32_t reference, uint16_t reference_ms, uint32_t local, bool had_time) {
+    clock_drift_sync_t result;
+    uint32_t since = since_sync(reference);
+    state.syncs++;
+
+    // The clock shows whole seconds, on average half a second behind, and
+    // started set_lag_ms behind at the last sync
+    int64_t offset = ((int64_t)local - reference) * 1000 + CLOCK_DRIFT_RESOLUTION_MS / 2 - reference_ms +
+                     state.set_lag_ms;
+    int32_t offset_ms = offset > INT32_MAX ? INT32_MAX : offset < -INT32_MAX ? -INT32_MAX : (int32_t)offset;
+
+    if (!had_time || state.synced_at == 0) {
+        restart_measurement(reference);
+        result = CLOCK_DRIFT_SYNC_FIRST;
+    } else if (magnitude(offset_ms) > CLOCK_DRIFT_STEP_MS + (uint64_t)since * CLOCK_DRIFT_MAX_PPB / 1000000u) {
+        restart_measurement(reference);
+        result = CLOCK_DRIFT_SYNC_STEP;
+    } else {
+        int64_t total_ms = (int64_t)state.measure_offset_ms + offset_ms;
+        uint32_t span = reference > state.measure_from ? reference - state.measure_from : 0;
+        if (span < CLOCK_DRIFT_MIN_SPAN_S) {
+            state.measure_offset_ms = (int32_t)total_ms;
+            result = CLOCK_DRIFT_SYNC_PENDING;
+        } else {
+            int64_t measured_ppb = total_ms * 1000000 / span;
+            if (magnitude(measured_ppb) > CLOCK_DRIFT_MAX_PPB) {
+                result = CLOCK_DRIFT_SYNC_STEP;
+            } else {
+                add_measurement((int32_t)measured_ppb, span);
+                result = CLOCK_DRIFT_SYNC_MEASURED;
+            }
+            restart_measurement(reference);
+        }
+    }
+
+    state.last_offset_ms = had_time ? offset_ms : 0;
+    state.synced_at = reference;
+    state.set_lag_ms = reference_ms;
+    added_error_ms = 0;
+    return result;
+}
+
+uint32_t clock_drift_correct(uint32_t local) {
+    if (state.synced_at == 0 || state.uncertainty_ppb == 0) return local;
+    int64_t drift_ms = (int64_t)state.rate_ppb * since_sync(local) / 1000000;
+    int64_t drift_s = (drift_ms + (drift_ms < 0 ? -500 : 500)) / 1000;
+    return (uint32_t)((int64_t)local - drift_s);
+}
+
+uint32_t clock_drift_error_ms(uint32_t local) {
+    if (state.synced_at == 0 || local == 0) return UINT32_MAX;
+    uint32_t uncertainty_ppb = state.uncertainty_ppb ? state.uncertainty_ppb : CLOCK_DRIFT_UNKNOWN_PPB;
+    uint64_t error_ms = CLOCK_DRIFT_RESOLUTION_MS + added_error_ms +
+                        (uint64_t)since_sync(local) * uncertainty_ppb / 1000000u;
+    return error_ms < UINT32_MAX ? (uint32_t)error_ms : UINT32_MAX - 1;
+}
+
+void clock_drift_add_error(uint32_t error_ms) {
+    added_error_ms = error_ms < UINT32_MAX - added_error_ms ? added_error_ms + error_ms : UINT32_MAX;
+}
+
+uint32_t clock_drift_added_error_ms(void) {
+    return added_error_ms;
+}
+
+bool clock_drift_needs_sync(uint32_t local) {
+    return clock_drift_error_ms(local) >= state.resync_ms;
+}
+
+const clock_drift_t *clock_drift_get(void) {
+    return &state;
+}
+
+// --- Reports ---
+
+// Parts per billion as ppm with three decimals, e.g. -12345 as "-12.345"
+static void append_ppm(char *buffer, size_t buffer_size, size_t *used, const char *name, int64_t ppb) {
+    uint32_t size = magnitude(ppb);
+    buffer_util_append(buffer, buffer_size, used, "%s,%s%lu.%03lu\n", name, ppb < 0 ? "-" : "",
+           (unsigned long)(size / 1000), (unsigned long)(size % 1000));
+}
+
+size_t clock_drift_format(uint32_t local, char *buffer, size_t buffer_size) {
+    size_t used = 0;
+    if (buffer_size == 0) return 0;
+    buffer[0] = '\0';
+
+    if (state.synced_at == 0 || local == 0) {
+        buffer_util_append(buffer, buffer_size, &used, "clock,unset\n");
+    } else {
+        int year, month, day, hour, min, sec;
+        time_util_from_epoch(clock_drift_correct(local), &year, &month, &day, &hour, &min, &sec);
+        buffer_util_append(buffer, buffer_size, &used, "clock,%04d-%02d-%02dT%02d:%02d:%02d\n", year, month, day, hour, min, sec);
+        buffer_util_append(buffer, buffer_size, &used, "error_ms,%lu\n", (unsigned long)clock_drift_error_ms(local));
+        buffer_util_append(buffer, buffer_size, &used, "since_sync_s,%lu\n", (unsigned long)since_sync(local));
+        buffer_util_append(buffer, buffer_size, &used, "added_error_ms,%lu\n", (unsigned long)added_error_ms);
+    }
+    buffer_util_append(buffer, buffer_size, &used, "resync_ms,%lu\n", (unsigned long)state.resync_ms);
+    buffer_util_append(buffer, buffer_size, &used, "resync,%s\n", clock_drift_needs_sync(local) ? "yes" : "no");
+    if (state.uncertainty_ppb) {
+        append_ppm(buffer, buffer_size, &used, "rate_ppm", state.rate_ppb);
+        append_ppm(buffer, buffer_size, &used, "uncertainty_ppm", state.uncertainty_ppb);
+    } else {
+        buffer_util_append(buffer, buffer_size, &used, "rate_ppm,unknown\n");
+    }
+    buffer_util_append(buffer, buffer_size, &used, "measured_h,%lu\n", (unsigned long)(state.weight_s / 3600));
+    buffer_util_append(buffer, buffer_size, &used, "last_offset_ms,%ld\n", (long)state.last_offset_ms);
+    buffer_util_append(buffer, buffer_size, &used, "syncs,%lu\n", (unsigned long)state.syncs);
+    buffer_util_append(buffer, buffer_size, &used, "measurements,%lu\n", (unsigned long)state.measurements);
+    return used;
+}
+
+// --- Persistence ---
+
+size_t clock_drift_save(uint8_t *buffer, size_t buffer_size) {
+    if (buffer_size < CLOCK_DRIFT_SAVED_SIZE) return 0;
+
+    uint8_t *p = buffer;
+    p = buffer_util_put_u32(p, CLOCK_DRIFT_MAGIC);
+    p = buffer_util_put_u32(p, state.synced_at);
+    p = buffer_util_put_u32(p, state.measure_from);
+    p = buffer_util_put_u32(p, (uint32_t)state.measure_offset_ms);
+    p = buffer_util_put_u32(p, (uint32_t)state.rate_ppb);
+    p = buffer_util_put_u32(p, state.uncertainty_ppb);
+    p = buffer_util_put_u32(p, state.wander_ppb);
+    p = buffer_util_put_u32(p, state.weight_s);
+    p = buffer_util_put_u32(p, (uint32_t)state.last_offset_ms);
+    p = buffer_util_put_u32(p, state.set_lag_ms);
+    p = buffer_util_put_u32(p, state.syncs);
+    p = buffer_util_put_u32(p, state.measurements);
+    p = buffer_util_put_u32(p, state.resync_ms);
+    uint16_t crc = log_frame_crc16((const char *)buffer, (size_t)(p - buffer));
+    *p++ = (uint8_t)crc;
+    *p++ = (uint8_t)(crc >> 8);
+    return (size_t)(p - buffer);
+}
+
+bool clock_drift_load(const uint8_t *buffer, size_t size) {
+    const size_t crc_at = CLOCK_DRIFT_SAVED_SIZE - 2;
+    if (size != CLOCK_DRIFT_SAVED_SIZE || buffer_util_get_u32(buffer) != CLOCK_DRIFT_MAGIC ||
+        (uint16_t)(buffer[crc_at] | buffer[crc_at + 1] << 8) != log_frame_crc16((const char *)buffer, crc_at)) {
+        return false;
+    }
+
+    const uint8_t *p = buffer + 4;
+    state.synced_at = buffer_util_get_u32(p);
+    state.measure_from = buffer_util_get_u32(p + 4);
+    state.measure_offset_ms = (int32_t)buffer_util_get_u32(p + 8);
+    state.rate_ppb = (int32_t)buffer_util_get_u32(p + 12);
+    state.uncertainty_ppb = buffer_util_get_u32(p + 16);
+    state.wander_ppb = buffer_util_get_u32(p + 20);
+    state.weight_s = buffer_util_get_u32(p + 24);
+    state.last_offset_ms = (int32_t)buffer_util_get_u32(p + 28);
+    state.set_lag_ms = buffer_util_get_u32(p + 32);
+    state.syncs = buffer_util_get_u32(p + 36);
+    state.measurements = buffer_util_get_u32(p + 40);
+    state.resync_ms = buffer_util_get_u32(p + 44);
+    if (state.resync_ms < CLOCK_DRIFT_RESYNC_MIN_MS || state.resync_ms > CLOCK_DRIFT_RESYNC_MAX_MS) {
+        state.resync_ms = CLOCK_DRIFT_RESYNC_MS;
+    }
+    return true;
+}
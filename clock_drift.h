@@ -0,0 +1,202 @@
+#ifndef CLOCK_DRIFT_H
+#define CLOCK_DRIFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Drift estimate for the RTC, so the phone only resyncs when it is needed.
+ *
+ * Every sync sets the RTC, and compares what it showed with the reference
+ * time it was given. The offsets, divided by the time between syncs, give
+ * the rate at which the RTC gains or loses time. The rate then corrects the
+ * timestamps of readings in between, and tells how far off the clock can be
+ * by now:
+ * - Syncs closer than CLOCK_DRIFT_MIN_SPAN_S add up their offsets until the
+ *   span is long enough. Times have whole seconds, so short spans are noise.
+ * - Each measurement counts as much as the time it spans. Older ones count
+ *   less once CLOCK_DRIFT_MEMORY_S is behind the rate, so it follows slow
+ *   changes such as the seasons.
+ * - An offset too big for any drift (the phone changed time zone, or the
+ *   clock was set by hand) starts a new measurement instead.
+ * - The error estimate grows from CLOCK_DRIFT_RESOLUTION_MS at the sync with
+ *   the rate's uncertainty: the whole seconds averaged over the measured
+ *   time, or how far measurements stray from the rate beyond that, at least
+ *   CLOCK_DRIFT_FLOOR_PPB. Until a rate is measured it grows with
+ *   CLOCK_DRIFT_UNKNOWN_PPB, the crystal tolerance.
+ *
+ * Times are seconds since 1970-01-01, as in time_util.h. The core has no Pico
+ * dependencies. tools/miflora_clock simulates a deployment through it.
+ */
+
+#define CLOCK_DRIFT_RESOLUTION_MS 1000    // Sync and RTC times have whole seconds
+#define CLOCK_DRIFT_OFFSET_MS 1500        // Most a measured offset can be off: half a second
+                                          // each for the two references and the RTC reading
+#define CLOCK_DRIFT_MIN_SPAN_S (6 * 3600) // Shortest span measured
+#define CLOCK_DRIFT_MEMORY_S (14 * 86400) // Measured time behind the rate, at most
+#define CLOCK_DRIFT_UNKNOWN_PPB 50000     // Assumed until a rate is measured (50 ppm)
+#define CLOCK_DRIFT_FLOOR_PPB 1000        // Least uncertainty of a measured rate (temperature)
+#define CLOCK_DRIFT_MAX_PPB 500000        // A bigger measured rate is a step, not a drift
+#define CLOCK_DRIFT_STEP_MS 5000          // Offsets beyond drift and this are steps
+
+// Error above which the phone should sync again, overridable at build time
+// or with clock_drift_configure("resync_ms=...")
+#ifndef CLOCK_DRIFT_RESYNC_MS
+#define CLOCK_DRIFT_RESYNC_MS 2000
+#endif
+#define CLOCK_DRIFT_RESYNC_MIN_MS 1000
+#define CLOCK_DRIFT_RESYNC_MAX_MS 3600000
+
+// What one sync did to the estimate
+typedef enum {
+    CLOCK_DRIFT_SYNC_FIRST,    // The clock had no time: nothing to measure
+    CLOCK_DRIFT_SYNC_PENDING,  // Offset added to a measurement still too short
+    CLOCK_DRIFT_SYNC_MEASURED, // Rate updated
+    CLOCK_DRIFT_SYNC_STEP,     // Offset not a drift: a new measurement starts
+} clock_drift_sync_t;
+
+typedef struct {
+    uint32_t synced_at;         // Time set by the last sync, 0 = never synced
+    uint32_t measure_from;      // Start of the measurement in progress
+    int32_t measure_offset_ms;  // Offsets of the syncs since measure_from
+    int32_t rate_ppb;           // RTC gain, parts per billion (positive: it runs fast)
+    uint32_t uncertainty_ppb;   // Of the rate; 0 = no rate measured yet
+    uint32_t wander_ppb;        // How far measurements stray from the rate, beyond whole seconds
+    uint32_t weight_s;          // Measured time behind the rate
+    int32_t last_offset_ms;     // How far off the clock was at the last sync
+    uint32_t set_lag_ms;        // The RTC was set to whole seconds, this far behind
+    uint32_t syncs;
+    uint32_t measurements;
+    uint32_t resync_ms;         // Setting: error that calls for a sync
+} clock_drift_t;
+
+/**
+ * Persisted form (little endian), see clock_drift_save():
+ *   [0]  u32 magic "CLK1"
+ *   [4]  the 12 fields of clock_drift_t, u32 each, in order
+ *   [52] u16 CRC-16 of everything before it
+ */
+#define CLOCK_DRIFT_MAGIC 0x314B4C43u // "CLK1"
+#define CLOCK_DRIFT_SAVED_SIZE (4 + 12 * 4 + 2)
+
+/**
+ * @brief Never synced, no rate, default settings.
+ */
+void clock_drift_init(void);
+
+/**
+ * @brief Forget the rate and the measurement in progress. The last sync is kept.
+ */
+void clock_drift_reset(void);
+
+/**
+ * @brief Apply a "name=value" setting. The only one is "resync_ms".
+ * @return false if the name is unknown or the value out of range.
+ */
+bool clock_drift_configure(const char *setting);
+
+/**
+ * @brief Account for a sync to the reference time. The clock is then set to
+ * reference, without its milliseconds.
+ * @param reference_ms Milliseconds past the reference second. References in
+ * whole seconds pass 500, the middle of the second they were cut to.
+ * @param local What the clock showed, ignored if had_time is false (the
+ * clock had no time).
+ */
+clock_drift_sync_t clock_drift_sync(uint32_t reference, uint16_t reference_ms, uint32_t local, bool had_time);
+
+/**
+ * @brief Correct a time read from the clock for the drift since the last sync.
+ */
+uint32_t clock_drift_correct(uint32_t local);
+
+/**
+ * @brief Estimated error of the corrected time at local, in ms, including any
+ * clock_drift_add_error(). UINT32_MAX if never synced, or local is 0 (the
+ * clock has no time).
+ */
+uint32_t clock_drift_error_ms(uint32_t local);
+
+/**
+ * @brief Widen the error estimate by error_ms until the next sync, for a clock
+ * that was set from something less exact than a sync (a warm restart).
+ */
+void clock_drift_add_error(uint32_t error_ms);
+
+/**
+ * @brief What clock_drift_add_error() added since the last sync.
+ */
+uint32_t clock_drift_added_error_ms(void);
+
+/**
+ * @brief true once the error estimate reaches the resync_ms setting.
+ */
+bool clock_drift_needs_sync(uint32_t local);
+
+const clock_drift_t *clock_drift_get(void);
+
+/**
+ * @brief Format the estimate at local (0: the clock has no time) as CSV text
+ * ("name,value" lines).
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t clock_drift_format(uint32_t local, char *buffer, size_t buffer_size);
+
+/**
+ * @brief Serialize the estimate (CLOCK_DRIFT_SAVED_SIZE bytes).
+ */
+size_t clock_drift_save(uint8_t *buffer, size_t buffer_size);
+
+/**
+ * @brief Restore what clock_drift_save() wrote.
+ * @return false if the data is not a valid saved state (nothing is changed).
+ */
+bool clock_drift_load(const uint8_t *buffer, size_t size);
+
+// --- Firmware (clock_drift_port.c) ---
+
+#define CLOCK_DRIFT_FILE "CLOCK.DAT" // clock_drift_save(), after every sync
+
+/**
+ * @brief The current time, corrected for drift.
+ * @return false if the clock was never set.
+ */
+bool clock_drift_port_now(uint32_t *epoch);
+
+/**
+ * @brief Estimated error of clock_drift_port_now(), in ms (UINT32_MAX if the clock is not set).
+ */
+uint32_t clock_drift_port_error_ms(void);
+
+/**
+ * @brief clock_drift_format() at the current time.
+ */
+size_t clock_drift_port_format(char *buffer, size_t buffer_size);
+
+/**
+ * @brief Set the RTC to a reference time and update the estimate.
+ * @param ms As reference_ms in clock_drift_sync().
+ * @return false if the date or time is invalid (the RTC is not changed).
+ */
+bool clock_drift_port_sync(int year, int month, int day, int hour, int min, int sec, uint16_t ms);
+
+/**
+ * @brief Restore the estimate from the card. Call once it is ready.
+ */
+void clock_drift_port_load(void);
+
+/**
+ * @brief Save the estimate to CLOCK_DRIFT_FILE.
+ */
+bool clock_drift_port_save(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CLOCK_DRIFT_H
@@ -0,0 +1,84 @@
+#include "clock_drift.h"
+#include <stdio.h>
+#include "hardware/rtc.h"
+#include "pico/util/datetime.h"
+#include "sd_logger.h"
+#include "time_util.h"
+
+static bool synced_this_boot = false; // Then the estimate in RAM is newer than the card's
+
+static const char * const sync_results[] = { "first sync", "measuring", "rate updated", "step, measuring again" };
+
+static bool rtc_epoch(uint32_t *epoch) {
+    datetime_t t;
+    if (!rtc_get_datetime(&t)) return false;
+    *epoch = time_util_to_epoch(t.year, t.month, t.day, t.hour, t.min, t.sec);
+    return true;
+}
+
+// --- Public Function Implementations ---
+
+bool clock_drift_port_now(uint32_t *epoch) {
+    uint32_t local;
+    if (!rtc_epoch(&local)) return false;
+    *epoch = clock_drift_correct(local);
+    return true;
+}
+
+uint32_t clock_drift_port_error_ms(void) {
+    uint32_t local;
+    return rtc_epoch(&local) ? clock_drift_error_ms(local) : UINT32_MAX;
+}
+
+size_t clock_drift_port_format(char *buffer, size_t buffer_size) {
+    uint32_t local;
+    if (!rtc_epoch(&local)) {
+        local = 0; // Reported as unset
+    }
+    return clock_drift_format(local, buffer, buffer_size);
+}
+
+bool clock_drift_port_sync(int year, int month, int day, int hour, int min, int sec, uint16_t ms) {
+    if (year < 2000 || year > 2099 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 59 || ms > 999) {
+        return false;
+    }
+    uint32_t reference = time_util_to_epoch(year, month, day, hour, min, sec);
+    uint32_t local = 0;
+    bool had_time = rtc_epoch(&local);
+
+    // 1970-01-01 was a Thursday; dotw counts from Sunday
+    datetime_t t = { (int16_t)year, (int8_t)month, (int8_t)day, (int8_t)((reference / 86400u + 4) % 7),
+                     (int8_t)hour, (int8_t)min, (int8_t)sec };
+    if (!rtc_set_datetime(&t)) return false;
+
+    clock_drift_sync_t result = clock_drift_sync(reference, ms, local, had_time);
+    synced_this_boot = true;
+
+    if (had_time) {
+        printf("Clock: was %ld ms off, %s\n", (long)clock_drift_get()->last_offset_ms, sync_results[result]);
+    } else {
+        printf("Clock: %s\n", sync_results[result]);
+    }
+    if (!clock_drift_port_save()) {
+        printf("Clock: drift estimate not saved\n");
+    }
+    return true;
+}
+
+void clock_drift_port_load(void) {
+    if (synced_this_boot) {
+        clock_drift_port_save(); // Synced before the card was ready
+        return;
+    }
+    uint8_t saved[CLOCK_DRIFT_SAVED_SIZE];
+    if (clock_drift_load(saved, sd_logger_read_file(CLOCK_DRIFT_FILE, saved, sizeof(saved)))) {
+        printf("Clock drift estimate restored from %s\n", CLOCK_DRIFT_FILE);
+    }
+}
+
+bool clock_drift_port_save(void) {
+    uint8_t saved[CLOCK_DRIFT_SAVED_SIZE];
+    size_t size = clock_drift_save(saved, sizeof(saved));
+    return sd_logger_write_file(CLOCK_DRIFT_FILE, saved, size);
+}
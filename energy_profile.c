@@ -0,0 +1,224 @@
+#include "energy_profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include "buffer_util.h"
+#include "log_frame.h"
+
+static const char * const state_names[ENERGY_NUM_STATES] = {
+    "idle", "adv", "scan", "server", "client", "sd_read", "sd_write", "pump"
+};
+
+static const uint32_t default_current_ua[ENERGY_NUM_STATES] = {
+    ENERGY_CURRENT_IDLE_UA,
+    ENERGY_CURRENT_ADVERTISING_UA,
+    ENERGY_CURRENT_SCANNING_UA,
+    ENERGY_CURRENT_SERVER_CONNECTION_UA,
+    ENERGY_CURRENT_CLIENT_CONNECTION_UA,
+    ENERGY_CURRENT_SD_READ_UA,
+    ENERGY_CURRENT_SD_WRITE_UA,
+    ENERGY_CURRENT_PUMP_UA,
+};
+
+// --- Accounting State ---
+static uint32_t current_ua[ENERGY_NUM_STATES];
+static uint32_t battery_mah = ENERGY_BATTERY_MAH;
+static uint32_t active_mask = 0;          // Bit per active state
+static energy_state_t charged_state = ENERGY_IDLE;
+static uint64_t last_update_us = 0;
+static uint32_t cycles = 0;
+static uint32_t current_day = 0;
+static energy_totals_t cycle_totals;      // Since the last cycle end
+static energy_totals_t last_cycle_totals;
+static energy_totals_t today_totals;
+static energy_totals_t yesterday_totals;
+static energy_totals_t all_totals;        // Since reset
+
+/**
+ * @brief Charge the time since the last update to the state that was active.
+ */
+static void accrue(void) {
+    uint64_t now = energy_profile_port_now_us();
+    uint64_t elapsed = now - last_update_us;
+    last_update_us = now;
+    cycle_totals.time_us[charged_state] += elapsed;
+    today_totals.time_us[charged_state] += elapsed;
+    all_totals.time_us[charged_state] += elapsed;
+}
+
+static uint64_t total_time_us(const energy_totals_t *totals) {
+    uint64_t sum = 0;
+    for (int s = 0; s < ENERGY_NUM_STATES; s++) sum += totals->time_us[s];
+    return sum;
+}
+
+// --- Public Function Implementations ---
+
+void energy_profile_init(void) {
+    memcpy(current_ua, default_current_ua, sizeof(current_ua));
+    battery_mah = ENERGY_BATTERY_MAH;
+    active_mask = 0;
+    charged_state = ENERGY_IDLE;
+    current_day = 0;
+    energy_profile_reset();
+}
+
+void energy_profile_set(energy_state_t state, bool active) {
+    if (state <= ENERGY_IDLE || state >= ENERGY_NUM_STATES) return;
+    accrue();
+    if (active) {
+        active_mask |= 1u << state;
+    } else {
+        active_mask &= ~(1u << state);
+    }
+    charged_state = ENERGY_IDLE;
+    for (int s = ENERGY_NUM_STATES - 1; s > ENERGY_IDLE; s--) {
+        if (active_mask & (1u << s)) {
+            charged_state = (energy_state_t)s;
+            break;
+        }
+    }
+}
+
+void energy_profile_cycle_end(uint32_t day) {
+    accrue();
+    last_cycle_totals = cycle_totals;
+    memset(&cycle_totals, 0, sizeof(cycle_totals));
+    cycles++;
+
+    if (day != 0 && current_day != 0 && day != current_day) {
+        if (day == current_day + 1) {
+            yesterday_totals = today_totals;
+        } else {
+            memset(&yesterday_totals, 0, sizeof(yesterday_totals)); // Days without data in between
+        }
+        memset(&today_totals, 0, sizeof(today_totals));
+    }
+    if (day != 0) current_day = day;
+}
+
+void energy_profile_reset(void) {
+    last_update_us = energy_profile_port_now_us();
+    cycles = 0;
+    memset(&cycle_totals, 0, sizeof(cycle_totals));
+    memset(&last_cycle_totals, 0, sizeof(last_cycle_totals));
+    memset(&today_totals, 0, sizeof(today_totals));
+    memset(&yesterday_totals, 0, sizeof(yesterday_totals));
+    memset(&all_totals, 0, sizeof(all_totals));
+}
+
+void energy_profile_set_current(energy_state_t state, uint32_t ua) {
+    if (state < ENERGY_NUM_STATES) current_ua[state] = ua;
+}
+
+bool energy_profile_configure(const char *setting) {
+    const char *equals = strchr(setting, '=');
+    if (equals == NULL || equals[1] < '0' || equals[1] > '9') return false;
+    char *end;
+    unsigned long value = strtoul(equals + 1, &end, 10);
+    if (*end != '\0') return false;
+
+    size_t name_len = (size_t)(equals - setting);
+    if (name_len == 7 && memcmp(setting, "battery", 7) == 0) {
+        battery_mah = (uint32_t)value;
+        return true;
+    }
+    for (int s = 0; s < ENERGY_NUM_STATES; s++) {
+        if (strlen(state_names[s]) == name_len && memcmp(state_names[s], setting, name_len) == 0) {
+            current_ua[s] = (uint32_t)value;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t energy_profile_charge_uah(const energy_totals_t *totals) {
+    uint64_t ua_ms = 0; // Fits 1 A for about 580 years
+    for (int s = 0; s < ENERGY_NUM_STATES; s++) {
+        ua_ms += totals->time_us[s] / 1000u * current_ua[s];
+    }
+    return ua_ms / 3600000u;
+}
+
+// --- Report ---
+
+size_t energy_profile_format(char *buffer, size_t buffer_size) {
+    if (buffer_size == 0) return 0;
+    buffer[0] = '\0';
+    accrue();
+
+    size_t used = 0;
+    buffer_util_append(buffer, buffer_size, &used, "state,uA,last_cycle_ms,today_s,total_s,total_mAh\n");
+    for (int s = 0; s < ENERGY_NUM_STATES; s++) {
+        energy_totals_t one;
+        memset(&one, 0, sizeof(one));
+        one.time_us[s] = all_totals.time_us[s];
+        buffer_util_append(buffer, buffer_size, &used, "%s,%lu,%lu,%lu,%lu,%lu\n", state_names[s],
+               (unsigned long)current_ua[s],
+               (unsigned long)(last_cycle_totals.time_us[s] / 1000u),
+               (unsigned long)(today_totals.time_us[s] / 1000000u),
+               (unsigned long)(all_totals.time_us[s] / 1000000u),
+               (unsigned long)(energy_profile_charge_uah(&one) / 1000u));
+    }
+
+    // Charge per day, extrapolated from everything counted so far
+    uint64_t all_us = total_time_us(&all_totals);
+    uint64_t all_uah = energy_profile_charge_uah(&all_totals);
+    uint64_t per_day_uah = all_us > 0 ? all_uah * 86400000000ull / all_us : 0;
+
+    buffer_util_append(buffer, buffer_size, &used, "cycles,%lu\n", (unsigned long)cycles);
+    buffer_util_append(buffer, buffer_size, &used, "last_cycle_uAh,%lu\n", (unsigned long)energy_profile_charge_uah(&last_cycle_totals));
+    buffer_util_append(buffer, buffer_size, &used, "avg_cycle_uAh,%lu\n", (unsigned long)(cycles > 0 ? all_uah / cycles : 0));
+    buffer_util_append(buffer, buffer_size, &used, "today_uAh,%lu\n", (unsigned long)energy_profile_charge_uah(&today_totals));
+    buffer_util_append(buffer, buffer_size, &used, "yesterday_uAh,%lu\n", (unsigned long)energy_profile_charge_uah(&yesterday_totals));
+    buffer_util_append(buffer, buffer_size, &used, "per_day_uAh,%lu\n", (unsigned long)per_day_uah);
+    if (battery_mah > 0 && per_day_uah > 0) {
+        uint64_t tenths = (uint64_t)battery_mah * 10000u / per_day_uah;
+        buffer_util_append(buffer, buffer_size, &used, "battery_days,%lu.%lu\n", (unsigned long)(tenths / 10), (unsigned long)(tenths % 10));
+    }
+    return used;
+}
+
+// --- Persistence ---
+
+size_t energy_profile_save(uint8_t *buffer, size_t buffer_size) {
+    if (buffer_size < ENERGY_PROFILE_SAVED_SIZE) return 0;
+    accrue();
+
+    uint8_t *p = buffer;
+    p = buffer_util_put_u32(p, ENERGY_PROFILE_MAGIC);
+    p = buffer_util_put_u32(p, cycles);
+    p = buffer_util_put_u32(p, current_day);
+    p = buffer_util_put_u32(p, battery_mah);
+    for (int s = 0; s < ENERGY_NUM_STATES; s++) p = buffer_util_put_u32(p, current_ua[s]);
+    for (int s = 0; s < ENERGY_NUM_STATES; s++) p = buffer_util_put_u64(p, all_totals.time_us[s]);
+    for (int s = 0; s < ENERGY_NUM_STATES; s++) p = buffer_util_put_u64(p, today_totals.time_us[s]);
+    for (int s = 0; s < ENERGY_NUM_STATES; s++) p = buffer_util_put_u64(p, yesterday_totals.time_us[s]);
+    uint16_t crc = log_frame_crc16((const char *)buffer, (size_t)(p - buffer));
+    *p++ = (uint8_t)crc;
+    *p++ = (uint8_t)(crc >> 8);
+    return (size_t)(p - buffer);
+}
+
+bool energy_profile_load(const uint8_t *buffer, size_t size) {
+    const size_t crc_at = ENERGY_PROFILE_SAVED_SIZE - 2;
+    if (size != ENERGY_PROFILE_SAVED_SIZE || buffer_util_get_u32(buffer) != ENERGY_PROFILE_MAGIC ||
+        (uint16_t)(buffer[crc_at] | buffer[crc_at + 1] << 8) != log_frame_crc16((const char *)buffer, crc_at)) {
+        return false;
+    }
+
+    const uint8_t *p = buffer + 4;
+    cycles = buffer_util_get_u32(p);
+    current_day = buffer_util_get_u32(p + 4);
+    battery_mah = buffer_util_get_u32(p + 8);
+    p += 12;
+    for (int s = 0; s < ENERGY_NUM_STATES; s++, p += 4) current_ua[s] = buffer_util_get_u32(p);
+    for (int s = 0; s < ENERGY_NUM_STATES; s++, p += 8) all_totals.time_us[s] = buffer_util_get_u64(p);
+    for (int s = 0; s < ENERGY_NUM_STATES; s++, p += 8) today_totals.time_us[s] = buffer_util_get_u64(p);
+    for (int s = 0; s < ENERGY_NUM_STATES; s++, p += 8) yesterday_totals.time_us[s] = buffer_util_get_u64(p);
+
+    // Time before the load belongs to the previous run; count from now
+    last_update_us = energy_profile_port_now_us();
+    memset(&cycle_totals, 0, sizeof(cycle_totals));
+    memset(&last_cycle_totals, 0, sizeof(last_cycle_totals));
+    return true;
+}
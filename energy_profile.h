@@ -0,0 +1,156 @@
+#ifndef ENERGY_PROFILE_H
+#define ENERGY_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Energy accounting: time spent in each activity, turned into charge by a
+ * per-state current model.
+ *
+ * Activities are switched on and off where they happen (scan start, SD write,
+ * pump, ...). They can overlap, e.g. advertising during a sensor read; the
+ * time is then charged to the active state listed last in energy_state_t,
+ * so the states always add up to the elapsed time and each current is the
+ * board's total draw in that state. Nothing active counts as idle.
+ *
+ * Totals are kept for the current and the last log cycle, today, yesterday
+ * and since the totals were reset. The core has no Pico or BTstack
+ * dependencies; the platform supplies energy_profile_port_now_us(), so the
+ * host simulation (tools/miflora_energy) produces the same report.
+ */
+
+// Ordered by precedence: when several are active, the last one is charged
+typedef enum {
+    ENERGY_IDLE,
+    ENERGY_ADVERTISING,
+    ENERGY_SCANNING,
+    ENERGY_SERVER_CONNECTION, // Phone connected to us
+    ENERGY_CLIENT_CONNECTION, // Connected to a MiFlora
+    ENERGY_SD_READ,
+    ENERGY_SD_WRITE,
+    ENERGY_PUMP,
+    ENERGY_NUM_STATES
+} energy_state_t;
+
+// Default current model (board total, microamps). Rough figures for a Pico W
+// with the CYW43 powered, an SD card and a small pump on the same supply;
+// measure your own board and set them with the ENERGY command or
+// energy_profile_configure().
+#ifndef ENERGY_CURRENT_IDLE_UA
+#define ENERGY_CURRENT_IDLE_UA 28000
+#endif
+#ifndef ENERGY_CURRENT_ADVERTISING_UA
+#define ENERGY_CURRENT_ADVERTISING_UA 31000
+#endif
+#ifndef ENERGY_CURRENT_SCANNING_UA
+#define ENERGY_CURRENT_SCANNING_UA 45000
+#endif
+#ifndef ENERGY_CURRENT_SERVER_CONNECTION_UA
+#define ENERGY_CURRENT_SERVER_CONNECTION_UA 36000
+#endif
+#ifndef ENERGY_CURRENT_CLIENT_CONNECTION_UA
+#define ENERGY_CURRENT_CLIENT_CONNECTION_UA 40000
+#endif
+#ifndef ENERGY_CURRENT_SD_READ_UA
+#define ENERGY_CURRENT_SD_READ_UA 50000
+#endif
+#ifndef ENERGY_CURRENT_SD_WRITE_UA
+#define ENERGY_CURRENT_SD_WRITE_UA 65000
+#endif
+#ifndef ENERGY_CURRENT_PUMP_UA
+#define ENERGY_CURRENT_PUMP_UA 250000
+#endif
+
+// Battery capacity for the runtime estimate (0 = no estimate)
+#ifndef ENERGY_BATTERY_MAH
+#define ENERGY_BATTERY_MAH 0
+#endif
+
+/**
+ * Persisted form (little endian), see energy_profile_save():
+ *   [0]   u32 magic "ENG1"
+ *   [4]   u32 log cycles counted
+ *   [8]   u32 current day (days since 1970-01-01, 0 = unknown)
+ *   [12]  u32 battery capacity, mAh
+ *   [16]  u32 current per state, uA
+ *   [..]  u64 time per state, us: since reset, today, yesterday
+ *   [..]  u16 CRC-16 of everything before it
+ */
+#define ENERGY_PROFILE_MAGIC 0x31474E45u // "ENG1"
+#define ENERGY_PROFILE_SAVED_SIZE (16 + ENERGY_NUM_STATES * 4 + 3 * ENERGY_NUM_STATES * 8 + 2)
+
+typedef struct {
+    uint64_t time_us[ENERGY_NUM_STATES];
+} energy_totals_t;
+
+/**
+ * @brief Start accounting from now, with the default current model and zero totals.
+ */
+void energy_profile_init(void);
+
+/**
+ * @brief Mark an activity as started (active = true) or finished.
+ * Repeated calls with the same value are harmless.
+ */
+void energy_profile_set(energy_state_t state, bool active);
+
+/**
+ * @brief Close the current log cycle: it becomes the "last cycle" of the report.
+ * @param day Days since 1970-01-01 from the RTC, 0 if unknown. A new day moves
+ *            today's totals to yesterday.
+ */
+void energy_profile_cycle_end(uint32_t day);
+
+/**
+ * @brief Clear all totals (the current model is kept).
+ */
+void energy_profile_reset(void);
+
+/**
+ * @brief Change the current model for one state.
+ */
+void energy_profile_set_current(energy_state_t state, uint32_t current_ua);
+
+/**
+ * @brief Apply a "name=value" setting: "<state>=<uA>" with a state's report
+ * name ("idle", "adv", "scan", ...), or "battery=<mAh>".
+ * @return false if the name is unknown or the value is not a number.
+ */
+bool energy_profile_configure(const char *setting);
+
+/**
+ * @brief Charge drawn over some totals with the current model, in microamp-hours.
+ */
+uint64_t energy_profile_charge_uah(const energy_totals_t *totals);
+
+/**
+ * @brief Format the report as CSV text: one line per state, then summary lines.
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t energy_profile_format(char *buffer, size_t buffer_size);
+
+/**
+ * @brief Serialize the totals and current model (ENERGY_PROFILE_SAVED_SIZE bytes).
+ */
+size_t energy_profile_save(uint8_t *buffer, size_t buffer_size);
+
+/**
+ * @brief Restore totals and model saved by energy_profile_save().
+ * @return false if the data is not a valid saved profile (nothing is changed).
+ */
+bool energy_profile_load(const uint8_t *buffer, size_t size);
+
+// --- Port Hook (implemented per platform) ---
+uint64_t energy_profile_port_now_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENERGY_PROFILE_H
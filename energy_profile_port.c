@@ -0,0 +1,7 @@
+#include "energy_profile.h"
+#include "pico/stdlib.h"
+
+// Energy profile port: the 64-bit microsecond timer never wraps in practice.
+uint64_t energy_profile_port_now_us(void) {
+    return time_us_64();
+}
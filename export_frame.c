@@ -0,0 +1,87 @@
+#include "export_frame.h"
+#include <string.h>
+#include "log_frame.h"
+
+// CRC-32 four bits at a time: a 64-byte table instead of 1 KB
+static const uint32_t crc32_nibble[16] = {
+    0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu, 0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+    0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu, 0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu,
+};
+
+static uint16_t frame_crc(const uint8_t *frame, size_t length) {
+    return log_frame_crc16((const char *)frame + 2, EXPORT_FRAME_HEADER_SIZE - 2 + length);
+}
+
+size_t export_frame_seal(uint8_t type, uint8_t tag, uint16_t length, uint8_t *out) {
+    out[0] = EXPORT_FRAME_SYNC0;
+    out[1] = EXPORT_FRAME_SYNC1;
+    out[2] = type;
+    out[3] = tag;
+    out[4] = (uint8_t)length;
+    out[5] = (uint8_t)(length >> 8);
+    uint16_t crc = frame_crc(out, length);
+    out[EXPORT_FRAME_HEADER_SIZE + length] = (uint8_t)crc;
+    out[EXPORT_FRAME_HEADER_SIZE + length + 1] = (uint8_t)(crc >> 8);
+    return EXPORT_FRAME_OVERHEAD + length;
+}
+
+size_t export_frame_encode(uint8_t type, uint8_t tag, const uint8_t *payload, uint16_t length, uint8_t *out) {
+    if (length > 0) memcpy(out + EXPORT_FRAME_HEADER_SIZE, payload, length);
+    return export_frame_seal(type, tag, length, out);
+}
+
+void export_frame_parser_init(export_frame_parser_t *parser, uint8_t *buffer, size_t capacity) {
+    parser->buffer = buffer;
+    parser->capacity = capacity;
+    parser->used = 0;
+    parser->bad_frames = 0;
+}
+
+/**
+ * @brief Drop the first byte of a damaged frame and keep looking for a sync
+ * byte in the rest, which may hold the start of the next frame.
+ */
+static void resync(export_frame_parser_t *p) {
+    p->bad_frames++;
+    size_t start = 1;
+    while (start < p->used && p->buffer[start] != EXPORT_FRAME_SYNC0) start++;
+    p->used -= start;
+    memmove(p->buffer, p->buffer + start, p->used);
+    if (p->used >= 2 && p->buffer[1] != EXPORT_FRAME_SYNC1) p->used = 0;
+}
+
+bool export_frame_push(export_frame_parser_t *p, uint8_t byte) {
+    if (p->used == 0 && byte != EXPORT_FRAME_SYNC0) return false;
+    if (p->used == 1 && byte != EXPORT_FRAME_SYNC1) {
+        p->used = byte == EXPORT_FRAME_SYNC0 ? 1 : 0;
+        return false;
+    }
+    p->buffer[p->used++] = byte;
+    if (p->used < EXPORT_FRAME_HEADER_SIZE) return false;
+
+    size_t length = export_frame_length(p);
+    if (length > EXPORT_FRAME_MAX_PAYLOAD || EXPORT_FRAME_OVERHEAD + length > p->capacity) {
+        resync(p);
+        return false;
+    }
+    if (p->used < EXPORT_FRAME_OVERHEAD + length) return false;
+
+    uint16_t crc = (uint16_t)(p->buffer[EXPORT_FRAME_HEADER_SIZE + length] |
+                              p->buffer[EXPORT_FRAME_HEADER_SIZE + length + 1] << 8);
+    if (crc != frame_crc(p->buffer, length)) {
+        resync(p);
+        return false;
+    }
+    p->used = 0; // The frame stays in the buffer until the next byte
+    return true;
+}
+
+uint32_t export_frame_crc32(uint32_t crc, const uint8_t *data, size_t length) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+    }
+    return ~crc;
+}
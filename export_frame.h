@@ -0,0 +1,123 @@
+#ifndef EXPORT_FRAME_H
+#define EXPORT_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Framing for the USB export protocol (usb_export.h), shared by the firmware
+ * and the host client (tools/miflora_export).
+ *
+ * Frame layout (little endian):
+ *   [0]   0xA5 0x5A sync
+ *   [2]   u8  type
+ *   [3]   u8  tag: chosen by the host per request, echoed in every reply
+ *   [4]   u16 payload length (at most EXPORT_FRAME_MAX_PAYLOAD)
+ *   [6]   payload
+ *   [6+n] u16 CRC-16/CCITT-FALSE over type, tag, length and payload
+ *
+ * The receiver looks for the sync bytes, so it skips stray text (boot
+ * messages printed before the session) and resynchronises after a damaged
+ * frame. A bad frame is dropped. The host notices the gap in the data
+ * offsets and asks again from the last good offset.
+ */
+
+#define EXPORT_FRAME_SYNC0 0xA5
+#define EXPORT_FRAME_SYNC1 0x5A
+#define EXPORT_FRAME_HEADER_SIZE 6
+#define EXPORT_FRAME_OVERHEAD (EXPORT_FRAME_HEADER_SIZE + 2)
+#define EXPORT_FRAME_MAX_DATA 4096 // File bytes per DATA frame
+#define EXPORT_FRAME_MAX_PAYLOAD (4 + EXPORT_FRAME_MAX_DATA)
+#define EXPORT_FRAME_MAX_SIZE (EXPORT_FRAME_OVERHEAD + EXPORT_FRAME_MAX_PAYLOAD)
+#define EXPORT_FRAME_MAX_NAME 63
+
+#define EXPORT_PROTOCOL_VERSION 1
+
+// Frame types. Requests come from the host; replies set the top bit.
+typedef enum {
+    EXPORT_HELLO = 0x01, // -> start a session;  <- u8 version, u8 window, u16 chunk size
+    EXPORT_LIST  = 0x02, // -> list the card;     <- ENTRY frames, then END (count = entries)
+    EXPORT_READ  = 0x03, // -> u32 offset, u32 length (0xFFFFFFFF = to the end), name;
+                         // <- DATA frames, then END (count = bytes, CRC-32 of the bytes)
+    EXPORT_CRC   = 0x04, // -> as READ; <- END only (CRC-32 of the range)
+    EXPORT_ACK   = 0x05, // -> u8 credits: the host has taken that many ENTRY/DATA frames
+    EXPORT_ABORT = 0x06, // -> stop the running request; <- END (ABORTED)
+    EXPORT_BYE   = 0x07, // -> end the session, USB serial prints again; <- END
+
+    EXPORT_ENTRY = 0x82, // <- u32 size, u16 FAT date, u16 FAT time, name
+    EXPORT_DATA  = 0x83, // <- u32 offset, file bytes
+    EXPORT_END   = 0x8F, // <- u8 status, u32 count, u32 CRC-32
+} export_frame_type_t;
+
+#define EXPORT_REPLY_HELLO (EXPORT_HELLO | 0x80)
+#define EXPORT_READ_TO_END 0xFFFFFFFFu
+
+// Status in END frames
+typedef enum {
+    EXPORT_STATUS_OK = 0,
+    EXPORT_STATUS_NO_FILE,
+    EXPORT_STATUS_IO_ERROR,
+    EXPORT_STATUS_BAD_REQUEST,
+    EXPORT_STATUS_ABORTED,
+    EXPORT_STATUS_BUSY,      // Another request is running
+    EXPORT_STATUS_NOT_READY, // The card is still mounting or not mounted
+} export_status_t;
+
+// Incremental frame reader
+typedef struct {
+    uint8_t *buffer;  // Holds one frame; the current frame when export_frame_push() returns true
+    size_t capacity;
+    size_t used;
+    uint32_t bad_frames; // CRC mismatches and impossible lengths
+} export_frame_parser_t;
+
+/**
+ * @brief Encode a frame.
+ * @param out Buffer of at least EXPORT_FRAME_OVERHEAD + length bytes.
+ * @return Frame size.
+ */
+size_t export_frame_encode(uint8_t type, uint8_t tag, const uint8_t *payload, uint16_t length, uint8_t *out);
+
+/**
+ * @brief Seal a frame whose payload was written in place at out + EXPORT_FRAME_HEADER_SIZE.
+ * @return Frame size.
+ */
+size_t export_frame_seal(uint8_t type, uint8_t tag, uint16_t length, uint8_t *out);
+
+/**
+ * @brief Start a reader. Frames longer than the buffer are treated as damaged.
+ */
+void export_frame_parser_init(export_frame_parser_t *parser, uint8_t *buffer, size_t capacity);
+
+/**
+ * @brief Feed one received byte.
+ * @return true when a complete frame with a good CRC is in the buffer (until the next call).
+ */
+bool export_frame_push(export_frame_parser_t *parser, uint8_t byte);
+
+// Fields of the frame in the parser's buffer
+static inline uint8_t export_frame_type(const export_frame_parser_t *p) { return p->buffer[2]; }
+static inline uint8_t export_frame_tag(const export_frame_parser_t *p) { return p->buffer[3]; }
+static inline uint16_t export_frame_length(const export_frame_parser_t *p) {
+    return (uint16_t)(p->buffer[4] | p->buffer[5] << 8);
+}
+static inline const uint8_t *export_frame_payload(const export_frame_parser_t *p) {
+    return p->buffer + EXPORT_FRAME_HEADER_SIZE;
+}
+
+/**
+ * @brief CRC-32 (IEEE 802.3, as zlib's crc32()), for whole ranges of a file.
+ * @param crc 0 to start, or the result for the preceding bytes.
+ */
+uint32_t export_frame_crc32(uint32_t crc, const uint8_t *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPORT_FRAME_H
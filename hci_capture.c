@@ -0,0 +1,195 @@
+#include "hci_capture.h"
+#include <stdio.h>
+#include <string.h>
+#include "btstack.h"
+#include "pico/stdlib.h"
+#include "btsnoop.h"
+#include "sd_logger.h"
+#include "scheduler.h"
+
+// BTstack's GATT client and ATT server events, which bypass the packet dump
+#define APP_EVENT_FIRST GATT_EVENT_QUERY_COMPLETE
+#define APP_EVENT_LAST  0xBF
+
+// --- Global State ---
+static bool capture_active = false;
+static bool capture_pending = false; // Buffering from power-on until the card is mounted
+static bool dump_registered = false;
+static uint8_t capture_buffer[HCI_CAPTURE_BUFFER_SIZE];
+static size_t capture_used = 0;
+static uint32_t capture_packets = 0;
+static uint32_t capture_drops = 0;
+static uint32_t capture_bytes = 0; // Written to the card
+static scheduler_task_t flush_task;
+
+static void flush_handler(scheduler_task_t *task);
+
+// --- Packet Dump ---
+
+static void dump_reset(void) {
+    // Called by BTstack if a packet limit is set; captures are not limited
+}
+
+static void dump_log_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t len) {
+    if (!capture_active || packet_type < BTSNOOP_H4_COMMAND || packet_type > BTSNOOP_H4_EVENT) return;
+
+    uint16_t kept = btstack_min(len, HCI_CAPTURE_SNAPLEN);
+    size_t needed = BTSNOOP_RECORD_HEADER_SIZE + 1u + kept;
+    if (capture_used + needed > sizeof(capture_buffer)) {
+        capture_drops++;
+        return;
+    }
+
+    btsnoop_record_t record = {
+        .original_length = len + 1u,
+        .included_length = kept + 1u,
+        .flags = (in ? BTSNOOP_FLAG_RECEIVED : 0) |
+                 (packet_type == BTSNOOP_H4_COMMAND || packet_type == BTSNOOP_H4_EVENT ? BTSNOOP_FLAG_COMMAND_EVENT : 0),
+        .drops = capture_drops,
+        .time_us = BTSNOOP_EPOCH_DELTA_US + time_us_64(),
+    };
+    uint8_t *out = capture_buffer + capture_used;
+    btsnoop_write_record_header(&record, out);
+    out[BTSNOOP_RECORD_HEADER_SIZE] = packet_type;
+    memcpy(out + BTSNOOP_RECORD_HEADER_SIZE + 1, packet, kept);
+    capture_used += needed;
+    capture_packets++;
+
+    // Write out early rather than drop during a burst (scan results)
+    if (capture_used > sizeof(capture_buffer) / 2 && !capture_pending) {
+        scheduler_run_in(&flush_task, 0);
+    }
+}
+
+static void dump_log_message(int log_level, const char *format, va_list argptr) {
+    // BTstack's debug log is not captured
+    UNUSED(log_level);
+    UNUSED(format);
+    UNUSED(argptr);
+}
+
+static const hci_dump_t capture_dump = {
+    .reset = dump_reset,
+    .log_packet = dump_log_packet,
+    .log_message = dump_log_message,
+};
+
+// --- Capture Control ---
+
+static bool create_file(void) {
+    uint8_t header[BTSNOOP_FILE_HEADER_SIZE];
+    btsnoop_write_file_header(header);
+    if (!sd_logger_write_file(HCI_CAPTURE_FILE, header, sizeof(header))) {
+        printf("HCI capture: cannot create %s\n", HCI_CAPTURE_FILE);
+        return false;
+    }
+    capture_bytes = sizeof(header);
+    return true;
+}
+
+/**
+ * @brief Register the packet dump and start buffering with empty counters.
+ */
+static void start_buffering(void) {
+    if (!dump_registered) {
+        hci_dump_init(&capture_dump);
+        dump_registered = true;
+    }
+    capture_used = 0;
+    capture_packets = 0;
+    capture_drops = 0;
+    capture_active = true;
+    hci_dump_enable_packet_log(true);
+}
+
+static bool start_capture(void) {
+    if (!create_file()) return false;
+    start_buffering();
+    scheduler_run_in(&flush_task, HCI_CAPTURE_FLUSH_INTERVAL_MS);
+    printf("HCI capture to %s started\n", HCI_CAPTURE_FILE);
+    return true;
+}
+
+static void stop_capture(void) {
+    if (!capture_active) return;
+    flush_handler(&flush_task);
+    capture_active = false;
+    hci_dump_enable_packet_log(false);
+    scheduler_cancel(&flush_task);
+    printf("HCI capture stopped: %lu packets, %lu dropped\n",
+           (unsigned long)capture_packets, (unsigned long)capture_drops);
+}
+
+/**
+ * @brief Appends the buffered packets to the capture file.
+ */
+static void flush_handler(scheduler_task_t *task) {
+    if (capture_used > 0) {
+        if (!sd_logger_append_file(HCI_CAPTURE_FILE, capture_buffer, capture_used)) {
+            printf("HCI capture: write failed, stopping\n");
+            capture_used = 0;
+            stop_capture();
+            return;
+        }
+        capture_bytes += capture_used;
+        capture_used = 0;
+    }
+    if (capture_active) scheduler_run_in(task, HCI_CAPTURE_FLUSH_INTERVAL_MS);
+}
+
+void hci_capture_init(void) {
+    scheduler_task_init(&flush_task, "hci_capture", SCHEDULER_PRIORITY_LOW, flush_handler, NULL);
+
+    // The mode is on the card, which is still mounting: keep what fits in RAM until it is known
+    start_buffering();
+    capture_pending = true;
+}
+
+void hci_capture_card_ready(void) {
+    if (!capture_pending) return;
+    capture_pending = false;
+
+    uint8_t mode = 0;
+    sd_logger_read_file(HCI_CAPTURE_MODE_FILE, &mode, 1);
+    if ((HCI_CAPTURE_AT_BOOT || mode == '1') && create_file()) {
+        printf("HCI capture to %s started, %lu packets since power-on\n",
+               HCI_CAPTURE_FILE, (unsigned long)capture_packets);
+        scheduler_run_in(&flush_task, 0);
+        return;
+    }
+
+    capture_active = false;
+    hci_dump_enable_packet_log(false);
+    capture_used = 0;
+    capture_packets = 0;
+    capture_drops = 0;
+}
+
+bool hci_capture_set_mode(bool on) {
+    uint8_t mode = on ? '1' : '0';
+    bool saved = sd_logger_write_file(HCI_CAPTURE_MODE_FILE, &mode, 1);
+    if (!on) {
+        stop_capture();
+        return saved;
+    }
+    return saved && (capture_active || start_capture());
+}
+
+bool hci_capture_is_active(void) {
+    return capture_active;
+}
+
+void hci_capture_app_event(uint8_t packet_type, const uint8_t *packet, uint16_t size) {
+    if (!capture_active || packet_type != HCI_EVENT_PACKET || size == 0) return;
+    if (packet[0] < APP_EVENT_FIRST || packet[0] > APP_EVENT_LAST) return;
+    dump_log_packet(HCI_EVENT_PACKET, 1, (uint8_t *)packet, size);
+}
+
+size_t hci_capture_format_status(char *buffer, size_t buffer_size) {
+    int n = snprintf(buffer, buffer_size, "capture,%s\nfile,%s\npackets,%lu\ndropped,%lu\nbytes,%lu\n",
+                     capture_pending ? "pending" : capture_active ? "on" : "off", HCI_CAPTURE_FILE,
+                     (unsigned long)capture_packets, (unsigned long)capture_drops,
+                     (unsigned long)(capture_bytes + capture_used));
+    if (n < 0) return 0;
+    return (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+}
@@ -0,0 +1,82 @@
+#ifndef HCI_CAPTURE_H
+#define HCI_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * HCI capture to the SD card.
+ *
+ * Plugs into BTstack's packet dump (hci_dump) and writes every HCI command,
+ * event and ACL packet to HCI_CAPTURE_FILE in BTSnoop format (btsnoop.h), so
+ * captures open in Wireshark and can be replayed through the firmware's event
+ * handlers on a PC (tools/miflora_replay). GATT client and ATT server events
+ * go straight from BTstack to our callbacks without passing the packet dump,
+ * so the handlers add those with hci_capture_app_event().
+ *
+ * Packets are buffered in RAM and appended to the card by a low-priority task;
+ * a packet that doesn't fit the buffer is dropped and counted in the file.
+ *
+ * Capture mode is saved on the card: "CAPTURE:ON" starts a new capture right
+ * away and from then on at every boot, so the capture covers everything since
+ * power-on (which a replay needs). "CAPTURE:OFF" stops it. The card mounts
+ * while BTstack powers on, so packets are buffered from power-on until the
+ * mode can be read; the buffer then goes to the file or is discarded.
+ */
+
+#define HCI_CAPTURE_FILE      "HCI.LOG"
+#define HCI_CAPTURE_MODE_FILE "HCI.CFG" // "1" = capture from boot
+
+// Capture from boot even without the mode file
+#ifndef HCI_CAPTURE_AT_BOOT
+#define HCI_CAPTURE_AT_BOOT 0
+#endif
+
+// RAM buffer between the packet dump and the card
+#ifndef HCI_CAPTURE_BUFFER_SIZE
+#define HCI_CAPTURE_BUFFER_SIZE 4096
+#endif
+
+// Bytes kept per packet; longer ones (log streams to the phone) are cut
+#ifndef HCI_CAPTURE_SNAPLEN
+#define HCI_CAPTURE_SNAPLEN 128
+#endif
+
+#define HCI_CAPTURE_FLUSH_INTERVAL_MS 500
+
+/**
+ * @brief Start buffering packets. Call before BTstack is powered on.
+ */
+void hci_capture_init(void);
+
+/**
+ * @brief Keep capturing to the card if capture mode is on, otherwise stop and
+ * discard the buffer. Call once sd_logger_is_ready().
+ */
+void hci_capture_card_ready(void);
+
+/**
+ * @brief Turn capture mode on (new capture now and at every boot) or off.
+ * @return false if the mode could not be saved or the capture file not created.
+ */
+bool hci_capture_set_mode(bool on);
+
+/**
+ * @brief Whether packets are being captured.
+ */
+bool hci_capture_is_active(void);
+
+/**
+ * @brief Capture a GATT client / ATT server event delivered to a handler.
+ * Other packets are ignored, BTstack's packet dump already has them.
+ */
+void hci_capture_app_event(uint8_t packet_type, const uint8_t *packet, uint16_t size);
+
+/**
+ * @brief Format the capture state and counters as CSV text.
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t hci_capture_format_status(char *buffer, size_t buffer_size);
+
+#endif // HCI_CAPTURE_H
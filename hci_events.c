@@ -0,0 +1,119 @@
+#include "hci_events.h"
+#include <stdio.h>
+#include "miflora_client.h"
+#include "ble_server.h"
+#include "hci_capture.h"
+#include "trace.h"
+#include "boot_profile.h"
+
+static void (*stack_ready_callback)(void);
+
+void hci_events_init(void (*stack_ready_handler)(void)) {
+    stack_ready_callback = stack_ready_handler;
+}
+
+/**
+ * @brief Advertises as "MiFlora Logger" unless a phone is already connected.
+ */
+static void advertise_if_no_phone(void){
+    if (ble_server_get_con_handle() == HCI_CON_HANDLE_INVALID) {
+        ble_server_start_advertising();
+    }
+}
+
+/**
+ * @brief Main HCI event handler (scan, connect, disconnect)
+ * Events are routed by connection role/handle, so the client (MiFlora)
+ * and server (phone) connections can be active at the same time.
+ */
+static void handle_hci_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) {
+    UNUSED(size);
+    UNUSED(channel);
+    bd_addr_t local_addr;
+    if (packet_type != HCI_EVENT_PACKET) return;
+
+    uint8_t event_type = hci_event_packet_get_type(packet);
+
+    // Delegate GATT client events; the client routes them to the sensor connection by handle
+    if (event_type == GATT_EVENT_SERVICE_QUERY_RESULT ||
+        event_type == GATT_EVENT_CHARACTERISTIC_QUERY_RESULT ||
+        event_type == GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT ||
+        event_type == GATT_EVENT_QUERY_COMPLETE) {
+
+        miflora_client_handle_gatt_event(packet_type, channel, packet, size);
+        return;
+    }
+
+    // ATT server events skip the HCI packet log; HCI events are already in it
+    hci_capture_app_event(packet_type, packet, size);
+
+    switch(event_type){
+        case BTSTACK_EVENT_STATE:
+            if (btstack_event_state_get_state(packet) == HCI_STATE_WORKING) {
+                boot_profile_mark(BOOT_PHASE_STACK_UP);
+                gap_local_bd_addr(local_addr);
+                printf("BTstack up and running on %s.\n", bd_addr_to_str(local_addr));
+                miflora_client_set_state(FLORA_IDLE);
+                advertise_if_no_phone();
+                if (stack_ready_callback) stack_ready_callback();
+            } else {
+                miflora_client_set_state(FLORA_OFF);
+            }
+            break;
+
+        case GAP_EVENT_ADVERTISING_REPORT:
+            // This is a client-role event
+            miflora_client_handle_hci_event(packet_type, channel, packet, size);
+            break;
+
+        case HCI_EVENT_LE_META:
+            switch (hci_event_le_meta_get_subevent_code(packet)) {
+                case HCI_SUBEVENT_LE_CONNECTION_COMPLETE:
+                    // No handle is known yet for a new link, so route by role:
+                    // we are central only on links we opened to a MiFlora, and
+                    // only our own connection attempts can complete with an error.
+                    if (hci_subevent_le_connection_complete_get_role(packet) == HCI_ROLE_MASTER ||
+                        hci_subevent_le_connection_complete_get_status(packet) != ERROR_CODE_SUCCESS) {
+                        miflora_client_handle_hci_event(packet_type, channel, packet, size);
+                    } else {
+                        // This is a server connection *to* us (e.g., a phone)
+                        ble_server_handle_hci_event(packet_type, channel, packet, size);
+                    }
+                    break;
+                default:
+                    break;
+            }
+            break;
+
+        case ATT_EVENT_CAN_SEND_NOW:
+            // Server-role event (deferred live reading notification)
+            ble_server_handle_hci_event(packet_type, channel, packet, size);
+            break;
+
+        case HCI_EVENT_DISCONNECTION_COMPLETE:
+            {
+                hci_con_handle_t disconnected_handle = hci_event_disconnection_complete_get_connection_handle(packet);
+
+                if (ble_server_get_con_handle() == disconnected_handle){
+                    ble_server_set_con_handle(HCI_CON_HANDLE_INVALID);
+                    TRACE(SERVER_DISCONNECTED, disconnected_handle, 0);
+                    advertise_if_no_phone(); // Let the next phone find us
+                }
+
+                if (miflora_client_has_connection(disconnected_handle)){
+                    // That context moves on to the next sensor (or the cycle ends)
+                    miflora_client_handle_hci_event(packet_type, channel, packet, size);
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void hci_events_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) {
+    uint32_t start_us = trace_latency_begin();
+    handle_hci_event(packet_type, channel, packet, size);
+    trace_latency_end(TRACE_CALLBACK_HCI_EVENT, start_us);
+}
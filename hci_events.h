@@ -0,0 +1,34 @@
+#ifndef HCI_EVENTS_H
+#define HCI_EVENTS_H
+
+#include <stdint.h>
+#include "btstack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Routes BTstack events to the client (MiFlora) and server (phone) roles.
+ *
+ * Only depends on BTstack and the two role modules, so the host replay tool
+ * (tools/miflora_replay) can feed captured events through the same code.
+ */
+
+/**
+ * @brief Set up the router.
+ * @param stack_ready_handler Called once BTstack is up and the roles are ready.
+ */
+void hci_events_init(void (*stack_ready_handler)(void));
+
+/**
+ * @brief Main HCI / ATT server packet handler (scan, connect, disconnect).
+ * Register with hci_add_event_handler() and ble_server_init().
+ */
+void hci_events_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HCI_EVENTS_H
@@ -0,0 +1,391 @@
+#include "irrigation.h"
+#include <stdlib.h>
+#include <string.h>
+#include "buffer_util.h"
+#include "log_frame.h"
+#include "time_util.h"
+
+static const char * const setting_names[IRRIGATION_NUM_SETTINGS] = {
+#define IRRIGATION_X_NAME(id, name, def, min, max) name,
+    IRRIGATION_SETTINGS(IRRIGATION_X_NAME)
+#undef IRRIGATION_X_NAME
+};
+
+static const uint32_t setting_defaults[IRRIGATION_NUM_SETTINGS] = {
+#define IRRIGATION_X_DEFAULT(id, name, def, min, max) def,
+    IRRIGATION_SETTINGS(IRRIGATION_X_DEFAULT)
+#undef IRRIGATION_X_DEFAULT
+};
+
+static const uint32_t setting_min[IRRIGATION_NUM_SETTINGS] = {
+#define IRRIGATION_X_MIN(id, name, def, min, max) min,
+    IRRIGATION_SETTINGS(IRRIGATION_X_MIN)
+#undef IRRIGATION_X_MIN
+};
+
+static const uint32_t setting_max[IRRIGATION_NUM_SETTINGS] = {
+#define IRRIGATION_X_MAX(id, name, def, min, max) max,
+    IRRIGATION_SETTINGS(IRRIGATION_X_MAX)
+#undef IRRIGATION_X_MAX
+};
+
+static const char * const reason_names[IRRIGATION_NUM_REASONS] = {
+#define IRRIGATION_X_REASON_NAME(id, name) name,
+    IRRIGATION_REASONS(IRRIGATION_X_REASON_NAME)
+#undef IRRIGATION_X_REASON_NAME
+};
+
+static bool enabled = false;
+static uint32_t settings[IRRIGATION_NUM_SETTINGS];
+static irrigation_sensor_t sensors[IRRIGATION_MAX_SENSORS];
+
+// --- Rolling Window ---
+
+static void clear_window(irrigation_sensor_t *s) {
+    s->count = 0;
+}
+
+static void drop_oldest(irrigation_sensor_t *s, uint8_t n) {
+    memmove(s->times, s->times + n, (s->count - n) * sizeof(s->times[0]));
+    memmove(s->moisture, s->moisture + n, (s->count - n) * sizeof(s->moisture[0]));
+    s->count -= n;
+}
+
+/**
+ * @brief Add a reading, dropping the oldest when full and those older than the span.
+ */
+static void push_reading(irrigation_sensor_t *s, uint32_t time, uint8_t moisture) {
+    if (s->count == IRRIGATION_WINDOW) drop_oldest(s, 1);
+    s->times[s->count] = time;
+    s->moisture[s->count] = moisture;
+    s->count++;
+
+    uint8_t stale = 0;
+    while (stale < s->count && time - s->times[stale] > IRRIGATION_WINDOW_SPAN_S) stale++;
+    if (stale > 0) drop_oldest(s, stale);
+}
+
+static uint8_t window_median(const irrigation_sensor_t *s) {
+    if (s->count == 0) return 0;
+    uint8_t sorted[IRRIGATION_WINDOW];
+    for (uint8_t i = 0; i < s->count; i++) {
+        uint8_t v = s->moisture[i];
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    uint8_t mid = s->count / 2;
+    return s->count % 2 ? sorted[mid] : (uint8_t)((sorted[mid - 1] + sorted[mid] + 1) / 2);
+}
+
+/**
+ * @brief Least-squares slope of the window, hundredths of % per hour.
+ */
+static int32_t window_trend(const irrigation_sensor_t *s) {
+    int64_t n = s->count, st = 0, sm = 0, stt = 0, stm = 0;
+    for (uint8_t i = 0; i < s->count; i++) {
+        int64_t t = s->times[i] - s->times[0];
+        st += t;
+        sm += s->moisture[i];
+        stt += t * t;
+        stm += t * s->moisture[i];
+    }
+    int64_t den = n * stt - st * st;
+    if (n < 2 || den == 0) return 0;
+    return (int32_t)((n * stm - st * sm) * 360000 / den);
+}
+
+// --- Controller ---
+
+static void reset_sensor(irrigation_sensor_t *s) {
+    s->episode = false;
+    s->checking = false;
+    s->fault = false;
+    s->no_response = 0;
+    s->soak_until = 0;
+    s->gain = IRRIGATION_INITIAL_GAIN;
+}
+
+/**
+ * @brief First reading after a soak: how much did the last run raise the moisture?
+ * A rise updates the learned gain. No rise halves it, so the next run is
+ * longer, until IRRIGATION_FAULT_RUNS in a row stop the watering.
+ * @return false if the sensor is now in fault.
+ */
+static bool check_response(irrigation_sensor_t *s, uint8_t moisture) {
+    int rise = (int)moisture - (int)s->before;
+    uint32_t gain;
+    if (rise >= IRRIGATION_MIN_RISE_PCT) {
+        uint32_t measured = (uint32_t)rise * 100000u / (s->last_run_ms ? s->last_run_ms : 1);
+        gain = (3u * s->gain + measured) / 4u;
+        s->no_response = 0;
+    } else {
+        gain = s->gain / 2u;
+        if (++s->no_response >= IRRIGATION_FAULT_RUNS) {
+            s->fault = true;
+            s->episode = false;
+        }
+    }
+    if (gain < IRRIGATION_MIN_GAIN) gain = IRRIGATION_MIN_GAIN;
+    if (gain > IRRIGATION_MAX_GAIN) gain = IRRIGATION_MAX_GAIN;
+    s->gain = (uint16_t)gain;
+    return !s->fault;
+}
+
+/**
+ * @brief Pump time to bring the median up to high with the learned gain.
+ */
+static uint32_t size_run(const irrigation_sensor_t *s, uint8_t median) {
+    uint32_t high = settings[IRRIGATION_SET_HIGH];
+    uint32_t deficit = median < high ? high - median : 1;
+    uint32_t run_ms = deficit * 100000u / s->gain;
+    if (run_ms < settings[IRRIGATION_SET_MIN_MS]) run_ms = settings[IRRIGATION_SET_MIN_MS];
+    if (run_ms > settings[IRRIGATION_SET_MAX_MS]) run_ms = settings[IRRIGATION_SET_MAX_MS];
+    return run_ms;
+}
+
+// --- Public Function Implementations ---
+
+void irrigation_init(void) {
+    enabled = false;
+    memcpy(settings, setting_defaults, sizeof(settings));
+    memset(sensors, 0, sizeof(sensors));
+    for (int i = 0; i < IRRIGATION_MAX_SENSORS; i++) reset_sensor(&sensors[i]);
+}
+
+void irrigation_set_enabled(bool on) {
+    enabled = on;
+}
+
+bool irrigation_is_enabled(void) {
+    return enabled;
+}
+
+bool irrigation_configure(const char *setting) {
+    const char *equals = strchr(setting, '=');
+    if (equals == NULL || equals[1] < '0' || equals[1] > '9') return false;
+    char *end;
+    unsigned long value = strtoul(equals + 1, &end, 10);
+    if (*end != '\0') return false;
+
+    size_t name_len = (size_t)(equals - setting);
+    for (int i = 0; i < IRRIGATION_NUM_SETTINGS; i++) {
+        if (strlen(setting_names[i]) != name_len || memcmp(setting_names[i], setting, name_len) != 0) continue;
+        if (value < setting_min[i] || value > setting_max[i]) return false;
+
+        uint32_t updated[IRRIGATION_NUM_SETTINGS];
+        memcpy(updated, settings, sizeof(updated));
+        updated[i] = (uint32_t)value;
+        if (updated[IRRIGATION_SET_LOW] >= updated[IRRIGATION_SET_HIGH] ||
+            updated[IRRIGATION_SET_MIN_MS] > updated[IRRIGATION_SET_MAX_MS]) {
+            return false;
+        }
+        memcpy(settings, updated, sizeof(settings));
+        return true;
+    }
+    return false;
+}
+
+uint32_t irrigation_get_setting(irrigation_setting_t setting) {
+    return settings[setting];
+}
+
+void irrigation_reset(void) {
+    for (int i = 0; i < IRRIGATION_MAX_SENSORS; i++) reset_sensor(&sensors[i]);
+}
+
+bool irrigation_decide(int sensor, const uint8_t addr[6], uint32_t time, uint8_t moisture,
+                       irrigation_decision_t *d) {
+    if (!enabled || sensor < 0 || sensor >= IRRIGATION_MAX_SENSORS) return false;
+    irrigation_sensor_t *s = &sensors[sensor];
+    uint32_t soak_s = settings[IRRIGATION_SET_SOAK_MIN] * 60u;
+
+    memset(d, 0, sizeof(*d));
+    d->time = time;
+    memcpy(d->addr, addr, 6);
+    d->sensor = (uint8_t)sensor;
+    d->moisture = moisture;
+
+    // Clock set back, or a long gap: the window no longer describes the soil
+    if (s->last_time != 0 && (time < s->last_time || time - s->last_time > IRRIGATION_WINDOW_SPAN_S)) {
+        clear_window(s);
+    }
+    if (s->soak_until > time + soak_s) s->soak_until = time + soak_s;
+    s->last_time = time;
+    if (time / 86400u != s->day) {
+        s->day = time / 86400u;
+        s->used_ms = 0;
+    }
+
+    d->gain = s->gain;
+    if (time < s->soak_until) {
+        d->reason = IRRIGATION_REASON_SOAKING;
+        return true;
+    }
+
+    push_reading(s, time, moisture);
+    d->median = window_median(s);
+    d->trend = window_trend(s);
+
+    if (s->checking) {
+        s->checking = false;
+        if (!check_response(s, moisture)) {
+            d->gain = s->gain;
+            d->reason = IRRIGATION_REASON_NO_RESPONSE;
+            return true;
+        }
+        d->gain = s->gain;
+    }
+    if (s->fault) {
+        d->reason = IRRIGATION_REASON_FAULT;
+        return true;
+    }
+    if (s->count < IRRIGATION_MIN_READINGS) {
+        d->reason = IRRIGATION_REASON_WARMUP;
+        return true;
+    }
+
+    // Hysteresis: start at low (or heading there), carry on until high
+    int32_t low = (int32_t)settings[IRRIGATION_SET_LOW];
+    int32_t predicted = d->median * 100 + d->trend * (int32_t)settings[IRRIGATION_SET_HORIZON_MIN] / 60;
+    if (s->episode) {
+        if (d->median >= settings[IRRIGATION_SET_HIGH]) {
+            s->episode = false;
+            d->reason = IRRIGATION_REASON_TARGET;
+            return true;
+        }
+        d->reason = IRRIGATION_REASON_TOPUP;
+    } else if (d->median <= low) {
+        d->reason = IRRIGATION_REASON_DRY;
+    } else if (d->trend < 0 && predicted <= low * 100) {
+        d->reason = IRRIGATION_REASON_TREND;
+    } else {
+        d->reason = IRRIGATION_REASON_MOIST;
+        return true;
+    }
+    s->episode = true;
+
+    uint32_t daily = settings[IRRIGATION_SET_DAILY_MS];
+    uint32_t remaining = s->used_ms < daily ? daily - s->used_ms : 0;
+    if (remaining < settings[IRRIGATION_SET_MIN_MS]) {
+        d->reason = IRRIGATION_REASON_DAILY_LIMIT;
+        return true;
+    }
+    uint32_t run_ms = size_run(s, d->median);
+    if (run_ms > remaining) run_ms = remaining;
+
+    // Run, then wait for the water to soak in and judge from a fresh window
+    s->used_ms += run_ms;
+    s->runs++;
+    s->last_run_ms = run_ms;
+    s->before = d->median;
+    s->soak_until = time + soak_s;
+    s->checking = true;
+    clear_window(s);
+    d->run_ms = run_ms;
+    return true;
+}
+
+const irrigation_sensor_t *irrigation_get(int sensor) {
+    return sensor >= 0 && sensor < IRRIGATION_MAX_SENSORS ? &sensors[sensor] : NULL;
+}
+
+const char *irrigation_reason_name(irrigation_reason_t reason) {
+    return reason < IRRIGATION_NUM_REASONS ? reason_names[reason] : "?";
+}
+
+// --- Reports ---
+
+// Hundredths as a decimal, e.g. -42 as "-0.42"
+static void append_hundredths(char *buffer, size_t buffer_size, size_t *used, int32_t value, char end) {
+    uint32_t magnitude = value < 0 ? (uint32_t)-value : (uint32_t)value;
+    buffer_util_append(buffer, buffer_size, used, "%s%lu.%02lu%c", value < 0 ? "-" : "",
+           (unsigned long)(magnitude / 100), (unsigned long)(magnitude % 100), end);
+}
+
+size_t irrigation_format_decision(const irrigation_decision_t *d, char *buffer, size_t buffer_size) {
+    int year, month, day, hour, min, sec;
+    time_util_from_epoch(d->time, &year, &month, &day, &hour, &min, &sec);
+    size_t used = 0;
+    buffer[0] = '\0';
+    buffer_util_append(buffer, buffer_size, &used, "%04d-%02d-%02dT%02d:%02d:%02d,%02X%02X%02X%02X%02X%02X,%u,%u,",
+           year, month, day, hour, min, sec,
+           d->addr[0], d->addr[1], d->addr[2], d->addr[3], d->addr[4], d->addr[5],
+           d->moisture, d->median);
+    append_hundredths(buffer, buffer_size, &used, d->trend, ',');
+    buffer_util_append(buffer, buffer_size, &used, "%lu,%s,", (unsigned long)d->run_ms, irrigation_reason_name(d->reason));
+    append_hundredths(buffer, buffer_size, &used, d->gain, '\n');
+    return used;
+}
+
+size_t irrigation_format(char *buffer, size_t buffer_size) {
+    size_t used = 0;
+    buffer[0] = '\0';
+    buffer_util_append(buffer, buffer_size, &used, "irrigation,%s\n", enabled ? "on" : "off");
+    for (int i = 0; i < IRRIGATION_NUM_SETTINGS; i++) {
+        buffer_util_append(buffer, buffer_size, &used, "%s,%lu\n", setting_names[i], (unsigned long)settings[i]);
+    }
+    buffer_util_append(buffer, buffer_size, &used, "sensor,median,trend_per_h,state,gain,runs,today_ms\n");
+    for (int i = 0; i < IRRIGATION_MAX_SENSORS; i++) {
+        const irrigation_sensor_t *s = &sensors[i];
+        if (s->last_time == 0 && s->runs == 0) continue;
+        const char *state = s->fault ? "fault" : s->checking ? "soaking" : s->episode ? "watering" : "idle";
+        buffer_util_append(buffer, buffer_size, &used, "%d,%u,", i, window_median(s));
+        append_hundredths(buffer, buffer_size, &used, window_trend(s), ',');
+        buffer_util_append(buffer, buffer_size, &used, "%s,", state);
+        append_hundredths(buffer, buffer_size, &used, s->gain, ',');
+        buffer_util_append(buffer, buffer_size, &used, "%lu,%lu\n", (unsigned long)s->runs, (unsigned long)s->used_ms);
+    }
+    return used;
+}
+
+// --- Persistence ---
+
+size_t irrigation_save(uint8_t *buffer, size_t buffer_size) {
+    if (buffer_size < IRRIGATION_SAVED_SIZE) return 0;
+
+    uint8_t *p = buffer;
+    p = buffer_util_put_u32(p, IRRIGATION_MAGIC);
+    *p++ = enabled;
+    for (int i = 0; i < IRRIGATION_NUM_SETTINGS; i++) p = buffer_util_put_u32(p, settings[i]);
+    for (int i = 0; i < IRRIGATION_MAX_SENSORS; i++) {
+        const irrigation_sensor_t *s = &sensors[i];
+        *p++ = (uint8_t)s->gain;
+        *p++ = (uint8_t)(s->gain >> 8);
+        *p++ = s->fault;
+        *p++ = s->episode;
+        p = buffer_util_put_u32(p, s->soak_until);
+        p = buffer_util_put_u32(p, s->day);
+        p = buffer_util_put_u32(p, s->used_ms);
+        p = buffer_util_put_u32(p, s->runs);
+    }
+    uint16_t crc = log_frame_crc16((const char *)buffer, (size_t)(p - buffer));
+    *p++ = (uint8_t)crc;
+    *p++ = (uint8_t)(crc >> 8);
+    return (size_t)(p - buffer);
+}
+
+bool irrigation_load(const uint8_t *buffer, size_t size) {
+    const size_t crc_at = IRRIGATION_SAVED_SIZE - 2;
+    if (size != IRRIGATION_SAVED_SIZE || buffer_util_get_u32(buffer) != IRRIGATION_MAGIC ||
+        (uint16_t)(buffer[crc_at] | buffer[crc_at + 1] << 8) != log_frame_crc16((const char *)buffer, crc_at)) {
+        return false;
+    }
+
+    const uint8_t *p = buffer + 4;
+    enabled = *p++ != 0;
+    for (int i = 0; i < IRRIGATION_NUM_SETTINGS; i++, p += 4) settings[i] = buffer_util_get_u32(p);
+    for (int i = 0; i < IRRIGATION_MAX_SENSORS; i++, p += 20) {
+        irrigation_sensor_t *s = &sensors[i];
+        memset(s, 0, sizeof(*s));
+        s->gain = (uint16_t)(p[0] | p[1] << 8);
+        s->fault = p[2] != 0;
+        s->episode = p[3] != 0;
+        s->soak_until = buffer_util_get_u32(p + 4);
+        s->day = buffer_util_get_u32(p + 8);
+        s->used_ms = buffer_util_get_u32(p + 12);
+        s->runs = buffer_util_get_u32(p + 16);
+        if (s->gain < IRRIGATION_MIN_GAIN || s->gain > IRRIGATION_MAX_GAIN) s->gain = IRRIGATION_INITIAL_GAIN;
+    }
+    return true;
+}
@@ -0,0 +1,259 @@
+#ifndef IRRIGATION_H
+#define IRRIGATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sensor_health.h" // For SENSOR_HEALTH_MAX_SENSORS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Closed-loop watering, one controller per sensor.
+ *
+ * Every reading goes through the controller of its sensor right after it is
+ * logged, and every decision is logged in turn (irrigation_port.c). The
+ * controller works on a rolling window of the sensor's recent moisture
+ * readings:
+ * - The median of the window is the moisture level, so a single odd
+ *   reading cannot start the pump. A least-squares fit gives the trend.
+ * - Hysteresis: a watering episode starts when the median is at or below
+ *   "low", or the trend reaches "low" within the horizon. It ends once the
+ *   median is at or above "high".
+ * - Soak model: water takes a while to reach the sensor. After each run the
+ *   controller ignores readings for "soak_min", then restarts its window.
+ *   It learns the rise per pump second from what it sees, and sizes the
+ *   next run to close the gap to "high".
+ * - Limits: each run lasts between "min_ms" and "max_ms", and a sensor gets
+ *   at most "daily_ms" of pumping per day. If IRRIGATION_FAULT_RUNS runs in
+ *   a row bring no rise (empty tank, pump or sensor out of the soil),
+ *   watering stops for that sensor until it is reset.
+ *
+ * The core has no Pico or BTstack dependencies. tools/miflora_irrigate
+ * replays recorded daily logs through it.
+ */
+
+// Default settings, overridable at build time or with irrigation_configure()
+#ifndef IRRIGATION_LOW_PCT
+#define IRRIGATION_LOW_PCT 25
+#endif
+#ifndef IRRIGATION_HIGH_PCT
+#define IRRIGATION_HIGH_PCT 40
+#endif
+#ifndef IRRIGATION_SOAK_MIN
+#define IRRIGATION_SOAK_MIN 45
+#endif
+#ifndef IRRIGATION_HORIZON_MIN
+#define IRRIGATION_HORIZON_MIN 60
+#endif
+#ifndef IRRIGATION_MIN_RUN_MS
+#define IRRIGATION_MIN_RUN_MS 2000
+#endif
+#ifndef IRRIGATION_MAX_RUN_MS
+#define IRRIGATION_MAX_RUN_MS 20000
+#endif
+#ifndef IRRIGATION_DAILY_MAX_MS
+#define IRRIGATION_DAILY_MAX_MS 120000
+#endif
+
+// Settings: id, name in commands and reports, default, allowed range
+#define IRRIGATION_SETTINGS(X) \
+    X(LOW,         "low",         IRRIGATION_LOW_PCT,      0, 100)     /* %: an episode starts at or below */ \
+    X(HIGH,        "high",        IRRIGATION_HIGH_PCT,     1, 100)     /* %: an episode ends at or above */ \
+    X(SOAK_MIN,    "soak_min",    IRRIGATION_SOAK_MIN,     1, 1440)    /* Wait after a run */ \
+    X(HORIZON_MIN, "horizon_min", IRRIGATION_HORIZON_MIN,  0, 1440)    /* How far ahead the trend looks */ \
+    X(MIN_MS,      "min_ms",      IRRIGATION_MIN_RUN_MS,   100, 600000) \
+    X(MAX_MS,      "max_ms",      IRRIGATION_MAX_RUN_MS,   100, 600000) \
+    X(DAILY_MS,    "daily_ms",    IRRIGATION_DAILY_MAX_MS, 0, 3600000) /* Pump time per sensor and day */
+
+typedef enum {
+#define IRRIGATION_X_SETTING(id, name, def, min, max) IRRIGATION_SET_##id,
+    IRRIGATION_SETTINGS(IRRIGATION_X_SETTING)
+#undef IRRIGATION_X_SETTING
+    IRRIGATION_NUM_SETTINGS
+} irrigation_setting_t;
+
+#define IRRIGATION_MAX_SENSORS SENSOR_HEALTH_MAX_SENSORS
+#define IRRIGATION_WINDOW 8              // Readings in the rolling window
+#define IRRIGATION_WINDOW_SPAN_S (4 * 3600) // Older readings leave the window
+#define IRRIGATION_MIN_READINGS 3        // Needed in the window before deciding
+#define IRRIGATION_MIN_RISE_PCT 2        // Smaller rises after a run count as none
+#define IRRIGATION_FAULT_RUNS 3          // Runs in a row without a rise before watering stops
+
+// Response to the pump, in hundredths of a moisture % per pump second. The
+// first runs use the initial guess; each measured rise moves it a quarter of
+// the way.
+#define IRRIGATION_INITIAL_GAIN 50
+#define IRRIGATION_MIN_GAIN 5
+#define IRRIGATION_MAX_GAIN 1000
+
+// Why a decision was taken, with its name in the decision log
+#define IRRIGATION_REASONS(X) \
+    X(WARMUP,      "warmup")      /* Fewer than IRRIGATION_MIN_READINGS recent readings */ \
+    X(SOAKING,     "soaking")     /* The last run is still soaking in */ \
+    X(MOIST,       "moist")       /* Above low and not heading there */ \
+    X(TARGET,      "target")      /* Reached high: the episode ends */ \
+    X(DRY,         "dry")         /* At or below low: an episode starts */ \
+    X(TREND,       "trend")       /* Reaches low within the horizon: an episode starts */ \
+    X(TOPUP,       "topup")       /* Episode running, still below high */ \
+    X(DAILY_LIMIT, "daily_limit") /* Needs water, but today's pump time is used up */ \
+    X(NO_RESPONSE, "no_response") /* The last runs brought no rise: watering stops */ \
+    X(FAULT,       "fault")       /* Stopped after no_response, until reset */
+
+typedef enum {
+#define IRRIGATION_X_REASON(id, name) IRRIGATION_REASON_##id,
+    IRRIGATION_REASONS(IRRIGATION_X_REASON)
+#undef IRRIGATION_X_REASON
+    IRRIGATION_NUM_REASONS
+} irrigation_reason_t;
+
+// One decision, taken on one reading
+typedef struct {
+    uint32_t time;      // Reading time, seconds since 1970-01-01
+    uint8_t addr[6];    // Sensor
+    uint8_t sensor;     // Sensor index
+    uint8_t moisture;   // This reading, %
+    uint8_t median;     // Median of the window, % (0 when empty)
+    int32_t trend;      // Hundredths of % per hour
+    uint32_t run_ms;    // Pump time; 0 = no watering
+    uint16_t gain;      // Response used, hundredths of % per pump second
+    irrigation_reason_t reason;
+} irrigation_decision_t;
+
+#define IRRIGATION_LOG_HEADER "time,sensor,moisture,median,trend_per_h,run_ms,reason,gain\n"
+
+// Per-sensor controller
+typedef struct {
+    uint32_t times[IRRIGATION_WINDOW];
+    uint8_t moisture[IRRIGATION_WINDOW];
+    uint8_t count;         // Readings in the window, oldest first
+    uint32_t last_time;    // Last reading, 0 = none yet
+    bool episode;          // Watering until the median reaches high
+    bool checking;         // Waiting for the first reading after a soak
+    bool fault;
+    uint8_t no_response;   // Runs in a row without a rise
+    uint8_t before;        // Median when the last run started
+    uint32_t last_run_ms;
+    uint32_t soak_until;   // No decisions before this time
+    uint16_t gain;
+    uint32_t day;          // Day of used_ms, days since 1970-01-01
+    uint32_t used_ms;      // Pump time that day
+    uint32_t runs;         // Runs since the controller was reset
+} irrigation_sensor_t;
+
+/**
+ * Persisted form (little endian), see irrigation_save():
+ *   [0]  u32 magic "IRR1"
+ *   [4]  u8  enabled
+ *   [5]  u32 settings, in IRRIGATION_SETTINGS order
+ *   [..] per sensor: u16 gain, u8 fault, u8 episode, u32 soak_until,
+ *        u32 day, u32 used_ms, u32 runs
+ *   [..] u16 CRC-16 of everything before it
+ * The reading windows are not saved. After a reset they fill up again before
+ * the next decision.
+ */
+#define IRRIGATION_MAGIC 0x31525249u // "IRR1"
+#define IRRIGATION_SAVED_SIZE (5 + 4 * IRRIGATION_NUM_SETTINGS + 20 * IRRIGATION_MAX_SENSORS + 2)
+
+/**
+ * @brief Default settings, watering off, every controller reset.
+ */
+void irrigation_init(void);
+
+/**
+ * @brief Switch automatic watering on or off. While off, readings are not decided on.
+ */
+void irrigation_set_enabled(bool enabled);
+bool irrigation_is_enabled(void);
+
+/**
+ * @brief Apply a "name=value" setting from IRRIGATION_SETTINGS, e.g. "low=30".
+ * @return false if the name is unknown, the value is out of range or low >= high.
+ */
+bool irrigation_configure(const char *setting);
+
+uint32_t irrigation_get_setting(irrigation_setting_t setting);
+
+/**
+ * @brief Clear faults and learned responses; pump time used today is kept.
+ */
+void irrigation_reset(void);
+
+/**
+ * @brief Run one reading through its sensor's controller.
+ * @param sensor Sensor index (below IRRIGATION_MAX_SENSORS).
+ * @param time Reading time, seconds since 1970-01-01.
+ * @param moisture Moisture, %.
+ * @return false if watering is off or the sensor index is out of range
+ * (no decision). Otherwise the decision is in *decision; run_ms > 0 means
+ * run the pump that long.
+ */
+bool irrigation_decide(int sensor, const uint8_t addr[6], uint32_t time, uint8_t moisture,
+                       irrigation_decision_t *decision);
+
+/**
+ * @brief A sensor's controller (NULL if out of range).
+ */
+const irrigation_sensor_t *irrigation_get(int sensor);
+
+/**
+ * @brief Name of a reason in the decision log.
+ */
+const char *irrigation_reason_name(irrigation_reason_t reason);
+
+/**
+ * @brief Format a decision as one line of the decision log (IRRIGATION_LOG_HEADER columns).
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t irrigation_format_decision(const irrigation_decision_t *decision, char *buffer, size_t buffer_size);
+
+/**
+ * @brief Format the settings and each sensor's controller as CSV text.
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t irrigation_format(char *buffer, size_t buffer_size);
+
+/**
+ * @brief Serialize the settings and controllers (IRRIGATION_SAVED_SIZE bytes).
+ */
+size_t irrigation_save(uint8_t *buffer, size_t buffer_size);
+
+/**
+ * @brief Restore what irrigation_save() wrote.
+ * @return false if the data is not a valid saved state (nothing is changed).
+ */
+bool irrigation_load(const uint8_t *buffer, size_t size);
+
+// --- Firmware (irrigation_port.c) ---
+
+#define IRRIGATION_LOG_FILE "IRRIGATE.CSV"   // One line per decision
+#define IRRIGATION_STATE_FILE "IRRIGATE.DAT" // irrigation_save(), after every change
+
+/**
+ * @brief Set up the controller and its task. Call on core 0 before the scheduler runs.
+ */
+void irrigation_port_init(void);
+
+/**
+ * @brief Restore the settings and controllers from the card. Call once it is ready.
+ */
+void irrigation_port_load(void);
+
+/**
+ * @brief Hand over a reading that was just logged. The decision is taken,
+ * logged and acted on from a task, outside the BTstack callback.
+ */
+void irrigation_port_reading(int sensor, const uint8_t addr[6], uint8_t moisture);
+
+/**
+ * @brief Save the settings and controllers to IRRIGATION_STATE_FILE.
+ */
+bool irrigation_port_save(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IRRIGATION_H
@@ -0,0 +1,106 @@
+#include "irrigation.h"
+#include <stdio.h>
+#include <string.h>
+#include "clock_drift.h"
+#include "scheduler.h"
+#include "sd_logger.h"
+
+#define PUMP_RETRY_MS 1000 // While the pump is busy with another run
+
+extern bool start_pump_for(uint32_t duration_ms); // From main.c
+
+// Latest reading of each sensor, waiting for the task
+typedef struct {
+    bool pending;
+    uint32_t time;
+    uint8_t addr[6];
+    uint8_t moisture;
+} irrigation_input_t;
+
+static scheduler_task_t irrigation_task;
+static irrigation_input_t inputs[IRRIGATION_MAX_SENSORS];
+static uint32_t queued_ms[IRRIGATION_MAX_SENSORS]; // Runs waiting for the pump
+
+/**
+ * @brief Append one decision to the log, with the header on a new file.
+ */
+static void log_decision(const irrigation_decision_t *decision) {
+    char line[96];
+    size_t used = irrigation_format_decision(decision, line, sizeof(line));
+    printf("Irrigation: %s", line);
+
+    uint8_t probe;
+    if (sd_logger_read_file(IRRIGATION_LOG_FILE, &probe, 1) == 0) {
+        sd_logger_append_file(IRRIGATION_LOG_FILE, (const uint8_t *)IRRIGATION_LOG_HEADER,
+                              strlen(IRRIGATION_LOG_HEADER));
+    }
+    if (!sd_logger_append_file(IRRIGATION_LOG_FILE, (const uint8_t *)line, used)) {
+        printf("Irrigation: decision not logged\n");
+    }
+}
+
+/**
+ * @brief Decides on new readings, then starts queued runs one at a time.
+ * Sensors share the pump, so a run waits while another one is going.
+ */
+static void irrigation_handler(scheduler_task_t *task) {
+    bool changed = false;
+    for (int i = 0; i < IRRIGATION_MAX_SENSORS; i++) {
+        if (!inputs[i].pending) continue;
+        inputs[i].pending = false;
+
+        irrigation_decision_t decision;
+        if (!irrigation_decide(i, inputs[i].addr, inputs[i].time, inputs[i].moisture, &decision)) continue;
+        log_decision(&decision);
+        queued_ms[i] += decision.run_ms;
+        changed |= decision.run_ms > 0 || decision.reason == IRRIGATION_REASON_TARGET ||
+                   decision.reason == IRRIGATION_REASON_NO_RESPONSE;
+    }
+    if (changed && !irrigation_port_save()) {
+        printf("Irrigation: state not saved\n");
+    }
+
+    for (int i = 0; i < IRRIGATION_MAX_SENSORS; i++) {
+        if (queued_ms[i] == 0) continue;
+        if (start_pump_for(queued_ms[i])) {
+            printf("Irrigation: pump on for %lu ms for sensor %d\n", (unsigned long)queued_ms[i], i);
+            queued_ms[i] = 0;
+        }
+        scheduler_run_in(task, PUMP_RETRY_MS); // For the next queued run
+        return;
+    }
+}
+
+// --- Public Function Implementations ---
+
+void irrigation_port_init(void) {
+    irrigation_init();
+    scheduler_task_init(&irrigation_task, "irrigation", SCHEDULER_PRIORITY_HIGH, irrigation_handler, NULL);
+}
+
+void irrigation_port_load(void) {
+    uint8_t saved[IRRIGATION_SAVED_SIZE];
+    if (irrigation_load(saved, sd_logger_read_file(IRRIGATION_STATE_FILE, saved, sizeof(saved)))) {
+        printf("Irrigation %s, state restored from %s\n", irrigation_is_enabled() ? "on" : "off",
+               IRRIGATION_STATE_FILE);
+    }
+}
+
+void irrigation_port_reading(int sensor, const uint8_t addr[6], uint8_t moisture) {
+    if (!irrigation_is_enabled() || sensor < 0 || sensor >= IRRIGATION_MAX_SENSORS) return;
+    uint32_t time;
+    if (!clock_drift_port_now(&time)) return;
+
+    irrigation_input_t *input = &inputs[sensor];
+    input->pending = true;
+    input->time = time;
+    memcpy(input->addr, addr, 6);
+    input->moisture = moisture;
+    scheduler_run_in(&irrigation_task, 0);
+}
+
+bool irrigation_port_save(void) {
+    uint8_t saved[IRRIGATION_SAVED_SIZE];
+    size_t size = irrigation_save(saved, sizeof(saved));
+    return sd_logger_write_file(IRRIGATION_STATE_FILE, saved, size);
+}
@@ -0,0 +1,106 @@
+#include "log_archive.h"
+#include <string.h>
+#include "time_util.h"
+
+static void store_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// --- Public Function Implementations ---
+
+bool log_archive_parse_line(const char *line, size_t length, log_record_t *record) {
+    // Strip line ending
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) length--;
+    if (length < 19 || !time_util_parse_iso(line, &record->time)) return false;
+
+    memset(record->sensor, 0, sizeof(record->sensor));
+    uint32_t found = 0;
+    const char *end = line + length;
+    const char *p = line + 19;
+
+    while (p < end) {
+        if (*p != ',') return false;
+        p++;
+        const char *token_end = memchr(p, ',', (size_t)(end - p));
+        if (token_end == NULL) token_end = end;
+        const char *colon = memchr(p, ':', (size_t)(token_end - p));
+        if (colon == NULL) return false;
+        size_t key_len = (size_t)(colon - p);
+
+        if (key_len == 6 && memcmp(p, "Sensor", 6) == 0) {
+            if (token_end - colon - 1 != 12) return false;
+            for (int i = 0; i < 6; i++) {
+                int hi = hex_value(colon[1 + 2 * i]);
+                int lo = hex_value(colon[2 + 2 * i]);
+                if (hi < 0 || lo < 0) return false;
+                record->sensor[i] = (uint8_t)(hi << 4 | lo);
+            }
+        } else {
+            int f = reading_find_key(p, key_len);
+            if (f >= 0) {
+                if (!reading_parse_fixed(colon + 1, token_end, reading_field_info[f].decimals, &record->fields[f])) return false;
+                found |= 1u << f;
+            }
+        }
+        p = token_end;
+    }
+    return found == (1u << LOG_ARCHIVE_NUM_FIELDS) - 1;
+}
+
+size_t log_archive_encode_block(const log_record_t *records, uint16_t count, uint8_t *out, size_t out_size) {
+    if (count == 0 || count > LOG_ARCHIVE_BLOCK_MAX_RECORDS || out_size < LOG_ARCHIVE_HEADER_SIZE) return 0;
+
+    // Header
+    store_le32(out + LOG_ARCHIVE_HDR_MAGIC, LOG_ARCHIVE_MAGIC);
+    memcpy(out + LOG_ARCHIVE_HDR_SENSOR, records[0].sensor, 6);
+    store_le16(out + LOG_ARCHIVE_HDR_COUNT, count);
+    store_le32(out + LOG_ARCHIVE_HDR_T_FIRST, records[0].time);
+    store_le32(out + LOG_ARCHIVE_HDR_T_LAST, records[count - 1].time);
+    for (int f = 0; f < LOG_ARCHIVE_NUM_FIELDS; f++) {
+        int32_t min = records[0].fields[f];
+        int32_t max = min;
+        for (uint16_t i = 1; i < count; i++) {
+            if (records[i].fields[f] < min) min = records[i].fields[f];
+            if (records[i].fields[f] > max) max = records[i].fields[f];
+        }
+        store_le32(out + LOG_ARCHIVE_HDR_MINMAX + 8 * f, (uint32_t)min);
+        store_le32(out + LOG_ARCHIVE_HDR_MINMAX + 8 * f + 4, (uint32_t)max);
+    }
+
+    // Time column, then one column per field
+    size_t pos = LOG_ARCHIVE_HEADER_SIZE;
+    uint32_t prev_time = records[0].time;
+    for (uint16_t i = 0; i < count; i++) {
+        size_t n = log_archive_put_varint(out + pos, out_size - pos, log_archive_zigzag((int32_t)(records[i].time - prev_time)));
+        if (n == 0) return 0;
+        pos += n;
+        prev_time = records[i].time;
+    }
+    for (int f = 0; f < LOG_ARCHIVE_NUM_FIELDS; f++) {
+        int32_t prev = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            size_t n = log_archive_put_varint(out + pos, out_size - pos, log_archive_zigzag(records[i].fields[f] - prev));
+            if (n == 0) return 0;
+            pos += n;
+            prev = records[i].fields[f];
+        }
+    }
+
+    store_le16(out + LOG_ARCHIVE_HDR_PAYLOAD_LEN, (uint16_t)(pos - LOG_ARCHIVE_HEADER_SIZE));
+    return pos;
+}
@@ -0,0 +1,122 @@
+#ifndef LOG_ARCHIVE_H
+#define LOG_ARCHIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "reading_schema.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Columnar archive format for daily logs (".mfa" files).
+ *
+ * A file is a sequence of self-contained blocks. Each block holds up to
+ * LOG_ARCHIVE_BLOCK_MAX_RECORDS readings of one sensor, stored column by
+ * column: first the timestamps, then one column per field. Every value is
+ * the zig-zag varint of its delta to the previous value in the column
+ * (timestamps start from t_first, fields from 0).
+ *
+ * The fixed-size block header carries the time range and per-field min/max,
+ * so a reader can skip a whole block using payload_len without decoding it.
+ *
+ * Block header (little endian):
+ *   [0]  u32 magic "MFA1"
+ *   [4]  6 bytes sensor address
+ *   [10] u16 record count
+ *   [12] u32 t_first (seconds since 1970-01-01, RTC wall clock)
+ *   [16] u32 t_last
+ *   [20] per field: i32 min, i32 max
+ *   [60] u16 payload_len
+ *   [62] payload
+ */
+
+#define LOG_ARCHIVE_MAGIC 0x3141464Du // "MFA1"
+#define LOG_ARCHIVE_BLOCK_MAX_RECORDS 96 // One day at 15-minute intervals
+
+// Field columns, in payload order after the time column (see reading_schema.h)
+enum {
+#define LOG_ARCHIVE_X_FIELD(id, member, type, key, decimals, src, offset, width) LOG_FIELD_##id = READING_FIELD_##id,
+    READING_FIELDS(LOG_ARCHIVE_X_FIELD)
+#undef LOG_ARCHIVE_X_FIELD
+    LOG_ARCHIVE_NUM_FIELDS = READING_NUM_FIELDS
+};
+
+#define LOG_ARCHIVE_HDR_MAGIC       0
+#define LOG_ARCHIVE_HDR_SENSOR      4
+#define LOG_ARCHIVE_HDR_COUNT       10
+#define LOG_ARCHIVE_HDR_T_FIRST     12
+#define LOG_ARCHIVE_HDR_T_LAST      16
+#define LOG_ARCHIVE_HDR_MINMAX      20
+#define LOG_ARCHIVE_HDR_PAYLOAD_LEN (LOG_ARCHIVE_HDR_MINMAX + 8 * LOG_ARCHIVE_NUM_FIELDS)
+#define LOG_ARCHIVE_HEADER_SIZE     (LOG_ARCHIVE_HDR_PAYLOAD_LEN + 2)
+
+// Worst case: 5 varint bytes per value
+#define LOG_ARCHIVE_BLOCK_MAX_SIZE \
+    (LOG_ARCHIVE_HEADER_SIZE + 5 * (1 + LOG_ARCHIVE_NUM_FIELDS) * LOG_ARCHIVE_BLOCK_MAX_RECORDS)
+
+// One reading in integer form
+typedef struct {
+    uint32_t time;                            // Seconds since 1970-01-01
+    int32_t fields[LOG_ARCHIVE_NUM_FIELDS];   // Fixed point, as in reading_values_t
+    uint8_t sensor[6];                        // All zero for logs without a Sensor field
+} log_record_t;
+
+/**
+ * @brief Parse one line of a daily text log.
+ * Accepts "YYYY-MM-DDTHH:MM:SS,Temp:28.5,Light:150,Moisture:45,Conductivity:350,Battery:88"
+ * with an optional trailing ",Sensor:XXXXXXXXXXXX".
+ * @return true if the line was a complete reading.
+ */
+bool log_archive_parse_line(const char *line, size_t length, log_record_t *record);
+
+/**
+ * @brief Encode readings of a single sensor as one block.
+ * @param records Readings in time order (count <= LOG_ARCHIVE_BLOCK_MAX_RECORDS).
+ * @param out Output buffer, at least LOG_ARCHIVE_BLOCK_MAX_SIZE bytes is always enough.
+ * @return Block size in bytes, or 0 if it does not fit.
+ */
+size_t log_archive_encode_block(const log_record_t *records, uint16_t count, uint8_t *out, size_t out_size);
+
+// --- Varint helpers (shared with the decoder) ---
+
+static inline uint32_t log_archive_zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t log_archive_unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Returns bytes written (1..5), or 0 if the buffer is too small
+static inline size_t log_archive_put_varint(uint8_t *out, size_t out_size, uint32_t value) {
+    size_t n = 0;
+    do {
+        if (n >= out_size) return 0;
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[n++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return n;
+}
+
+// Returns bytes consumed (1..5), or 0 on truncated/overlong input
+static inline size_t log_archive_get_varint(const uint8_t *in, size_t in_size, uint32_t *value) {
+    uint32_t result = 0;
+    for (size_t n = 0; n < in_size && n < 5; n++) {
+        result |= (uint32_t)(in[n] & 0x7F) << (7 * n);
+        if (!(in[n] & 0x80)) {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_ARCHIVE_H
@@ -0,0 +1,67 @@
+#include "log_frame.h"
+#include <stdio.h>
+#include <string.h>
+
+uint16_t log_frame_crc16(const char *data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)((uint8_t)data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)(crc << 1 ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+size_t log_frame_seal(char *line, size_t length, size_t buffer_size) {
+    // Field, newline and the terminator snprintf always writes
+    if (length + LOG_FRAME_CRC_FIELD_LEN + 2 > buffer_size) return 0;
+    snprintf(line + length, buffer_size - length, LOG_FRAME_CRC_FIELD "%04X\n", log_frame_crc16(line, length));
+    return length + LOG_FRAME_CRC_FIELD_LEN + 1;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool log_frame_check_line(const char *line, size_t length) {
+    if (length >= LOG_FRAME_CRC_FIELD_LEN &&
+        memcmp(line + length - LOG_FRAME_CRC_FIELD_LEN, LOG_FRAME_CRC_FIELD, sizeof(LOG_FRAME_CRC_FIELD) - 1) == 0) {
+        uint16_t expected = 0;
+        for (size_t i = length - 4; i < length; i++) {
+            int digit = hex_digit(line[i]);
+            if (digit < 0) return false;
+            expected = (uint16_t)(expected << 4 | digit);
+        }
+        return log_frame_crc16(line, length - LOG_FRAME_CRC_FIELD_LEN) == expected;
+    }
+
+    // Written before framing existed
+    if (length == 0) return false;
+    for (size_t i = 0; i < length; i++) {
+        if (line[i] < 0x20 || line[i] > 0x7E) return false;
+    }
+    return true;
+}
+
+size_t log_frame_recover(const char *tail, size_t length, bool at_file_start) {
+    // Anything after the last newline is a partial record
+    size_t end = length;
+    while (end > 0 && tail[end - 1] != '\n') end--;
+    if (end == 0) {
+        // No record boundary in the window: only decide if we see the whole file
+        return at_file_start ? 0 : length;
+    }
+
+    // Drop damaged complete lines from the end, stopping at the first good one
+    while (end > 0) {
+        size_t start = end - 1;
+        while (start > 0 && tail[start - 1] != '\n') start--;
+        if (start == 0 && !at_file_start) break; // Line begins before the window, can't check it
+        if (log_frame_check_line(tail + start, end - 1 - start)) break;
+        end = start;
+    }
+    return end;
+}
@@ -0,0 +1,69 @@
+#ifndef LOG_FRAME_H
+#define LOG_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Record framing for the daily text logs.
+ *
+ * Every log line ends with a CRC field over the text before it:
+ *   "2025-10-30T08:30:05,Temp:28.5,...,Sensor:5C857E1317F9,CRC:1A2B\n"
+ * CRC-16/CCITT-FALSE, 4 upper-case hex digits. Readers that don't know the
+ * field ignore it like any other unknown key.
+ *
+ * Since the files are append-only, a power loss can only damage the end of
+ * the file that was being written. Recovery therefore looks at a fixed-size
+ * window at the end of that one file: it drops a trailing partial line and
+ * any complete lines whose CRC doesn't match, so it takes the same time no
+ * matter how much history is on the card.
+ */
+
+#define LOG_FRAME_CRC_FIELD ",CRC:"
+#define LOG_FRAME_CRC_FIELD_LEN 9 // ",CRC:XXXX"
+
+// Bytes at the end of a file checked by recovery: a whole torn 512-byte
+// sector plus a few log lines before it
+#ifndef LOG_FRAME_RECOVERY_WINDOW
+#define LOG_FRAME_RECOVERY_WINDOW 1024
+#endif
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF).
+ */
+uint16_t log_frame_crc16(const char *data, size_t length);
+
+/**
+ * @brief Append the CRC field and the newline to a log line.
+ * @param line Line without newline, in a buffer of buffer_size bytes.
+ * @param length Current line length.
+ * @return New length, or 0 if the buffer is too small.
+ */
+size_t log_frame_seal(char *line, size_t length, size_t buffer_size);
+
+/**
+ * @brief Check one complete line (without its newline).
+ * Lines with a CRC field must match it; older lines without one are accepted
+ * if they are plain printable text.
+ */
+bool log_frame_check_line(const char *line, size_t length);
+
+/**
+ * @brief Find where the intact records end in the tail of a log file.
+ * @param tail Last bytes of the file (at most LOG_FRAME_RECOVERY_WINDOW are needed).
+ * @param length Number of bytes in tail.
+ * @param at_file_start true if tail is the whole file.
+ * @return Number of bytes of tail to keep; the file should be truncated after them.
+ */
+size_t log_frame_recover(const char *tail, size_t length, bool at_file_start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_FRAME_H
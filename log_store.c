@@ -0,0 +1,606 @@
+#include "log_store.h"
+#include <stdio.h>
+#include <string.h>
+#include "btstack.h"
+#include "f_util.h"
+#include "scheduler.h"
+#include "time_util.h"
+#include "energy_profile.h"
+#include "clock_drift.h"
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t merged_size; // Bytes of the day's text file already merged (0 once it is deleted)
+} day_entry_t;
+
+// Directory search patterns; names are checked with parse_name_date()
+#define DAY_FILE_PATTERN "*-*-*.txt"
+
+// --- Compaction Job State ---
+typedef enum {
+    COMPACT_IDLE,
+    COMPACT_FIND,     // Looking for a closed daily file
+    COMPACT_BEGIN,    // Opening the month's old archive and the temp archive
+    COMPACT_COPY,     // Copying day data, one slice per run
+    COMPACT_FINISH,   // Writing the index and header
+    COMPACT_SWAP,     // Replacing the old archive with the temp one
+    COMPACT_CLEANUP   // Deleting merged daily files, one per run
+} compact_phase_t;
+
+static scheduler_task_t compact_task;
+static compact_phase_t phase = COMPACT_IDLE;
+static uint32_t cutoff_day;          // Days (since 1970) before this one are closed
+static DIR find_dir;
+static bool find_open = false;
+static int job_year, job_month;
+static FIL old_archive, new_archive, day_txt;
+static bool have_old;
+static day_entry_t old_index[LOG_STORE_DAYS_PER_MONTH];
+static day_entry_t new_index[LOG_STORE_DAYS_PER_MONTH];
+static uint8_t job_day;              // 0-based day of month being copied
+static uint8_t job_part;             // 0 = data from the old archive, 1 = daily text file
+static bool part_open;
+static uint32_t copy_left;
+static uint32_t delete_mask;         // Days whose text file is now inside the archive
+static uint8_t copy_buffer[512];
+static int open_readers = 0;         // Days opened by log_store_open_day(), plus log_store_hold()
+
+// --- Listing State ---
+typedef enum { LIST_ARCHIVES, LIST_TEXT, LIST_DONE } list_phase_t;
+static list_phase_t list_phase = LIST_DONE;
+static DIR list_dir;
+static bool list_dir_open = false;
+static bool list_have_archive = false;
+static int list_year, list_month, list_day;
+static day_entry_t list_index[LOG_STORE_DAYS_PER_MONTH]; // Index of list_year-list_month
+
+// --- Private Helpers ---
+
+static void archive_name(char *name, size_t size, int year, int month, const char *ext) {
+    snprintf(name, size, "%04d-%02d.%s", year, month, ext);
+}
+
+static void day_name(char *name, size_t size, int year, int month, int day) {
+    snprintf(name, size, "%04d-%02d-%02d.txt", year, month, day);
+}
+
+// Parses the date part of "YYYY-MM-DD..." names, or of "YYYY-MM..." names when day is NULL
+static bool parse_name_date(const char *name, int *year, int *month, int *day) {
+    char iso[20];
+    uint32_t epoch;
+    int mday, hour, min, sec;
+    if (day) {
+        snprintf(iso, sizeof(iso), "%.10sT00:00:00", name);
+    } else {
+        snprintf(iso, sizeof(iso), "%.7s-01T00:00:00", name);
+    }
+    if (!time_util_parse_iso(iso, &epoch)) return false;
+    time_util_from_epoch(epoch, year, month, &mday, &hour, &min, &sec);
+    if (day) *day = mday;
+    return true;
+}
+
+// Parses "YYYY-MM-DD.txt" day file names; anything else (e.g. ".mfa") is not a day
+static bool parse_day_text(const char *name, int *year, int *month, int *day) {
+    return strlen(name) == 14 && strcmp(name + 10, ".txt") == 0 && parse_name_date(name, year, month, day);
+}
+
+static bool read_index(FIL *fil, day_entry_t index[LOG_STORE_DAYS_PER_MONTH]) {
+    uint8_t header[LOG_STORE_DATA_OFFSET];
+    UINT bytes_read;
+    if (f_lseek(fil, 0) != FR_OK || f_read(fil, header, sizeof(header), &bytes_read) != FR_OK ||
+        bytes_read != sizeof(header) || little_endian_read_32(header, 0) != LOG_STORE_ARCHIVE_MAGIC) {
+        return false;
+    }
+    for (int d = 0; d < LOG_STORE_DAYS_PER_MONTH; d++) {
+        const int base = LOG_STORE_INDEX_OFFSET + d * LOG_STORE_INDEX_ENTRY_SIZE;
+        index[d].offset = little_endian_read_32(header, base);
+        index[d].length = little_endian_read_32(header, base + 4);
+        index[d].merged_size = little_endian_read_32(header, base + 8);
+    }
+    return true;
+}
+
+static bool write_index(FIL *fil, const day_entry_t index[LOG_STORE_DAYS_PER_MONTH], uint32_t magic) {
+    uint8_t header[LOG_STORE_DATA_OFFSET];
+    uint16_t days = 0;
+    for (int d = 0; d < LOG_STORE_DAYS_PER_MONTH; d++) {
+        const int base = LOG_STORE_INDEX_OFFSET + d * LOG_STORE_INDEX_ENTRY_SIZE;
+        little_endian_store_32(header, base, index[d].offset);
+        little_endian_store_32(header, base + 4, index[d].length);
+        little_endian_store_32(header, base + 8, index[d].merged_size);
+        if (index[d].length > 0) days++;
+    }
+    little_endian_store_32(header, 0, magic);
+    little_endian_store_16(header, 4, days);
+    little_endian_store_16(header, 6, 0);
+
+    UINT written;
+    return f_lseek(fil, 0) == FR_OK && f_write(fil, header, sizeof(header), &written) == FR_OK &&
+           written == sizeof(header);
+}
+
+// Reads the index of a month's archive; false if there is no valid one
+static bool load_index(int year, int month, day_entry_t index[LOG_STORE_DAYS_PER_MONTH]) {
+    char name[16];
+    FIL fil;
+    archive_name(name, sizeof(name), year, month, "mfm");
+    if (f_open(&fil, name, FA_READ) != FR_OK) return false;
+    bool ok = read_index(&fil, index);
+    f_close(&fil);
+    return ok;
+}
+
+static void abort_job(const char *reason) {
+    char tmp_name[16];
+    printf("Compaction aborted: %s\n", reason);
+    if (part_open && job_part == 1) f_close(&day_txt);
+    if (have_old) f_close(&old_archive);
+    f_close(&new_archive);
+    archive_name(tmp_name, sizeof(tmp_name), job_year, job_month, "tmp");
+    f_unlink(tmp_name);
+    part_open = false;
+    have_old = false;
+    phase = COMPACT_IDLE;
+}
+
+static void next_day(void) {
+    job_day++;
+    job_part = 0;
+    if (job_day < LOG_STORE_DAYS_PER_MONTH) {
+        new_index[job_day].offset = (uint32_t)f_tell(&new_archive);
+    }
+}
+
+// --- Compaction Steps (each returns true if the job continues) ---
+
+static bool step_find(void) {
+    FILINFO fno;
+    FRESULT fr = find_open ? f_findnext(&find_dir, &fno) : f_findfirst(&find_dir, &fno, "", DAY_FILE_PATTERN);
+    find_open = true;
+
+    // Look at a bounded number of directory entries per slice
+    for (int scanned = 0; ; scanned++) {
+        if (fr != FR_OK || fno.fname[0] == '\0') {
+            f_closedir(&find_dir);
+            find_open = false;
+            phase = COMPACT_IDLE;
+            return false; // Nothing left to compact
+        }
+
+        int year, month, day;
+        if (parse_name_date(fno.fname, &year, &month, &day) &&
+            time_util_to_epoch(year, month, day, 0, 0, 0) / 86400u < cutoff_day) {
+            f_closedir(&find_dir);
+            find_open = false;
+            job_year = year;
+            job_month = month;
+            phase = COMPACT_BEGIN;
+            return true;
+        }
+
+        if (scanned == 15) return true;
+        fr = f_findnext(&find_dir, &fno);
+    }
+}
+
+static bool step_begin(void) {
+    char name[16];
+    archive_name(name, sizeof(name), job_year, job_month, "mfm");
+    have_old = f_open(&old_archive, name, FA_READ) == FR_OK;
+    if (have_old && !read_index(&old_archive, old_index)) {
+        f_close(&old_archive);
+        have_old = false;
+    }
+    if (!have_old) {
+        memset(old_index, 0, sizeof(old_index));
+    }
+
+    // Build the new archive in a temp file; the index is rewritten at the end
+    archive_name(name, sizeof(name), job_year, job_month, "tmp");
+    memset(new_index, 0, sizeof(new_index));
+    if (f_open(&new_archive, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK || !write_index(&new_archive, new_index, 0)) {
+        abort_job("cannot create temp archive");
+        return false;
+    }
+
+    printf("Compacting %04d-%02d into monthly archive...\n", job_year, job_month);
+    job_day = 0;
+    job_part = 0;
+    part_open = false;
+    delete_mask = 0;
+    new_index[0].offset = LOG_STORE_DATA_OFFSET;
+    phase = COMPACT_COPY;
+    return true;
+}
+
+static bool step_copy(void) {
+    uint32_t budget = LOG_STORE_SLICE_BYTES;
+
+    while (budget > 0) {
+        if (job_day == LOG_STORE_DAYS_PER_MONTH) {
+            phase = COMPACT_FINISH;
+            return true;
+        }
+        day_entry_t *entry = &new_index[job_day];
+
+        // Open the source of the current part
+        if (!part_open) {
+            if (job_part == 0) {
+                if (!have_old || old_index[job_day].length == 0) {
+                    job_part = 1;
+                    continue;
+                }
+                if (f_lseek(&old_archive, old_index[job_day].offset) != FR_OK) {
+                    abort_job("seek in old archive failed");
+                    return false;
+                }
+                copy_left = old_index[job_day].length;
+                entry->merged_size = old_index[job_day].merged_size;
+            } else {
+                char name[16];
+                day_name(name, sizeof(name), job_year, job_month, job_day + 1);
+                bool closed = time_util_to_epoch(job_year, job_month, job_day + 1, 0, 0, 0) / 86400u < cutoff_day;
+                if (!closed || f_open(&day_txt, name, FA_READ) != FR_OK) {
+                    next_day();
+                    continue;
+                }
+                uint32_t size = (uint32_t)f_size(&day_txt);
+                uint32_t merged = old_index[job_day].length > 0 ? old_index[job_day].merged_size : 0;
+                delete_mask |= 1u << job_day;
+                if (size <= merged) {
+                    // Merged already; a reset cut the cleanup short
+                    f_close(&day_txt);
+                    next_day();
+                    continue;
+                }
+                // Only lines written after the last merge are new
+                if (f_lseek(&day_txt, merged) != FR_OK) {
+                    abort_job("seek in daily file failed");
+                    return false;
+                }
+                copy_left = size - merged;
+                entry->merged_size = size;
+            }
+            part_open = true;
+        }
+
+        // Copy one chunk
+        FIL *src = job_part == 0 ? &old_archive : &day_txt;
+        UINT chunk = (UINT)btstack_min(btstack_min(copy_left, sizeof(copy_buffer)), budget);
+        UINT bytes_read = 0, written = 0;
+        if (chunk > 0 && (f_read(src, copy_buffer, chunk, &bytes_read) != FR_OK ||
+                          f_write(&new_archive, copy_buffer, bytes_read, &written) != FR_OK ||
+                          written != bytes_read)) {
+            abort_job("copy failed");
+            return false;
+        }
+        entry->length += written;
+        budget -= chunk;
+        copy_left = bytes_read < chunk ? 0 : copy_left - bytes_read; // Short read ends the part
+
+        if (copy_left == 0) {
+            part_open = false;
+            if (job_part == 0) {
+                job_part = 1;
+            } else {
+                f_close(&day_txt);
+                next_day();
+            }
+        }
+    }
+    return true;
+}
+
+static bool step_finish(void) {
+    // Data first, header (with magic) last: a temp file without magic is never used
+    if (f_sync(&new_archive) != FR_OK || !write_index(&new_archive, new_index, LOG_STORE_ARCHIVE_MAGIC) ||
+        f_close(&new_archive) != FR_OK) {
+        abort_job("cannot write archive index");
+        return false;
+    }
+    if (have_old) {
+        f_close(&old_archive);
+        have_old = false;
+    }
+    phase = COMPACT_SWAP;
+    return true;
+}
+
+static bool step_swap(void) {
+    if (open_readers > 0) return true; // A client is streaming a day, try again later
+
+    char name[16], tmp_name[16];
+    archive_name(name, sizeof(name), job_year, job_month, "mfm");
+    archive_name(tmp_name, sizeof(tmp_name), job_year, job_month, "tmp");
+    f_unlink(name);
+    FRESULT fr = f_rename(tmp_name, name);
+    if (fr != FR_OK) {
+        // Left for log_store_recover() to finish after the next mount
+        printf("Compaction: f_rename(%s) error: %s\n", name, FRESULT_str(fr));
+        phase = COMPACT_IDLE;
+        return false;
+    }
+    phase = COMPACT_CLEANUP;
+    return true;
+}
+
+static bool step_cleanup(void) {
+    if (delete_mask == 0) {
+        printf("Compaction of %04d-%02d complete.\n", job_year, job_month);
+        phase = COMPACT_FIND; // Look for another month
+        return true;
+    }
+    if (open_readers > 0) return true;
+
+    int day = 0;
+    while (!(delete_mask & (1u << day))) day++;
+    delete_mask &= ~(1u << day);
+
+    // Nothing of a text file created for this day from now on is merged yet. Zeroed
+    // before the delete: a reset in between merges the text twice instead of losing it.
+    // The day's .mfa stays, it is the long-term columnar copy of the day.
+    char name[16];
+    FIL fil;
+    UINT written;
+    uint8_t zero[4] = {0};
+    archive_name(name, sizeof(name), job_year, job_month, "mfm");
+    if (f_open(&fil, name, FA_READ | FA_WRITE) == FR_OK) {
+        if (f_lseek(&fil, LOG_STORE_INDEX_OFFSET + day * LOG_STORE_INDEX_ENTRY_SIZE + 8) == FR_OK) {
+            f_write(&fil, zero, sizeof(zero), &written);
+        }
+        f_close(&fil);
+    }
+
+    day_name(name, sizeof(name), job_year, job_month, day + 1);
+    FRESULT fr = f_unlink(name);
+    if (fr != FR_OK) {
+        // Without this the search would find the same file forever
+        printf("Compaction: f_unlink(%s) error: %s\n", name, FRESULT_str(fr));
+        phase = COMPACT_IDLE;
+        return false;
+    }
+    return true;
+}
+
+static void compact_task_handler(scheduler_task_t *task) {
+    bool more = false;
+    energy_profile_set(ENERGY_SD_WRITE, true);
+    switch (phase) {
+        case COMPACT_FIND:    more = step_find(); break;
+        case COMPACT_BEGIN:   more = step_begin(); break;
+        case COMPACT_COPY:    more = step_copy(); break;
+        case COMPACT_FINISH:  more = step_finish(); break;
+        case COMPACT_SWAP:    more = step_swap(); break;
+        case COMPACT_CLEANUP: more = step_cleanup(); break;
+        default: break;
+    }
+    energy_profile_set(ENERGY_SD_WRITE, false);
+    if (more) {
+        scheduler_run_in(task, LOG_STORE_SLICE_INTERVAL_MS);
+    }
+}
+
+// --- Public Function Implementations ---
+
+void log_store_init(void) {
+    scheduler_task_init(&compact_task, "compact", SCHEDULER_PRIORITY_LOW, compact_task_handler, NULL);
+}
+
+void log_store_recover(void) {
+    // A reset between deleting the old archive and renaming the new one leaves
+    // a complete temp file behind; anything else is a partial build.
+    DIR dir;
+    FILINFO fno;
+    for (FRESULT fr = f_findfirst(&dir, &fno, "", "*.tmp"); fr == FR_OK && fno.fname[0] != '\0'; fr = f_findnext(&dir, &fno)) {
+        int year, month;
+        if (strlen(fno.fname) != 11 || !parse_name_date(fno.fname, &year, &month, NULL)) continue;
+        char name[16];
+        snprintf(name, sizeof(name), "%.7s.mfm", fno.fname);
+        FIL fil;
+        day_entry_t index[LOG_STORE_DAYS_PER_MONTH];
+        bool complete = false;
+        if (f_open(&fil, fno.fname, FA_READ) == FR_OK) {
+            complete = read_index(&fil, index);
+            f_close(&fil);
+        }
+        if (complete && f_stat(name, NULL) == FR_NO_FILE) {
+            printf("Finishing interrupted archive swap for %s\n", name);
+            f_rename(fno.fname, name);
+        } else {
+            f_unlink(fno.fname);
+        }
+    }
+    f_closedir(&dir);
+}
+
+void log_store_compact_start(void) {
+    if (phase != COMPACT_IDLE) return;
+
+    uint32_t epoch;
+    if (!clock_drift_port_now(&epoch)) return; // Can't tell which days are closed
+
+    // Same corrected clock the logger names files by; keep today and yesterday
+    // as text: they are still written or archived at rollover
+    cutoff_day = epoch / 86400u - 1u;
+    phase = COMPACT_FIND;
+    scheduler_run_in(&compact_task, 0);
+}
+
+FRESULT log_store_open_day(const char *filename, log_store_day_t *day) {
+    memset(day, 0, sizeof(*day));
+    int year, month, mday;
+    if (!parse_day_text(filename, &year, &month, &mday)) {
+        // Any other file (e.g. a day's .mfa) is served as is
+        FRESULT fr = f_open(&day->fil, filename, FA_READ);
+        if (fr != FR_OK) return fr;
+        day->left = day->part_left = (uint32_t)f_size(&day->fil);
+        open_readers++;
+        return FR_OK;
+    }
+
+    // The month's archive first, then whatever the text file got after the last merge
+    day_entry_t index[LOG_STORE_DAYS_PER_MONTH];
+    bool archived = load_index(year, month, index) && index[mday - 1].length > 0;
+    uint32_t text_size = 0;
+    FILINFO fno;
+    snprintf(day->text_name, sizeof(day->text_name), "%s", filename);
+    if (f_stat(filename, &fno) == FR_OK) text_size = (uint32_t)fno.fsize;
+    day->text_from = archived ? index[mday - 1].merged_size : 0;
+    uint32_t text_left = text_size > day->text_from ? text_size - day->text_from : 0;
+
+    FRESULT fr;
+    if (archived) {
+        char name[16];
+        archive_name(name, sizeof(name), year, month, "mfm");
+        fr = f_open(&day->fil, name, FA_READ);
+        if (fr == FR_OK && f_lseek(&day->fil, index[mday - 1].offset) != FR_OK) {
+            f_close(&day->fil);
+            fr = FR_DISK_ERR;
+        }
+        day->part_left = index[mday - 1].length;
+        day->left = day->part_left + text_left;
+    } else if (text_left > 0) {
+        fr = f_open(&day->fil, filename, FA_READ);
+        day->left = day->part_left = text_left;
+    } else {
+        return FR_NO_FILE;
+    }
+    if (fr != FR_OK) return fr;
+    open_readers++;
+    return FR_OK;
+}
+
+// Moves on to the day's unmerged text once the archived part is read
+static FRESULT next_part(log_store_day_t *day) {
+    f_close(&day->fil);
+    FRESULT fr = f_open(&day->fil, day->text_name, FA_READ);
+    if (fr == FR_OK && f_lseek(&day->fil, day->text_from) != FR_OK) {
+        f_close(&day->fil);
+        fr = FR_DISK_ERR;
+    }
+    if (fr != FR_OK) {
+        day->left = 0;
+        return fr;
+    }
+    day->part_left = day->left;
+    return FR_OK;
+}
+
+FRESULT log_store_read_day(log_store_day_t *day, void *buffer, UINT size, UINT *bytes_read) {
+    *bytes_read = 0;
+    if (day->left == 0) return FR_OK;
+    if (day->part_left == 0) {
+        FRESULT fr = next_part(day);
+        if (fr != FR_OK) return fr;
+    }
+    FRESULT fr = f_read(&day->fil, buffer, (UINT)btstack_min(size, day->part_left), bytes_read);
+    if (fr != FR_OK) return fr;
+    if (*bytes_read == 0) {
+        day->left = 0; // The file ended early: the day is cut short
+        return FR_OK;
+    }
+    day->part_left -= *bytes_read;
+    day->left -= *bytes_read;
+    return FR_OK;
+}
+
+FRESULT log_store_read_line(log_store_day_t *day, char *line, int size) {
+    line[0] = '\0';
+    if (day->left == 0) return FR_OK;
+    if (day->part_left == 0) {
+        FRESULT fr = next_part(day);
+        if (fr != FR_OK) return fr;
+    }
+    if (f_gets(line, size, &day->fil) == NULL) {
+        line[0] = '\0';
+        if (f_error(&day->fil)) return FR_DISK_ERR;
+        day->left = 0;
+        return FR_OK;
+    }
+    // An archived day ends inside the month file
+    uint32_t len = btstack_min(strlen(line), day->part_left);
+    line[len] = '\0';
+    day->part_left -= len;
+    day->left -= len;
+    return FR_OK;
+}
+
+void log_store_close_day(log_store_day_t *day) {
+    f_close(&day->fil);
+    if (open_readers > 0) open_readers--;
+}
+
+void log_store_hold(bool hold) {
+    if (hold) {
+        open_readers++;
+    } else if (open_readers > 0) {
+        open_readers--;
+    }
+}
+
+void log_store_list_begin(void) {
+    if (list_dir_open) f_closedir(&list_dir);
+    list_dir_open = false;
+    list_have_archive = false;
+    list_phase = LIST_ARCHIVES;
+}
+
+bool log_store_list_next(char *name, size_t name_size) {
+    FILINFO fno;
+    FRESULT fr;
+
+    for (;;) {
+        switch (list_phase) {
+            case LIST_ARCHIVES:
+                // Every day in the current archive, whether or not its text file is left
+                while (list_have_archive && list_day < LOG_STORE_DAYS_PER_MONTH) {
+                    int day = ++list_day;
+                    if (list_index[day - 1].length == 0) continue;
+                    day_name(name, name_size, list_year, list_month, day);
+                    return true;
+                }
+
+                fr = list_dir_open ? f_findnext(&list_dir, &fno) : f_findfirst(&list_dir, &fno, "", "*.mfm");
+                list_dir_open = true;
+                if (fr != FR_OK || fno.fname[0] == '\0') {
+                    f_closedir(&list_dir);
+                    list_dir_open = false;
+                    list_have_archive = false;
+                    list_phase = LIST_TEXT;
+                    break;
+                }
+
+                list_have_archive = parse_name_date(fno.fname, &list_year, &list_month, NULL) &&
+                                    load_index(list_year, list_month, list_index);
+                list_day = 0;
+                break;
+
+            case LIST_TEXT:
+                fr = list_dir_open ? f_findnext(&list_dir, &fno) : f_findfirst(&list_dir, &fno, "", DAY_FILE_PATTERN);
+                list_dir_open = true;
+                if (fr == FR_OK && fno.fname[0] != '\0') {
+                    int year, month, day;
+                    if (!parse_day_text(fno.fname, &year, &month, &day)) break; // Not a day file
+                    // Days in their month's archive were listed above; keep the last index read
+                    if (!list_have_archive || year != list_year || month != list_month) {
+                        list_year = year;
+                        list_month = month;
+                        if (!load_index(year, month, list_index)) memset(list_index, 0, sizeof(list_index));
+                        list_have_archive = true;
+                    }
+                    if (list_index[day - 1].length > 0) break;
+                    snprintf(name, name_size, "%s", fno.fname);
+                    return true;
+                }
+                f_closedir(&list_dir);
+                list_dir_open = false;
+                list_phase = LIST_DONE;
+                return false;
+
+            default:
+                return false;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Log store: daily text logs plus monthly archives.
+ *
+ * Closed daily files ("YYYY-MM-DD.txt") are merged in the background into one
+ * archive per month ("YYYY-MM.mfm"), which keeps the original text of each day
+ * behind a fixed day index. Readers use log_store_open_day(), which reads a
+ * day from the archive index first and then any text written to the day after
+ * its last merge, so clients never see the difference. A day's columnar archive
+ * ("YYYY-MM-DD.mfa", see sd_logger.h) is kept after its text is merged.
+ *
+ * Monthly archive layout (little endian):
+ *   [0]  u32 magic "MFM1" (written last, so a torn archive is never valid)
+ *   [4]  u16 number of days present
+ *   [6]  u16 reserved
+ *   [8]  31 index entries of { u32 offset, u32 length, u32 merged_txt_size }
+ *        (merged_txt_size: bytes of the loose text already merged, 0 once it is deleted)
+ *   [380] day data
+ */
+
+#define LOG_STORE_ARCHIVE_MAGIC 0x314D464Du // "MFM1"
+#define LOG_STORE_DAYS_PER_MONTH 31
+#define LOG_STORE_INDEX_OFFSET 8
+#define LOG_STORE_INDEX_ENTRY_SIZE 12
+#define LOG_STORE_DATA_OFFSET (LOG_STORE_INDEX_OFFSET + LOG_STORE_DAYS_PER_MONTH * LOG_STORE_INDEX_ENTRY_SIZE)
+
+// Bytes copied per compaction slice, and the pause between slices
+#ifndef LOG_STORE_SLICE_BYTES
+#define LOG_STORE_SLICE_BYTES 2048
+#endif
+#ifndef LOG_STORE_SLICE_INTERVAL_MS
+#define LOG_STORE_SLICE_INTERVAL_MS 20
+#endif
+
+/**
+ * @brief A day opened for reading: archived bytes, then the text not merged yet.
+ */
+typedef struct {
+    FIL fil;
+    uint32_t left;        // Bytes of the day still to read, over both parts
+    uint32_t part_left;   // Of which in the part open in fil
+    uint32_t text_from;   // Where the unmerged text starts in the day's text file
+    char text_name[16];
+} log_store_day_t;
+
+/**
+ * @brief Set up the compaction task. Call from the core running the scheduler.
+ */
+void log_store_init(void);
+
+/**
+ * @brief Finish any archive swap cut short by a reset.
+ * Call after the card is mounted; only touches the card, so it may run on core 1.
+ */
+void log_store_recover(void);
+
+/**
+ * @brief Start merging closed days (older than yesterday) into monthly archives.
+ * Runs in slices from the scheduler; does nothing if already running or the clock is not set.
+ * Days are judged by the drift-corrected clock, like the logger's file names.
+ */
+void log_store_compact_start(void);
+
+/**
+ * @brief Open a day for reading, from the monthly archive and its text file.
+ * @param filename Day file name, "YYYY-MM-DD.txt"; other names (e.g. a day's
+ *        ".mfa") are opened as plain files.
+ * @param day Reader; day->left is the number of bytes belonging to the day.
+ * @return FR_OK on success, FR_NO_FILE if the day is in neither place.
+ */
+FRESULT log_store_open_day(const char *filename, log_store_day_t *day);
+
+/**
+ * @brief Read the next bytes of an open day.
+ * @return FR_OK with bytes_read == 0 at the end of the day.
+ */
+FRESULT log_store_read_day(log_store_day_t *day, void *buffer, UINT size, UINT *bytes_read);
+
+/**
+ * @brief Read the next line of an open day, like f_gets().
+ * @return FR_OK with an empty line at the end of the day.
+ */
+FRESULT log_store_read_line(log_store_day_t *day, char *line, int size);
+
+/**
+ * @brief Close a day opened with log_store_open_day().
+ */
+void log_store_close_day(log_store_day_t *day);
+
+/**
+ * @brief Keep compaction from deleting or replacing files while they are read
+ * without log_store_open_day() (USB export). Calls nest.
+ */
+void log_store_hold(bool hold);
+
+/**
+ * @brief Start listing all days on the card: archived days, then text files of days not archived yet.
+ */
+void log_store_list_begin(void);
+
+/**
+ * @brief Get the next day file name ("YYYY-MM-DD.txt").
+ * @return false when the listing is complete.
+ */
+bool log_store_list_next(char *name, size_t name_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_STORE_H
@@ -2,6 +2,7 @@
  * Miflora Sensor (BLE) for Raspberry Pi Pico W
  * * With SD Card Datalogging and Timestamps!
  * * Also acts as a peripheral to allow RTC syncing.
+ * * Client (MiFlora) and server (phone) roles run concurrently.
  * * Also exposes a BLE service to read log files directly from the SD card.
  */ 
 
@@ -10,206 +11,207 @@
 #include "btstack.h"
 #include "pico/cyw43_arch.h"
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
 #include "hardware/rtc.h"
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
 
 // --- Project Modules ---
 #include "miflora_client.h"
 #include "ble_server.h"
 #include "sd_logger.h"
+#include "scheduler.h"
+#include "log_store.h"
+#include "energy_profile.h"
+#include "time_util.h"
+#include "trace.h"
+#include "hci_events.h"
+#include "hci_capture.h"
+#include "warm_restart.h"
+#include "boot_profile.h"
+#include "usb_export.h"
+#include "stack_probe.h"
+#include "irrigation.h"
+#include "clock_drift.h"
 
 #define LED_QUICK_FLASH_DELAY_MS 100 
 #define LED_SLOW_FLASH_DELAY_MS 1000 
 
-#define SYNC_TIMEOUT_MS 30000  // 30 seconds for initial RTC sync
 #define LOG_INTERVAL_MS (15 * 60 * 1000) // 15 minutes
 
+// Trace events are printed in small batches so stdio never holds up BLE work
+#define TRACE_DRAIN_INTERVAL_MS 50
+#define TRACE_DRAIN_BATCH 8
+
+#define ENERGY_FILE "ENERGY.DAT" // Energy totals and current model, saved every log cycle
+
+#define CARD_POLL_INTERVAL_MS 5 // How often core 0 looks for the end of the mount on core 1
+
 // --- Miflora Definitions ---
-static const char * target_mac_string = "5C:85:7E:13:17:F9"; // Change to your sensor's MAC address 
+// Sensors polled even without enrollment (up to SENSOR_HEALTH_MAX_SENSORS together
+// with the ones enrolled over BLE, see sensor_registry.h)
+static const char * const target_mac_strings[] = {
+    "5C:85:7E:13:17:F9",
+};
 
 // --- Global State ---
 static btstack_packet_callback_registration_t hci_event_callback_registration;
-static btstack_timer_source_t heartbeat; 
+static scheduler_task_t heartbeat_task; 
+static scheduler_task_t trace_task;
+static scheduler_task_t card_task;
 
-// --- Modal Logic Timers ---
-static btstack_timer_source_t server_advertisement_timer; 
-static btstack_timer_source_t start_scan_delay_timer; 
+// --- Log Cycle Task ---
+// The server (advertising / phone connection) runs continuously; this task
+// only decides when the next MiFlora read (client role) starts.
+static scheduler_task_t log_cycle_task; 
 
 // --- Function Declarations ---
-static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
-static void heartbeat_handler(struct btstack_timer_source *ts);
-static void server_timeout_handler(struct btstack_timer_source *ts);
-static void enter_server_mode(void);
-static void start_scan_handler(struct btstack_timer_source *ts);
+static void heartbeat_handler(scheduler_task_t *task);
+static void trace_drain_handler(scheduler_task_t *task);
+static void card_ready_handler(scheduler_task_t *task);
+static void log_cycle_handler(scheduler_task_t *task);
+static void schedule_next_log_cycle(void);
+static void stack_ready(void);
+static void poll_cycle_complete(void);
+static void end_energy_cycle(void);
 
 // --- Pump Control Definitions ---
 static const uint PUMP_GPIO_PIN = 16; // <<< CHOOSE A FREE GPIO PIN
 static const uint32_t PUMP_DURATION_MS = 5000; // 5 seconds
-static btstack_timer_source_t pump_off_timer;
+static scheduler_task_t pump_off_task;
 static bool is_pump_on = false;
 
 /**
- * @brief Handler for the short delay after stopping ADV.
- * This function actually starts the MiFlora scan.
+ * @brief Runs when the next MiFlora read is due (or right after the RTC is synced).
+ * Starts a scan *if* the RTC has been synced, otherwise keeps waiting.
+ * A connected phone is left alone; both roles run side by side.
  */ 
-static void start_scan_handler(struct btstack_timer_source *ts) {
-    UNUSED(ts); 
-    printf("ADV stop delay complete. Starting MiFlora scan.\n"); 
-    // Now it's safe to start scanning
+static void log_cycle_handler(scheduler_task_t *task) {
+    // Enrolled sensors are on the card
+    if (!sd_logger_is_ready()) {
+        scheduler_wait_event(task, SCHEDULER_EVENT_CARD_READY, SCHEDULER_NO_TIMEOUT);
+        return;
+    }
+
+    if (!ble_server_is_rtc_synced()) {
+        schedule_next_log_cycle(); 
+        return;
+    }
+
+    if (miflora_client_get_state() != FLORA_IDLE) {
+        printf("Previous MiFlora read still running. Skipping this cycle.\n"); 
+        schedule_next_log_cycle(); 
+        return;
+    }
+
+    printf("Log cycle due. Starting MiFlora scan.\n"); 
+    end_energy_cycle();
     miflora_client_start(); 
 }
 
 /**
- * @brief This handler fires if no phone connects to our server within the timeout.
- * It stops advertising and switches to client (MiFlora scan) mode
- * *if* the RTC has been synced.
+ * @brief Arms the log cycle task.
+ * Until the RTC is set it waits for the sync event, then for the log interval.
  */ 
-static void server_timeout_handler(struct btstack_timer_source *ts) {
-    UNUSED(ts);
-    
-    ble_server_stop_advertising(); 
-
+static void schedule_next_log_cycle(void){
     if (ble_server_is_rtc_synced()) {
-        printf("Server mode timed out, RTC is synced. Proceeding to scan.\n"); 
-        // Set a 100ms timer to give the stack time to stop advertising
-        // before we start scanning. 
-        btstack_run_loop_set_timer_handler(&start_scan_delay_timer, start_scan_handler);
-        btstack_run_loop_set_timer(&start_scan_delay_timer, 100); // 100ms delay 
-        btstack_run_loop_add_timer(&start_scan_delay_timer); 
+        printf("Waiting %lu mins for next log cycle...\n", LOG_INTERVAL_MS / 60000);
+        scheduler_run_in(&log_cycle_task, LOG_INTERVAL_MS);
+        warm_restart_set_log_due(LOG_INTERVAL_MS); // Kept across a watchdog reset
     } else {
-        printf("Server mode timed out. RTC NOT synced. Restarting server mode...\n"); 
-        // Re-enter server mode to wait for a connection again.
-        enter_server_mode(); 
-    }
+        printf("Waiting for RTC sync...\n");
+        scheduler_wait_event(&log_cycle_task, SCHEDULER_EVENT_RTC_SYNCED, SCHEDULER_NO_TIMEOUT);
+    }    
 }
 
 /**
- * @brief Enters the default "server" state.
- * Advertises as "MiFlora Logger" and sets a timer.
- */ 
-static void enter_server_mode(void){
-    // First, always remove the timer. 
-    btstack_run_loop_remove_timer(&server_advertisement_timer); 
-    
-    // Check if RTC is synced and set timer accordingly
-    bool rtc_synced = ble_server_is_rtc_synced();
-    uint32_t timeout_ms = rtc_synced ? LOG_INTERVAL_MS : SYNC_TIMEOUT_MS;
-    
-    if (rtc_synced) {
-        printf("Entering server mode. Waiting %lu mins for next log cycle...\n", LOG_INTERVAL_MS / 60000);
+ * @brief BTstack is up. After a warm restart the log cycle keeps the
+ * schedule it had before the reset; otherwise a new one starts.
+ */
+static void stack_ready(void){
+    static bool resumed = false;
+    int32_t due_ms = warm_restart_log_due_in_ms();
+    if (!resumed && due_ms >= 0 && ble_server_is_rtc_synced()) {
+        printf("Resuming log cycle, due in %ld ms\n", (long)due_ms);
+        scheduler_run_in(&log_cycle_task, (uint32_t)due_ms);
+        warm_restart_set_log_due((uint32_t)due_ms);
     } else {
-        printf("Entering server mode. Advertising for RTC sync (%lus)...\n", SYNC_TIMEOUT_MS / 1000);
-    }    
-
-    miflora_client_set_state(FLORA_IDLE); 
-    ble_server_start_advertising();
+        schedule_next_log_cycle();
+    }
+    resumed = true;
+}
 
-    // Now it is safe to set up and add the timer
-    btstack_run_loop_set_timer_handler(&server_advertisement_timer, server_timeout_handler);
-    // Use the dynamically set timeout
-    btstack_run_loop_set_timer(&server_advertisement_timer, timeout_ms);
-    btstack_run_loop_add_timer(&server_advertisement_timer);
+/**
+ * @brief Called by the client once every due sensor has been polled.
+ */ 
+static void poll_cycle_complete(void){
+    schedule_next_log_cycle(); 
+    log_store_compact_start(); // Radio is idle until the next cycle
 }
 
+/**
+ * @brief Closes the energy accounting cycle (one log interval) and saves the totals.
+ */ 
+static void end_energy_cycle(void){
+    datetime_t t;
+    uint32_t day = rtc_get_datetime(&t) ? time_util_to_epoch(t.year, t.month, t.day, 0, 0, 0) / 86400u : 0;
+    energy_profile_cycle_end(day);
+
+    uint8_t saved[ENERGY_PROFILE_SAVED_SIZE];
+    size_t size = energy_profile_save(saved, sizeof(saved));
+    if (!sd_logger_write_file(ENERGY_FILE, saved, size)) {
+        printf("Energy totals not saved.\n");
+    }
+}
 
 /**
- * @brief Main HCI event handler (scan, connect, disconnect)
- * This function now delegates to the client and server modules.
+ * @brief Core 1: mounts the SD card while core 0 loads the radio firmware and
+ * powers on BTstack. Afterwards it only sleeps: the card driver enabled its
+ * DMA interrupt on this core, so the core has to stay up to handle it.
  */
-static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) {
-    UNUSED(size); 
-    UNUSED(channel); 
-    bd_addr_t local_addr;
-    if (packet_type != HCI_EVENT_PACKET) return;
+static void core1_mount_card(void) {
+    sd_logger_mount();
+    boot_profile_mark(BOOT_PHASE_CARD_READY);
+    while (true) {
+        __wfi();
+    }
+}
 
-    uint8_t event_type = hci_event_packet_get_type(packet); 
-    
-    // Delegate GATT client events
-    if (event_type == GATT_EVENT_SERVICE_QUERY_RESULT ||
-        event_type == GATT_EVENT_CHARACTERISTIC_QUERY_RESULT ||
-        event_type == GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT ||
-        event_type == GATT_EVENT_QUERY_COMPLETE) {
-        
-        if (miflora_client_get_con_handle() != HCI_CON_HANDLE_INVALID) {
-            miflora_client_handle_gatt_event(packet_type, channel, packet, size);
-        }
+/**
+ * @brief Waits for the mount on core 1, then loads what the card holds.
+ */
+static void card_ready_handler(scheduler_task_t *task) {
+    if (!sd_logger_is_ready()) {
+        scheduler_run_in(task, CARD_POLL_INTERVAL_MS);
         return;
     }
 
-    switch(event_type){
-        case BTSTACK_EVENT_STATE:
-            if (btstack_event_state_get_state(packet) == HCI_STATE_WORKING) {
-                gap_local_bd_addr(local_addr);
-                printf("BTstack up and running on %s.\n", bd_addr_to_str(local_addr)); 
-                // Start in server mode
-                enter_server_mode(); 
-            } else {
-                miflora_client_set_state(FLORA_OFF); 
-            }
-            break;
-            
-        case GAP_EVENT_ADVERTISING_REPORT:
-            // This is a client-role event
-            miflora_client_handle_hci_event(packet_type, channel, packet, size); 
-            break;
-            
-        case HCI_EVENT_LE_META:
-            switch (hci_event_le_meta_get_subevent_code(packet)) {
-                case HCI_SUBEVENT_LE_CONNECTION_COMPLETE:
-                    
-                    if (miflora_client_get_state() == FLORA_W4_CONNECT) {
-                        // This is the client connection *to* the MiFlora
-                        miflora_client_handle_hci_event(packet_type, channel, packet, size); 
-                    } 
-                    else if (miflora_client_get_state() == FLORA_IDLE) 
-                    {
-                        // This is a server connection *to* us
-                        btstack_run_loop_remove_timer(&server_advertisement_timer); 
-                        ble_server_handle_hci_event(packet_type, channel, packet, size); 
-                    }
-                    else {
-                        // We are in a busy state... ignore ghost/duplicate event 
-                        printf("Ignoring duplicate connection event in state %d.\n", miflora_client_get_state()); 
-                    }
-                    break;
-                default:
-                    break;
-            }
-            break;
-            
-        case HCI_EVENT_DISCONNECTION_COMPLETE:
-            { 
-                hci_con_handle_t disconnected_handle = hci_event_disconnection_complete_get_connection_handle(packet);
-                
-                if (ble_server_get_con_handle() == disconnected_handle){
-                    ble_server_set_con_handle(HCI_CON_HANDLE_INVALID);
-                    printf("Client disconnected from our server.\n"); 
-                }
-                
-                if (miflora_client_get_con_handle() == disconnected_handle){
-                    miflora_client_set_con_handle(HCI_CON_HANDLE_INVALID);
-                    printf("Disconnected from MiFlora.\n"); 
-                }
-                
-                // Only enter server mode if BOTH connections are invalid
-                if (miflora_client_get_con_handle() == HCI_CON_HANDLE_INVALID && 
-                    ble_server_get_con_handle() == HCI_CON_HANDLE_INVALID)
-                {
-                    printf("All connections closed. Re-entering server mode.\n");
-                    enter_server_mode(); // Go back to advertising
-                }
-            }
-            break;
-            
-        default:
-            break;
+    miflora_client_load_enrolled();
+
+    // Continue the energy totals from before the reset
+    uint8_t energy_saved[ENERGY_PROFILE_SAVED_SIZE];
+    if (energy_profile_load(energy_saved, sd_logger_read_file(ENERGY_FILE, energy_saved, sizeof(energy_saved)))) {
+        printf("Energy totals restored from %s\n", ENERGY_FILE);
     }
+
+    irrigation_port_load();
+    clock_drift_port_load();
+    hci_capture_card_ready();
+    sd_logger_archive_start(); // Days closed before this boot
+    scheduler_signal(SCHEDULER_EVENT_CARD_READY);
 }
 
 /**
- * @brief Timer handler - Used for LED flash ONLY
+ * @brief Prints trace events recorded by the BLE callbacks, a batch at a time.
  */
-static void heartbeat_handler(struct btstack_timer_source *ts) {
+static void trace_drain_handler(scheduler_task_t *task) {
+    scheduler_run_in(task, trace_drain(TRACE_DRAIN_BATCH) ? 0 : TRACE_DRAIN_INTERVAL_MS);
+}
+
+/**
+ * @brief Heartbeat task - Used for LED flash ONLY
+ */
+static void heartbeat_handler(scheduler_task_t *task) {
     static bool quick_flash; 
     static bool led_on = true; 
 
@@ -223,49 +225,62 @@ static void heartbeat_handler(struct btstack_timer_source *ts) {
         quick_flash = false; 
     }
 
-    // Restart timer
-    btstack_run_loop_set_timer(ts, (led_on || quick_flash) ? LED_QUICK_FLASH_DELAY_MS : LED_SLOW_FLASH_DELAY_MS); 
-    btstack_run_loop_add_timer(ts); 
+    // Run again
+    scheduler_run_in(task, (led_on || quick_flash) ? LED_QUICK_FLASH_DELAY_MS : LED_SLOW_FLASH_DELAY_MS); 
 }
 
 /**
- * @brief Timer callback to turn the pump OFF after the duration
+ * @brief Task to turn the pump OFF after the duration
  */
-static void pump_off_handler(struct btstack_timer_source *ts) {
-    UNUSED(ts);
+static void pump_off_handler(scheduler_task_t *task) {
+    UNUSED(task);
     gpio_put(PUMP_GPIO_PIN, 0); // Turn pump OFF
     is_pump_on = false;
+    energy_profile_set(ENERGY_PUMP, false);
     printf("Pump OFF.\n");
 }
 
 /**
- * @brief Public function to turn the pump ON
- * (Called from ble_server.c)
+ * @brief Run the pump for a while (called from irrigation_port.c)
+ * @return false if it is already running.
  */
-void start_pump(void) {
+bool start_pump_for(uint32_t duration_ms) {
     if (is_pump_on) {
-        printf("Pump command ignored, already running.\n");
-        return;
+        return false;
     }
 
-    printf("Pump ON for %lu ms\n", PUMP_DURATION_MS);
+    printf("Pump ON for %lu ms\n", duration_ms);
     is_pump_on = true;
     gpio_put(PUMP_GPIO_PIN, 1); // Turn pump ON
+    energy_profile_set(ENERGY_PUMP, true);
+
+    // Schedule the one-shot task to turn it off
+    scheduler_run_in(&pump_off_task, duration_ms);
+    return true;
+}
 
-    // Set and start the one-shot timer to turn it off
-    btstack_run_loop_set_timer_handler(&pump_off_timer, pump_off_handler);
-    btstack_run_loop_set_timer(&pump_off_timer, PUMP_DURATION_MS);
-    btstack_run_loop_add_timer(&pump_off_timer);
+/**
+ * @brief Public function to turn the pump ON
+ * (Called from ble_server.c)
+ */
+void start_pump(void) {
+    if (!start_pump_for(PUMP_DURATION_MS)) {
+        printf("Pump command ignored, already running.\n");
+    }
 }
 
 int main() {
-    stdio_init_all();
-    sleep_ms(2000); // Wait for stdio
+    boot_profile_mark(BOOT_PHASE_MAIN);
+    stack_probe_init(); // Before core 1 starts on its stack
+    stdio_init_all(); // No wait for a USB host: boot times are in the boot profile
     
     // --- Initialize RTC ---
     printf("Initializing RTC...\n");
     rtc_init(); 
-    printf("RTC initialized. Waiting for time sync from app...\n");
+    printf("RTC initialized.\n");
+
+    // Restores the clock after a watchdog or software reset (warm_restart.h)
+    warm_restart_init();
     // ------------------------------------
 
     // --- Initialize Pump GPIO ---
@@ -276,8 +291,17 @@ int main() {
 
     printf("--- Pico W Miflora Datalogger ---\n");
     
+    // The card mounts on core 1 while the radio comes up here; until
+    // sd_logger_is_ready() nothing on core 0 touches it (see card_ready_handler)
+    multicore_launch_core1(core1_mount_card);
+
     // --- Initialize Modules ---
-    miflora_client_init(target_mac_string);
+    energy_profile_init();
+    boot_profile_init();
+    clock_drift_init();
+    clock_drift_add_error(warm_restart_clock_error_ms()); // 0 unless the clock was restored
+    irrigation_port_init();
+    miflora_client_init(target_mac_strings, sizeof(target_mac_strings) / sizeof(target_mac_strings[0]), poll_cycle_complete);
     sd_logger_init();
     // -------------------------
 
@@ -285,24 +309,43 @@ int main() {
         printf("failed to initialise cyw43_arch\n");
         return -1; 
     }
+    boot_profile_mark(BOOT_PHASE_RADIO_READY);
 
     l2cap_init();
     sm_init();
     sm_set_io_capabilities(IO_CAPABILITY_NO_INPUT_NO_OUTPUT);
     
     // Initialize BLE Server (which initializes ATT server)
-    ble_server_init(hci_event_handler); 
+    ble_server_init(hci_events_packet_handler); 
+    if (warm_restart_clock_restored()) {
+        ble_server_set_rtc_synced(); // Logging resumes without a phone
+    }
     
     // Initialize BLE Client
     gatt_client_init(); 
 
-    hci_event_callback_registration.callback = &hci_event_handler;
+    hci_events_init(stack_ready);
+    hci_event_callback_registration.callback = &hci_events_packet_handler;
     hci_add_event_handler(&hci_event_callback_registration); 
     
-    // Set up LED flashing timer
-    heartbeat.process = &heartbeat_handler; 
-    btstack_run_loop_set_timer(&heartbeat, LED_SLOW_FLASH_DELAY_MS);
-    btstack_run_loop_add_timer(&heartbeat); 
+    // Set up scheduler tasks
+    scheduler_task_init(&pump_off_task, "pump_off", SCHEDULER_PRIORITY_HIGH, pump_off_handler, NULL);
+    scheduler_task_init(&log_cycle_task, "log_cycle", SCHEDULER_PRIORITY_NORMAL, log_cycle_handler, NULL);
+    scheduler_task_init(&heartbeat_task, "heartbeat", SCHEDULER_PRIORITY_LOW, heartbeat_handler, NULL);
+    scheduler_run_in(&heartbeat_task, LED_SLOW_FLASH_DELAY_MS); 
+    scheduler_task_init(&trace_task, "trace", SCHEDULER_PRIORITY_LOW, trace_drain_handler, NULL);
+    scheduler_run_in(&trace_task, TRACE_DRAIN_INTERVAL_MS);
+    scheduler_task_init(&card_task, "card_ready", SCHEDULER_PRIORITY_NORMAL, card_ready_handler, NULL);
+    scheduler_run_in(&card_task, 0);
+
+    // Bulk export of the card to tools/miflora_export over USB serial (see usb_export.h)
+    usb_export_init();
+
+    // Buffer the HCI traffic from power-on until the card says whether to keep it (see hci_capture.h)
+    hci_capture_init();
+
+    // From here on a stuck handler resets the device, which then restarts warm
+    warm_restart_start();
 
     hci_power_control(HCI_POWER_ON);
     
@@ -3,6 +3,14 @@
 #include <string.h>
 #include "btstack.h"
 #include "sd_logger.h" // Include for logging
+#include "ble_server.h" // For live reading notifications
+#include "scheduler.h"
+#include "sensor_health.h"
+#include "sensor_registry.h"
+#include "energy_profile.h"
+#include "trace.h"
+#include "hci_capture.h"
+#include "irrigation.h"
 
 #if 0
 #define DEBUG_LOG(...) printf(__VA_ARGS__)
@@ -10,75 +18,355 @@
 #define DEBUG_LOG(...)
 #endif
 
+#ifdef ENABLE_LE_CENTRAL
+_Static_assert(MIFLORA_MAX_CONNECTIONS <= MAX_NR_GATT_CLIENTS, "each sensor connection needs a BTstack GATT client");
+#endif
+
 // --- Miflora Definitions ---
-static bd_addr_t target_mac_addr; //
 #define TARGET_SERVICE_UUID 0x1204 //
 #define TARGET_CHAR_MODE_UUID 0x1A00 //
 #define TARGET_CHAR_DATA_UUID 0x1A01 //
 #define TARGET_CHAR_BATT_UUID 0x1A02 //
 static uint8_t mode_command[2] = {0xA0, 0x1F}; //
 
-// --- Global BLE State Variables ---
-static miflora_state_t state = FLORA_OFF; //
-static bd_addr_t server_addr;
-static bd_addr_type_t server_addr_type;
-static hci_con_handle_t connection_handle = HCI_CON_HANDLE_INVALID; //
-static gatt_client_service_t server_service; //
-static gatt_client_characteristic_t char_mode; //
-static gatt_client_characteristic_t char_data; //
-static gatt_client_characteristic_t char_battery; //
-static miflora_reading_t current_reading; //
-
-// Temporary storage for read data
-static uint8_t  temp_read_value[30]; //
-static uint16_t temp_read_value_length; //
+// --- Connection Contexts ---
+// One per sensor read in progress. Reads overlap: while one context reads
+// its sensor over GATT, the others scan for or connect to the next sensors.
+typedef struct {
+    miflora_state_t state;
+    int sensor;                          // Index into the sensor health table, -1 if free
+    bd_addr_t addr;
+    bd_addr_type_t addr_type;
+    hci_con_handle_t con_handle;
+    gatt_client_service_t service;
+    gatt_client_characteristic_t char_mode;
+    gatt_client_characteristic_t char_data;
+    gatt_client_characteristic_t char_battery;
+    miflora_reading_t reading;
+    uint8_t read_value[30];              // Temporary storage for read data
+    uint16_t read_value_length;
+    scheduler_task_t timeout_task;       // Deadline of the current state
+} miflora_conn_t;
+
+static miflora_conn_t conns[MIFLORA_MAX_CONNECTIONS];
+static int max_connections = MIFLORA_MAX_CONNECTIONS;
+static bool client_on = false;           // BTstack is up
+static bool scanning = false;
+static miflora_reading_t last_reading;
+
+// --- Poll Cycle State ---
+static bool cycle_active = false;
+static uint32_t cycle_done_mask = 0;   // Sensors already polled this cycle
+static void (*cycle_complete_callback)(void) = NULL;
+
+// --- Discovery ---
+static bool discovery_active = false;  // New MiFloras in advertisements are added to the registry
+static scheduler_task_t discovery_task;
+
+// --- State Deadlines ---
+static uint32_t state_timeout_ms[FLORA_NUM_STATES] = {
+    [FLORA_W4_SCAN_RESULT]            = MIFLORA_SCAN_TIMEOUT_MS,
+    [FLORA_W4_CONNECT]                = MIFLORA_CONNECT_TIMEOUT_MS,
+    [FLORA_W4_CANCEL]                 = MIFLORA_CANCEL_TIMEOUT_MS,
+    [FLORA_W4_SERVICE_RESULT]         = MIFLORA_GATT_TIMEOUT_MS,
+    [FLORA_W4_CHARACTERISTICS_RESULT] = MIFLORA_GATT_TIMEOUT_MS,
+    [FLORA_W4_WRITE_MODE_COMPLETE]    = MIFLORA_GATT_TIMEOUT_MS,
+    [FLORA_W4_READ_DATA_COMPLETE]     = MIFLORA_GATT_TIMEOUT_MS,
+    [FLORA_W4_READ_BATT_COMPLETE]     = MIFLORA_GATT_TIMEOUT_MS,
+    [FLORA_W4_DISCONNECT]             = MIFLORA_DISCONNECT_TIMEOUT_MS,
+};
 
 // --- Private Function Declarations ---
 // *** FIX 1: Removed the static forward declaration for handle_gatt_client_event ***
 static void parseSensorData(const uint8_t *data, uint16_t length, miflora_reading_t *reading);
 static void parseBatteryData(const uint8_t *data, uint16_t length, miflora_reading_t *reading);
+static void state_timeout_handler(scheduler_task_t *task);
+static void start_next_reads(void);
+static void discovery_handler(scheduler_task_t *task);
+
+// --- Private Functions (Connection Contexts) ---
+
+static miflora_conn_t *find_in_state(miflora_state_t wanted) {
+    for (int i = 0; i < MIFLORA_MAX_CONNECTIONS; i++) {
+        if (conns[i].state == wanted) return &conns[i];
+    }
+    return NULL;
+}
+
+static miflora_conn_t *find_by_handle(hci_con_handle_t handle) {
+    if (handle == HCI_CON_HANDLE_INVALID) return NULL;
+    for (int i = 0; i < MIFLORA_MAX_CONNECTIONS; i++) {
+        if (conns[i].con_handle == handle) return &conns[i];
+    }
+    return NULL;
+}
+
+static miflora_conn_t *find_scanning_for(int sensor) {
+    for (int i = 0; i < MIFLORA_MAX_CONNECTIONS; i++) {
+        if (conns[i].state == FLORA_W4_SCAN_RESULT && conns[i].sensor == sensor) return &conns[i];
+    }
+    return NULL;
+}
+
+static bool is_busy(const miflora_conn_t *conn) {
+    return conn->state != FLORA_IDLE && conn->state != FLORA_OFF;
+}
+
+/**
+ * @brief Scans while a context waits for its sensor (or discovery runs), but
+ * not during a connection attempt, and charges the radio time.
+ */
+static void update_radio(void) {
+    bool waiting = false;
+    bool connecting = false;
+    bool linked = false;
+    for (int i = 0; i < MIFLORA_MAX_CONNECTIONS; i++) {
+        miflora_state_t s = conns[i].state;
+        waiting |= s == FLORA_W4_SCAN_RESULT;
+        connecting |= s == FLORA_W4_CONNECT || s == FLORA_W4_CANCEL;
+        linked |= s >= FLORA_W4_CONNECT && s <= FLORA_W4_DISCONNECT;
+    }
+
+    bool want_scan = client_on && !connecting && (waiting || discovery_active);
+    if (want_scan && !scanning) {
+        gap_set_scan_parameters(0, 0x0030, 0x0030);
+        gap_start_scan();
+    } else if (!want_scan && scanning) {
+        gap_stop_scan();
+    }
+    scanning = want_scan;
+    energy_profile_set(ENERGY_SCANNING, scanning);
+    energy_profile_set(ENERGY_CLIENT_CONNECTION, linked);
+}
+
+/**
+ * @brief Single place for state changes, so every state gets its deadline
+ * and the radio time is charged to scanning or the sensor connection.
+ */
+static void enter_state(miflora_conn_t *conn, miflora_state_t new_state) {
+    conn->state = new_state;
+    TRACE(FLORA_STATE, conn->sensor, new_state);
+    if (state_timeout_ms[new_state] > 0) {
+        scheduler_run_in(&conn->timeout_task, state_timeout_ms[new_state]);
+    } else {
+        scheduler_cancel(&conn->timeout_task);
+    }
+    update_radio();
+}
+
+/**
+ * @brief Frees the context and gives it the next due sensor, if any.
+ */
+static void finish_read(miflora_conn_t *conn) {
+    enter_state(conn, FLORA_IDLE);
+    conn->sensor = -1;
+    start_next_reads();
+}
+
+/**
+ * @brief Count the current attempt as failed and close the link, if any.
+ * The context moves on once the disconnect completes.
+ */
+static void fail_and_disconnect(miflora_conn_t *conn) {
+    sensor_health_record_failure(conn->sensor, btstack_run_loop_get_time_ms());
+    enter_state(conn, FLORA_W4_DISCONNECT);
+    gap_disconnect(conn->con_handle);
+}
+
+/**
+ * @brief Gives every free context the next due sensor and starts scanning
+ * for it. Ends the cycle when every sensor was polled or is backing off.
+ */
+static void start_next_reads(void) {
+    if (!cycle_active) return;
+
+    bool busy = false;
+    for (int i = 0; i < max_connections; i++) {
+        miflora_conn_t *conn = &conns[i];
+        if (conn->state == FLORA_IDLE) {
+            int sensor = sensor_health_pick_next(btstack_run_loop_get_time_ms(), cycle_done_mask);
+            if (sensor >= 0) {
+                cycle_done_mask |= 1u << sensor;
+                conn->sensor = sensor;
+                // Nothing of the context's previous sensor may end up in this reading
+                memset(&conn->reading, 0, sizeof(conn->reading));
+                conn->read_value_length = 0;
+                DEBUG_LOG("Start scanning for Miflora %d!\n", sensor);
+                enter_state(conn, FLORA_W4_SCAN_RESULT); //
+            }
+        }
+        busy |= is_busy(conn);
+    }
+
+    if (!busy) {
+        cycle_active = false;
+        TRACE(POLL_CYCLE_COMPLETE, 0, 0);
+        if (cycle_complete_callback) {
+            cycle_complete_callback();
+        }
+    }
+}
+
+/**
+ * @brief Fires when a state's deadline passes without progress.
+ */
+static void state_timeout_handler(scheduler_task_t *task) {
+    miflora_conn_t *conn = (miflora_conn_t *)task->context;
+    TRACE(FLORA_TIMEOUT, conn->sensor, conn->state);
+
+    switch (conn->state) {
+        case FLORA_W4_SCAN_RESULT:
+            // Sensor out of range or not advertising
+            sensor_health_record_failure(conn->sensor, btstack_run_loop_get_time_ms());
+            finish_read(conn);
+            break;
+        case FLORA_W4_CONNECT:
+            // The context stays taken until the controller reports the cancel,
+            // so a late result cannot be mistaken for the next attempt's
+            sensor_health_record_failure(conn->sensor, btstack_run_loop_get_time_ms());
+            enter_state(conn, FLORA_W4_CANCEL);
+            gap_connect_cancel();
+            break;
+        case FLORA_W4_CANCEL:
+            // Controller never reported the cancel; stop waiting for it
+            finish_read(conn);
+            break;
+        case FLORA_W4_SERVICE_RESULT:
+        case FLORA_W4_CHARACTERISTICS_RESULT:
+        case FLORA_W4_WRITE_MODE_COMPLETE:
+        case FLORA_W4_READ_DATA_COMPLETE:
+        case FLORA_W4_READ_BATT_COMPLETE:
+            // GATT request never answered
+            fail_and_disconnect(conn);
+            break;
+        case FLORA_W4_DISCONNECT:
+            // Controller never reported the disconnect; stop waiting for it
+            conn->con_handle = HCI_CON_HANDLE_INVALID;
+            finish_read(conn);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Ends the discovery window. A poll cycle's scan keeps running.
+ */
+static void discovery_handler(scheduler_task_t *task) {
+    UNUSED(task);
+    discovery_active = false;
+    update_radio();
+    printf("Discovery finished: %d new MiFloras, %lu not kept\n",
+           sensor_registry_discovered_count(), (unsigned long)sensor_registry_dropped());
+}
 
 // --- Public Function Implementations ---
 
-void miflora_client_init(const char *mac_string) {
-    sscanf_bd_addr(mac_string, target_mac_addr); //
-    state = FLORA_IDLE;
+void miflora_client_init(const char * const *mac_strings, int count, void (*cycle_complete_handler)(void)) {
+    for (int i = 0; i < count; i++) {
+        bd_addr_t addr;
+        if (!sscanf_bd_addr(mac_strings[i], addr) || sensor_registry_enroll(addr) < 0) {
+            printf("Ignoring sensor address '%s'.\n", mac_strings[i]);
+        }
+    }
+    cycle_complete_callback = cycle_complete_handler;
+    for (int i = 0; i < MIFLORA_MAX_CONNECTIONS; i++) {
+        miflora_conn_t *conn = &conns[i];
+        conn->state = FLORA_IDLE;
+        conn->sensor = -1;
+        conn->con_handle = HCI_CON_HANDLE_INVALID;
+        scheduler_task_init(&conn->timeout_task, "flora_timeout", SCHEDULER_PRIORITY_NORMAL, state_timeout_handler, conn);
+    }
+    scheduler_task_init(&discovery_task, "discovery", SCHEDULER_PRIORITY_LOW, discovery_handler, NULL);
+    client_on = true;
+}
+
+void miflora_client_load_enrolled(void) {
+    uint8_t saved[SENSOR_REGISTRY_SAVED_MAX];
+    int enrolled = sensor_registry_load(saved, sd_logger_read_file(SENSOR_REGISTRY_FILE, saved, sizeof(saved)));
+    if (enrolled > 0) {
+        printf("%d enrolled sensors restored from %s\n", enrolled, SENSOR_REGISTRY_FILE);
+    }
+}
+
+void miflora_client_discover(uint32_t duration_ms) {
+    discovery_active = true;
+    update_radio();
+    scheduler_run_in(&discovery_task, duration_ms);
+}
+
+int miflora_client_enroll(const char *mac_string) {
+    bd_addr_t addr;
+    if (!sscanf_bd_addr(mac_string, addr)) return -1;
+    int sensor = sensor_registry_enroll(addr);
+    if (sensor < 0) return -1;
+
+    // Polled from the next cycle on, and after every reset
+    uint8_t saved[SENSOR_REGISTRY_SAVED_MAX];
+    if (!sd_logger_write_file(SENSOR_REGISTRY_FILE, saved, sensor_registry_save(saved, sizeof(saved)))) {
+        printf("Enroll: %s not saved\n", SENSOR_REGISTRY_FILE);
+    }
+    return sensor;
 }
 
 void miflora_client_start(void) {
-    DEBUG_LOG("Start scanning for Miflora!\n");
-    state = FLORA_W4_SCAN_RESULT; //
-    gap_set_scan_parameters(0, 0x0030, 0x0030);
-    gap_start_scan();
+    cycle_done_mask = 0;
+    cycle_active = true;
+    start_next_reads();
+}
+
+void miflora_client_set_state_timeout(miflora_state_t target_state, uint32_t timeout_ms) {
+    if (target_state < FLORA_NUM_STATES) {
+        state_timeout_ms[target_state] = timeout_ms;
+    }
+}
+
+void miflora_client_set_max_connections(int count) {
+    max_connections = count < 1 ? 1 : count > MIFLORA_MAX_CONNECTIONS ? MIFLORA_MAX_CONNECTIONS : count;
 }
 
 miflora_state_t miflora_client_get_state(void) {
-    return state;
+    for (int i = 0; i < MIFLORA_MAX_CONNECTIONS; i++) {
+        if (is_busy(&conns[i])) return conns[i].state;
+    }
+    return client_on ? FLORA_IDLE : FLORA_OFF;
 }
 
 void miflora_client_set_state(miflora_state_t new_state) {
-    state = new_state;
+    client_on = new_state != FLORA_OFF;
+    if (!client_on) scanning = false; // Went down with the stack
+    cycle_active = false;
+    for (int i = 0; i < MIFLORA_MAX_CONNECTIONS; i++) {
+        conns[i].sensor = -1;
+        conns[i].con_handle = HCI_CON_HANDLE_INVALID; // Links are gone after a stack restart
+        enter_state(&conns[i], new_state);
+    }
 }
 
 hci_con_handle_t miflora_client_get_con_handle(void) {
-    return connection_handle;
+    for (int i = 0; i < MIFLORA_MAX_CONNECTIONS; i++) {
+        if (conns[i].con_handle != HCI_CON_HANDLE_INVALID) return conns[i].con_handle;
+    }
+    return HCI_CON_HANDLE_INVALID;
 }
 
-void miflora_client_set_con_handle(hci_con_handle_t handle) {
-    connection_handle = handle;
+bool miflora_client_has_connection(hci_con_handle_t handle) {
+    return find_by_handle(handle) != NULL;
 }
 
 miflora_reading_t* miflora_client_get_last_reading(void) {
-    return &current_reading;
+    return &last_reading;
 }
 
 void miflora_client_print_reading(void) {
+    int32_t values[READING_NUM_FIELDS];
+    char text[READING_TEXT_MAX];
+    reading_to_array(&last_reading.values, values);
+    reading_format_text(values, text);
+
     printf("\n--- Miflora Data ---\n");
-    printf("  Temperature:  %.1f C\n", current_reading.temperature); //
-    printf("  Light:        %lu lux\n", (unsigned long)current_reading.light); //
-    printf("  Moisture:     %u %%\n", current_reading.moisture); //
-    printf("  Conductivity: %u uS/cm\n", current_reading.conductivity); //
-    printf("  Battery:      %u %%\n", current_reading.battery); //
+    printf("  Sensor:       %s\n", bd_addr_to_str(last_reading.address));
+    printf("  Reading:      %s\n", text + 1); // Skip the leading ','
     printf("--------------------\n");
 }
 
@@ -90,37 +378,96 @@ void miflora_client_handle_hci_event(uint8_t packet_type, uint16_t channel, uint
     UNUSED(size);
 
     uint8_t event_type = hci_event_packet_get_type(packet);
+    miflora_conn_t *conn;
     
     switch (event_type) {
-        case GAP_EVENT_ADVERTISING_REPORT:
-            if (state != FLORA_W4_SCAN_RESULT) return; //
-            
+        case GAP_EVENT_ADVERTISING_REPORT: {
             bd_addr_t event_addr;
             gap_event_advertising_report_get_address(packet, event_addr); //
-            
-            if (memcmp(event_addr, target_mac_addr, 6) != 0) {
-                return; // Not our device
+            int8_t rssi = (int8_t)gap_event_advertising_report_get_rssi(packet);
+            uint32_t now_ms = btstack_run_loop_get_time_ms();
+
+            // One hash lookup per report, however many devices are around
+            sensor_registry_entry_t *entry = sensor_registry_find(event_addr);
+            if (!entry && discovery_active &&
+                sensor_registry_is_miflora_adv(gap_event_advertising_report_get_data(packet),
+                                               gap_event_advertising_report_get_data_length(packet))) {
+                entry = sensor_registry_add_discovered(event_addr);
+                if (entry) TRACE(FLORA_DISCOVERED, rssi, sensor_registry_discovered_count());
+            }
+            if (!entry) {
+                return; // Not one of our devices
+            }
+            sensor_registry_record_seen(entry, rssi, now_ms);
+
+            int sensor = entry->sensor;
+            if (sensor < 0) {
+                return; // Discovered, not enrolled
             }
+            sensor_health_record_seen(sensor, rssi, now_ms);
 
-            printf("Found Miflora sensor: %s\n", bd_addr_to_str(event_addr)); //
-            memcpy(server_addr, event_addr, 6); //
-            server_addr_type = gap_event_advertising_report_get_address_type(packet); //
+            // One connection attempt at a time (a cancelled one counts until it is
+            // settled); the others wait for the next report
+            if (find_in_state(FLORA_W4_CONNECT) || find_in_state(FLORA_W4_CANCEL)) return;
+            conn = find_scanning_for(sensor);
+            if (!conn) return; //
+
+            TRACE(FLORA_FOUND, sensor, rssi);
+            memcpy(conn->addr, event_addr, 6); //
+            conn->addr_type = gap_event_advertising_report_get_address_type(packet); //
             
-            state = FLORA_W4_CONNECT; //
-            gap_stop_scan();
-            printf("...connecting to check for service 0x%04X...\n", TARGET_SERVICE_UUID);
-            gap_connect(server_addr, server_addr_type); //
+            enter_state(conn, FLORA_W4_CONNECT); // Stops the scan
+            gap_connect(conn->addr, conn->addr_type); //
             break;
+        }
 
         case HCI_EVENT_LE_META:
             if (hci_event_le_meta_get_subevent_code(packet) == HCI_SUBEVENT_LE_CONNECTION_COMPLETE) {
-                // This is our *client* connection *to* the MiFlora
-                connection_handle = hci_subevent_le_connection_complete_get_connection_handle(packet); //
-                printf("Connected to MiFlora. Searching for service 0x%04X.\n", TARGET_SERVICE_UUID); //
-                state = FLORA_W4_SERVICE_RESULT; //
+                // This is one of our *client* connections *to* a MiFlora
+                conn = find_in_state(FLORA_W4_CONNECT);
+                if (!conn && (conn = find_in_state(FLORA_W4_CANCEL)) != NULL) {
+                    // Outcome of a timed-out attempt, its failure is already recorded
+                    if (hci_subevent_le_connection_complete_get_status(packet) != ERROR_CODE_SUCCESS) {
+                        finish_read(conn); // Cancelled (unknown connection identifier)
+                    } else {
+                        // Connected just before the cancel; drop the link, then move on
+                        conn->con_handle = hci_subevent_le_connection_complete_get_connection_handle(packet);
+                        enter_state(conn, FLORA_W4_DISCONNECT);
+                        gap_disconnect(conn->con_handle);
+                    }
+                    break;
+                }
+                if (hci_subevent_le_connection_complete_get_status(packet) != ERROR_CODE_SUCCESS) {
+                    if (!conn) break; // Nothing was waiting for it
+                    TRACE(FLORA_CONNECT_FAILED, conn->sensor, hci_subevent_le_connection_complete_get_status(packet));
+                    sensor_health_record_failure(conn->sensor, btstack_run_loop_get_time_ms());
+                    finish_read(conn);
+                    break;
+                }
+                if (!conn) {
+                    // Connect completed after we gave up on it; drop the link
+                    gap_disconnect(hci_subevent_le_connection_complete_get_connection_handle(packet));
+                    break;
+                }
+                conn->con_handle = hci_subevent_le_connection_complete_get_connection_handle(packet); //
+                TRACE(FLORA_CONNECTED, conn->sensor, conn->con_handle);
+                enter_state(conn, FLORA_W4_SERVICE_RESULT); // Scanning for the others resumes
                 // *** FIX 4: Update internal callback references ***
-                gatt_client_discover_primary_services_by_uuid16(miflora_client_handle_gatt_event, connection_handle, TARGET_SERVICE_UUID); //
+                gatt_client_discover_primary_services_by_uuid16(miflora_client_handle_gatt_event, conn->con_handle, TARGET_SERVICE_UUID); //
+            }
+            break;
+
+        case HCI_EVENT_DISCONNECTION_COMPLETE:
+            conn = find_by_handle(hci_event_disconnection_complete_get_connection_handle(packet));
+            if (!conn) break;
+            conn->con_handle = HCI_CON_HANDLE_INVALID;
+            TRACE(FLORA_DISCONNECTED, conn->sensor, hci_event_disconnection_complete_get_reason(packet));
+            if (!is_busy(conn)) break;
+            if (conn->state != FLORA_W4_DISCONNECT) {
+                // Sensor dropped the link in the middle of a read
+                sensor_health_record_failure(conn->sensor, btstack_run_loop_get_time_ms());
             }
+            finish_read(conn);
             break;
         
         default:
@@ -135,28 +482,18 @@ static void parseSensorData(const uint8_t *data, uint16_t length, miflora_readin
         printf("Invalid data length: %u bytes, expected 16\n", length);
         return; //
     }
-    int16_t temp_raw = (int16_t)little_endian_read_16(data, 0);
-    reading->temperature = temp_raw / 10.0f;
-    reading->light = little_endian_read_32(data, 3);
-    reading->moisture = data[7]; //
-    reading->conductivity = little_endian_read_16(data, 8); //
+    reading_parse_ble(&reading->values, READING_SRC_DATA, data, length);
 }
 
 static void parseBatteryData(const uint8_t *data, uint16_t length, miflora_reading_t *reading) {
-    if (length > 0) {
-        reading->battery = data[0]; // Battery is byte 0
-    }
+    reading_parse_ble(&reading->values, READING_SRC_BATTERY, data, length);
 }
 
 /**
  * @brief Main GATT event handler and state machine
- * This is the original handle_gatt_client_event function, now public.
+ * This is the original handle_gatt_client_event function.
  */
-// *** FIX 2: Renamed function to match header and removed 'static' ***
-void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) {
-    UNUSED(packet_type); //
-    UNUSED(channel); //
-    UNUSED(size); //
+static void handle_gatt_event(miflora_conn_t *conn, uint8_t *packet) {
 
     uint8_t att_status;
 
@@ -164,28 +501,26 @@ void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uin
     #define CHECK_ATT_STATUS_AND_DISCONNECT(packet) \
         att_status = gatt_event_query_complete_get_att_status(packet); \
         if (att_status != ATT_ERROR_SUCCESS){ \
-            printf("GATT Error 0x%02x, disconnecting.\n", att_status); \
-            state = FLORA_IDLE; /* */ \
-            gap_disconnect(connection_handle); /* */ \
+            TRACE(FLORA_GATT_ERROR, conn->sensor, att_status); \
+            fail_and_disconnect(conn); \
             break; \
         } 
 
-    switch(state){
+    switch(conn->state){
         case FLORA_W4_SERVICE_RESULT:
             switch(hci_event_packet_get_type(packet)) {
                 case GATT_EVENT_SERVICE_QUERY_RESULT:
                     DEBUG_LOG("Storing service\n");
-                    gatt_event_service_query_result_get_service(packet, &server_service); //
+                    gatt_event_service_query_result_get_service(packet, &conn->service); //
                     break;
                 case GATT_EVENT_QUERY_COMPLETE:
                     CHECK_ATT_STATUS_AND_DISCONNECT(packet);
-                    printf("Found service 0x%04X, discovering characteristics...\n", TARGET_SERVICE_UUID); //
-                    state = FLORA_W4_CHARACTERISTICS_RESULT; //
-                    char_mode.value_handle = 0;
-                    char_data.value_handle = 0;
-                    char_battery.value_handle = 0;
+                    enter_state(conn, FLORA_W4_CHARACTERISTICS_RESULT); //
+                    conn->char_mode.value_handle = 0;
+                    conn->char_data.value_handle = 0;
+                    conn->char_battery.value_handle = 0;
                     // *** FIX 4: Update internal callback references ***
-                    gatt_client_discover_characteristics_for_service(miflora_client_handle_gatt_event, connection_handle, &server_service); //
+                    gatt_client_discover_characteristics_for_service(miflora_client_handle_gatt_event, conn->con_handle, &conn->service); //
                     break;
                 default:
                     break;
@@ -199,30 +534,28 @@ void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uin
                     uint16_t uuid = characteristic.uuid16;
 
                     if (uuid == TARGET_CHAR_MODE_UUID) {
-                        memcpy(&char_mode, &characteristic, sizeof(gatt_client_characteristic_t));
+                        memcpy(&conn->char_mode, &characteristic, sizeof(gatt_client_characteristic_t));
                         DEBUG_LOG("Found Mode Char (0x%04X)\n", uuid); //
                     } else if (uuid == TARGET_CHAR_DATA_UUID) {
-                        memcpy(&char_data, &characteristic, sizeof(gatt_client_characteristic_t));
+                        memcpy(&conn->char_data, &characteristic, sizeof(gatt_client_characteristic_t));
                         DEBUG_LOG("Found Data Char (0x%04X)\n", uuid); //
                     } else if (uuid == TARGET_CHAR_BATT_UUID) {
-                        memcpy(&char_battery, &characteristic, sizeof(gatt_client_characteristic_t));
+                        memcpy(&conn->char_battery, &characteristic, sizeof(gatt_client_characteristic_t));
                         DEBUG_LOG("Found Battery Char (0x%04X)\n", uuid); //
                     }
                     break;
                 }
                 case GATT_EVENT_QUERY_COMPLETE:
                     CHECK_ATT_STATUS_AND_DISCONNECT(packet);
-                    if (char_mode.value_handle == 0 || char_data.value_handle == 0 || char_battery.value_handle == 0) { //
-                        printf("Failed to find all required characteristics. Disconnecting.\n");
-                        state = FLORA_IDLE; //
-                        gap_disconnect(connection_handle);
+                    if (conn->char_mode.value_handle == 0 || conn->char_data.value_handle == 0 || conn->char_battery.value_handle == 0) { //
+                        TRACE(FLORA_NO_CHARACTERISTICS, conn->sensor, 0);
+                        fail_and_disconnect(conn);
                         break;
                     }
-                    
-                    printf("Found all characteristics. Writing mode command...\n");
-                    state = FLORA_W4_WRITE_MODE_COMPLETE; //
+
+                    enter_state(conn, FLORA_W4_WRITE_MODE_COMPLETE); //
                     // *** FIX 4: Update internal callback references ***
-                    gatt_client_write_value_of_characteristic(miflora_client_handle_gatt_event, connection_handle, char_mode.value_handle, sizeof(mode_command), mode_command); //
+                    gatt_client_write_value_of_characteristic(miflora_client_handle_gatt_event, conn->con_handle, conn->char_mode.value_handle, sizeof(mode_command), mode_command); //
                     break;
                 default:
                     break;
@@ -232,10 +565,10 @@ void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uin
             switch(hci_event_packet_get_type(packet)) {
                 case GATT_EVENT_QUERY_COMPLETE:
                     CHECK_ATT_STATUS_AND_DISCONNECT(packet);
-                    printf("Mode write complete. Reading sensor data...\n"); //
-                    state = FLORA_W4_READ_DATA_COMPLETE; //
+                    enter_state(conn, FLORA_W4_READ_DATA_COMPLETE); //
                     // *** FIX 4: Update internal callback references ***
-                    gatt_client_read_value_of_characteristic(miflora_client_handle_gatt_event, connection_handle, &char_data); //
+                    conn->read_value_length = 0; // A read with no value must not parse the last one
+                    gatt_client_read_value_of_characteristic(miflora_client_handle_gatt_event, conn->con_handle, &conn->char_data); //
                     break;
                 default:
                     break;
@@ -244,21 +577,23 @@ void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uin
         case FLORA_W4_READ_DATA_COMPLETE: //
             switch(hci_event_packet_get_type(packet)) {
                 case GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT: {
-                    temp_read_value_length = gatt_event_characteristic_value_query_result_get_value_length(packet); //
+                    conn->read_value_length = gatt_event_characteristic_value_query_result_get_value_length(packet); //
                     const uint8_t *value = gatt_event_characteristic_value_query_result_get_value(packet); //
-                    if (temp_read_value_length > 0 && temp_read_value_length <= sizeof(temp_read_value)) {
-                        memcpy(temp_read_value, value, temp_read_value_length); //
+                    if (conn->read_value_length > 0 && conn->read_value_length <= sizeof(conn->read_value)) {
+                        memcpy(conn->read_value, value, conn->read_value_length); //
+                    } else {
+                        conn->read_value_length = 0;
                     }
                     break;
                 }
                 case GATT_EVENT_QUERY_COMPLETE: {
                     CHECK_ATT_STATUS_AND_DISCONNECT(packet);
-                    parseSensorData(temp_read_value, temp_read_value_length, &current_reading); //
-                    
-                    printf("Data read complete. Reading battery...\n");
-                    state = FLORA_W4_READ_BATT_COMPLETE; //
+                    parseSensorData(conn->read_value, conn->read_value_length, &conn->reading); //
+
+                    enter_state(conn, FLORA_W4_READ_BATT_COMPLETE); //
                     // *** FIX 4: Update internal callback references ***
-                    gatt_client_read_value_of_characteristic(miflora_client_handle_gatt_event, connection_handle, &char_battery); //
+                    conn->read_value_length = 0; // A read with no value must not parse the last one
+                    gatt_client_read_value_of_characteristic(miflora_client_handle_gatt_event, conn->con_handle, &conn->char_battery); //
                     break;
                 }
                 default:
@@ -268,30 +603,38 @@ void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uin
         case FLORA_W4_READ_BATT_COMPLETE: //
              switch(hci_event_packet_get_type(packet)) {
                 case GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT: {
-                    temp_read_value_length = gatt_event_characteristic_value_query_result_get_value_length(packet); //
+                    conn->read_value_length = gatt_event_characteristic_value_query_result_get_value_length(packet); //
                     const uint8_t *value = gatt_event_characteristic_value_query_result_get_value(packet); //
-                    if (temp_read_value_length > 0 && temp_read_value_length <= sizeof(temp_read_value)) {
-                        memcpy(temp_read_value, value, temp_read_value_length); //
+                    if (conn->read_value_length > 0 && conn->read_value_length <= sizeof(conn->read_value)) {
+                        memcpy(conn->read_value, value, conn->read_value_length); //
+                    } else {
+                        conn->read_value_length = 0;
                     }
                     break;
                 }
                 case GATT_EVENT_QUERY_COMPLETE: {
                     att_status = gatt_event_query_complete_get_att_status(packet);
                     if (att_status != ATT_ERROR_SUCCESS) { //
-                         printf("Battery read failed, error 0x%02x\n", att_status); //
+                         TRACE(FLORA_BATTERY_FAILED, conn->sensor, att_status);
                     } else {
-                        parseBatteryData(temp_read_value, temp_read_value_length, &current_reading); //
+                        parseBatteryData(conn->read_value, conn->read_value_length, &conn->reading); //
                     }
-                    
-                    printf("Battery read complete.\n");
-                    // 1. Print to console
-                    miflora_client_print_reading(); //
+
+                    memcpy(conn->reading.address, conn->addr, 6);
+                    conn->reading.sensor_index = (uint8_t)conn->sensor;
+                    last_reading = conn->reading;
+                    sensor_health_record_success(conn->sensor, btstack_run_loop_get_time_ms());
+                    // 1. Trace (printed later, outside this callback)
+                    TRACE(FLORA_READING, conn->sensor, conn->reading.values.temperature);
                     // 2. Log to SD card
-                    printf("Logging data to SD card...\n");
-                    sd_logger_log_reading(&current_reading); //
+                    sd_logger_log_reading(&conn->reading); //
+                    // 3. Push to any subscribed phone
+                    ble_server_notify_reading(&conn->reading);
+                    // 4. Watering decision (decided and logged from a task)
+                    irrigation_port_reading(conn->sensor, conn->addr, conn->reading.values.moisture);
                     
-                    state = FLORA_IDLE; //
-                    gap_disconnect(connection_handle); //
+                    enter_state(conn, FLORA_W4_DISCONNECT); //
+                    gap_disconnect(conn->con_handle); //
                     break;
                 }
                 default:
@@ -299,7 +642,20 @@ void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uin
             }
             break;
         default:
-            DEBUG_LOG("Unhandled state %d, event 0x%02x\n", state, hci_event_packet_get_type(packet)); //
+            DEBUG_LOG("Unhandled state %d, event 0x%02x\n", conn->state, hci_event_packet_get_type(packet)); //
             break;
     }
-}
\ No newline at end of file
+}
+// *** FIX 2: Renamed function to match header and removed 'static' ***
+void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) {
+    uint32_t start_us = trace_latency_begin();
+    UNUSED(channel);
+    hci_capture_app_event(packet_type, packet, size); // GATT client events bypass BTstack's packet dump
+
+    // Every GATT client event starts with the handle of the connection it belongs to
+    miflora_conn_t *conn = find_by_handle(little_endian_read_16(packet, 2));
+    if (conn) {
+        handle_gatt_event(conn, packet);
+    }
+    trace_latency_end(TRACE_CALLBACK_GATT_EVENT, start_us);
+}
@@ -2,55 +2,124 @@
 #define MIFLORA_CLIENT_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "btstack.h"
+#include "reading_schema.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 // Struct to hold the parsed sensor data 
 typedef struct {
-    float temperature;
-    uint32_t light;
-    uint8_t moisture;
-    uint16_t conductivity;
-    uint8_t battery;
+    reading_values_t values; // Fixed point, fields defined in reading_schema.h
+    bd_addr_t address;     // Sensor the reading came from
+    uint8_t sensor_index;  // Index in the configured sensor list
 } miflora_reading_t;
 
 // State machine for the multi-step read 
 typedef enum {
     FLORA_OFF,
-    FLORA_IDLE, // Server Mode 
+    FLORA_IDLE, // No sensor read in progress 
     FLORA_W4_SCAN_RESULT,
     FLORA_W4_CONNECT,
+    FLORA_W4_CANCEL,                 // Connect timed out, waiting for the controller's cancel outcome
     FLORA_W4_SERVICE_RESULT,
     FLORA_W4_CHARACTERISTICS_RESULT, // Discovering all 3 chars 
     FLORA_W4_WRITE_MODE_COMPLETE,    // Waiting for mode write to finish 
     FLORA_W4_READ_DATA_COMPLETE,     // Waiting for main data read 
-    FLORA_W4_READ_BATT_COMPLETE      // Waiting for battery data read 
+    FLORA_W4_READ_BATT_COMPLETE,     // Waiting for battery data read 
+    FLORA_W4_DISCONNECT,             // Waiting for the sensor link to close
+    FLORA_NUM_STATES
 } miflora_state_t;
 
+// Default deadlines per state (0 = no deadline), overridable at build time
+#ifndef MIFLORA_SCAN_TIMEOUT_MS
+#define MIFLORA_SCAN_TIMEOUT_MS 30000    // Sensor not advertising / out of range
+#endif
+#ifndef MIFLORA_CONNECT_TIMEOUT_MS
+#define MIFLORA_CONNECT_TIMEOUT_MS 10000
+#endif
+#ifndef MIFLORA_CANCEL_TIMEOUT_MS
+#define MIFLORA_CANCEL_TIMEOUT_MS 2000   // Controller never reports the connect cancel
+#endif
+#ifndef MIFLORA_GATT_TIMEOUT_MS
+#define MIFLORA_GATT_TIMEOUT_MS 5000     // Each discovery / read / write step
+#endif
+#ifndef MIFLORA_DISCONNECT_TIMEOUT_MS
+#define MIFLORA_DISCONNECT_TIMEOUT_MS 3000
+#endif
+// Sensor connections held at once. While one sensor is read over GATT, the
+// next ones are scanned for and connected; 1 reads one sensor after another.
+// Each needs a BTstack GATT client (MAX_NR_GATT_CLIENTS in btstack_config.h).
+#ifndef MIFLORA_MAX_CONNECTIONS
+#define MIFLORA_MAX_CONNECTIONS 3
+#endif
+#ifndef MIFLORA_DISCOVERY_TIME_MS
+#define MIFLORA_DISCOVERY_TIME_MS 60000  // Scan window of a DISCOVER command
+#endif
+
+/**
+ * @brief Initialize the MiFlora client with the sensors' MAC addresses.
+ * @param mac_strings Array of "XX:XX:XX:XX:XX:XX" addresses.
+ * @param count Number of addresses.
+ * @param cycle_complete_handler Called when a poll cycle has finished with every due sensor.
+ */
+void miflora_client_init(const char * const *mac_strings, int count, void (*cycle_complete_handler)(void));
+
+/**
+ * @brief Enroll the sensors saved in SENSOR_REGISTRY_FILE. Call after sd_logger_init().
+ */
+void miflora_client_load_enrolled(void);
+
+/**
+ * @brief Scan for the given time and add every MiFlora seen to the sensor
+ * registry (sensor_registry.h). Poll cycles carry on meanwhile.
+ */
+void miflora_client_discover(uint32_t duration_ms);
+
 /**
- * @brief Initialize the MiFlora client with the target sensor's MAC address.
+ * @brief Enroll a sensor by address, polled from the next cycle on, and save
+ * the enrolled list to the card.
+ * @return The sensor index, or -1 if the address is invalid or the table is full.
  */
-void miflora_client_init(const char *mac_string);
+int miflora_client_enroll(const char *mac_string);
 
 /**
- * @brief Start scanning for the MiFlora sensor.
+ * @brief Start a poll cycle: read every sensor that is not backing off,
+ * up to miflora_client_set_max_connections() at a time.
  */
 void miflora_client_start(void);
 
+/**
+ * @brief Override the deadline for a state.
+ * @param timeout_ms Time allowed in the state, 0 for no deadline.
+ */
+void miflora_client_set_state_timeout(miflora_state_t state, uint32_t timeout_ms);
+
+/**
+ * @brief Limit the sensor connections held at once (1..MIFLORA_MAX_CONNECTIONS).
+ * Takes effect as connections free up.
+ */
+void miflora_client_set_max_connections(int count);
+
 /**
  * @brief Handle GATT client events (service/characteristic discovery, reads).
  */
 void miflora_client_handle_gatt_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 
 /**
- * @brief Handle HCI events related to the client role (scan results, connection).
+ * @brief Handle HCI events related to the client role (scan results, connection, disconnection).
  */
 void miflora_client_handle_hci_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 
 // --- State Management Functions ---
+// get_state is the state of the first busy connection, FLORA_IDLE if none;
+// set_state applies to every connection.
 miflora_state_t miflora_client_get_state(void);
 void miflora_client_set_state(miflora_state_t new_state);
-hci_con_handle_t miflora_client_get_con_handle(void);
-void miflora_client_set_con_handle(hci_con_handle_t handle);
+hci_con_handle_t miflora_client_get_con_handle(void); // First open sensor connection
+bool miflora_client_has_connection(hci_con_handle_t con_handle);
 miflora_reading_t* miflora_client_get_last_reading(void);
 
 /**
@@ -58,4 +127,8 @@ miflora_reading_t* miflora_client_get_last_reading(void);
  */
 void miflora_client_print_reading(void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // MIFLORA_CLIENT_H
\ No newline at end of file
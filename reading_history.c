@@ -0,0 +1,30 @@
+#include "reading_history.h"
+#include <string.h>
+
+static uint8_t history[READING_HISTORY_SENSORS][READING_HISTORY_DEPTH][READING_HISTORY_RECORD_SIZE];
+static uint32_t history_total[READING_HISTORY_SENSORS];
+
+void reading_history_add(uint8_t sensor_index, uint32_t time, const reading_values_t *values) {
+    if (sensor_index >= READING_HISTORY_SENSORS) return;
+
+    uint8_t *record = history[sensor_index][history_total[sensor_index] % READING_HISTORY_DEPTH];
+    reading_write_le(record, 4, time);
+    reading_pack(values, record + 4);
+    history_total[sensor_index]++;
+}
+
+uint32_t reading_history_total(uint8_t sensor_index) {
+    return sensor_index < READING_HISTORY_SENSORS ? history_total[sensor_index] : 0;
+}
+
+uint16_t reading_history_count(uint8_t sensor_index) {
+    uint32_t total = reading_history_total(sensor_index);
+    return (uint16_t)(total < READING_HISTORY_DEPTH ? total : READING_HISTORY_DEPTH);
+}
+
+bool reading_history_get(uint8_t sensor_index, uint32_t sequence, uint8_t out[READING_HISTORY_RECORD_SIZE]) {
+    uint32_t total = reading_history_total(sensor_index);
+    if (sequence >= total || total - sequence > READING_HISTORY_DEPTH) return false;
+    memcpy(out, history[sensor_index][sequence % READING_HISTORY_DEPTH], READING_HISTORY_RECORD_SIZE);
+    return true;
+}
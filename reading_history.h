@@ -0,0 +1,59 @@
+#ifndef READING_HISTORY_H
+#define READING_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "reading_schema.h"
+#include "sensor_health.h"
+
+/**
+ * Recent readings per sensor, kept in RAM.
+ *
+ * A fixed ring of READING_HISTORY_DEPTH records per sensor, so the latest
+ * readings can be served over BLE without touching the SD card. Each record
+ * is stored ready to send:
+ *   u32 time (seconds since 1970-01-01, RTC wall clock, 0 if the RTC was not set)
+ *   READING_PACKED_SIZE bytes of values (reading_pack layout)
+ *
+ * Records are addressed by sequence number (0 = first reading since boot),
+ * so a reader can take a consistent view while new readings arrive.
+ */
+
+// Readings kept per sensor (default: 24 hours at 15-minute intervals)
+#ifndef READING_HISTORY_DEPTH
+#define READING_HISTORY_DEPTH 96
+#endif
+
+// Sensors with a history; readings of sensors with a higher index are not kept
+#ifndef READING_HISTORY_SENSORS
+#define READING_HISTORY_SENSORS SENSOR_HEALTH_MAX_SENSORS
+#endif
+
+#define READING_HISTORY_RECORD_SIZE (4 + READING_PACKED_SIZE)
+#define READING_HISTORY_RAM_BYTES \
+    (READING_HISTORY_SENSORS * (READING_HISTORY_DEPTH * READING_HISTORY_RECORD_SIZE + sizeof(uint32_t)))
+
+/**
+ * @brief Store a reading, replacing the sensor's oldest one when its ring is full.
+ */
+void reading_history_add(uint8_t sensor_index, uint32_t time, const reading_values_t *values);
+
+/**
+ * @brief Number of readings stored for a sensor since boot (next sequence number).
+ */
+uint32_t reading_history_total(uint8_t sensor_index);
+
+/**
+ * @brief Number of readings currently held for a sensor (at most READING_HISTORY_DEPTH).
+ */
+uint16_t reading_history_count(uint8_t sensor_index);
+
+/**
+ * @brief Copy one record.
+ * @param sequence Sequence number of the reading.
+ * @return false if the reading was never stored or has been overwritten.
+ */
+bool reading_history_get(uint8_t sensor_index, uint32_t sequence, uint8_t out[READING_HISTORY_RECORD_SIZE]);
+
+#endif // READING_HISTORY_H
@@ -0,0 +1,266 @@
+#ifndef READING_SCHEMA_H
+#define READING_SCHEMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The fields of a MiFlora reading, defined once.
+ *
+ * Everything that knows the reading layout is generated from READING_FIELDS:
+ * the fixed-point struct, the parser for the sensor's GATT payloads, the
+ * packed binary form (0xAAA4 live packet), the text log fields and their
+ * parser (log_archive_parse_line). Adding a field means adding one line here.
+ *
+ * X(id, member, type, log_key, decimals, ble_source, ble_offset, ble_width)
+ *   id          READING_FIELD_<id>
+ *   member      member of reading_values_t
+ *   type        fixed-point storage type; value = stored / 10^decimals
+ *   log_key     key in the text log ("Key:value")
+ *   decimals    digits after the decimal point in the text log
+ *   ble_source  sensor characteristic carrying the field
+ *   ble_offset  byte offset in that characteristic's value (little endian)
+ *   ble_width   bytes in that characteristic's value
+ *
+ * The packed binary form is the fields in this order, each sizeof(type)
+ * bytes little endian.
+ */
+#define READING_FIELDS(X) \
+    X(TEMPERATURE,  temperature,  int16_t,  "Temp",         1, READING_SRC_DATA,    0, 2) \
+    X(LIGHT,        light,        uint32_t, "Light",        0, READING_SRC_DATA,    3, 4) \
+    X(MOISTURE,     moisture,     uint8_t,  "Moisture",     0, READING_SRC_DATA,    7, 1) \
+    X(CONDUCTIVITY, conductivity, uint16_t, "Conductivity", 0, READING_SRC_DATA,    8, 2) \
+    X(BATTERY,      battery,      uint8_t,  "Battery",      0, READING_SRC_BATTERY, 0, 1)
+
+// Sensor characteristics a field can come from
+enum {
+    READING_SRC_DATA,     // Real-time data, after the mode change write
+    READING_SRC_BATTERY   // Battery and firmware version
+};
+
+enum {
+#define READING_X_ENUM(id, member, type, key, decimals, src, offset, width) READING_FIELD_##id,
+    READING_FIELDS(READING_X_ENUM)
+#undef READING_X_ENUM
+    READING_NUM_FIELDS
+};
+
+// Fixed-point values of one reading
+typedef struct {
+#define READING_X_MEMBER(id, member, type, key, decimals, src, offset, width) type member;
+    READING_FIELDS(READING_X_MEMBER)
+#undef READING_X_MEMBER
+} reading_values_t;
+
+// Bytes of the packed binary form
+enum {
+#define READING_X_SIZE(id, member, type, key, decimals, src, offset, width) + sizeof(type)
+    READING_PACKED_SIZE = 0 READING_FIELDS(READING_X_SIZE)
+#undef READING_X_SIZE
+};
+
+// Longest text produced by reading_format_text: ",Key:-2147483648" plus a '.' per field
+enum {
+#define READING_X_TEXT(id, member, type, key, decimals, src, offset, width) + sizeof(key) + 13
+    READING_TEXT_MAX = 1 READING_FIELDS(READING_X_TEXT)
+#undef READING_X_TEXT
+};
+
+typedef struct {
+    const char *log_key;
+    uint8_t key_len;
+    uint8_t decimals;
+    uint8_t ble_source;
+    uint8_t ble_offset;
+    uint8_t ble_width;
+    bool is_signed;
+} reading_field_info_t;
+
+static const reading_field_info_t reading_field_info[READING_NUM_FIELDS] = {
+#define READING_X_INFO(id, member, type, key, decimals, src, offset, width) \
+    { key, sizeof(key) - 1, decimals, src, offset, width, (type)~0 < 1 },
+    READING_FIELDS(READING_X_INFO)
+#undef READING_X_INFO
+};
+
+// --- Field access ---
+
+static inline int32_t reading_get(const reading_values_t *values, int field) {
+    switch (field) {
+#define READING_X_GET(id, member, type, key, decimals, src, offset, width) \
+        case READING_FIELD_##id: return (int32_t)values->member;
+        READING_FIELDS(READING_X_GET)
+#undef READING_X_GET
+        default: return 0;
+    }
+}
+
+static inline void reading_set(reading_values_t *values, int field, int32_t value) {
+    switch (field) {
+#define READING_X_SET(id, member, type, key, decimals, src, offset, width) \
+        case READING_FIELD_##id: values->member = (type)value; break;
+        READING_FIELDS(READING_X_SET)
+#undef READING_X_SET
+        default: break;
+    }
+}
+
+static inline void reading_to_array(const reading_values_t *values, int32_t out[READING_NUM_FIELDS]) {
+    for (int f = 0; f < READING_NUM_FIELDS; f++) out[f] = reading_get(values, f);
+}
+
+// --- Little-endian helpers ---
+
+static inline uint32_t reading_read_le(const uint8_t *p, int width) {
+    uint32_t v = 0;
+    for (int i = width - 1; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+static inline void reading_write_le(uint8_t *p, int width, uint32_t v) {
+    for (int i = 0; i < width; i++, v >>= 8) p[i] = (uint8_t)v;
+}
+
+static inline int32_t reading_sign_extend(uint32_t v, int width, bool is_signed) {
+    if (is_signed && width < 4 && (v & (1u << (8 * width - 1)))) v |= ~0u << (8 * width);
+    return (int32_t)v;
+}
+
+// --- BLE payload parser ---
+
+/**
+ * @brief Fill the fields carried by one of the sensor's characteristics.
+ * @return false if the value is too short for any of them (those fields are left unchanged).
+ */
+static inline bool reading_parse_ble(reading_values_t *values, int source, const uint8_t *data, uint16_t length) {
+    bool complete = true;
+    for (int f = 0; f < READING_NUM_FIELDS; f++) {
+        const reading_field_info_t *info = &reading_field_info[f];
+        if (info->ble_source != source) continue;
+        if (info->ble_offset + info->ble_width > length) {
+            complete = false;
+            continue;
+        }
+        uint32_t raw = reading_read_le(data + info->ble_offset, info->ble_width);
+        reading_set(values, f, reading_sign_extend(raw, info->ble_width, info->is_signed));
+    }
+    return complete;
+}
+
+// --- Packed binary form ---
+
+static inline void reading_pack(const reading_values_t *values, uint8_t out[READING_PACKED_SIZE]) {
+#define READING_X_PACK(id, member, type, key, decimals, src, offset, width) \
+    reading_write_le(out, sizeof(type), (uint32_t)values->member); \
+    out += sizeof(type);
+    READING_FIELDS(READING_X_PACK)
+#undef READING_X_PACK
+}
+
+static inline void reading_unpack(reading_values_t *values, const uint8_t in[READING_PACKED_SIZE]) {
+#define READING_X_UNPACK(id, member, type, key, decimals, src, offset, width) \
+    values->member = (type)reading_read_le(in, sizeof(type)); \
+    in += sizeof(type);
+    READING_FIELDS(READING_X_UNPACK)
+#undef READING_X_UNPACK
+}
+
+// --- Text log fields ---
+
+// Writes a fixed-point value with its decimal point, without floating point.
+static inline char *reading_put_fixed(char *out, int32_t value, uint8_t decimals) {
+    char digits[12];
+    int n = 0;
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude || n <= decimals);
+    if (value < 0) *out++ = '-';
+    while (n) {
+        if (n == decimals) *out++ = '.';
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+/**
+ * @brief Format the fields as ",Temp:28.5,Light:150,..." (the text log layout).
+ * @param values Fixed-point values in READING_FIELD_* order.
+ * @param out Buffer of at least READING_TEXT_MAX bytes; the text is NUL-terminated.
+ * @return Length of the text.
+ */
+static inline size_t reading_format_text(const int32_t values[READING_NUM_FIELDS], char *out) {
+    char *p = out;
+    for (int f = 0; f < READING_NUM_FIELDS; f++) {
+        const reading_field_info_t *info = &reading_field_info[f];
+        *p++ = ',';
+        memcpy(p, info->log_key, info->key_len);
+        p += info->key_len;
+        *p++ = ':';
+        p = reading_put_fixed(p, values[f], info->decimals);
+    }
+    *p = '\0';
+    return (size_t)(p - out);
+}
+
+/**
+ * @brief Parse a text log value with the field's number of decimals.
+ * Missing decimals count as zeros, extra ones are ignored.
+ */
+static inline bool reading_parse_fixed(const char *p, const char *end, uint8_t decimals, int32_t *value) {
+    bool negative = false;
+    int32_t v = 0;
+    int digits = 0;
+
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (decimals > 0) {
+        int fraction_digits = 0;
+        if (p < end && *p == '.') {
+            p++;
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (fraction_digits < decimals) {
+                    v = v * 10 + (*p - '0');
+                    fraction_digits++;
+                }
+                p++;
+            }
+        }
+        for (; fraction_digits < decimals; fraction_digits++) v *= 10;
+    }
+    if (digits == 0 || p != end) return false;
+    *value = negative ? -v : v;
+    return true;
+}
+
+/**
+ * @brief Find a field by its text log key.
+ * @return READING_FIELD_* or -1.
+ */
+static inline int reading_find_key(const char *key, size_t key_len) {
+    for (int f = 0; f < READING_NUM_FIELDS; f++) {
+        if (reading_field_info[f].key_len == key_len && memcmp(reading_field_info[f].log_key, key, key_len) == 0) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // READING_SCHEMA_H
@@ -0,0 +1,158 @@
+#include "scheduler.h"
+#include <stdio.h>
+
+// --- Scheduler State ---
+static scheduler_task_t *task_list = NULL; // Sorted by priority
+static bool in_run = false;
+
+// Wrap-safe "a is at or before b" for 32-bit millisecond timestamps
+static bool time_reached(uint32_t deadline_ms, uint32_t now_ms) {
+    return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
+/**
+ * @brief Tell the port when the earliest pending deadline is due.
+ * Skipped while scheduler_run() is active; it reschedules on exit.
+ */
+static void reschedule(void) {
+    if (in_run) return;
+
+    uint32_t now = scheduler_port_now_ms();
+    bool found = false;
+    uint32_t next_delay = 0;
+
+    for (scheduler_task_t *t = task_list; t != NULL; t = t->next) {
+        if (!t->armed) continue;
+        uint32_t delay = time_reached(t->deadline_ms, now) ? 0 : t->deadline_ms - now;
+        if (!found || delay < next_delay) {
+            next_delay = delay;
+            found = true;
+        }
+    }
+
+    if (found) {
+        scheduler_port_request_run(next_delay);
+    }
+}
+
+// --- Public Function Implementations ---
+
+void scheduler_task_init(scheduler_task_t *task, const char *name, uint8_t priority,
+                         scheduler_task_handler_t handler, void *context) {
+    task->name = name;
+    task->priority = priority;
+    task->handler = handler;
+    task->context = context;
+    task->armed = false;
+    task->wait_events = 0;
+    task->woken_by = 0;
+    task->stats = (scheduler_task_stats_t){0};
+
+    // Insert sorted by priority (stable for equal priorities)
+    scheduler_task_t **link = &task_list;
+    while (*link != NULL && (*link)->priority <= priority) {
+        link = &(*link)->next;
+    }
+    task->next = *link;
+    *link = task;
+}
+
+void scheduler_run_in(scheduler_task_t *task, uint32_t delay_ms) {
+    task->deadline_ms = scheduler_port_now_ms() + delay_ms;
+    task->wait_events = 0;
+    task->armed = true;
+    reschedule();
+}
+
+void scheduler_wait_event(scheduler_task_t *task, uint32_t events, uint32_t timeout_ms) {
+    task->wait_events = events;
+    if (timeout_ms == SCHEDULER_NO_TIMEOUT) {
+        task->armed = false;
+    } else {
+        task->deadline_ms = scheduler_port_now_ms() + timeout_ms;
+        task->armed = true;
+        reschedule();
+    }
+}
+
+void scheduler_cancel(scheduler_task_t *task) {
+    task->armed = false;
+    task->wait_events = 0;
+}
+
+bool scheduler_task_is_pending(const scheduler_task_t *task) {
+    return task->armed || task->wait_events != 0;
+}
+
+void scheduler_signal(uint32_t events) {
+    uint32_t now = scheduler_port_now_ms();
+    bool woke = false;
+
+    for (scheduler_task_t *t = task_list; t != NULL; t = t->next) {
+        if (t->wait_events & events) {
+            t->woken_by = t->wait_events & events;
+            t->wait_events = 0;
+            t->deadline_ms = now; // Lateness is measured from the signal
+            t->armed = true;
+            woke = true;
+        }
+    }
+
+    if (woke) {
+        reschedule();
+    }
+}
+
+void scheduler_run(void) {
+    in_run = true;
+
+    for (;;) {
+        uint32_t now = scheduler_port_now_ms();
+
+        // List is priority-sorted, so the first ready task wins
+        scheduler_task_t *task = task_list;
+        while (task != NULL && !(task->armed && time_reached(task->deadline_ms, now))) {
+            task = task->next;
+        }
+        if (task == NULL) break;
+
+        uint32_t late_ms = now - task->deadline_ms;
+        task->armed = false;
+        task->wait_events = 0;
+
+        uint32_t start_us = scheduler_port_now_us();
+        task->handler(task);
+        uint32_t run_us = scheduler_port_now_us() - start_us;
+
+        task->woken_by = 0;
+        task->stats.runs++;
+        task->stats.total_run_us += run_us;
+        task->stats.total_late_ms += late_ms;
+        if (run_us > task->stats.max_run_us) task->stats.max_run_us = run_us;
+        if (late_ms > task->stats.max_late_ms) task->stats.max_late_ms = late_ms;
+    }
+
+    in_run = false;
+    reschedule();
+}
+
+size_t scheduler_format_stats(char *buffer, size_t buffer_size) {
+    size_t used = 0;
+    int n = snprintf(buffer, buffer_size, "task,prio,runs,avg_us,max_us,avg_late_ms,max_late_ms\n");
+    if (n < 0) return 0;
+    used = (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+
+    for (scheduler_task_t *t = task_list; t != NULL && used < buffer_size - 1; t = t->next) {
+        uint32_t runs = t->stats.runs ? t->stats.runs : 1;
+        n = snprintf(buffer + used, buffer_size - used, "%s,%u,%lu,%lu,%lu,%lu,%lu\n",
+                     t->name, t->priority,
+                     (unsigned long)t->stats.runs,
+                     (unsigned long)(t->stats.total_run_us / runs),
+                     (unsigned long)t->stats.max_run_us,
+                     (unsigned long)(t->stats.total_late_ms / runs),
+                     (unsigned long)t->stats.max_late_ms);
+        if (n < 0) break;
+        used += (size_t)n < buffer_size - used ? (size_t)n : buffer_size - used - 1;
+    }
+    return used;
+}
@@ -0,0 +1,114 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Small cooperative task scheduler.
+ *
+ * Tasks run to completion from the main run loop, highest priority first.
+ * A task becomes ready when its deadline passes or when one of the events it
+ * waits for is signalled. The core has no BTstack or Pico dependencies; the
+ * platform supplies the three scheduler_port_* hooks below, so the same code
+ * runs on the device and in a host build.
+ */
+
+#define SCHEDULER_NO_TIMEOUT 0xFFFFFFFFu
+
+// Task priorities (lower value runs first)
+#define SCHEDULER_PRIORITY_HIGH   0 // Actuators, anything with a hard deadline
+#define SCHEDULER_PRIORITY_NORMAL 1 // BLE protocol work
+#define SCHEDULER_PRIORITY_LOW    2 // Cosmetic (LED)
+
+// Events a task can wait for instead of guessing a delay
+typedef enum {
+    SCHEDULER_EVENT_CAN_SEND_NOW = 1u << 0, // ATT server can take another notification
+    SCHEDULER_EVENT_RTC_SYNCED   = 1u << 1, // A client has set the RTC
+    SCHEDULER_EVENT_CARD_READY   = 1u << 2, // The SD card mount on core 1 has finished
+} scheduler_event_t;
+
+typedef struct scheduler_task scheduler_task_t;
+typedef void (*scheduler_task_handler_t)(scheduler_task_t *task);
+
+typedef struct {
+    uint32_t runs;
+    uint32_t total_run_us;
+    uint32_t max_run_us;
+    uint32_t total_late_ms;  // Time between becoming ready and actually running
+    uint32_t max_late_ms;
+} scheduler_task_stats_t;
+
+struct scheduler_task {
+    scheduler_task_t *next;
+    const char *name;
+    scheduler_task_handler_t handler;
+    void *context;
+    uint8_t priority;          // Lower value runs first
+    bool armed;                // Waiting for its deadline
+    uint32_t deadline_ms;
+    uint32_t wait_events;      // Events that make the task ready early
+    uint32_t woken_by;         // Events that made it ready (0 = deadline)
+    scheduler_task_stats_t stats;
+};
+
+/**
+ * @brief Register a task with the scheduler. The task starts idle.
+ */
+void scheduler_task_init(scheduler_task_t *task, const char *name, uint8_t priority,
+                         scheduler_task_handler_t handler, void *context);
+
+/**
+ * @brief Run the task once after delay_ms (0 = as soon as possible).
+ * Replaces any pending deadline or event wait.
+ */
+void scheduler_run_in(scheduler_task_t *task, uint32_t delay_ms);
+
+/**
+ * @brief Run the task when any of the events is signalled, or after timeout_ms.
+ * @param timeout_ms Upper bound on the wait, or SCHEDULER_NO_TIMEOUT.
+ */
+void scheduler_wait_event(scheduler_task_t *task, uint32_t events, uint32_t timeout_ms);
+
+/**
+ * @brief Stop a pending task from running.
+ */
+void scheduler_cancel(scheduler_task_t *task);
+
+/**
+ * @brief Check if the task is waiting for a deadline or an event.
+ */
+bool scheduler_task_is_pending(const scheduler_task_t *task);
+
+/**
+ * @brief Wake all tasks waiting for any of the given events.
+ */
+void scheduler_signal(uint32_t events);
+
+/**
+ * @brief Run all ready tasks, then ask the port to call again at the next deadline.
+ * Called by the port.
+ */
+void scheduler_run(void);
+
+/**
+ * @brief Format per-task run-time and lateness statistics as text.
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t scheduler_format_stats(char *buffer, size_t buffer_size);
+
+// --- Port Hooks (implemented per platform) ---
+uint32_t scheduler_port_now_ms(void);
+uint32_t scheduler_port_now_us(void);
+void scheduler_port_request_run(uint32_t delay_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCHEDULER_H
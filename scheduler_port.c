@@ -0,0 +1,26 @@
+#include "scheduler.h"
+#include "btstack.h"
+#include "pico/stdlib.h"
+
+// Scheduler port for the BTstack run loop: one timer drives every task.
+static btstack_timer_source_t scheduler_timer;
+
+static void scheduler_timer_handler(btstack_timer_source_t *ts) {
+    UNUSED(ts);
+    scheduler_run();
+}
+
+uint32_t scheduler_port_now_ms(void) {
+    return btstack_run_loop_get_time_ms();
+}
+
+uint32_t scheduler_port_now_us(void) {
+    return time_us_32();
+}
+
+void scheduler_port_request_run(uint32_t delay_ms) {
+    btstack_run_loop_remove_timer(&scheduler_timer);
+    btstack_run_loop_set_timer_handler(&scheduler_timer, scheduler_timer_handler);
+    btstack_run_loop_set_timer(&scheduler_timer, delay_ms);
+    btstack_run_loop_add_timer(&scheduler_timer);
+}
@@ -1,86 +1,545 @@
 #include "sd_logger.h"
 #include <stdio.h>
+#include <string.h>
 #include "hw_config.h" 
 #include "f_util.h" 
 #include "ff.h" 
-#include "hardware/rtc.h" 
-#include "pico/util/datetime.h" 
+#include "log_archive.h"
+#include "scheduler.h"
+#include "log_store.h"
+#include "log_frame.h"
+#include "energy_profile.h"
+#include "trace.h"
+#include "time_util.h"
+#include "warm_restart.h"
+#include "boot_profile.h"
+#include "clock_drift.h"
+#include "sensor_health.h"
+#include "hardware/sync.h"
 
 // --- SD Card Globals ---
 static FATFS fs; 
 static bool sd_mounted = false; 
+static volatile bool mount_finished = false; // Set by core 1 once sd_mounted is final
 
-bool sd_logger_init(void) {
+// --- Day Rollover Archiving ---
+#define ARCHIVE_MAX_SENSORS SENSOR_HEALTH_MAX_SENSORS // As many as the poller reads
+#define ARCHIVE_MAX_FAILED 4   // Days given up on until the next boot
+#define ARCHIVE_SLICE_LINES 32 // Text lines read per slice
+typedef enum {
+    ARCHIVE_IDLE,
+    ARCHIVE_FIND,    // Looking for a closed daily file without an archive
+    ARCHIVE_SENSORS, // Pass 1: which sensors logged that day, one slice per run
+    ARCHIVE_ENCODE,  // Pass 2: one sensor's blocks at a time, one slice per run
+    ARCHIVE_SWAP     // Replacing an older archive with the temp file
+} archive_phase_t;
+
+static int last_log_year = 0; // 0 = nothing logged since boot
+static int last_log_month = 0;
+static int last_log_day = 0;
+static scheduler_task_t archive_task;
+static archive_phase_t archive_phase = ARCHIVE_IDLE;
+static uint32_t archive_today;  // Days (since 1970) before this one are closed
+static bool archive_rescan;     // Started again while running: search once more
+static DIR archive_dir;
+static bool archive_dir_open = false;
+static char archive_day[16];    // "YYYY-MM-DD"
+static uint32_t archive_day_number;
+static uint32_t archive_failed[ARCHIVE_MAX_FAILED]; // Days (since 1970) the search skips
+static int archive_failed_count = 0;
+static FIL archive_in, archive_out;
+static uint8_t archive_sensors[ARCHIVE_MAX_SENSORS][6];
+static int archive_sensor_count;
+static int archive_sensor;      // Sensor being encoded
+static uint16_t archive_count;  // Records buffered for the next block
+static uint32_t archive_total;
+static log_record_t archive_records[LOG_ARCHIVE_BLOCK_MAX_RECORDS];
+static uint8_t archive_block[LOG_ARCHIVE_BLOCK_MAX_SIZE];
+
+static void archive_task_handler(scheduler_task_t *task);
+static void start_archive(uint32_t today);
+
+// --- Torn-Write Recovery ---
+// The checkpoint names the daily file currently being appended to, so
+// recovery only has to look at the tail of that one file after a reset.
+#define CHECKPOINT_FILE "LOG.CKP"
+#define CHECKPOINT_MAGIC 0x31504B43u // "CKP1"
+#define CHECKPOINT_NAME_SIZE 16
+#define CHECKPOINT_SIZE (4 + CHECKPOINT_NAME_SIZE + 2)
+static char checkpoint_name[CHECKPOINT_NAME_SIZE]; // Empty until known
+
+/**
+ * @brief Read a whole small file. No mount check and no energy accounting,
+ * so the mount on core 1 can use it.
+ */
+static size_t read_file(const char *name, uint8_t *buffer, size_t buffer_size) {
+    FIL fil;
+    UINT bytes_read = 0;
+    if (f_open(&fil, name, FA_READ) == FR_OK) {
+        if (f_read(&fil, buffer, buffer_size, &bytes_read) != FR_OK) bytes_read = 0;
+        f_close(&fil);
+    }
+    return bytes_read;
+}
+
+/**
+ * @brief Read the name of the file that was being written before the reset.
+ */
+static bool read_checkpoint(void) {
+    uint8_t buffer[CHECKPOINT_SIZE];
+    if (read_file(CHECKPOINT_FILE, buffer, sizeof(buffer)) != CHECKPOINT_SIZE ||
+        little_endian_read_32(buffer, 0) != CHECKPOINT_MAGIC ||
+        little_endian_read_16(buffer, CHECKPOINT_SIZE - 2) != log_frame_crc16((const char *)buffer, CHECKPOINT_SIZE - 2)) {
+        return false;
+    }
+    memcpy(checkpoint_name, buffer + 4, CHECKPOINT_NAME_SIZE);
+    checkpoint_name[CHECKPOINT_NAME_SIZE - 1] = '\0';
+    return true;
+}
+
+/**
+ * @brief Record the file about to be appended to. Written once per file, not per reading.
+ */
+static void write_checkpoint(const char *filename) {
+    uint8_t buffer[CHECKPOINT_SIZE];
+    memset(buffer, 0, sizeof(buffer));
+    little_endian_store_32(buffer, 0, CHECKPOINT_MAGIC);
+    strncpy((char *)buffer + 4, filename, CHECKPOINT_NAME_SIZE - 1);
+    little_endian_store_16(buffer, CHECKPOINT_SIZE - 2, log_frame_crc16((const char *)buffer, CHECKPOINT_SIZE - 2));
+
+    if (sd_logger_write_file(CHECKPOINT_FILE, buffer, sizeof(buffer))) {
+        snprintf(checkpoint_name, sizeof(checkpoint_name), "%s", filename);
+    }
+}
+
+/**
+ * @brief Truncate a partial or corrupt record at the end of the last written file.
+ * Reads at most LOG_FRAME_RECOVERY_WINDOW bytes, however large the card's history.
+ */
+static void recover_torn_tail(void) {
+    if (!read_checkpoint()) return;
+
+    FIL fil;
+    if (f_open(&fil, checkpoint_name, FA_READ | FA_WRITE) != FR_OK) return; // Compacted or never created
+
+    static char tail[LOG_FRAME_RECOVERY_WINDOW];
+    uint32_t size = (uint32_t)f_size(&fil);
+    uint32_t window = size < sizeof(tail) ? size : sizeof(tail);
+    UINT bytes_read = 0;
+    if (f_lseek(&fil, size - window) == FR_OK && f_read(&fil, tail, window, &bytes_read) == FR_OK && bytes_read == window) {
+        size_t keep = log_frame_recover(tail, window, window == size);
+        if (keep < window && f_lseek(&fil, size - window + keep) == FR_OK && f_truncate(&fil) == FR_OK) {
+            printf("Recovered %s: dropped %lu bytes of torn records.\n", checkpoint_name, (unsigned long)(window - keep));
+        }
+    }
+    f_close(&fil);
+}
+
+void sd_logger_init(void) {
+    scheduler_task_init(&archive_task, "archive", SCHEDULER_PRIORITY_LOW, archive_task_handler, NULL);
+    log_store_init();
+}
+
+bool sd_logger_mount(void) {
     printf("Mounting SD card...\n");
     FRESULT fr = f_mount(&fs, "", 1); 
-    if (FR_OK != fr) {
+    bool mounted = FR_OK == fr;
+    if (!mounted) {
         printf("f_mount error: %s (%d)\n", FRESULT_str(fr), fr); 
-        sd_mounted = false; 
     } else {
         printf("SD card mounted successfully.\n");
-        sd_mounted = true; 
+        recover_torn_tail();
+        log_store_recover();
     }
-    return sd_mounted;
+
+    // Core 0 reads sd_mounted only after it sees mount_finished
+    sd_mounted = mounted;
+    __dmb();
+    mount_finished = true;
+    return mounted;
 }
 
-void sd_logger_log_reading(miflora_reading_t *reading) {
-    if (!sd_mounted) {
-        printf("SD card not mounted. Skipping log.\n");
-        return; 
-    }
+bool sd_logger_is_ready(void) {
+    if (!mount_finished) return false;
+    __dmb(); // Pairs with the barrier in sd_logger_mount()
+    return true;
+}
+
+/**
+ * @brief Append one reading to the daily file of its time.
+ * @return false if the card did not take it.
+ */
+static bool append_reading(const miflora_reading_t *reading, uint32_t epoch) {
+    int year, month, day, hour, min, sec;
+    time_util_from_epoch(epoch, &year, &month, &day, &hour, &min, &sec);
 
-    // --- Get and format timestamp ---
-    datetime_t t;
+    // --- Format timestamp ---
     char timestamp_buf[32]; // Buffer for "YYYY-MM-DDTHH:MM:SS" 
     char filename_buf[32];  // Buffer for "YYYY-MM-DD.txt"
     
-    if (!rtc_get_datetime(&t)) {
-        // If RTC is not set, we cannot create a daily filename.
-        // This is a critical error for this logic.
-        printf("Failed to get RTC time. Skipping log.\EN");
-        return; 
-    } 
-    
     // Format as ISO 8601 for the log line
     snprintf(timestamp_buf, sizeof(timestamp_buf),
              "%04d-%02d-%02dT%02d:%02d:%02d",
-             t.year, t.month, t.day, t.hour, t.min, t.sec);
+             year, month, day, hour, min, sec);
     
     // Format the daily filename
     snprintf(filename_buf, sizeof(filename_buf),
              "%04d-%02d-%02d.txt",
-             t.year, t.month, t.day);
+             year, month, day);
     // ------------------------------------------
 
+    // Name the file in the checkpoint before its first append
+    if (strcmp(checkpoint_name, filename_buf) != 0) {
+        write_checkpoint(filename_buf);
+    }
+
     FIL fil;
     
     // Use the new dynamic filename_buf instead of "miflora_log.txt"
+    energy_profile_set(ENERGY_SD_WRITE, true);
     FRESULT fr = f_open(&fil, filename_buf, FA_OPEN_APPEND | FA_WRITE);
     if (FR_OK != fr && FR_EXIST != fr) {
         // Use filename_buf in the error message
         printf("f_open(%s) error: %s (%d)\n", filename_buf, FRESULT_str(fr), fr);
-        return; 
+        energy_profile_set(ENERGY_SD_WRITE, false);
+        return false; 
     }
 
-    // --- Write timestamp + data as a CSV-like string ---
-    int chars_written = f_printf(&fil, "%s,Temp:%.1f,Light:%lu,Moisture:%u,Conductivity:%u,Battery:%u\n",
-            timestamp_buf,
-            reading->temperature,
-            reading->light,
-            reading->moisture,
-            reading->conductivity,
-            reading->battery);
+    // --- Write timestamp + data as a CSV-like string, framed with a CRC ---
+    // Fields are formatted from fixed point by the schema, no float printf
+    char line[32 + READING_TEXT_MAX + 32];
+    int32_t values[READING_NUM_FIELDS];
+    reading_to_array(&reading->values, values);
+    size_t text_len = strlen(timestamp_buf);
+    memcpy(line, timestamp_buf, text_len);
+    text_len += reading_format_text(values, line + text_len);
+    int chars_written = (int)text_len;
+    if (sensor_health_count() > 1) {
+        // Only needed to tell sensors apart; single-sensor logs keep their old format
+        chars_written += snprintf(line + text_len, sizeof(line) - text_len, ",Sensor:%02X%02X%02X%02X%02X%02X",
+                reading->address[0], reading->address[1], reading->address[2],
+                reading->address[3], reading->address[4], reading->address[5]);
+    }
+    size_t line_len = chars_written > 0 ? log_frame_seal(line, (size_t)chars_written, sizeof(line)) : 0;
 
-    if (chars_written < 0) {
-        printf("f_printf failed\n");
+    UINT written = 0;
+    bool ok = line_len > 0 && f_write(&fil, line, line_len, &written) == FR_OK && written == line_len;
+    if (!ok) {
+        printf("f_write failed\n");
     }
 
     // Close the file (this also flushes the write buffer)
     fr = f_close(&fil);
+    energy_profile_set(ENERGY_SD_WRITE, false);
     if (FR_OK != fr) {
         printf("f_close error: %s (%d)\n", FRESULT_str(fr), fr);
-    } else {
-        // Use filename_buf in the success message
-        printf("Successfully logged reading to %s\n", filename_buf);
+        return false;
+    }
+    if (ok) {
+        TRACE(LOG_APPENDED, line_len, 0); // Runs inside the GATT callback, no printf
+    }
+    return ok;
+}
+
+void sd_logger_log_reading(miflora_reading_t *reading) {
+    // --- Get timestamp (RTC corrected for its measured drift) ---
+    uint32_t epoch;
+    if (!clock_drift_port_now(&epoch)) {
+        // If RTC is not set, we cannot create a daily filename.
+        // This is a critical error for this logic.
+        printf("Failed to get RTC time. Skipping log.\n");
+        return; 
+    } 
+    int year, month, day, hour, min, sec;
+    time_util_from_epoch(epoch, &year, &month, &day, &hour, &min, &sec);
+
+    // First reading of a new day (or since boot): archive the closed days once we are done here
+    if (year != last_log_year || month != last_log_month || day != last_log_day) {
+        start_archive(epoch / 86400u);
+    }
+    last_log_year = year;
+    last_log_month = month;
+    last_log_day = day;
+
+    // Readings the card did not take before (also from before a warm restart)
+    // go first, so every day file stays in time order
+    bool ok = sd_mounted;
+    miflora_reading_t held;
+    uint32_t held_epoch;
+    while (ok && warm_restart_peek_reading(&held, &held_epoch)) {
+        ok = append_reading(&held, held_epoch);
+        if (ok) warm_restart_drop_reading();
+    }
+    if (!ok || !append_reading(reading, epoch)) {
+        printf("%s Reading held in RAM.\n", sd_mounted ? "SD write failed." : "SD card not mounted.");
+        warm_restart_hold_reading(reading, epoch);
+        return;
+    }
+    boot_profile_mark(BOOT_PHASE_FIRST_LOG);
+}
+
+// --- Columnar Archive ---
+
+static void archive_names(char *txt_name, char *tmp_name, char *mfa_name, size_t size) {
+    snprintf(txt_name, size, "%s.txt", archive_day);
+    snprintf(tmp_name, size, "%s.tmp", archive_day);
+    snprintf(mfa_name, size, "%s.mfa", archive_day);
+}
+
+/**
+ * @brief Give up on the current day without leaving an archive behind.
+ * @return true if the job goes on with the next day.
+ */
+static bool abort_archive(const char *reason) {
+    char txt_name[32], tmp_name[32], mfa_name[32];
+    archive_names(txt_name, tmp_name, mfa_name, sizeof(txt_name));
+    printf("Archive of %s aborted: %s\n", txt_name, reason);
+    f_close(&archive_in);
+    f_close(&archive_out);
+    f_unlink(tmp_name);
+    log_store_hold(false);
+
+    // Skipped until the next boot, so one bad day does not hold up the others
+    if (archive_failed_count == ARCHIVE_MAX_FAILED) {
+        archive_phase = ARCHIVE_IDLE; // The card itself is likely failing
+        return false;
+    }
+    archive_failed[archive_failed_count++] = archive_day_number;
+    archive_phase = ARCHIVE_FIND;
+    return true;
+}
+
+static bool archive_failed_before(uint32_t day) {
+    for (int i = 0; i < archive_failed_count; i++) {
+        if (archive_failed[i] == day) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Encode the buffered records as one block and append it to the archive.
+ */
+static bool write_archive_block(void) {
+    size_t size = log_archive_encode_block(archive_records, archive_count, archive_block, sizeof(archive_block));
+    UINT written;
+    bool ok = size > 0 && f_write(&archive_out, archive_block, size, &written) == FR_OK && written == size;
+    archive_total += archive_count;
+    archive_count = 0;
+    return ok;
+}
+
+// --- Archive Steps (each returns true if the job continues) ---
+
+static bool archive_step_find(void) {
+    FILINFO fno;
+    FRESULT fr = archive_dir_open ? f_findnext(&archive_dir, &fno) : f_findfirst(&archive_dir, &fno, "", "*-*-*.txt");
+    archive_dir_open = true;
+
+    // Look at a bounded number of directory entries per slice
+    for (int scanned = 0; ; scanned++) {
+        if (fr != FR_OK || fno.fname[0] == '\0') {
+            f_closedir(&archive_dir);
+            archive_dir_open = false;
+            archive_phase = archive_rescan ? ARCHIVE_FIND : ARCHIVE_IDLE;
+            archive_rescan = false;
+            return archive_phase == ARCHIVE_FIND;
+        }
+
+        // Closed days ("YYYY-MM-DD.txt" before today) without an archive yet
+        char iso[20], mfa_name[32];
+        uint32_t epoch;
+        snprintf(iso, sizeof(iso), "%.10sT00:00:00", fno.fname);
+        snprintf(mfa_name, sizeof(mfa_name), "%.10s.mfa", fno.fname);
+        if (strlen(fno.fname) == 14 && time_util_parse_iso(iso, &epoch) && epoch / 86400u < archive_today &&
+            !archive_failed_before(epoch / 86400u) && f_stat(mfa_name, NULL) == FR_NO_FILE) {
+            f_closedir(&archive_dir);
+            archive_dir_open = false;
+            snprintf(archive_day, sizeof(archive_day), "%.10s", fno.fname);
+            archive_day_number = epoch / 86400u;
+            break;
+        }
+
+        if (scanned == 15) return true;
+        fr = f_findnext(&archive_dir, &fno);
+    }
+
+    char txt_name[32], tmp_name[32], mfa_name[32];
+    archive_names(txt_name, tmp_name, mfa_name, sizeof(txt_name));
+    fr = f_open(&archive_in, txt_name, FA_READ);
+    if (fr != FR_OK) {
+        printf("Archive: f_open(%s) error: %s\n", txt_name, FRESULT_str(fr));
+        archive_phase = ARCHIVE_IDLE;
+        return false;
+    }
+    // Write to a temp file first so a crash never leaves a half-written archive
+    fr = f_open(&archive_out, tmp_name, FA_CREATE_ALWAYS | FA_WRITE);
+    if (fr != FR_OK) {
+        printf("Archive: f_open(%s) error: %s\n", tmp_name, FRESULT_str(fr));
+        f_close(&archive_in);
+        archive_phase = ARCHIVE_IDLE;
+        return false;
+    }
+    log_store_hold(true); // Compaction must not delete the text file while it is read
+    archive_sensor_count = 0;
+    archive_phase = ARCHIVE_SENSORS;
+    return true;
+}
+
+static bool archive_step_sensors(void) {
+    char line[160];
+    log_record_t record;
+    for (int lines = 0; lines < ARCHIVE_SLICE_LINES; lines++) {
+        if (!f_gets(line, sizeof(line), &archive_in)) {
+            archive_sensor = 0;
+            archive_count = 0;
+            archive_total = 0;
+            if (f_lseek(&archive_in, 0) != FR_OK) {
+                return abort_archive("seek failed");
+            }
+            archive_phase = ARCHIVE_ENCODE;
+            return true;
+        }
+        if (!log_archive_parse_line(line, strlen(line), &record)) continue;
+        int s;
+        for (s = 0; s < archive_sensor_count && memcmp(archive_sensors[s], record.sensor, 6) != 0; s++) {}
+        if (s < archive_sensor_count) continue;
+        if (archive_sensor_count == ARCHIVE_MAX_SENSORS) {
+            // A partial archive would look complete; keep only the text
+            return abort_archive("more sensors than ARCHIVE_MAX_SENSORS");
+        }
+        memcpy(archive_sensors[archive_sensor_count++], record.sensor, 6);
+    }
+    return true;
+}
+
+static bool archive_step_encode(void) {
+    // One run of blocks per sensor, so each block is a single series
+    char line[160];
+    for (int lines = 0; lines < ARCHIVE_SLICE_LINES; lines++) {
+        if (archive_sensor == archive_sensor_count) {
+            archive_phase = ARCHIVE_SWAP;
+            return true;
+        }
+        if (!f_gets(line, sizeof(line), &archive_in)) {
+            if (archive_count > 0 && !write_archive_block()) {
+                return abort_archive("write failed");
+            }
+            archive_sensor++;
+            if (f_lseek(&archive_in, 0) != FR_OK) {
+                return abort_archive("seek failed");
+            }
+            continue;
+        }
+        log_record_t *record = &archive_records[archive_count];
+        if (!log_archive_parse_line(line, strlen(line), record)) continue;
+        if (memcmp(record->sensor, archive_sensors[archive_sensor], 6) != 0) continue;
+        if (++archive_count == LOG_ARCHIVE_BLOCK_MAX_RECORDS && !write_archive_block()) {
+            return abort_archive("write failed");
+        }
+    }
+    return true;
+}
+
+static bool archive_step_swap(void) {
+    char txt_name[32], tmp_name[32], mfa_name[32];
+    archive_names(txt_name, tmp_name, mfa_name, sizeof(txt_name));
+    FSIZE_t in_size = f_size(&archive_in);
+    FSIZE_t out_size = f_size(&archive_out);
+    f_close(&archive_in);
+    log_store_hold(false);
+    if (f_close(&archive_out) != FR_OK) {
+        printf("Archive: write failed for %s\n", mfa_name);
+        f_unlink(tmp_name);
+        archive_phase = ARCHIVE_IDLE;
+        return false;
     }
-}
\ No newline at end of file
+
+    f_unlink(mfa_name); // Replace an older archive of the same day
+    FRESULT fr = f_rename(tmp_name, mfa_name);
+    if (fr != FR_OK) {
+        // Without this the search would find the same day forever
+        printf("Archive: f_rename(%s) error: %s\n", mfa_name, FRESULT_str(fr));
+        archive_phase = ARCHIVE_IDLE;
+        return false;
+    }
+    printf("Archived %lu readings from %s: %lu -> %lu bytes\n", (unsigned long)archive_total,
+           txt_name, (unsigned long)in_size, (unsigned long)out_size);
+    archive_phase = ARCHIVE_FIND; // Look for another closed day
+    return true;
+}
+
+static void archive_task_handler(scheduler_task_t *task) {
+    bool more = false;
+    energy_profile_set(ENERGY_SD_WRITE, true);
+    switch (archive_phase) {
+        case ARCHIVE_FIND:    more = archive_step_find(); break;
+        case ARCHIVE_SENSORS: more = archive_step_sensors(); break;
+        case ARCHIVE_ENCODE:  more = archive_step_encode(); break;
+        case ARCHIVE_SWAP:    more = archive_step_swap(); break;
+        default: break;
+    }
+    energy_profile_set(ENERGY_SD_WRITE, false);
+    if (more) {
+        scheduler_run_in(task, LOG_STORE_SLICE_INTERVAL_MS);
+    }
+}
+
+static void start_archive(uint32_t today) {
+    if (!sd_mounted) return;
+
+    archive_today = today;
+    if (archive_phase != ARCHIVE_IDLE) {
+        archive_rescan = true; // The running search may have passed the newly closed day
+        return;
+    }
+    archive_phase = ARCHIVE_FIND;
+    scheduler_run_in(&archive_task, 0);
+}
+
+void sd_logger_archive_start(void) {
+    uint32_t epoch;
+    if (clock_drift_port_now(&epoch)) { // Otherwise the first reading starts it
+        start_archive(epoch / 86400u);
+    }
+}
+
+// --- Small State Files ---
+
+size_t sd_logger_read_file(const char *name, uint8_t *buffer, size_t buffer_size) {
+    if (!sd_mounted) return 0;
+
+    energy_profile_set(ENERGY_SD_READ, true);
+    size_t bytes_read = read_file(name, buffer, buffer_size);
+    energy_profile_set(ENERGY_SD_READ, false);
+    return bytes_read;
+}
+
+bool sd_logger_write_file(const char *name, const uint8_t *data, size_t size) {
+    if (!sd_mounted) return false;
+
+    FIL fil;
+    UINT written = 0;
+    bool ok = false;
+    energy_profile_set(ENERGY_SD_WRITE, true);
+    if (f_open(&fil, name, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK) {
+        ok = f_write(&fil, data, size, &written) == FR_OK && written == size;
+        ok = f_close(&fil) == FR_OK && ok;
+    }
+    energy_profile_set(ENERGY_SD_WRITE, false);
+    return ok;
+}
+
+bool sd_logger_append_file(const char *name, const uint8_t *data, size_t size) {
+    if (!sd_mounted) return false;
+
+    FIL fil;
+    UINT written = 0;
+    bool ok = false;
+    energy_profile_set(ENERGY_SD_WRITE, true);
+    if (f_open(&fil, name, FA_OPEN_APPEND | FA_WRITE) == FR_OK) {
+        ok = f_write(&fil, data, size, &written) == FR_OK && written == size;
+        ok = f_close(&fil) == FR_OK && ok;
+    }
+    energy_profile_set(ENERGY_SD_WRITE, false);
+    return ok;
+}
@@ -2,13 +2,28 @@
 #define SD_LOGGER_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "miflora_client.h" // For miflora_reading_t
 
 /**
- * @brief Initialize and mount the SD card.
+ * @brief Set up the background tasks. Call on core 0, before the scheduler runs.
+ */
+void sd_logger_init(void);
+
+/**
+ * @brief Mount the SD card and repair what a reset left behind (torn log tail,
+ * interrupted archive swap). Only touches the card, so it runs on core 1
+ * while core 0 brings up the radio; nothing else may use the card until
+ * sd_logger_is_ready() returns true.
  * @return true if mount was successful, false otherwise.
  */
-bool sd_logger_init(void);
+bool sd_logger_mount(void);
+
+/**
+ * @brief Whether sd_logger_mount() has finished, mounted or not.
+ */
+bool sd_logger_is_ready(void);
 
 /**
  * @brief Log a MiFlora reading to the SD card.
@@ -16,4 +31,32 @@ bool sd_logger_init(void);
  */
 void sd_logger_log_reading(miflora_reading_t *reading);
 
+/**
+ * @brief Start encoding closed daily text logs into columnar archives.
+ * Each "YYYY-MM-DD.txt" before today without a "YYYY-MM-DD.mfa" (see log_archive.h)
+ * is encoded in slices from the scheduler. Also starts on the first reading of
+ * each day, so days closed while the board was off or the clock unset are caught.
+ * Call once the card is ready; does nothing if the clock is not set.
+ */
+void sd_logger_archive_start(void);
+
+/**
+ * @brief Read a small state file (checkpoint, saved totals) in one go.
+ * @return Number of bytes read, 0 if the file is missing or the card is not mounted.
+ */
+size_t sd_logger_read_file(const char *name, uint8_t *buffer, size_t buffer_size);
+
+/**
+ * @brief Replace a small state file with new contents.
+ * The caller protects the contents (e.g. with a CRC), as a reset can tear the write.
+ * @return true if all bytes were written.
+ */
+bool sd_logger_write_file(const char *name, const uint8_t *data, size_t size);
+
+/**
+ * @brief Append bytes to a file, creating it if needed.
+ * @return true if all bytes were written.
+ */
+bool sd_logger_append_file(const char *name, const uint8_t *data, size_t size);
+
 #endif // SD_LOGGER_H
\ No newline at end of file
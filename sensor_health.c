@@ -0,0 +1,121 @@
+#include "sensor_health.h"
+#include <stdio.h>
+#include <string.h>
+
+// --- Health Table ---
+static sensor_health_t sensors[SENSOR_HEALTH_MAX_SENSORS];
+static int sensor_count = 0;
+
+// Wrap-safe "deadline has passed" for 32-bit millisecond timestamps
+static bool time_reached(uint32_t deadline_ms, uint32_t now_ms) {
+    return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
+// Success rate in percent; untried sensors count as healthy
+static uint32_t success_rate(const sensor_health_t *s) {
+    return s->attempts ? (s->successes * 100u) / s->attempts : 100u;
+}
+
+// --- Public Function Implementations ---
+
+int sensor_health_add(const uint8_t addr[6]) {
+    int index = sensor_health_find(addr);
+    if (index >= 0) return index;
+    if (sensor_count >= SENSOR_HEALTH_MAX_SENSORS) return -1;
+
+    sensor_health_t *s = &sensors[sensor_count];
+    memset(s, 0, sizeof(*s));
+    memcpy(s->addr, addr, 6);
+    return sensor_count++;
+}
+
+int sensor_health_find(const uint8_t addr[6]) {
+    for (int i = 0; i < sensor_count; i++) {
+        if (memcmp(sensors[i].addr, addr, 6) == 0) return i;
+    }
+    return -1;
+}
+
+int sensor_health_count(void) {
+    return sensor_count;
+}
+
+const sensor_health_t *sensor_health_get(int index) {
+    if (index < 0 || index >= sensor_count) return NULL;
+    return &sensors[index];
+}
+
+void sensor_health_record_seen(int index, int8_t rssi, uint32_t now_ms) {
+    if (index < 0 || index >= sensor_count) return;
+    sensors[index].seen = true;
+    sensors[index].last_rssi = rssi;
+    sensors[index].last_seen_ms = now_ms;
+}
+
+void sensor_health_record_success(int index, uint32_t now_ms) {
+    if (index < 0 || index >= sensor_count) return;
+    sensor_health_t *s = &sensors[index];
+    s->attempts++;
+    s->successes++;
+    s->consecutive_failures = 0;
+    s->next_attempt_ms = now_ms;
+}
+
+void sensor_health_record_failure(int index, uint32_t now_ms) {
+    if (index < 0 || index >= sensor_count) return;
+    sensor_health_t *s = &sensors[index];
+    s->attempts++;
+    if (s->consecutive_failures < UINT8_MAX) s->consecutive_failures++;
+
+    // First failure: retry next cycle. After that: BASE, 2*BASE, 4*BASE... up to MAX.
+    uint32_t backoff_ms = 0;
+    if (s->consecutive_failures >= 2) {
+        backoff_ms = SENSOR_BACKOFF_BASE_MS;
+        for (uint8_t i = 2; i < s->consecutive_failures && backoff_ms < SENSOR_BACKOFF_MAX_MS; i++) {
+            backoff_ms *= 2;
+        }
+        if (backoff_ms > SENSOR_BACKOFF_MAX_MS) backoff_ms = SENSOR_BACKOFF_MAX_MS;
+    }
+    s->next_attempt_ms = now_ms + backoff_ms;
+}
+
+int sensor_health_pick_next(uint32_t now_ms, uint32_t done_mask) {
+    int best = -1;
+    uint32_t best_rate = 0;
+
+    for (int i = 0; i < sensor_count; i++) {
+        if (done_mask & (1u << i)) continue;
+        if (!time_reached(sensors[i].next_attempt_ms, now_ms)) continue; // Backing off
+
+        uint32_t rate = success_rate(&sensors[i]);
+        if (best < 0 || rate > best_rate) {
+            best = i;
+            best_rate = rate;
+        }
+    }
+    return best;
+}
+
+size_t sensor_health_format(char *buffer, size_t buffer_size, uint32_t now_ms) {
+    size_t used = 0;
+    int n = snprintf(buffer, buffer_size, "sensor,addr,attempts,success_pct,fails_in_row,rssi,seen_s_ago,backoff_s\n");
+    if (n < 0) return 0;
+    used = (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+
+    for (int i = 0; i < sensor_count && used < buffer_size - 1; i++) {
+        const sensor_health_t *s = &sensors[i];
+        uint32_t backoff_ms = time_reached(s->next_attempt_ms, now_ms) ? 0 : s->next_attempt_ms - now_ms;
+        n = snprintf(buffer + used, buffer_size - used,
+                     "%d,%02X%02X%02X%02X%02X%02X,%lu,%lu,%u,%d,%ld,%lu\n",
+                     i, s->addr[0], s->addr[1], s->addr[2], s->addr[3], s->addr[4], s->addr[5],
+                     (unsigned long)s->attempts,
+                     (unsigned long)success_rate(s),
+                     s->consecutive_failures,
+                     s->last_rssi,
+                     s->seen ? (long)((now_ms - s->last_seen_ms) / 1000) : -1L,
+                     (unsigned long)(backoff_ms / 1000));
+        if (n < 0) break;
+        used += (size_t)n < buffer_size - used ? (size_t)n : buffer_size - used - 1;
+    }
+    return used;
+}
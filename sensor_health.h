@@ -0,0 +1,85 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of sensors the poller keeps records for (at most 32, one bit
+// per sensor in the poll cycle mask)
+#ifndef SENSOR_HEALTH_MAX_SENSORS
+#define SENSOR_HEALTH_MAX_SENSORS 8
+#endif
+
+// Backoff after repeated failures: the first failure is retried next cycle,
+// then the wait doubles from BASE up to MAX.
+#ifndef SENSOR_BACKOFF_BASE_MS
+#define SENSOR_BACKOFF_BASE_MS (30 * 60 * 1000)       // 30 minutes
+#endif
+#ifndef SENSOR_BACKOFF_MAX_MS
+#define SENSOR_BACKOFF_MAX_MS (24 * 60 * 60 * 1000)   // 24 hours
+#endif
+
+// Per-sensor health record
+typedef struct {
+    uint8_t addr[6];
+    uint32_t attempts;
+    uint32_t successes;
+    uint8_t consecutive_failures;
+    bool seen;                 // Seen in at least one advertisement
+    int8_t last_rssi;
+    uint32_t last_seen_ms;
+    uint32_t next_attempt_ms;  // Not polled before this time (backoff)
+} sensor_health_t;
+
+/**
+ * @brief Add a sensor to the table.
+ * @return The sensor index, or -1 if the table is full.
+ */
+int sensor_health_add(const uint8_t addr[6]);
+
+/**
+ * @brief Find a sensor by address.
+ * @return The sensor index, or -1 if unknown.
+ */
+int sensor_health_find(const uint8_t addr[6]);
+
+/**
+ * @brief Number of sensors in the table.
+ */
+int sensor_health_count(void);
+
+/**
+ * @brief Get a sensor record by index (NULL if out of range).
+ */
+const sensor_health_t *sensor_health_get(int index);
+
+// --- Recording ---
+void sensor_health_record_seen(int index, int8_t rssi, uint32_t now_ms);
+void sensor_health_record_success(int index, uint32_t now_ms);
+void sensor_health_record_failure(int index, uint32_t now_ms);
+
+/**
+ * @brief Pick the next sensor to poll in this cycle.
+ * Sensors still in backoff are skipped; among the rest, sensors with the
+ * best success rate go first so dead sensors do not delay healthy ones.
+ * @param done_mask Bit i set if sensor i was already polled this cycle.
+ * @return The sensor index, or -1 if nothing is left to poll.
+ */
+int sensor_health_pick_next(uint32_t now_ms, uint32_t done_mask);
+
+/**
+ * @brief Format the table as CSV text.
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t sensor_health_format(char *buffer, size_t buffer_size, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SENSOR_HEALTH_H
@@ -0,0 +1,212 @@
+#include "sensor_registry.h"
+#include <stdio.h>
+#include <string.h>
+
+// Enrolled and discovered entries together fill at most half the table,
+// so a probe ends at a free slot after two steps on average
+_Static_assert((SENSOR_REGISTRY_CAPACITY & (SENSOR_REGISTRY_CAPACITY - 1)) == 0,
+               "SENSOR_REGISTRY_CAPACITY must be a power of two");
+_Static_assert(SENSOR_HEALTH_MAX_SENSORS + SENSOR_REGISTRY_MAX_DISCOVERED <= SENSOR_REGISTRY_CAPACITY / 2,
+               "sensor registry would be more than half full");
+
+// Advertising data types (Bluetooth Core Supplement, part A)
+#define AD_TYPE_SHORT_NAME        0x08
+#define AD_TYPE_COMPLETE_NAME     0x09
+#define AD_TYPE_SERVICE_DATA_16   0x16
+#define MIFLORA_SERVICE_DATA_UUID 0xFE95 // Xiaomi
+static const char miflora_name[] = "Flower care";
+
+// --- Hash Table ---
+static sensor_registry_entry_t table[SENSOR_REGISTRY_CAPACITY];
+static int discovered_count = 0;
+static uint32_t discovered_dropped = 0;
+
+// FNV-1a over the whole address: sensors share the vendor bytes
+static uint32_t home_slot(const uint8_t addr[6]) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        hash = (hash ^ addr[i]) * 16777619u;
+    }
+    return hash & (SENSOR_REGISTRY_CAPACITY - 1);
+}
+
+/**
+ * @brief Slot holding addr, or the free slot where it would go.
+ */
+static sensor_registry_entry_t *probe(const uint8_t addr[6]) {
+    uint32_t slot = home_slot(addr);
+    while (table[slot].used && memcmp(table[slot].addr, addr, 6) != 0) {
+        slot = (slot + 1) & (SENSOR_REGISTRY_CAPACITY - 1);
+    }
+    return &table[slot];
+}
+
+static void init_entry(sensor_registry_entry_t *entry, const uint8_t addr[6]) {
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry->addr, addr, 6);
+    entry->used = true;
+    entry->sensor = -1;
+}
+
+static bool parse_hex_byte(const char *p, uint8_t *value) {
+    int v = 0;
+    for (int i = 0; i < 2; i++) {
+        char c = p[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' :
+                    c >= 'A' && c <= 'F' ? c - 'A' + 10 :
+                    c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) return false;
+        v = v * 16 + digit;
+    }
+    *value = (uint8_t)v;
+    return true;
+}
+
+// "XX:XX:XX:XX:XX:XX", most significant byte first like bd_addr_to_str()
+static bool parse_addr(const char *text, uint8_t addr[6]) {
+    for (int i = 0; i < 6; i++) {
+        if (!parse_hex_byte(text + i * 3, &addr[i])) return false;
+        if (i < 5 && text[i * 3 + 2] != ':') return false;
+    }
+    return true;
+}
+
+// --- Public Function Implementations ---
+
+sensor_registry_entry_t *sensor_registry_find(const uint8_t addr[6]) {
+    sensor_registry_entry_t *entry = probe(addr);
+    return entry->used ? entry : NULL;
+}
+
+sensor_registry_entry_t *sensor_registry_add_discovered(const uint8_t addr[6]) {
+    sensor_registry_entry_t *entry = probe(addr);
+    if (entry->used) return entry;
+    if (discovered_count >= SENSOR_REGISTRY_MAX_DISCOVERED) {
+        discovered_dropped++;
+        return NULL;
+    }
+    init_entry(entry, addr);
+    discovered_count++;
+    return entry;
+}
+
+int sensor_registry_enroll(const uint8_t addr[6]) {
+    int index = sensor_health_add(addr);
+    if (index < 0) return -1;
+
+    sensor_registry_entry_t *entry = probe(addr);
+    if (!entry->used) {
+        init_entry(entry, addr);
+    } else if (entry->sensor < 0) {
+        discovered_count--; // Discovered first, keeps its RSSI and last-seen time
+    }
+    entry->sensor = (int8_t)index;
+    return index;
+}
+
+void sensor_registry_clear_discovered(void) {
+    memset(table, 0, sizeof(table));
+    discovered_count = 0;
+    discovered_dropped = 0;
+    for (int i = 0; i < sensor_health_count(); i++) {
+        const sensor_health_t *s = sensor_health_get(i);
+        sensor_registry_entry_t *entry = probe(s->addr);
+        init_entry(entry, s->addr);
+        entry->sensor = (int8_t)i;
+    }
+}
+
+void sensor_registry_record_seen(sensor_registry_entry_t *entry, int8_t rssi, uint32_t now_ms) {
+    entry->last_rssi = rssi;
+    entry->last_seen_ms = now_ms;
+    entry->reports++;
+}
+
+bool sensor_registry_is_miflora_adv(const uint8_t *data, uint8_t length) {
+    // Walk the [length, type, payload] structures
+    for (uint8_t pos = 0; pos + 1 < length && data[pos] > 0; pos += data[pos] + 1) {
+        uint8_t field_len = data[pos];
+        if (pos + 1 + field_len > length) break;
+        uint8_t type = data[pos + 1];
+        const uint8_t *payload = data + pos + 2;
+        uint8_t payload_len = field_len - 1;
+
+        if (type == AD_TYPE_SERVICE_DATA_16 && payload_len >= 2 &&
+            (payload[0] | payload[1] << 8) == MIFLORA_SERVICE_DATA_UUID) {
+            return true;
+        }
+        if ((type == AD_TYPE_COMPLETE_NAME || type == AD_TYPE_SHORT_NAME) &&
+            payload_len == sizeof(miflora_name) - 1 && memcmp(payload, miflora_name, payload_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t sensor_registry_save(uint8_t *buffer, size_t buffer_size) {
+    size_t used = 0;
+    for (int i = 0; i < sensor_health_count() && used + SENSOR_REGISTRY_LINE_SIZE < buffer_size; i++) {
+        const uint8_t *a = sensor_health_get(i)->addr;
+        used += (size_t)snprintf((char *)buffer + used, buffer_size - used, "%02X:%02X:%02X:%02X:%02X:%02X\n",
+                                 a[0], a[1], a[2], a[3], a[4], a[5]);
+    }
+    return used;
+}
+
+int sensor_registry_load(const uint8_t *buffer, size_t size) {
+    int enrolled = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        size_t end = pos;
+        while (end < size && buffer[end] != '\n') end++;
+
+        // A line is an address, optionally with '\r' from an editor on a PC
+        uint8_t addr[6];
+        size_t len = end - pos;
+        if (len > 0 && buffer[pos + len - 1] == '\r') len--;
+        if (len == SENSOR_REGISTRY_LINE_SIZE - 1 && parse_addr((const char *)buffer + pos, addr) &&
+            sensor_registry_enroll(addr) >= 0) {
+            enrolled++;
+        }
+        pos = end + 1;
+    }
+    return enrolled;
+}
+
+int sensor_registry_discovered_count(void) {
+    return discovered_count;
+}
+
+uint32_t sensor_registry_dropped(void) {
+    return discovered_dropped;
+}
+
+/**
+ * @brief Append one entry as a CSV line.
+ */
+static size_t format_entry(char *buffer, size_t buffer_size, const sensor_registry_entry_t *e, uint32_t now_ms) {
+    int n = snprintf(buffer, buffer_size, "%02X%02X%02X%02X%02X%02X,%d,%d,%ld,%lu\n",
+                     e->addr[0], e->addr[1], e->addr[2], e->addr[3], e->addr[4], e->addr[5],
+                     e->sensor, e->last_rssi,
+                     e->reports ? (long)((now_ms - e->last_seen_ms) / 1000) : -1L,
+                     (unsigned long)e->reports);
+    if (n < 0) return 0;
+    return (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+}
+
+size_t sensor_registry_format(char *buffer, size_t buffer_size, uint32_t now_ms) {
+    int n = snprintf(buffer, buffer_size, "addr,sensor,rssi,seen_s_ago,reports\n");
+    if (n < 0) return 0;
+    size_t used = (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+
+    // Enrolled sensors in poll order, then discoveries in table order
+    for (int i = 0; i < sensor_health_count() && used < buffer_size - 1; i++) {
+        used += format_entry(buffer + used, buffer_size - used, probe(sensor_health_get(i)->addr), now_ms);
+    }
+    for (int slot = 0; slot < SENSOR_REGISTRY_CAPACITY && used < buffer_size - 1; slot++) {
+        if (table[slot].used && table[slot].sensor < 0) {
+            used += format_entry(buffer + used, buffer_size - used, &table[slot], now_ms);
+        }
+    }
+    return used;
+}
@@ -0,0 +1,115 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sensor_health.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Address registry for enrolled and discovered MiFloras.
+ *
+ * Every advertising report is looked up here, so the table is a fixed-size
+ * open-addressing hash table keyed by address: one probe on average, however
+ * many BLE devices are around. Enrolled sensors (the ones we poll, indexed in
+ * sensor_health) are always in the table; in discovery mode, MiFloras seen in
+ * advertisements are added too, with RSSI and last-seen time, until
+ * SENSOR_REGISTRY_MAX_DISCOVERED is reached. Entries are only removed all at
+ * once (sensor_registry_clear_discovered), so no tombstones are needed.
+ *
+ * Enrolled addresses are persisted as text, one "XX:XX:XX:XX:XX:XX" per line,
+ * so the file can also be edited on a PC.
+ */
+
+#define SENSOR_REGISTRY_FILE "SENSORS.CFG"
+
+// Slots in the hash table, a power of two. Most reports come from devices
+// that are not in the table, and a miss probes until a free slot, so the
+// table is kept at most half full.
+#ifndef SENSOR_REGISTRY_CAPACITY
+#define SENSOR_REGISTRY_CAPACITY 64
+#endif
+
+// Discovered (not enrolled) entries kept; later discoveries are counted and dropped
+#ifndef SENSOR_REGISTRY_MAX_DISCOVERED
+#define SENSOR_REGISTRY_MAX_DISCOVERED 16
+#endif
+
+#define SENSOR_REGISTRY_LINE_SIZE 18 // "XX:XX:XX:XX:XX:XX\n"
+#define SENSOR_REGISTRY_SAVED_MAX (SENSOR_HEALTH_MAX_SENSORS * SENSOR_REGISTRY_LINE_SIZE)
+
+// Registry entry
+typedef struct {
+    uint8_t addr[6];
+    bool used;
+    int8_t sensor;         // Index in sensor_health if enrolled, -1 if only discovered
+    int8_t last_rssi;
+    uint32_t last_seen_ms;
+    uint32_t reports;      // Advertisements seen
+} sensor_registry_entry_t;
+
+/**
+ * @brief Find an address.
+ * @return The entry, or NULL if the address is neither enrolled nor discovered.
+ */
+sensor_registry_entry_t *sensor_registry_find(const uint8_t addr[6]);
+
+/**
+ * @brief Add a discovered MiFlora (or find it if already known).
+ * @return The entry, or NULL if the discovered entries are at their limit.
+ */
+sensor_registry_entry_t *sensor_registry_add_discovered(const uint8_t addr[6]);
+
+/**
+ * @brief Enroll a sensor for polling (sensor_health_add) and index it.
+ * @return The sensor index, or -1 if the sensor table is full.
+ */
+int sensor_registry_enroll(const uint8_t addr[6]);
+
+/**
+ * @brief Drop all discovered entries, keeping the enrolled sensors.
+ */
+void sensor_registry_clear_discovered(void);
+
+void sensor_registry_record_seen(sensor_registry_entry_t *entry, int8_t rssi, uint32_t now_ms);
+
+/**
+ * @brief Whether advertising data comes from a MiFlora: the "Flower care" name
+ * or Xiaomi's 0xFE95 service data.
+ */
+bool sensor_registry_is_miflora_adv(const uint8_t *data, uint8_t length);
+
+/**
+ * @brief Write the enrolled addresses as text for SENSOR_REGISTRY_FILE.
+ * @return Number of bytes written.
+ */
+size_t sensor_registry_save(uint8_t *buffer, size_t buffer_size);
+
+/**
+ * @brief Enroll every address in text saved by sensor_registry_save().
+ * Malformed lines are skipped.
+ * @return Number of addresses enrolled.
+ */
+int sensor_registry_load(const uint8_t *buffer, size_t size);
+
+/**
+ * @brief Number of discovered entries, and discoveries dropped because the table was full.
+ */
+int sensor_registry_discovered_count(void);
+uint32_t sensor_registry_dropped(void);
+
+/**
+ * @brief Format the table as CSV text, enrolled sensors first.
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t sensor_registry_format(char *buffer, size_t buffer_size, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SENSOR_REGISTRY_H
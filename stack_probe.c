@@ -0,0 +1,54 @@
+#include "stack_probe.h"
+#include <stdio.h>
+
+// Words left unpainted below the frame of stack_probe_init(), for the call itself
+#define PAINT_MARGIN_WORDS 16
+
+// Stack bounds from the Pico SDK's linker script
+extern uint32_t __StackBottom;
+extern uint32_t __StackTop;
+extern uint32_t __StackOneBottom;
+extern uint32_t __StackOneTop;
+
+static void paint(uint32_t *bottom, uint32_t *limit) {
+    for (volatile uint32_t *p = bottom; p < limit; p++) *p = STACK_PROBE_PATTERN;
+}
+
+// --- Public Function Implementations ---
+
+void __attribute__((noinline)) stack_probe_init(void) {
+    // Core 0 is running on its stack: paint only below this frame
+    uint32_t *frame = (uint32_t *)__builtin_frame_address(0) - PAINT_MARGIN_WORDS;
+    paint(&__StackBottom, frame);
+    paint(&__StackOneBottom, &__StackOneTop);
+}
+
+stack_probe_core_t stack_probe_read(int core) {
+    const volatile uint32_t *bottom = core == 0 ? &__StackBottom : &__StackOneBottom;
+    const uint32_t *top = core == 0 ? &__StackTop : &__StackOneTop;
+
+    const volatile uint32_t *p = bottom;
+    while (p < top && *p == STACK_PROBE_PATTERN) p++;
+
+    stack_probe_core_t result;
+    result.size = (uint32_t)((const uint8_t *)top - (const uint8_t *)bottom);
+    result.used = (uint32_t)((const uint8_t *)top - (const uint8_t *)p);
+    result.overflow = p == bottom;
+    return result;
+}
+
+size_t stack_probe_format(char *buffer, size_t buffer_size) {
+    int n = snprintf(buffer, buffer_size, "core,size,used,free,state\n");
+    if (n < 0) return 0;
+    size_t used = (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+    for (int core = 0; core < 2 && used < buffer_size - 1; core++) {
+        stack_probe_core_t s = stack_probe_read(core);
+        uint32_t free_bytes = s.size - s.used;
+        const char *state = s.overflow ? "overflow" : free_bytes < STACK_PROBE_LOW_BYTES ? "low" : "ok";
+        n = snprintf(buffer + used, buffer_size - used, "%d,%lu,%lu,%lu,%s\n", core,
+                     (unsigned long)s.size, (unsigned long)s.used, (unsigned long)free_bytes, state);
+        if (n < 0) break;
+        used += (size_t)n < buffer_size - used ? (size_t)n : buffer_size - used - 1;
+    }
+    return used;
+}
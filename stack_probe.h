@@ -0,0 +1,62 @@
+#ifndef STACK_PROBE_H
+#define STACK_PROBE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Stack high-water marks of both cores.
+ *
+ * Each core has a small fixed stack in its own scratch bank
+ * (PICO_STACK_SIZE, PICO_CORE1_STACK_SIZE: 2 KB by default). Core 1 runs
+ * the mount and recovery, with FatFs objects on the stack. Core 0 runs
+ * BTstack and every task. An overflow does not fault; it silently corrupts
+ * the memory below the stack.
+ *
+ * At boot both stacks are filled with a pattern, below the frame of main()
+ * on core 0 and whole on core 1 before it is launched. Later, the deepest
+ * word that no longer holds the pattern marks the most stack ever used. The
+ * MEM command streams the figures. Static RAM is checked at build time
+ * instead (memory_budget.csv).
+ */
+
+#define STACK_PROBE_PATTERN 0xC5AC5AC5u
+
+// Free bytes below which a core's stack is reported as low
+#ifndef STACK_PROBE_LOW_BYTES
+#define STACK_PROBE_LOW_BYTES 256
+#endif
+
+typedef struct {
+    uint32_t size;  // Bytes reserved for the stack
+    uint32_t used;  // Most bytes ever in use
+    bool overflow;  // The bottom word was overwritten: used may be larger
+} stack_probe_core_t;
+
+/**
+ * @brief Fill both stacks with the pattern. Call first in main(), before
+ * core 1 is launched.
+ */
+void stack_probe_init(void);
+
+/**
+ * @brief High-water mark of one core's stack (0 or 1).
+ */
+stack_probe_core_t stack_probe_read(int core);
+
+/**
+ * @brief Format both cores as CSV text ("core,size,used,free,state").
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t stack_probe_format(char *buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STACK_PROBE_H
@@ -0,0 +1,62 @@
+#include "time_util.h"
+
+// Days since 1970-01-01 for a proleptic Gregorian date (Howard Hinnant's algorithm)
+static int32_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153u * (uint32_t)(m + (m > 2 ? -3 : 9)) + 2u) / 5u + (uint32_t)d - 1u;
+    uint32_t doe = yoe * 365u + yoe / 4u - yoe / 100u + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+uint32_t time_util_to_epoch(int year, int month, int day, int hour, int min, int sec) {
+    return (uint32_t)days_from_civil(year, month, day) * 86400u +
+           (uint32_t)(hour * 3600 + min * 60 + sec);
+}
+
+void time_util_from_epoch(uint32_t epoch, int *year, int *month, int *day, int *hour, int *min, int *sec) {
+    int32_t z = (int32_t)(epoch / 86400u) + 719468;
+    uint32_t secs = epoch % 86400u;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460u + doe / 36524u - doe / 146096u) / 365u;
+    uint32_t doy = doe - (365u * yoe + yoe / 4u - yoe / 100u);
+    uint32_t mp = (5u * doy + 2u) / 153u;
+    int m = (int)(mp < 10 ? mp + 3 : mp - 9);
+
+    *year = (int)yoe + era * 400 + (m <= 2);
+    *month = m;
+    *day = (int)(doy - (153u * mp + 2u) / 5u + 1u);
+    *hour = (int)(secs / 3600u);
+    *min = (int)(secs / 60u % 60u);
+    *sec = (int)(secs % 60u);
+}
+
+// Parse exactly n decimal digits
+static bool parse_digits(const char *p, int n, int *value) {
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') return false;
+        v = v * 10 + (p[i] - '0');
+    }
+    *value = v;
+    return true;
+}
+
+bool time_util_parse_iso(const char *text, uint32_t *epoch) {
+    int year, month, day, hour, min, sec;
+    if (!parse_digits(text, 4, &year) || text[4] != '-' ||
+        !parse_digits(text + 5, 2, &month) || text[7] != '-' ||
+        !parse_digits(text + 8, 2, &day) || text[10] != 'T' ||
+        !parse_digits(text + 11, 2, &hour) || text[13] != ':' ||
+        !parse_digits(text + 14, 2, &min) || text[16] != ':' ||
+        !parse_digits(text + 17, 2, &sec)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || min > 59 || sec > 59) {
+        return false;
+    }
+    *epoch = time_util_to_epoch(year, month, day, hour, min, sec);
+    return true;
+}
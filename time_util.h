@@ -0,0 +1,37 @@
+#ifndef TIME_UTIL_H
+#define TIME_UTIL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Calendar helpers shared by the firmware and the host tools.
+ * Times are UTC-agnostic "wall clock" seconds since 1970-01-01T00:00:00,
+ * matching whatever the RTC was set to.
+ */
+
+/**
+ * @brief Convert a calendar date/time to seconds since 1970-01-01.
+ */
+uint32_t time_util_to_epoch(int year, int month, int day, int hour, int min, int sec);
+
+/**
+ * @brief Convert seconds since 1970-01-01 back to a calendar date/time.
+ */
+void time_util_from_epoch(uint32_t epoch, int *year, int *month, int *day, int *hour, int *min, int *sec);
+
+/**
+ * @brief Parse "YYYY-MM-DDTHH:MM:SS" (the log timestamp format).
+ * @return true on success.
+ */
+bool time_util_parse_iso(const char *text, uint32_t *epoch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIME_UTIL_H
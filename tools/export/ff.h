@@ -0,0 +1,62 @@
+// FatFs surface used by usb_export.c, for the host export stand-in
+// (tools/miflora_export): the "card" is a directory on the PC.
+#ifndef EXPORT_FF_H
+#define EXPORT_FF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint64_t FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+    FR_NO_PATH,
+    FR_INVALID_NAME,
+} FRESULT;
+
+#define FA_READ 0x01
+#define AM_DIR  0x10
+
+typedef struct {
+    FILE *fp;
+    FSIZE_t obj_size;
+} FIL;
+
+typedef struct {
+    void *dir; // std::filesystem::directory_iterator in miflora_export.cpp
+} DIR;
+
+typedef struct {
+    FSIZE_t fsize;
+    WORD fdate;
+    WORD ftime;
+    BYTE fattrib;
+    char fname[256];
+} FILINFO;
+
+#define f_size(fp) ((fp)->obj_size)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FRESULT f_close(FIL *fp);
+FRESULT f_opendir(DIR *dp, const char *path);
+FRESULT f_readdir(DIR *dp, FILINFO *fno);
+FRESULT f_closedir(DIR *dp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPORT_FF_H
@@ -0,0 +1,288 @@
+// miflora_archive: encode, decode and benchmark columnar .mfa log archives.
+//
+// Usage:
+//   miflora_archive encode <YYYY-MM-DD.txt> <out.mfa>
+//   miflora_archive decode <in.mfa> [from-iso [to-iso]]
+//   miflora_archive bench <YYYY-MM-DD.txt>...
+//
+// The block format is defined in log_archive.h and shared with the firmware,
+// which writes one .mfa per day at day rollover.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "log_archive.h"
+#include "time_util.h"
+
+namespace {
+
+struct BlockHeader {
+    uint8_t sensor[6];
+    uint16_t count;
+    uint32_t t_first;
+    uint32_t t_last;
+    int32_t min[LOG_ARCHIVE_NUM_FIELDS];
+    int32_t max[LOG_ARCHIVE_NUM_FIELDS];
+    uint16_t payload_len;
+};
+
+uint16_t read_le16(const uint8_t *p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+uint32_t read_le32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+bool read_file(const std::string &path, std::vector<uint8_t> &data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Walks the blocks of an archive; each block can be decoded or skipped by its header alone.
+class ArchiveReader {
+public:
+    explicit ArchiveReader(const std::vector<uint8_t> &data) : data_(data) {}
+
+    // Reads the next block header; false at end of data or on corruption.
+    bool next(BlockHeader &h) {
+        pos_ = next_pos_;
+        if (pos_ + LOG_ARCHIVE_HEADER_SIZE > data_.size()) return false;
+        const uint8_t *p = data_.data() + pos_;
+        if (read_le32(p + LOG_ARCHIVE_HDR_MAGIC) != LOG_ARCHIVE_MAGIC) return false;
+        std::memcpy(h.sensor, p + LOG_ARCHIVE_HDR_SENSOR, 6);
+        h.count = read_le16(p + LOG_ARCHIVE_HDR_COUNT);
+        h.t_first = read_le32(p + LOG_ARCHIVE_HDR_T_FIRST);
+        h.t_last = read_le32(p + LOG_ARCHIVE_HDR_T_LAST);
+        for (int f = 0; f < LOG_ARCHIVE_NUM_FIELDS; f++) {
+            h.min[f] = static_cast<int32_t>(read_le32(p + LOG_ARCHIVE_HDR_MINMAX + 8 * f));
+            h.max[f] = static_cast<int32_t>(read_le32(p + LOG_ARCHIVE_HDR_MINMAX + 8 * f + 4));
+        }
+        h.payload_len = read_le16(p + LOG_ARCHIVE_HDR_PAYLOAD_LEN);
+        next_pos_ = pos_ + LOG_ARCHIVE_HEADER_SIZE + h.payload_len;
+        if (next_pos_ > data_.size()) return false;
+        header_ = h;
+        return true;
+    }
+
+    // Decodes the block returned by the last next() call, appending to out.
+    bool decode(std::vector<log_record_t> &out) const {
+        const uint8_t *p = data_.data() + pos_ + LOG_ARCHIVE_HEADER_SIZE;
+        size_t left = header_.payload_len;
+        size_t base = out.size();
+        out.resize(base + header_.count);
+        log_record_t *records = out.data() + base;
+
+        uint32_t value;
+        uint32_t time = header_.t_first;
+        for (uint16_t i = 0; i < header_.count; i++) {
+            size_t n = log_archive_get_varint(p, left, &value);
+            if (n == 0) return false;
+            p += n;
+            left -= n;
+            time += static_cast<uint32_t>(log_archive_unzigzag(value));
+            records[i].time = time;
+            std::memcpy(records[i].sensor, header_.sensor, 6);
+        }
+        for (int f = 0; f < LOG_ARCHIVE_NUM_FIELDS; f++) {
+            int32_t prev = 0;
+            for (uint16_t i = 0; i < header_.count; i++) {
+                size_t n = log_archive_get_varint(p, left, &value);
+                if (n == 0) return false;
+                p += n;
+                left -= n;
+                prev += log_archive_unzigzag(value);
+                records[i].fields[f] = prev;
+            }
+        }
+        return left == 0;
+    }
+
+private:
+    const std::vector<uint8_t> &data_;
+    size_t pos_ = 0;
+    size_t next_pos_ = 0;
+    BlockHeader header_{};
+};
+
+// Formats a record exactly like sd_logger_log_reading does.
+std::string format_record(const log_record_t &r) {
+    int year, month, day, hour, min, sec;
+    time_util_from_epoch(r.time, &year, &month, &day, &hour, &min, &sec);
+    char line[32 + READING_TEXT_MAX + 32];
+    int n = std::snprintf(line, sizeof(line), "%04d-%02d-%02dT%02d:%02d:%02d", year, month, day, hour, min, sec);
+    n += static_cast<int>(reading_format_text(r.fields, line + n));
+    static const uint8_t no_sensor[6] = {0};
+    if (std::memcmp(r.sensor, no_sensor, 6) != 0) {
+        std::snprintf(line + n, sizeof(line) - n, ",Sensor:%02X%02X%02X%02X%02X%02X",
+                      r.sensor[0], r.sensor[1], r.sensor[2], r.sensor[3], r.sensor[4], r.sensor[5]);
+    }
+    return line;
+}
+
+std::vector<log_record_t> parse_text(const std::vector<uint8_t> &text) {
+    std::vector<log_record_t> records;
+    const char *p = reinterpret_cast<const char *>(text.data());
+    const char *end = p + text.size();
+    while (p < end) {
+        const char *eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (eol == nullptr) eol = end;
+        log_record_t r;
+        if (log_archive_parse_line(p, eol - p, &r)) records.push_back(r);
+        p = eol + 1;
+    }
+    return records;
+}
+
+// Same grouping as the firmware: per sensor in first-seen order, then blocks in time order.
+std::vector<uint8_t> encode_records(const std::vector<log_record_t> &records) {
+    std::vector<std::vector<log_record_t>> series;
+    for (const auto &r : records) {
+        auto it = series.begin();
+        while (it != series.end() && std::memcmp(it->front().sensor, r.sensor, 6) != 0) ++it;
+        if (it == series.end()) {
+            series.emplace_back();
+            it = series.end() - 1;
+        }
+        it->push_back(r);
+    }
+
+    std::vector<uint8_t> out;
+    uint8_t block[LOG_ARCHIVE_BLOCK_MAX_SIZE];
+    for (const auto &s : series) {
+        for (size_t i = 0; i < s.size(); i += LOG_ARCHIVE_BLOCK_MAX_RECORDS) {
+            uint16_t count = static_cast<uint16_t>(std::min<size_t>(LOG_ARCHIVE_BLOCK_MAX_RECORDS, s.size() - i));
+            size_t size = log_archive_encode_block(&s[i], count, block, sizeof(block));
+            out.insert(out.end(), block, block + size);
+        }
+    }
+    return out;
+}
+
+bool decode_all(const std::vector<uint8_t> &archive, std::vector<log_record_t> &out) {
+    ArchiveReader reader(archive);
+    BlockHeader h;
+    while (reader.next(h)) {
+        if (!reader.decode(out)) return false;
+    }
+    return true;
+}
+
+int cmd_encode(const char *in_path, const char *out_path) {
+    std::vector<uint8_t> text;
+    if (!read_file(in_path, text)) {
+        std::fprintf(stderr, "cannot read %s\n", in_path);
+        return 1;
+    }
+    std::vector<uint8_t> archive = encode_records(parse_text(text));
+    std::ofstream out(out_path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(archive.data()), static_cast<std::streamsize>(archive.size()));
+    std::printf("%zu -> %zu bytes\n", text.size(), archive.size());
+    return out ? 0 : 1;
+}
+
+int cmd_decode(const char *path, const char *from_iso, const char *to_iso) {
+    std::vector<uint8_t> archive;
+    if (!read_file(path, archive)) {
+        std::fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    uint32_t from = 0, to = UINT32_MAX;
+    if ((from_iso && !time_util_parse_iso(from_iso, &from)) || (to_iso && !time_util_parse_iso(to_iso, &to))) {
+        std::fprintf(stderr, "timestamps must be YYYY-MM-DDTHH:MM:SS\n");
+        return 1;
+    }
+
+    ArchiveReader reader(archive);
+    BlockHeader h;
+    std::vector<log_record_t> records;
+    while (reader.next(h)) {
+        if (h.t_last < from || h.t_first > to) continue; // Skip the block without decoding it
+        records.clear();
+        if (!reader.decode(records)) {
+            std::fprintf(stderr, "corrupt block\n");
+            return 1;
+        }
+        for (const auto &r : records) {
+            if (r.time >= from && r.time <= to) std::printf("%s\n", format_record(r).c_str());
+        }
+    }
+    return 0;
+}
+
+// Runs fn repeatedly for at least 200 ms and returns seconds per run.
+template <typename Fn>
+double time_per_run(Fn fn) {
+    using clock = std::chrono::steady_clock;
+    size_t runs = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        fn();
+        runs++;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < 0.2);
+    return elapsed.count() / static_cast<double>(runs);
+}
+
+int cmd_bench(int argc, char **argv) {
+    std::vector<uint8_t> text;
+    for (int i = 0; i < argc; i++) {
+        std::vector<uint8_t> file;
+        if (!read_file(argv[i], file)) {
+            std::fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        text.insert(text.end(), file.begin(), file.end());
+        if (!text.empty() && text.back() != '\n') text.push_back('\n');
+    }
+
+    std::vector<log_record_t> records = parse_text(text);
+    if (records.empty()) {
+        std::fprintf(stderr, "no readings found\n");
+        return 1;
+    }
+    std::vector<uint8_t> archive = encode_records(records);
+
+    size_t sink = 0;
+    double text_s = time_per_run([&] { sink += parse_text(text).size(); });
+    std::vector<log_record_t> decoded;
+    decoded.reserve(records.size());
+    double archive_s = time_per_run([&] {
+        decoded.clear();
+        decode_all(archive, decoded);
+        sink += decoded.size();
+    });
+
+    std::printf("readings:        %zu\n", records.size());
+    std::printf("text size:       %zu bytes (%.1f bytes/reading)\n", text.size(),
+                static_cast<double>(text.size()) / records.size());
+    std::printf("archive size:    %zu bytes (%.1f bytes/reading, %.1fx smaller)\n", archive.size(),
+                static_cast<double>(archive.size()) / records.size(),
+                static_cast<double>(text.size()) / archive.size());
+    std::printf("text parse:      %.1f M readings/s\n", records.size() / text_s / 1e6);
+    std::printf("archive decode:  %.1f M readings/s (%.1fx faster)\n", records.size() / archive_s / 1e6,
+                text_s / archive_s);
+    return sink == 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && std::strcmp(argv[1], "encode") == 0) return cmd_encode(argv[2], argv[3]);
+    if (argc >= 3 && std::strcmp(argv[1], "decode") == 0)
+        return cmd_decode(argv[2], argc > 3 ? argv[3] : nullptr, argc > 4 ? argv[4] : nullptr);
+    if (argc >= 3 && std::strcmp(argv[1], "bench") == 0) return cmd_bench(argc - 2, argv + 2);
+
+    std::fprintf(stderr,
+                 "usage: %s encode <YYYY-MM-DD.txt> <out.mfa>\n"
+                 "       %s decode <in.mfa> [from-iso [to-iso]]\n"
+                 "       %s bench <YYYY-MM-DD.txt>...\n",
+                 argv[0], argv[0], argv[0]);
+    return 2;
+}
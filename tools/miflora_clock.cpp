@@ -0,0 +1,163 @@
+// miflora_clock: RTC drift estimate from a saved CLOCK.DAT, or from a simulated deployment.
+//
+// Usage:
+//   miflora_clock report <CLOCK.DAT> [YYYY-MM-DDTHH:MM:SS]
+//   miflora_clock simulate [setting=value]...
+//
+// report prints the estimate saved on the card in the same CSV as the CLOCK
+// command, at the given time (the last sync if none is given).
+//
+// simulate runs the firmware's clock_drift module against an RTC that drifts
+// by drift_ppm, plus a daily temperature swing of wander_ppm. A phone
+// connects every connect_h hours and writes the time in whole seconds, as the
+// app does. The "always" policy syncs on every connection, as the app did
+// before the error estimate existed. The "on_demand" policy reads 0xAAA1
+// first and only syncs when the estimate reaches resync_ms. For both, the
+// true error of the corrected time is sampled every minute: how far the true
+// time is from the second the corrected time names. "beyond_est"
+// counts the samples where the true error exceeded the estimate. Settings:
+//   days=60 drift_ppm=20 wander_ppm=3 connect_h=4 resync_ms=2000
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "clock_drift.h"
+#include "time_util.h"
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+struct Result {
+    uint32_t syncs = 0;
+    double max_error_ms = 0;
+    double error_sum_ms = 0;
+    uint64_t samples = 0;
+    uint64_t beyond_estimate = 0;
+};
+
+// Simulated RTC: advances with the drift, shows whole seconds
+struct Rtc {
+    double time = 0; // What the RTC counted, in seconds
+    bool set = false;
+
+    uint32_t read() const {
+        return (uint32_t)std::floor(time);
+    }
+};
+
+Result simulate(const std::map<std::string, double> &s, bool on_demand) {
+    clock_drift_init();
+    char setting[32];
+    std::snprintf(setting, sizeof(setting), "resync_ms=%.0f", s.at("resync_ms"));
+    clock_drift_configure(setting);
+
+    const double start = time_util_to_epoch(2025, 6, 1, 0, 0, 0) + 0.37; // Not on a second
+    const double step_s = 60;
+    const uint64_t steps = (uint64_t)(s.at("days") * 86400 / step_s);
+    const uint64_t connect_every = (uint64_t)(s.at("connect_h") * 3600 / step_s);
+    Rtc rtc;
+    Result result;
+
+    for (uint64_t i = 0; i <= steps; i++) {
+        double now = start + (double)i * step_s; // True time
+
+        if (connect_every > 0 && i % connect_every == 0 &&
+            (!on_demand || !rtc.set || clock_drift_needs_sync(rtc.read()))) {
+            // The app writes whole seconds; the RTC starts counting from them
+            uint32_t reference = (uint32_t)std::floor(now);
+            clock_drift_sync(reference, 500, rtc.read(), rtc.set);
+            rtc.time = reference;
+            rtc.set = true;
+            result.syncs++;
+        }
+
+        if (rtc.set) {
+            // How far the true time is from the second the corrected time names
+            uint32_t local = rtc.read();
+            double named = clock_drift_correct(local);
+            double error_ms = std::max({ 0.0, named - now, now - (named + 1) }) * 1000;
+            result.max_error_ms = std::max(result.max_error_ms, error_ms);
+            result.error_sum_ms += error_ms;
+            result.samples++;
+            if (error_ms > clock_drift_error_ms(local)) result.beyond_estimate++;
+        }
+
+        double ppm = s.at("drift_ppm") + s.at("wander_ppm") * std::sin(2 * kPi * now / 86400);
+        rtc.time += step_s * (1 + ppm / 1e6);
+    }
+    return result;
+}
+
+int cmd_simulate(int argc, char **argv) {
+    std::map<std::string, double> s = {
+        {"days", 60}, {"drift_ppm", 20}, {"wander_ppm", 3}, {"connect_h", 4}, {"resync_ms", 2000},
+    };
+    for (int i = 0; i < argc; i++) {
+        const char *equals = std::strchr(argv[i], '=');
+        std::string key = equals ? std::string(argv[i], (size_t)(equals - argv[i])) : std::string(argv[i]);
+        if (!equals || !s.count(key)) {
+            std::fprintf(stderr, "unknown setting: %s\n", argv[i]);
+            return 2;
+        }
+        s[key] = std::strtod(equals + 1, nullptr);
+    }
+    if (s["days"] <= 0 || s["connect_h"] <= 0) {
+        std::fprintf(stderr, "days and connect_h must be positive\n");
+        return 2;
+    }
+
+    std::printf("policy,syncs,max_error_ms,mean_error_ms,beyond_est\n");
+    for (bool on_demand : {false, true}) {
+        Result r = simulate(s, on_demand);
+        std::printf("%s,%u,%.0f,%.0f,%.2f%%\n", on_demand ? "on_demand" : "always", r.syncs, r.max_error_ms,
+                    r.samples ? r.error_sum_ms / r.samples : 0.0,
+                    r.samples ? 100.0 * r.beyond_estimate / r.samples : 0.0);
+    }
+
+    // What the device ends up with under the on-demand policy
+    char report[1024];
+    clock_drift_format(clock_drift_get()->synced_at, report, sizeof(report));
+    std::printf("\n%s", report);
+    return 0;
+}
+
+int cmd_report(const char *path, int argc, char **argv) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    clock_drift_init();
+    if (!clock_drift_load(data.data(), data.size())) {
+        std::fprintf(stderr, "%s: not a saved clock drift estimate\n", path);
+        return 1;
+    }
+    uint32_t at = clock_drift_get()->synced_at;
+    if (argc > 0 && !time_util_parse_iso(argv[0], &at)) {
+        std::fprintf(stderr, "bad time: %s\n", argv[0]);
+        return 2;
+    }
+    char report[1024];
+    clock_drift_format(at, report, sizeof(report));
+    std::fputs(report, stdout);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && std::strcmp(argv[1], "report") == 0) return cmd_report(argv[2], argc - 3, argv + 3);
+    if (argc >= 2 && std::strcmp(argv[1], "simulate") == 0) return cmd_simulate(argc - 2, argv + 2);
+
+    std::fprintf(stderr,
+                 "usage: %s report <CLOCK.DAT> [YYYY-MM-DDTHH:MM:SS]\n"
+                 "       %s simulate [setting=value]...\n",
+                 argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,165 @@
+// miflora_energy: energy report from saved totals, or from a simulated deployment.
+//
+// Usage:
+//   miflora_energy report <ENERGY.DAT> [setting=value]...
+//   miflora_energy simulate [setting=value]...
+//
+// report prints the totals saved on the card in the same CSV as the ENERGY
+// command. Model settings ("scan=47000", "battery=2000") recompute the charge
+// with other currents.
+//
+// simulate drives the firmware's energy_profile module with a simulated clock
+// through the same sequence the firmware goes through (advertising, one scan
+// and sensor connection per sensor each log cycle, SD writes, a daily phone
+// session and pump runs) and prints the same report. Change the firmware's
+// timings or the model and compare the two reports. Scenario settings:
+//   days=7 interval_min=15 sensors=1 missing=0 scan_ms=2500 read_ms=1500
+//   sd_write_ms=15 save_ms=5 scan_timeout_ms=30000 phone_min=10
+//   phone_read_ms=300 pump_runs=0 pump_s=5
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "energy_profile.h"
+#include "time_util.h"
+
+namespace {
+
+uint64_t sim_now_us = 0;
+
+void advance_ms(uint64_t ms) {
+    sim_now_us += ms * 1000u;
+}
+
+void advance_to_ms(uint64_t ms) {
+    if (ms * 1000u > sim_now_us) sim_now_us = ms * 1000u;
+}
+
+// Runs an activity for a while
+void run(energy_state_t state, uint64_t ms) {
+    energy_profile_set(state, true);
+    advance_ms(ms);
+    energy_profile_set(state, false);
+}
+
+void print_report() {
+    char report[4096];
+    energy_profile_format(report, sizeof(report));
+    std::fputs(report, stdout);
+}
+
+// Splits "key=value" arguments into scenario values and model settings
+bool parse_settings(int argc, char **argv, std::map<std::string, uint64_t> &scenario) {
+    for (int i = 0; i < argc; i++) {
+        const char *equals = std::strchr(argv[i], '=');
+        std::string key = equals ? std::string(argv[i], (size_t)(equals - argv[i])) : std::string(argv[i]);
+        if (scenario.count(key)) {
+            scenario[key] = std::strtoull(equals + 1, nullptr, 10);
+        } else if (!energy_profile_configure(argv[i])) {
+            std::fprintf(stderr, "unknown setting: %s\n", argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int cmd_report(const char *path, int argc, char **argv) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    energy_profile_init();
+    if (!energy_profile_load(data.data(), data.size())) {
+        std::fprintf(stderr, "%s: not a saved energy profile\n", path);
+        return 1;
+    }
+    std::map<std::string, uint64_t> none;
+    if (!parse_settings(argc, argv, none)) return 2;
+    print_report();
+    return 0;
+}
+
+int cmd_simulate(int argc, char **argv) {
+    std::map<std::string, uint64_t> s = {
+        {"days", 7}, {"interval_min", 15}, {"sensors", 1}, {"missing", 0},
+        {"scan_ms", 2500}, {"read_ms", 1500}, {"sd_write_ms", 15}, {"save_ms", 5},
+        {"scan_timeout_ms", 30000}, {"phone_min", 10}, {"phone_read_ms", 300},
+        {"pump_runs", 0}, {"pump_s", 5},
+    };
+    energy_profile_init();
+    if (!parse_settings(argc, argv, s)) return 2;
+    if (s["interval_min"] == 0 || s["interval_min"] > 1440) {
+        std::fprintf(stderr, "interval_min must be 1..1440\n");
+        return 2;
+    }
+
+    const uint64_t interval_ms = s["interval_min"] * 60000u;
+    const uint64_t cycles_per_day = 1440 / s["interval_min"];
+    const uint32_t first_day = time_util_to_epoch(2025, 6, 1, 0, 0, 0) / 86400u;
+
+    // BTstack up: advertising until a phone connects
+    energy_profile_set(ENERGY_ADVERTISING, true);
+
+    for (uint64_t cycle = 0; cycle < s["days"] * cycles_per_day; cycle++) {
+        advance_to_ms(cycle * interval_ms);
+        uint64_t cycle_in_day = cycle % cycles_per_day;
+
+        // Log cycle due: close the energy cycle and save the totals
+        energy_profile_cycle_end(first_day + (uint32_t)(sim_now_us / 86400000000ull));
+        run(ENERGY_SD_WRITE, s["save_ms"]);
+
+        // Sensors one after another: scan, connect and read, log the reading
+        for (uint64_t sensor = 0; sensor < s["sensors"]; sensor++) {
+            if (sensor < s["missing"]) {
+                run(ENERGY_SCANNING, s["scan_timeout_ms"]);
+                continue;
+            }
+            run(ENERGY_SCANNING, s["scan_ms"]);
+            energy_profile_set(ENERGY_CLIENT_CONNECTION, true);
+            advance_ms(s["read_ms"] > s["sd_write_ms"] ? s["read_ms"] - s["sd_write_ms"] : 0);
+            run(ENERGY_SD_WRITE, s["sd_write_ms"]);
+            energy_profile_set(ENERGY_CLIENT_CONNECTION, false);
+        }
+
+        // A phone connects around noon and downloads a day
+        if (s["phone_min"] > 0 && cycle_in_day == cycles_per_day / 2) {
+            energy_profile_set(ENERGY_ADVERTISING, false);
+            energy_profile_set(ENERGY_SERVER_CONNECTION, true);
+            run(ENERGY_SD_READ, s["phone_read_ms"]);
+            advance_ms(s["phone_min"] * 60000u);
+            energy_profile_set(ENERGY_SERVER_CONNECTION, false);
+            energy_profile_set(ENERGY_ADVERTISING, true);
+        }
+
+        // Pump runs spread over the day
+        uint64_t pump_every = s["pump_runs"] > 0 ? cycles_per_day / s["pump_runs"] : 0;
+        if (pump_every > 0 && cycle_in_day % pump_every == 0 && cycle_in_day / pump_every < s["pump_runs"]) {
+            run(ENERGY_PUMP, s["pump_s"] * 1000u);
+        }
+    }
+    advance_to_ms(s["days"] * cycles_per_day * interval_ms);
+    print_report();
+    return 0;
+}
+
+}  // namespace
+
+// Simulated clock for the energy profile
+extern "C" uint64_t energy_profile_port_now_us(void) {
+    return sim_now_us;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && std::strcmp(argv[1], "report") == 0) return cmd_report(argv[2], argc - 3, argv + 3);
+    if (argc >= 2 && std::strcmp(argv[1], "simulate") == 0) return cmd_simulate(argc - 2, argv + 2);
+
+    std::fprintf(stderr,
+                 "usage: %s report <ENERGY.DAT> [setting=value]...\n"
+                 "       %s simulate [setting=value]...\n",
+                 argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,119 @@
+// miflora_health: check the firmware's sensor backoff and poll order.
+//
+// Usage:
+//   miflora_health check
+//
+// check drives sensor_health.c on a fake millisecond clock:
+//   - backoff: a sensor that keeps failing is retried next cycle after its
+//     first failure, then after SENSOR_BACKOFF_BASE_MS doubling up to
+//     SENSOR_BACKOFF_MAX_MS. It must be skipped one millisecond before each
+//     retry is due and picked at the due time, also across the 32-bit wrap of
+//     the clock. A success ends the backoff.
+//   - order: sensor_health_pick_next() must skip sensors done this cycle and
+//     sensors backing off, and pick the best success rate first (untried
+//     sensors count as healthy, ties go to the lower index).
+// It prints each step and OK or FAILED, and sets the exit status. The state
+// machine deadlines (MIFLORA_*_TIMEOUT_MS) need the fake BTstack and are
+// checked by miflora_replay check.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "sensor_health.h"
+
+namespace {
+
+bool failed = false;
+
+void expect(bool ok, const char *what) {
+    std::printf("%-64s %s\n", what, ok ? "ok" : "FAILED");
+    failed = failed || !ok;
+}
+
+int add_sensor(uint8_t last) {
+    const uint8_t addr[6] = { 0xC4, 0x7C, 0x8D, 0x6A, 0x00, last };
+    return sensor_health_add(addr);
+}
+
+// Whether pick_next offers the sensor, with only it left to poll
+bool offered(int sensor, uint32_t now_ms) {
+    return sensor_health_pick_next(now_ms, ~(1u << sensor)) == sensor;
+}
+
+void check_backoff(int sensor, uint32_t start_ms) {
+    std::printf("backoff, starting at %lu ms\n", (unsigned long)start_ms);
+    uint32_t now = start_ms;
+    char what[96];
+
+    sensor_health_record_failure(sensor, now);
+    expect(offered(sensor, now), "  1 failure: retried next cycle");
+
+    // Expected waits after the 2nd, 3rd, ... failure
+    std::vector<uint32_t> waits;
+    for (uint64_t wait = SENSOR_BACKOFF_BASE_MS; waits.size() < 12; wait *= 2) {
+        waits.push_back(wait < SENSOR_BACKOFF_MAX_MS ? (uint32_t)wait : SENSOR_BACKOFF_MAX_MS);
+    }
+    for (size_t i = 0; i < waits.size(); i++) {
+        sensor_health_record_failure(sensor, now);
+        std::snprintf(what, sizeof(what), "  %zu failures: skipped for %lu min", i + 2, (unsigned long)(waits[i] / 60000));
+        expect(!offered(sensor, now) && !offered(sensor, now + waits[i] - 1) && offered(sensor, now + waits[i]), what);
+        now += waits[i];
+    }
+    expect(waits.back() == SENSOR_BACKOFF_MAX_MS, "  wait reaches the maximum and stays there");
+
+    sensor_health_record_failure(sensor, now);
+    sensor_health_record_success(sensor, now + 1);
+    expect(offered(sensor, now + 1), "  success: no more backoff");
+    sensor_health_record_failure(sensor, now + 2);
+    expect(offered(sensor, now + 2), "  next failure: retried next cycle again");
+    sensor_health_record_success(sensor, now + 3);
+}
+
+void check_order(int first) {
+    std::printf("order\n");
+    const uint32_t now = 1000;
+    // first: 2 of 2 read, +1: 1 of 2, +2: 0 of 1 (retried next cycle), +3: untried
+    sensor_health_record_success(first, now);
+    sensor_health_record_success(first, now);
+    sensor_health_record_success(first + 1, now);
+    sensor_health_record_failure(first + 1, now);
+    sensor_health_record_failure(first + 2, now);
+    uint32_t others = 0;
+    for (int i = 0; i < first; i++) others |= 1u << i; // Sensors of the backoff check
+
+    expect(sensor_health_pick_next(now, others) == first, "  best success rate first, ties to the lower index");
+    expect(sensor_health_pick_next(now, others | 1u << first) == first + 3, "  untried sensor counts as healthy");
+    uint32_t done = others | 1u << first | 1u << (first + 3);
+    expect(sensor_health_pick_next(now, done) == first + 1, "  then the partly failing one");
+    done |= 1u << (first + 1);
+    expect(sensor_health_pick_next(now, done) == first + 2, "  the failing one last");
+    done |= 1u << (first + 2);
+    expect(sensor_health_pick_next(now, done) == -1, "  nothing left once all are done");
+
+    sensor_health_record_failure(first + 2, now);
+    expect(sensor_health_pick_next(now, done & ~(1u << (first + 2))) == -1, "  sensor backing off is skipped");
+}
+
+int cmd_check() {
+    int backoff = add_sensor(0);
+    int wrap = add_sensor(1);
+    check_backoff(backoff, 1000);
+    check_backoff(wrap, UINT32_MAX - SENSOR_BACKOFF_BASE_MS); // Retries due after the clock wraps
+    int first = add_sensor(2);
+    for (uint8_t i = 3; i < 6; i++) add_sensor(i);
+    check_order(first);
+
+    std::printf("%s\n", failed ? "FAILED" : "OK");
+    return failed ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc == 2 && std::strcmp(argv[1], "check") == 0) return cmd_check();
+
+    std::fprintf(stderr, "usage: %s check\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,572 @@
+// miflora_ingest: bulk-convert daily text logs pulled from SD cards.
+//
+// Usage:
+//   miflora_ingest [-j threads] [-f csv|mfa] -o <out-dir> <YYYY-MM-DD.txt>...
+//   miflora_ingest bench [-j threads] <YYYY-MM-DD.txt>...
+//
+// Files are memory-mapped and converted in parallel, one file per worker at a
+// time. Each file is scanned 64 bytes at a time for ',' and '\n' with SIMD
+// compares, producing a bitmask of delimiter positions; the tokens between
+// them are parsed by hand-rolled integer code for the exact line format
+// written by sd_logger_log_reading. Lines in any other shape fall back to
+// log_archive_parse_line, so the output never depends on which path ran.
+//
+// Output per input file: "<day>.csv" (time,sensor,temp,light,moisture,
+// conductivity,battery) or "<day>.mfa" (columnar blocks, see log_archive.h).
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "log_archive.h"
+#include "time_util.h"
+
+namespace {
+
+// Read-only memory map of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0) {
+            size_ = static_cast<size_t>(st.st_size);
+            ok_ = true;
+            if (size_ > 0) {
+#ifdef MAP_POPULATE
+                const int flags = MAP_PRIVATE | MAP_POPULATE; // One call instead of a fault per page
+#else
+                const int flags = MAP_PRIVATE;
+#endif
+                void *p = ::mmap(nullptr, size_, PROT_READ, flags, fd, 0);
+                if (p == MAP_FAILED) {
+                    ok_ = false;
+                } else {
+                    data_ = static_cast<const char *>(p);
+                    ::madvise(p, size_, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char *>(data_), size_);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool ok() const { return ok_; }
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    bool ok_ = false;
+};
+
+// --- Delimiter scanning ---
+
+// Bit i is set if p[i] is ',' or '\n'.
+inline uint64_t delimiter_mask(const char *p) {
+#if defined(__AVX2__)
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32 * i));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, comma), _mm256_cmpeq_epi8(v, newline));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit))) << (32 * i);
+    }
+    return mask;
+#elif defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, newline));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(hit))) << (16 * i);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i++) {
+        mask |= static_cast<uint64_t>(p[i] == ',' || p[i] == '\n') << i;
+    }
+    return mask;
+#endif
+}
+
+// --- Hand-rolled field parsers ---
+
+// Up to 8 digits ending at end. All digits are converted at once (SWAR), so
+// the cost doesn't depend on the number's length; needs 8 readable bytes
+// before end, which the key and timestamp in front of every value provide.
+inline bool parse_uint(const char *p, const char *end, int32_t &value) {
+    size_t n = static_cast<size_t>(end - p);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (n >= 1 && n <= 8) {
+        uint64_t chunk;
+        std::memcpy(&chunk, end - 8, 8);
+        const unsigned pad = 8 * static_cast<unsigned>(8 - n);
+        if (pad) chunk = (chunk >> pad << pad) | 0x3030303030303030ull >> (64 - pad); // Bytes before p become leading '0's
+        if ((chunk & 0xF0F0F0F0F0F0F0F0ull) != 0x3030303030303030ull ||
+            ((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) != 0x3030303030303030ull) {
+            return false;
+        }
+        chunk -= 0x3030303030303030ull;
+        chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFull;
+        chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFull;
+        value = static_cast<int32_t>((chunk * 10000 + (chunk >> 32)) & 0xFFFFFFFFu);
+        return true;
+    }
+#endif
+    if (n == 0 || n > 9) return false;
+    uint32_t v = 0;
+    for (; p < end; p++) {
+        uint32_t digit = static_cast<uint32_t>(*p - '0');
+        if (digit > 9) return false;
+        v = v * 10 + digit;
+    }
+    value = static_cast<int32_t>(v);
+    return true;
+}
+
+// "%.1f" as written by the firmware, in tenths
+inline bool parse_tenths(const char *p, const char *end, int32_t &value) {
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+    if (end - p < 3 || end[-2] != '.') return false;
+    int32_t whole, fraction;
+    if (!parse_uint(p, end - 2, whole) || !parse_uint(end - 1, end, fraction)) return false;
+    value = negative ? -(whole * 10 + fraction) : whole * 10 + fraction;
+    return true;
+}
+
+inline int hex_digit(char c) {
+    if (static_cast<unsigned>(c - '0') < 10) return c - '0';
+    if (static_cast<unsigned>(c - 'A') < 6) return c - 'A' + 10;
+    return -1;
+}
+
+inline bool parse_two(const char *p, int &value) {
+    unsigned hi = static_cast<unsigned>(p[0] - '0'), lo = static_cast<unsigned>(p[1] - '0');
+    value = static_cast<int>(hi * 10 + lo);
+    return hi < 10 && lo < 10;
+}
+
+// "YYYY-MM-DDTHH:MM:SS". Consecutive lines share the date, so its epoch is cached.
+class TimestampParser {
+public:
+    bool parse(const char *p, uint32_t &time) {
+        int hour, min, sec;
+        if (p[13] != ':' || p[16] != ':' || !parse_two(p + 11, hour) || !parse_two(p + 14, min) ||
+            !parse_two(p + 17, sec) || hour > 23 || min > 59 || sec > 59) {
+            return false;
+        }
+        if (std::memcmp(p, date_, 11) != 0) {
+            int c, y, month, day;
+            if (p[4] != '-' || p[7] != '-' || p[10] != 'T' || !parse_two(p, c) || !parse_two(p + 2, y) ||
+                !parse_two(p + 5, month) || !parse_two(p + 8, day) || month < 1 || month > 12 || day < 1 || day > 31) {
+                return false;
+            }
+            std::memcpy(date_, p, 11);
+            day_epoch_ = time_util_to_epoch(c * 100 + y, month, day, 0, 0, 0);
+        }
+        time = day_epoch_ + static_cast<uint32_t>(hour * 3600 + min * 60 + sec);
+        return true;
+    }
+
+private:
+    char date_[11] = {};
+    uint32_t day_epoch_ = 0;
+};
+
+inline bool key_is(const char *p, const char *end, const char *key, size_t key_len) {
+    return static_cast<size_t>(end - p) > key_len && std::memcmp(p, key, key_len) == 0;
+}
+
+// "Key:value" token after the timestamp; unknown keys are ignored like log_archive_parse_line does.
+inline bool parse_token(const char *p, const char *end, log_record_t &r, uint32_t &found) {
+    switch (*p) {
+        case 'T':
+            if (!key_is(p, end, "Temp:", 5)) break;
+            found |= 1u << LOG_FIELD_TEMPERATURE;
+            return parse_tenths(p + 5, end, r.fields[LOG_FIELD_TEMPERATURE]);
+        case 'L':
+            if (!key_is(p, end, "Light:", 6)) break;
+            found |= 1u << LOG_FIELD_LIGHT;
+            return parse_uint(p + 6, end, r.fields[LOG_FIELD_LIGHT]);
+        case 'M':
+            if (!key_is(p, end, "Moisture:", 9)) break;
+            found |= 1u << LOG_FIELD_MOISTURE;
+            return parse_uint(p + 9, end, r.fields[LOG_FIELD_MOISTURE]);
+        case 'C':
+            if (!key_is(p, end, "Conductivity:", 13)) break;
+            found |= 1u << LOG_FIELD_CONDUCTIVITY;
+            return parse_uint(p + 13, end, r.fields[LOG_FIELD_CONDUCTIVITY]);
+        case 'B':
+            if (!key_is(p, end, "Battery:", 8)) break;
+            found |= 1u << LOG_FIELD_BATTERY;
+            return parse_uint(p + 8, end, r.fields[LOG_FIELD_BATTERY]);
+        case 'S':
+            if (!key_is(p, end, "Sensor:", 7)) break;
+            if (end - p != 7 + 12) return false;
+            for (int i = 0; i < 6; i++) {
+                int hi = hex_digit(p[7 + 2 * i]), lo = hex_digit(p[8 + 2 * i]);
+                if (hi < 0 || lo < 0) return false;
+                r.sensor[i] = static_cast<uint8_t>(hi << 4 | lo);
+            }
+            return true;
+        default:
+            break;
+    }
+    return std::memchr(p, ':', end - p) != nullptr;
+}
+
+struct IngestStats {
+    size_t bytes = 0;
+    size_t readings = 0;
+    size_t bad_lines = 0;
+    size_t fallback_lines = 0;
+};
+
+// Calls emit(record, line_begin) for every reading in data. A trailing line
+// without newline is a torn write and is skipped.
+template <typename Emit>
+void parse_log(const char *data, size_t size, IngestStats &stats, Emit &&emit) {
+    TimestampParser timestamps;
+    log_record_t r;
+    uint32_t found = 0;
+    bool line_ok = true;
+    size_t line_start = 0, token_start = 0;
+    const uint32_t all_fields = (1u << LOG_ARCHIVE_NUM_FIELDS) - 1;
+
+    std::memset(r.sensor, 0, sizeof(r.sensor));
+    for (size_t block = 0; block < size; block += 64) {
+        uint64_t mask;
+        if (block + 64 <= size) {
+            mask = delimiter_mask(data + block);
+        } else {
+            char tail[64];
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, data + block, size - block);
+            mask = delimiter_mask(tail);
+        }
+
+        while (mask) {
+            size_t d = block + static_cast<size_t>(__builtin_ctzll(mask));
+            mask &= mask - 1;
+            const char *p = data + token_start;
+            const char *end = data + d;
+
+            if (line_ok) {
+                if (token_start == line_start) {
+                    line_ok = end - p == 19 && timestamps.parse(p, r.time);
+                } else {
+                    line_ok = p < end && parse_token(p, end, r, found);
+                }
+            }
+
+            if (data[d] == '\n') {
+                if (line_ok && found == all_fields) {
+                    emit(r, data + line_start);
+                    stats.readings++;
+                } else if (d > line_start) {
+                    // Not the expected shape: let the reference parser decide
+                    stats.fallback_lines++;
+                    if (log_archive_parse_line(data + line_start, d - line_start, &r)) {
+                        emit(r, data + line_start);
+                        stats.readings++;
+                    } else {
+                        stats.bad_lines++;
+                    }
+                }
+                std::memset(r.sensor, 0, sizeof(r.sensor));
+                found = 0;
+                line_ok = true;
+                line_start = d + 1;
+            }
+            token_start = d + 1;
+        }
+    }
+    stats.bytes += size;
+}
+
+// --- Output ---
+
+inline char *put_uint(char *out, uint32_t v) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *out++ = digits[--n];
+    return out;
+}
+
+// Same grouping as the firmware archive: per sensor in first-seen order, then blocks in time order.
+std::vector<uint8_t> encode_archive(const std::vector<log_record_t> &records) {
+    std::vector<std::vector<log_record_t>> series;
+    for (const auto &r : records) {
+        auto it = series.begin();
+        while (it != series.end() && std::memcmp(it->front().sensor, r.sensor, 6) != 0) ++it;
+        if (it == series.end()) {
+            series.emplace_back();
+            it = series.end() - 1;
+        }
+        it->push_back(r);
+    }
+
+    std::vector<uint8_t> out;
+    uint8_t block[LOG_ARCHIVE_BLOCK_MAX_SIZE];
+    for (const auto &s : series) {
+        for (size_t i = 0; i < s.size(); i += LOG_ARCHIVE_BLOCK_MAX_RECORDS) {
+            uint16_t count = static_cast<uint16_t>(std::min<size_t>(LOG_ARCHIVE_BLOCK_MAX_RECORDS, s.size() - i));
+            size_t size = log_archive_encode_block(&s[i], count, block, sizeof(block));
+            out.insert(out.end(), block, block + size);
+        }
+    }
+    return out;
+}
+
+enum class Format { Csv, Archive };
+
+bool convert_file(const std::string &path, const std::filesystem::path &out_dir, Format format, IngestStats &stats) {
+    MappedFile in(path);
+    if (!in.ok()) {
+        std::fprintf(stderr, "%s: cannot map\n", path.c_str());
+        return false;
+    }
+
+    std::filesystem::path out_path = out_dir / std::filesystem::path(path).stem();
+    std::vector<char> out;
+    if (format == Format::Csv) {
+        out_path += ".csv";
+        static const char header[] = "time,sensor,temp,light,moisture,conductivity,battery\n";
+        out.reserve(in.size());
+        out.insert(out.end(), header, header + sizeof(header) - 1);
+        parse_log(in.data(), in.size(), stats, [&](const log_record_t &r, const char *line) {
+            static const char hex[] = "0123456789ABCDEF";
+            char buf[128];
+            char *p = buf;
+            std::memcpy(p, line, 19); // The timestamp as written
+            p += 19;
+            *p++ = ',';
+            for (int i = 0; i < 6; i++) {
+                *p++ = hex[r.sensor[i] >> 4];
+                *p++ = hex[r.sensor[i] & 0xF];
+            }
+            *p++ = ',';
+            int32_t temp = r.fields[LOG_FIELD_TEMPERATURE];
+            if (temp < 0) *p++ = '-';
+            uint32_t magnitude = static_cast<uint32_t>(temp < 0 ? -temp : temp);
+            p = put_uint(p, magnitude / 10);
+            *p++ = '.';
+            *p++ = static_cast<char>('0' + magnitude % 10);
+            for (int f = LOG_FIELD_LIGHT; f < LOG_ARCHIVE_NUM_FIELDS; f++) {
+                *p++ = ',';
+                p = put_uint(p, static_cast<uint32_t>(r.fields[f]));
+            }
+            *p++ = '\n';
+            out.insert(out.end(), buf, p);
+        });
+    } else {
+        out_path += ".mfa";
+        std::vector<log_record_t> records;
+        records.reserve(in.size() / 100);
+        parse_log(in.data(), in.size(), stats, [&](const log_record_t &r, const char *) { records.push_back(r); });
+        std::vector<uint8_t> archive = encode_archive(records);
+        out.assign(archive.begin(), archive.end());
+    }
+
+    std::ofstream file(out_path, std::ios::binary);
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    if (!file) {
+        std::fprintf(stderr, "%s: cannot write\n", out_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Runs work(file_index, stats) over all files on `threads` workers and sums the stats.
+template <typename Work>
+IngestStats run_parallel(size_t file_count, unsigned threads, Work &&work) {
+    std::atomic<size_t> next{0};
+    std::vector<IngestStats> per_thread(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (size_t i = next++; i < file_count; i = next++) work(i, per_thread[t]);
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    IngestStats total;
+    for (const auto &s : per_thread) {
+        total.bytes += s.bytes;
+        total.readings += s.readings;
+        total.bad_lines += s.bad_lines;
+        total.fallback_lines += s.fallback_lines;
+    }
+    return total;
+}
+
+// --- Commands ---
+
+int cmd_convert(const std::vector<std::string> &files, const std::string &out_dir, Format format, unsigned threads) {
+    std::filesystem::create_directories(out_dir);
+    std::atomic<bool> failed{false};
+    auto start = std::chrono::steady_clock::now();
+    IngestStats stats = run_parallel(files.size(), threads, [&](size_t i, IngestStats &s) {
+        if (!convert_file(files[i], out_dir, format, s)) failed = true;
+    });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::printf("%zu files, %zu readings, %zu bad lines, %.1f MB in %.3f s (%.2f GB/s, %u threads)\n",
+                files.size(), stats.readings, stats.bad_lines, stats.bytes / 1e6, elapsed.count(),
+                stats.bytes / elapsed.count() / 1e9, threads);
+    return failed ? 1 : 0;
+}
+
+// Runs fn repeatedly for at least 500 ms and returns seconds per run.
+template <typename Fn>
+double time_per_run(Fn fn) {
+    using clock = std::chrono::steady_clock;
+    size_t runs = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        fn();
+        runs++;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < 0.5);
+    return elapsed.count() / static_cast<double>(runs);
+}
+
+// Order-independent digest of parsed readings, to check both parsers agree.
+struct Digest {
+    uint64_t sum = 0;
+    size_t count = 0;
+    void add(const log_record_t &r) {
+        uint64_t h = r.time;
+        for (int f = 0; f < LOG_ARCHIVE_NUM_FIELDS; f++) h = h * 1000003u + static_cast<uint32_t>(r.fields[f]);
+        for (int i = 0; i < 6; i++) h = h * 31u + r.sensor[i];
+        sum += h;
+        count++;
+    }
+};
+
+int cmd_bench(const std::vector<std::string> &files, unsigned threads) {
+    size_t total_bytes = 0;
+    for (const auto &f : files) {
+        MappedFile m(f);
+        if (!m.ok()) {
+            std::fprintf(stderr, "%s: cannot map\n", f.c_str());
+            return 1;
+        }
+        total_bytes += m.size(); // Also warms the page cache
+    }
+
+    // Baseline: getline + the generic per-line parser
+    Digest naive;
+    double naive_s = time_per_run([&] {
+        naive = Digest{};
+        for (const auto &f : files) {
+            std::ifstream in(f);
+            std::string line;
+            log_record_t r;
+            while (std::getline(in, line)) {
+                if (log_archive_parse_line(line.data(), line.size(), &r)) naive.add(r);
+            }
+        }
+    });
+
+    auto fast_pass = [&](unsigned n, Digest &digest) {
+        std::vector<Digest> per_file(files.size());
+        run_parallel(files.size(), n, [&](size_t i, IngestStats &s) {
+            MappedFile m(files[i]);
+            parse_log(m.data(), m.size(), s, [&](const log_record_t &r, const char *) { per_file[i].add(r); });
+        });
+        digest = Digest{};
+        for (const auto &d : per_file) {
+            digest.sum += d.sum;
+            digest.count += d.count;
+        }
+    };
+    Digest single, parallel;
+    double single_s = time_per_run([&] { fast_pass(1, single); });
+    double parallel_s = time_per_run([&] { fast_pass(threads, parallel); });
+
+    if (single.sum != naive.sum || single.count != naive.count || parallel.sum != naive.sum) {
+        std::fprintf(stderr, "parsers disagree: %zu vs %zu readings\n", naive.count, single.count);
+        return 1;
+    }
+
+    const double gb = total_bytes / 1e9;
+    std::printf("input:               %zu files, %.1f MB, %zu readings\n", files.size(), total_bytes / 1e6, naive.count);
+    std::printf("getline + generic:   %.3f GB/s\n", gb / naive_s);
+    std::printf("mmap + SIMD, 1 thr:  %.3f GB/s (%.1fx)\n", gb / single_s, naive_s / single_s);
+    std::printf("mmap + SIMD, %u thr: %.3f GB/s (%.1fx)\n", threads, gb / parallel_s, naive_s / parallel_s);
+    return 0;
+}
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: miflora_ingest [-j threads] [-f csv|mfa] -o <out-dir> <day.txt>...\n"
+                 "       miflora_ingest bench [-j threads] <day.txt>...\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    bool bench = argc > 1 && std::strcmp(argv[1], "bench") == 0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    Format format = Format::Csv;
+    std::string out_dir;
+    std::vector<std::string> files;
+
+    for (int i = bench ? 2 : 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "-f" && i + 1 < argc) {
+            std::string f = argv[++i];
+            if (f != "csv" && f != "mfa") {
+                usage();
+                return 2;
+            }
+            format = f == "csv" ? Format::Csv : Format::Archive;
+        } else if (arg == "-o" && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty() || (!bench && out_dir.empty())) {
+        usage();
+        return 2;
+    }
+    return bench ? cmd_bench(files, threads) : cmd_convert(files, out_dir, format, threads);
+}
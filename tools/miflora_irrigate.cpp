@@ -0,0 +1,195 @@
+// miflora_irrigate: run the firmware's watering controller over recorded logs.
+//
+// Usage:
+//   miflora_irrigate replay [-q] [setting=value]... <day.txt>...
+//
+// replay feeds every reading of the daily logs, in time order, through the
+// controllers of irrigation.c. It prints each decision as the firmware writes
+// it to IRRIGATE.CSV, then a summary per sensor. Sensors get indexes in the
+// order they first appear. -q prints only the summary.
+//
+// The settings are the IRRIGATE ones (low, high, soak_min, horizon_min,
+// min_ms, max_ms, daily_ms), plus a model of how the soil answers the pump.
+// A recorded log does not show the water the controller would have given,
+// so each run adds "response" hundredths of % per pump second to the
+// recorded moisture. The rise builds up over "lag_min" minutes and then
+// fades with a time constant of "decay_h" hours. With response=0 the replay
+// is open loop: the recorded values are used as they are, and the runs
+// bring no rise.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "irrigation.h"
+#include "log_archive.h"
+
+namespace {
+
+struct Reading {
+    uint32_t time;
+    int sensor;
+    uint8_t moisture;
+};
+
+struct Run {
+    uint32_t time;
+    uint32_t run_ms;
+};
+
+struct Model {
+    double response = IRRIGATION_INITIAL_GAIN; // Hundredths of % per pump second
+    double lag_min = 30;
+    double decay_h = 48;
+};
+
+struct Summary {
+    uint8_t addr[6] = {};
+    int readings = 0;
+    int runs = 0;
+    uint64_t pump_ms = 0;
+    int below_low = 0; // Readings at or below low, after the model
+    int min_moisture = 100;
+    int reasons[IRRIGATION_NUM_REASONS] = {};
+};
+
+bool set_model(Model &model, const char *setting) {
+    const char *equals = std::strchr(setting, '=');
+    if (!equals) return false;
+    std::string name(setting, equals);
+    char *end;
+    double value = std::strtod(equals + 1, &end);
+    if (*end != '\0' || value < 0) return false;
+    if (name == "response") model.response = value;
+    else if (name == "lag_min") model.lag_min = value;
+    else if (name == "decay_h") model.decay_h = value;
+    else return false;
+    return true;
+}
+
+// Moisture a run adds, in %, some seconds after it started
+double run_effect(const Model &model, const Run &run, double seconds) {
+    double full = run.run_ms / 1000.0 * model.response / 100.0;
+    double lag_s = model.lag_min * 60;
+    if (seconds < lag_s) return full * seconds / lag_s;
+    return model.decay_h > 0 ? full * std::exp(-(seconds - lag_s) / (model.decay_h * 3600)) : full;
+}
+
+bool load_logs(const std::vector<const char *> &paths, std::vector<Reading> &readings,
+               std::vector<Summary> &sensors) {
+    for (const char *path : paths) {
+        std::ifstream in(path);
+        if (!in) {
+            std::fprintf(stderr, "cannot open %s\n", path);
+            return false;
+        }
+        std::string line;
+        log_record_t record;
+        while (std::getline(in, line)) {
+            if (!log_archive_parse_line(line.c_str(), line.size(), &record)) continue;
+            size_t s = 0;
+            while (s < sensors.size() && std::memcmp(sensors[s].addr, record.sensor, 6) != 0) s++;
+            if (s == sensors.size()) {
+                if (sensors.size() == IRRIGATION_MAX_SENSORS) continue;
+                sensors.emplace_back();
+                std::memcpy(sensors.back().addr, record.sensor, 6);
+            }
+            int32_t moisture = record.fields[LOG_FIELD_MOISTURE];
+            readings.push_back({ record.time, (int)s, (uint8_t)std::clamp(moisture, 0, 100) });
+        }
+    }
+    std::stable_sort(readings.begin(), readings.end(),
+                     [](const Reading &a, const Reading &b) { return a.time < b.time; });
+    return true;
+}
+
+int cmd_replay(int argc, char **argv) {
+    irrigation_init();
+    irrigation_set_enabled(true);
+
+    Model model;
+    bool quiet = false;
+    std::vector<const char *> paths;
+    for (int i = 0; i < argc; i++) {
+        if (std::strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        } else if (std::strchr(argv[i], '=')) {
+            if (!irrigation_configure(argv[i]) && !set_model(model, argv[i])) {
+                std::fprintf(stderr, "invalid setting %s\n", argv[i]);
+                return 2;
+            }
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        std::fprintf(stderr, "no logs given\n");
+        return 2;
+    }
+
+    std::vector<Reading> readings;
+    std::vector<Summary> sensors;
+    if (!load_logs(paths, readings, sensors)) return 1;
+
+    std::vector<std::vector<Run>> runs(sensors.size());
+    uint32_t low = irrigation_get_setting(IRRIGATION_SET_LOW);
+    if (!quiet) std::fputs(IRRIGATION_LOG_HEADER, stdout);
+    for (const Reading &r : readings) {
+        double moisture = r.moisture;
+        for (const Run &run : runs[r.sensor]) {
+            if (run.time <= r.time) moisture += run_effect(model, run, r.time - run.time);
+        }
+        uint8_t seen = (uint8_t)std::clamp((int)std::lround(moisture), 0, 100);
+
+        Summary &s = sensors[r.sensor];
+        irrigation_decision_t decision;
+        if (!irrigation_decide(r.sensor, s.addr, r.time, seen, &decision)) continue;
+        s.readings++;
+        s.reasons[decision.reason]++;
+        s.min_moisture = std::min<int>(s.min_moisture, seen);
+        if (seen <= low) s.below_low++;
+        if (decision.run_ms > 0) {
+            s.runs++;
+            s.pump_ms += decision.run_ms;
+            runs[r.sensor].push_back({ r.time, decision.run_ms });
+        }
+        if (!quiet) {
+            char line[128];
+            irrigation_format_decision(&decision, line, sizeof(line));
+            std::fputs(line, stdout);
+        }
+    }
+
+    std::printf("%s%-13s %8s %5s %8s %9s %9s  reasons\n", quiet ? "" : "\n",
+                "sensor", "readings", "runs", "pump_s", "min_pct", "at_low");
+    for (size_t i = 0; i < sensors.size(); i++) {
+        const Summary &s = sensors[i];
+        std::printf("%02X%02X%02X%02X%02X%02X  %8d %5d %8.1f %9d %9d ",
+                    s.addr[0], s.addr[1], s.addr[2], s.addr[3], s.addr[4], s.addr[5],
+                    s.readings, s.runs, s.pump_ms / 1000.0, s.min_moisture, s.below_low);
+        for (int k = 0; k < IRRIGATION_NUM_REASONS; k++) {
+            if (s.reasons[k]) std::printf(" %s=%d", irrigation_reason_name((irrigation_reason_t)k), s.reasons[k]);
+        }
+        const irrigation_sensor_t *c = irrigation_get((int)i);
+        std::printf("%s\n", c && c->fault ? "  FAULT" : "");
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && std::strcmp(argv[1], "replay") == 0) return cmd_replay(argc - 2, argv + 2);
+
+    std::fprintf(stderr,
+                 "usage: %s replay [-q] [setting=value]... <day.txt>...\n"
+                 "  settings: low high soak_min horizon_min min_ms max_ms daily_ms (as IRRIGATE)\n"
+                 "  soil model: response=<0.01%%/s> lag_min=<min> decay_h=<h> (response=0: open loop)\n",
+                 argv[0]);
+    return 2;
+}
@@ -0,0 +1,470 @@
+// miflora_mapsize: static RAM and flash per module from the firmware's linker map.
+//
+// Usage:
+//   miflora_mapsize report <map> [group]
+//   miflora_mapsize check <map> <budget.csv>
+//   miflora_mapsize update <map> <budget.csv>
+//
+// The map is the one the firmware build writes next to the binary
+// (pico_miflora_datalogger.elf.map). Every input section is charged to a
+// group:
+// - a module: one of the firmware's own source files (main.c, sd_logger.c);
+// - a library: a Pico SDK component (hardware_spi, pico_stdio_usb), a
+//   directory under the SDK's lib/ (btstack, cyw43-driver, tinyusb), a
+//   fetched dependency (sd_card_pico) or an archive from the toolchain
+//   (libc_nano.a, libgcc.a).
+// Sections placed in a writable memory region count as RAM. Sections loaded
+// from flash and copied to RAM at boot (.data, .scratch_x) count in both.
+//
+// report prints RAM and flash per group. With a group name it lists that
+// group's sections instead, largest first.
+//
+// check compares the groups and the total against a budget file and fails if
+// any of them grew past its budget. Once the file lists groups besides the
+// total, a group missing from it fails too, so a new module or library can't
+// slip in unbudgeted. The firmware build runs it after every link, so a
+// change that adds RAM or flash has to update the budget in the same commit.
+// update rewrites the budget file with the map's figures.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr const char *kTotal = "total";
+
+struct Region {
+    std::string name;
+    uint64_t origin;
+    uint64_t length;
+    bool writable;
+};
+
+struct Section {
+    std::string name;   // Input section, e.g. .bss.stream_buffer
+    std::string output; // Output section, e.g. .bss
+    uint64_t ram;
+    uint64_t flash;
+};
+
+struct Usage {
+    bool module = false;
+    uint64_t ram = 0;
+    uint64_t flash = 0;
+    std::vector<Section> sections;
+};
+
+struct Budget {
+    uint64_t ram;
+    uint64_t flash;
+};
+
+struct MapFile {
+    std::vector<Region> regions;
+    std::map<std::string, Usage> groups;
+    uint64_t ram = 0;
+    uint64_t flash = 0;
+    uint64_t ram_size = 0;
+    uint64_t flash_size = 0;
+};
+
+bool starts_with(const std::string &s, const char *prefix) {
+    return s.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+std::string basename_of(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// First path component after marker, or "" if marker is not in path
+std::string component_after(const std::string &path, const char *marker) {
+    size_t at = path.find(marker);
+    if (at == std::string::npos) return "";
+    at += std::strlen(marker);
+    return path.substr(at, path.find('/', at) - at);
+}
+
+/**
+ * @brief Group an object file from the map: a firmware module or a library.
+ */
+std::string group_of(const std::string &file, bool &module) {
+    module = false;
+    if (file == "linker stubs") return "(linker)";
+
+    // Archive member: /path/libc_nano.a(lib_a-memcpy.o)
+    size_t paren = file.find(".a(");
+    if (paren != std::string::npos) return basename_of(file.substr(0, paren + 2));
+
+    // Objects of the firmware target. CMake keeps the path of sources outside
+    // the project below the target's directory.
+    std::string path = file;
+    size_t dir = path.find(".dir/");
+    if (dir != std::string::npos) path = path.substr(dir + 5);
+    if (path.find('/') == std::string::npos) {
+        module = true;
+        for (const char *ext : { ".obj", ".o" }) {
+            size_t n = std::strlen(ext);
+            if (path.size() > n && path.compare(path.size() - n, n, ext) == 0) return path.substr(0, path.size() - n);
+        }
+        return path;
+    }
+
+    std::string name = component_after(path, "/_deps/");
+    if (!name.empty()) {
+        size_t src = name.rfind("-src");
+        return src == std::string::npos ? name : name.substr(0, src);
+    }
+    for (const char *marker : { "/lib/", "/src/rp2_common/", "/src/common/", "/src/rp2040/", "/src/rp2350/" }) {
+        name = component_after(path, marker);
+        if (!name.empty()) return name;
+    }
+    return basename_of(path.substr(0, path.find_last_of('/')));
+}
+
+bool parse_hex(const std::string &token, uint64_t &value) {
+    if (!starts_with(token, "0x")) return false;
+    char *end = nullptr;
+    value = std::strtoull(token.c_str() + 2, &end, 16);
+    return end != token.c_str() + 2 && *end == '\0';
+}
+
+std::vector<std::string> split(const std::string &line) {
+    std::istringstream in(line);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (in >> token) tokens.push_back(token);
+    return tokens;
+}
+
+// Rest of the line after the first n whitespace-separated tokens
+std::string rest_after(const std::string &line, int n) {
+    size_t at = 0;
+    for (int i = 0; i < n; i++) {
+        at = line.find_first_not_of(" \t", at);
+        at = line.find_first_of(" \t", at);
+        if (at == std::string::npos) return "";
+    }
+    at = line.find_first_not_of(" \t", at);
+    return at == std::string::npos ? "" : line.substr(at);
+}
+
+// Zero-filled or uninitialised at boot: nothing to load from flash, even when
+// ld prints a load address for the output section (it does after .data)
+bool is_unloaded(const std::string &name) {
+    for (const char *prefix : { ".bss", ".sbss", ".tbss", "COMMON", ".heap", ".stack", ".uninitialized", ".noinit",
+                                ".ram_vector_table" }) {
+        if (starts_with(name, prefix)) return true;
+    }
+    return false;
+}
+
+const Region *region_at(const MapFile &map, uint64_t address) {
+    for (const Region &r : map.regions) {
+        if (address >= r.origin && address - r.origin < r.length) return &r;
+    }
+    return nullptr;
+}
+
+void add_section(MapFile &map, const std::string &name, const std::string &output, bool loaded,
+                 uint64_t address, uint64_t size, const std::string &file) {
+    const Region *region = region_at(map, address);
+    if (size == 0 || !region) return;
+
+    Section s = { name, output, 0, 0 };
+    if (region->writable) {
+        s.ram = size;
+        // Initial values, copied from flash at boot
+        if (loaded && !is_unloaded(output) && !is_unloaded(name)) s.flash = size;
+    } else {
+        s.flash = size;
+    }
+
+    bool module = false;
+    std::string group = name == "*fill*" ? "(fill)" : group_of(file, module);
+    Usage &usage = map.groups[group];
+    usage.module = module;
+    usage.ram += s.ram;
+    usage.flash += s.flash;
+    usage.sections.push_back(s);
+    map.ram += s.ram;
+    map.flash += s.flash;
+}
+
+/**
+ * @brief Read a GNU ld map: the memory regions, then every input section of
+ * the memory map. Long section names put the address, size and file on the
+ * next line.
+ */
+bool load_map(const char *path, MapFile &map) {
+    std::ifstream in(path);
+    if (!in) {
+        std::fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    enum { PREAMBLE, MEMORY, LAYOUT } part = PREAMBLE;
+    std::string line;
+    std::string output;         // Current output section
+    bool loaded = false;        // It has a load address in flash
+    std::string pending_output; // Output section name waiting for its address line
+    std::string pending_input;  // Input section name waiting for its address line
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (starts_with(line, "Memory Configuration")) {
+            part = MEMORY;
+            continue;
+        }
+        if (starts_with(line, "Linker script and memory map")) {
+            part = LAYOUT;
+            continue;
+        }
+
+        std::vector<std::string> tokens = split(line);
+        if (part == MEMORY) {
+            Region r;
+            if (tokens.size() >= 3 && tokens[0] != "*default*" && parse_hex(tokens[1], r.origin) &&
+                parse_hex(tokens[2], r.length)) {
+                r.name = tokens[0];
+                r.writable = tokens.size() > 3 && tokens[3].find('w') != std::string::npos;
+                map.regions.push_back(r);
+                (r.writable ? map.ram_size : map.flash_size) += r.length;
+            }
+            continue;
+        }
+        if (part != LAYOUT || tokens.empty()) continue;
+
+        if (!pending_output.empty()) {
+            output = pending_output;
+            loaded = line.find("load address") != std::string::npos;
+            pending_output.clear();
+            continue;
+        }
+
+        uint64_t address = 0, size = 0;
+        if (!pending_input.empty()) {
+            if (tokens.size() >= 2 && parse_hex(tokens[0], address) && parse_hex(tokens[1], size)) {
+                add_section(map, pending_input, output, loaded, address, size, rest_after(line, 2));
+            }
+            pending_input.clear();
+            continue;
+        }
+
+        // Output section: starts in the first column
+        if (line[0] != ' ') {
+            if (tokens[0][0] == '.' || tokens[0] == "/DISCARD/") {
+                if (tokens.size() == 1) {
+                    pending_output = tokens[0];
+                } else {
+                    output = tokens[0];
+                    loaded = line.find("load address") != std::string::npos;
+                }
+            } else {
+                output.clear();
+            }
+            continue;
+        }
+
+        // Input section: one space of indent. Deeper lines are symbols and
+        // assignments; "*(" lines are the linker script's patterns.
+        if (line[1] == ' ' || output.empty() || output == "/DISCARD/") continue;
+        const std::string &name = tokens[0];
+        if (name != "*fill*" && name[0] != '.' && name != "COMMON") continue;
+        if (tokens.size() == 1) {
+            pending_input = name;
+        } else if (tokens.size() >= 3 && parse_hex(tokens[1], address) && parse_hex(tokens[2], size)) {
+            add_section(map, name, output, loaded, address, size, name == "*fill*" ? "" : rest_after(line, 3));
+        }
+    }
+
+    if (map.regions.empty()) {
+        std::fprintf(stderr, "%s: no memory regions, not a GNU ld map of the firmware?\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool load_budget(const char *path, std::map<std::string, Budget> &budget, std::vector<std::string> *comments) {
+    std::ifstream in(path);
+    if (!in) {
+        std::fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') {
+            if (comments && !line.empty()) comments->push_back(line);
+            continue;
+        }
+        char name[128];
+        unsigned long long ram = 0, flash = 0;
+        if (std::sscanf(line.c_str(), "%127[^,],%llu,%llu", name, &ram, &flash) != 3) {
+            std::fprintf(stderr, "%s:%d: expected name,ram,flash\n", path, number);
+            return false;
+        }
+        budget[name] = { ram, flash };
+    }
+    return true;
+}
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+// Groups of one kind, most RAM first
+std::vector<const std::pair<const std::string, Usage> *> sorted_groups(const MapFile &map, bool modules) {
+    std::vector<const std::pair<const std::string, Usage> *> out;
+    for (const auto &g : map.groups) {
+        if (g.second.module == modules) out.push_back(&g);
+    }
+    std::sort(out.begin(), out.end(), [](auto *a, auto *b) {
+        if (a->second.ram != b->second.ram) return a->second.ram > b->second.ram;
+        return a->second.flash > b->second.flash;
+    });
+    return out;
+}
+
+int cmd_report(const char *path, const char *group) {
+    MapFile map;
+    if (!load_map(path, map)) return 1;
+
+    if (group) {
+        auto it = map.groups.find(group);
+        if (it == map.groups.end()) {
+            std::fprintf(stderr, "no sections of %s in the map\n", group);
+            return 1;
+        }
+        std::vector<Section> sections = it->second.sections;
+        std::sort(sections.begin(), sections.end(), [](const Section &a, const Section &b) {
+            return a.ram + a.flash > b.ram + b.flash;
+        });
+        std::printf("%-48s %-18s %8s %8s\n", group, "output", "RAM", "flash");
+        for (const Section &s : sections) {
+            std::printf("%-48s %-18s %8" PRIu64 " %8" PRIu64 "\n", s.name.c_str(), s.output.c_str(), s.ram, s.flash);
+        }
+        std::printf("%-48s %-18s %8" PRIu64 " %8" PRIu64 "\n", kTotal, "", it->second.ram, it->second.flash);
+        return 0;
+    }
+
+    std::printf("RAM %" PRIu64 " of %" PRIu64 " bytes (%.1f%%), flash %" PRIu64 " of %" PRIu64 " bytes (%.1f%%)\n",
+                map.ram, map.ram_size, percent(map.ram, map.ram_size),
+                map.flash, map.flash_size, percent(map.flash, map.flash_size));
+    for (bool modules : { true, false }) {
+        std::printf("\n%-28s %8s %8s\n", modules ? "module" : "library", "RAM", "flash");
+        for (auto *g : sorted_groups(map, modules)) {
+            std::printf("%-28s %8" PRIu64 " %8" PRIu64 "\n", g->first.c_str(), g->second.ram, g->second.flash);
+        }
+    }
+    return 0;
+}
+
+int cmd_check(const char *map_path, const char *budget_path) {
+    MapFile map;
+    std::map<std::string, Budget> budget;
+    if (!load_map(map_path, map) || !load_budget(budget_path, budget, nullptr)) return 1;
+
+    std::map<std::string, Budget> actual;
+    for (const auto &g : map.groups) actual[g.first] = { g.second.ram, g.second.flash };
+    actual[kTotal] = { map.ram, map.flash };
+
+    // A budget with only the total has not recorded the groups yet
+    const bool per_group = budget.size() > (budget.count(kTotal) ? 1u : 0u);
+    int over = 0, unbudgeted = 0, under = 0;
+    for (const auto &a : actual) {
+        auto b = budget.find(a.first);
+        if (b == budget.end()) {
+            std::printf("memory budget: %s is not in the budget (RAM %" PRIu64 ", flash %" PRIu64 ")\n",
+                        a.first.c_str(), a.second.ram, a.second.flash);
+            unbudgeted++;
+            continue;
+        }
+        const struct { const char *what; uint64_t used, limit; } checks[] = {
+            { "RAM", a.second.ram, b->second.ram },
+            { "flash", a.second.flash, b->second.flash },
+        };
+        for (const auto &c : checks) {
+            if (c.used > c.limit) {
+                std::printf("memory budget: %s %s %" PRIu64 " > %" PRIu64 " (+%" PRIu64 ")\n",
+                            a.first.c_str(), c.what, c.used, c.limit, c.used - c.limit);
+                over++;
+            } else if (c.used < c.limit) {
+                under++;
+            }
+        }
+    }
+    for (const auto &b : budget) {
+        if (!actual.count(b.first)) std::printf("memory budget: %s is no longer in the map\n", b.first.c_str());
+    }
+
+    std::printf("memory budget: RAM %" PRIu64 " (%.1f%%), flash %" PRIu64 " (%.1f%%), %d over, %d not budgeted\n",
+                map.ram, percent(map.ram, map.ram_size), map.flash, percent(map.flash, map.flash_size),
+                over, unbudgeted);
+    if (over > 0 || (per_group && unbudgeted > 0)) {
+        std::printf("memory budget: if the growth is intended, run\n"
+                    "  miflora_mapsize update %s %s\n"
+                    "and commit the budget with the change\n",
+                    map_path, budget_path);
+        return 1;
+    }
+    if (under > 0 || unbudgeted > 0) {
+        std::printf("memory budget: run miflora_mapsize update to record the current figures\n");
+    }
+    return 0;
+}
+
+int cmd_update(const char *map_path, const char *budget_path) {
+    MapFile map;
+    if (!load_map(map_path, map)) return 1;
+
+    // Keep the file's comment header, if there is one
+    std::map<std::string, Budget> old;
+    std::vector<std::string> comments;
+    {
+        std::ifstream exists(budget_path);
+        if (exists && !load_budget(budget_path, old, &comments)) return 1;
+    }
+
+    std::ofstream out(budget_path, std::ios::trunc);
+    if (!out) {
+        std::fprintf(stderr, "cannot write %s\n", budget_path);
+        return 1;
+    }
+    for (const std::string &c : comments) out << c << '\n';
+    out << kTotal << ',' << map.ram << ',' << map.flash << '\n';
+    for (bool modules : { true, false }) {
+        for (const auto &g : map.groups) {
+            if (g.second.module == modules) out << g.first << ',' << g.second.ram << ',' << g.second.flash << '\n';
+        }
+    }
+    std::printf("%s: %zu groups, RAM %" PRIu64 ", flash %" PRIu64 "\n", budget_path, map.groups.size(), map.ram, map.flash);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if ((argc == 3 || argc == 4) && std::strcmp(argv[1], "report") == 0) {
+        return cmd_report(argv[2], argc == 4 ? argv[3] : nullptr);
+    }
+    if (argc == 4 && std::strcmp(argv[1], "check") == 0) return cmd_check(argv[2], argv[3]);
+    if (argc == 4 && std::strcmp(argv[1], "update") == 0) return cmd_update(argv[2], argv[3]);
+
+    std::fprintf(stderr,
+                 "usage: %s report <map> [group]\n"
+                 "       %s check <map> <budget.csv>\n"
+                 "       %s update <map> <budget.csv>\n",
+                 argv[0], argv[0], argv[0]);
+    return 2;
+}
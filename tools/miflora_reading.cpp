@@ -0,0 +1,200 @@
+// miflora_reading: decode live-reading packets and benchmark reading encoders.
+//
+// Usage:
+//   miflora_reading decode <hex>...
+//   miflora_reading bench
+//
+// decode turns 0xAAA4 notifications (as hex, e.g. copied from a BLE sniffer
+// app) into log-style lines, using the field layout from reading_schema.h.
+//
+// bench compares the per-reading cost of the encoders generated from the
+// schema (fixed point, no float formatting) with the float + printf path the
+// firmware used before: text log line and live packet.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "reading_schema.h"
+
+namespace {
+
+const size_t kLivePacketSize = READING_PACKED_SIZE + 8; // Values, date/time, sensor index (more than one sensor)
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+int cmd_decode(int argc, char **argv) {
+    for (int i = 0; i < argc; i++) {
+        std::vector<uint8_t> packet;
+        for (const char *p = argv[i]; *p; p++) {
+            if (*p == ':' || *p == ' ' || *p == '-') continue;
+            int hi = hex_value(p[0]), lo = p[1] ? hex_value(p[1]) : -1;
+            if (hi < 0 || lo < 0) {
+                std::fprintf(stderr, "%s: not a hex string\n", argv[i]);
+                return 1;
+            }
+            packet.push_back(static_cast<uint8_t>(hi << 4 | lo));
+            p++;
+        }
+        if (packet.size() != kLivePacketSize && packet.size() != kLivePacketSize - 1) {
+            std::fprintf(stderr, "%s: expected %zu or %zu bytes, got %zu\n", argv[i], kLivePacketSize - 1,
+                         kLivePacketSize, packet.size());
+            return 1;
+        }
+
+        reading_values_t values;
+        reading_unpack(&values, packet.data());
+        int32_t fields[READING_NUM_FIELDS];
+        reading_to_array(&values, fields);
+        char text[READING_TEXT_MAX];
+        reading_format_text(fields, text);
+
+        const uint8_t *t = packet.data() + READING_PACKED_SIZE;
+        std::printf("%04d-%02d-%02dT%02d:%02d:%02d%s", t[0] | t[1] << 8, t[2], t[3], t[4], t[5], t[6], text);
+        if (packet.size() == kLivePacketSize) std::printf(",SensorIndex:%u", t[7]);
+        std::printf("\n");
+    }
+    return 0;
+}
+
+// --- Encoders as the firmware had them before the schema ---
+
+struct LegacyReading {
+    float temperature;
+    uint32_t light;
+    uint8_t moisture;
+    uint16_t conductivity;
+    uint8_t battery;
+};
+
+size_t legacy_format_line(const LegacyReading &r, const char *timestamp, const uint8_t *address, char *line,
+                          size_t size) {
+    int n = std::snprintf(line, size,
+                          "%s,Temp:%.1f,Light:%lu,Moisture:%u,Conductivity:%u,Battery:%u,Sensor:%02X%02X%02X%02X%02X%02X",
+                          timestamp, r.temperature, static_cast<unsigned long>(r.light), r.moisture, r.conductivity,
+                          r.battery, address[0], address[1], address[2], address[3], address[4], address[5]);
+    return static_cast<size_t>(n);
+}
+
+void legacy_pack(const LegacyReading &r, uint8_t *out) {
+    int16_t temp_tenths = static_cast<int16_t>(r.temperature * 10.0f + (r.temperature < 0 ? -0.5f : 0.5f));
+    out[0] = static_cast<uint8_t>(temp_tenths);
+    out[1] = static_cast<uint8_t>(temp_tenths >> 8);
+    std::memcpy(out + 2, &r.light, 4);
+    out[6] = r.moisture;
+    out[7] = static_cast<uint8_t>(r.conductivity);
+    out[8] = static_cast<uint8_t>(r.conductivity >> 8);
+    out[9] = r.battery;
+}
+
+// --- Encoders generated from the schema, as the firmware uses them now ---
+
+size_t schema_format_line(const reading_values_t &v, const char *timestamp, const uint8_t *address, char *line,
+                          size_t size) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = std::strlen(timestamp);
+    std::memcpy(line, timestamp, n);
+    int32_t fields[READING_NUM_FIELDS];
+    reading_to_array(&v, fields);
+    n += reading_format_text(fields, line + n);
+    if (n + 8 + 12 + 1 > size) return 0;
+    std::memcpy(line + n, ",Sensor:", 8);
+    n += 8;
+    for (int i = 0; i < 6; i++) {
+        line[n++] = hex[address[i] >> 4];
+        line[n++] = hex[address[i] & 0xF];
+    }
+    line[n] = '\0';
+    return n;
+}
+
+template <typename Fn>
+double ns_per_call(size_t count, Fn fn) {
+    using clock = std::chrono::steady_clock;
+    size_t runs = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        for (size_t i = 0; i < count; i++) fn(i);
+        runs += count;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < 0.3);
+    return elapsed.count() * 1e9 / static_cast<double>(runs);
+}
+
+int cmd_bench() {
+    // Realistic spread of sensor values, each kept in both representations
+    std::mt19937 rng(1);
+    const size_t count = 4096;
+    std::vector<reading_values_t> values(count);
+    std::vector<LegacyReading> legacy(count);
+    for (size_t i = 0; i < count; i++) {
+        reading_values_t &v = values[i];
+        v.temperature = static_cast<int16_t>(std::uniform_int_distribution<int>(-150, 450)(rng));
+        v.light = std::uniform_int_distribution<uint32_t>(0, 100000)(rng);
+        v.moisture = static_cast<uint8_t>(std::uniform_int_distribution<int>(0, 100)(rng));
+        v.conductivity = static_cast<uint16_t>(std::uniform_int_distribution<int>(0, 3000)(rng));
+        v.battery = static_cast<uint8_t>(std::uniform_int_distribution<int>(0, 100)(rng));
+        legacy[i] = {v.temperature / 10.0f, v.light, v.moisture, v.conductivity, v.battery};
+    }
+    const char *timestamp = "2025-10-30T08:30:05";
+    const uint8_t address[6] = {0x5C, 0x85, 0x7E, 0x13, 0x17, 0xF9};
+
+    // Both paths must produce the same bytes
+    char a[256], b[256];
+    uint8_t pa[READING_PACKED_SIZE], pb[READING_PACKED_SIZE];
+    for (size_t i = 0; i < count; i++) {
+        legacy_format_line(legacy[i], timestamp, address, a, sizeof(a));
+        schema_format_line(values[i], timestamp, address, b, sizeof(b));
+        legacy_pack(legacy[i], pa);
+        reading_pack(&values[i], pb);
+        if (std::strcmp(a, b) != 0 || std::memcmp(pa, pb, sizeof(pa)) != 0) {
+            std::fprintf(stderr, "encoders disagree:\n  %s\n  %s\n", a, b);
+            return 1;
+        }
+    }
+
+    size_t sink = 0;
+    double legacy_line = ns_per_call(count, [&](size_t i) {
+        sink += legacy_format_line(legacy[i], timestamp, address, a, sizeof(a));
+    });
+    double schema_line = ns_per_call(count, [&](size_t i) {
+        sink += schema_format_line(values[i], timestamp, address, b, sizeof(b));
+    });
+    double legacy_packet = ns_per_call(count, [&](size_t i) {
+        legacy_pack(legacy[i], pa);
+        sink += pa[0];
+    });
+    double schema_packet = ns_per_call(count, [&](size_t i) {
+        reading_pack(&values[i], pb);
+        sink += pb[0];
+    });
+
+    std::printf("per reading          float + printf   schema (fixed point)\n");
+    std::printf("text log line        %8.1f ns      %8.1f ns  (%.1fx)\n", legacy_line, schema_line,
+                legacy_line / schema_line);
+    std::printf("live packet          %8.1f ns      %8.1f ns  (%.1fx)\n", legacy_packet, schema_packet,
+                legacy_packet / schema_packet);
+    return sink == 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && std::strcmp(argv[1], "decode") == 0) return cmd_decode(argc - 2, argv + 2);
+    if (argc == 2 && std::strcmp(argv[1], "bench") == 0) return cmd_bench();
+
+    std::fprintf(stderr,
+                 "usage: %s decode <hex>...\n"
+                 "       %s bench\n",
+                 argv[0], argv[0]);
+    return 2;
+}
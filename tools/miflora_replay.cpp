@@ -0,0 +1,1222 @@
+// miflora_replay: replay an HCI capture through the firmware's event handlers.
+//
+// Usage:
+//   miflora_replay run <HCI.LOG> <sensor-mac>...
+//   miflora_replay bench <HCI.LOG> <sensor-mac>...
+//   miflora_replay simulate [missing]
+//   miflora_replay check
+//
+// The capture is the BTSnoop file written by the firmware's capture mode
+// (hci_capture.h, "CAPTURE:ON"). The firmware's router (hci_events.c), MiFlora
+// client and BLE server are linked in unchanged; BTstack itself is replaced by
+// fakes that record what the firmware asks the radio to do. Each captured
+// packet is handed over at its captured time on a simulated clock, so the
+// state machines, their timeouts and the scheduler run exactly as often and in
+// the same order on every replay:
+//   - events go to the handler that received them on the device: GATT client
+//     events to the callback of the last GATT request, ATT server events to
+//     the ATT packet handler, everything else to the HCI event handler;
+//   - ATT writes from the phone (in ACL packets) go to the ATT write callback;
+//   - the device starting a scan while the client is idle marks a log cycle
+//     (main.c's timer), which starts the client.
+// Pass the sensor MAC addresses the device was built with (main.c).
+//
+// run prints a transcript: packets handed over (<), calls into the fake
+// BTstack (>), the firmware's own output and its trace events, all on the
+// capture's clock. It is the same for the same capture and firmware, so keep
+// the transcript of a known-good capture and diff against it after changes.
+//
+// bench replays silently and reports the time spent in the firmware's
+// handlers per event type, without the radio and USB in the way.
+//
+// simulate needs no capture: the fake BTstack plays the radio itself, with
+// MiFloras that advertise, accept connections and answer GATT requests after
+// realistic delays. It runs one poll cycle over 8, 16 and 32 sensors, reading
+// one sensor at a time and with overlapped connections, and reports the
+// simulated cycle time of each. The last [missing] sensors never advertise,
+// (spread over the list), so their reads run into the scan timeout. It then
+// runs the same cycles while a phone downloads a large day file (GET) over a
+// second link, and reports the cycle time next to the idle one and the rate
+// the phone got. The phone's notifications take the radio for a millisecond
+// each, up to 4 per connection event; sensor packets due meanwhile wait, and
+// advertisements sent meanwhile are missed.
+//
+// check runs the same simulation with a sensor that stops answering in each
+// state of the client (MIFLORA_*_TIMEOUT_MS). For each state it checks that
+// the state's deadline ends the wait: the cycle ends within a few responses
+// after it, and sensor_health.c has recorded the failure. It prints OK or
+// FAILED and sets the exit status.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "btstack.h"
+#include "btsnoop.h"
+#include "hci_events.h"
+#include "miflora_client.h"
+#include "ble_server.h"
+#include "energy_profile.h"
+#include "log_store.h"
+#include "scheduler.h"
+#include "time_util.h"
+#include "trace.h"
+#include "warm_restart.h"
+#include "boot_profile.h"
+#include "stack_probe.h"
+#include "irrigation.h"
+#include "clock_drift.h"
+#include "sensor_health.h"
+#include "f_util.h"
+#include "hardware/rtc.h"
+#include "datalogger.h" // Generated from datalogger.gatt
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const uint16_t kOpcodeLeSetScanEnable = 0x200C;
+const uint16_t kL2capCidAtt = 0x0004;
+const uint8_t kAttWriteRequest = 0x12;
+const uint8_t kAttWriteCommand = 0x52;
+
+// --- Simulated Device ---
+uint64_t now_us = 0;
+bool run_requested = false;
+uint64_t run_at_us = 0;
+bool quiet = false;
+
+btstack_packet_handler_t hci_handler = nullptr;
+btstack_packet_handler_t att_handler = nullptr;
+btstack_packet_handler_t gatt_callback = nullptr;
+att_write_callback_t att_write = nullptr;
+
+bool rtc_set = false;
+uint32_t rtc_epoch = 0;
+uint64_t rtc_set_at_us = 0;
+
+btstack_packet_callback_registration_t hci_registration;
+
+void action(const char *format, ...) {
+    if (quiet) return;
+    std::printf("[%4lu.%06lu] > ", (unsigned long)(now_us / 1000000u), (unsigned long)(now_us % 1000000u));
+    va_list args;
+    va_start(args, format);
+    std::vprintf(format, args);
+    va_end(args);
+    std::printf("\n");
+}
+
+void input(const char *format, ...) {
+    if (quiet) return;
+    std::printf("[%4lu.%06lu] < ", (unsigned long)(now_us / 1000000u), (unsigned long)(now_us % 1000000u));
+    va_list args;
+    va_start(args, format);
+    std::vprintf(format, args);
+    va_end(args);
+    std::printf("\n");
+}
+
+std::string addr_text(const uint8_t *addr) {
+    char text[18];
+    std::snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X",
+                  addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
+    return text;
+}
+
+// Runs the scheduler tasks that fall due up to the given time
+void advance_to(uint64_t time_us) {
+    while (run_requested && run_at_us <= time_us) {
+        if (run_at_us > now_us) now_us = run_at_us;
+        run_requested = false;
+        scheduler_run();
+        if (!quiet) trace_drain(1 << 30);
+    }
+    if (time_us > now_us) now_us = time_us;
+}
+
+// --- Capture ---
+
+struct Record {
+    btsnoop_record_t header;
+    std::vector<uint8_t> data; // H4 type byte, then the packet
+};
+
+bool load_capture(const char *path, std::vector<Record> &records) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!btsnoop_check_file_header(file.data(), file.size())) {
+        std::fprintf(stderr, "%s: not a BTSnoop H4 capture\n", path);
+        return false;
+    }
+    size_t pos = BTSNOOP_FILE_HEADER_SIZE;
+    while (pos + BTSNOOP_RECORD_HEADER_SIZE <= file.size()) {
+        Record record;
+        btsnoop_read_record_header(&record.header, file.data() + pos);
+        pos += BTSNOOP_RECORD_HEADER_SIZE;
+        if (record.header.included_length == 0 || pos + record.header.included_length > file.size()) break;
+        record.data.assign(file.begin() + pos, file.begin() + pos + record.header.included_length);
+        pos += record.header.included_length;
+        records.push_back(std::move(record));
+    }
+    if (pos != file.size()) {
+        std::fprintf(stderr, "%s: %zu bytes of a torn record at the end ignored\n", path, file.size() - pos);
+    }
+    return true;
+}
+
+// --- Replay ---
+
+struct Stats {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+struct Replay {
+    std::map<std::string, Stats> cost; // Per event type
+    size_t delivered = 0;
+    size_t truncated = 0;
+    size_t cycles = 0;
+    uint32_t drops = 0;
+};
+
+void timed(Replay &replay, const std::string &kind, btstack_packet_handler_t handler, uint8_t *packet, uint16_t size) {
+    auto start = Clock::now();
+    handler(HCI_EVENT_PACKET, 0, packet, size);
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    Stats &stats = replay.cost[kind];
+    stats.count++;
+    stats.total_ns += ns;
+    if (ns > stats.max_ns) stats.max_ns = ns;
+    replay.delivered++;
+}
+
+void deliver_event(Replay &replay, uint8_t *packet, uint16_t size) {
+    char kind[32];
+    uint8_t code = packet[0];
+    if (code >= GATT_EVENT_QUERY_COMPLETE && code < ATT_EVENT_CONNECTED) {
+        std::snprintf(kind, sizeof(kind), "gatt 0x%02x", code);
+        input("%s", kind);
+        if (gatt_callback) timed(replay, kind, gatt_callback, packet, size);
+    } else if (code >= ATT_EVENT_CONNECTED && code <= 0xBF) {
+        std::snprintf(kind, sizeof(kind), "att 0x%02x", code);
+        input("%s", kind);
+        if (att_handler) timed(replay, kind, att_handler, packet, size);
+    } else {
+        if (code == HCI_EVENT_LE_META && size > 2) {
+            std::snprintf(kind, sizeof(kind), "hci 0x%02x/%02x", code, packet[2]);
+        } else {
+            std::snprintf(kind, sizeof(kind), "hci 0x%02x", code);
+        }
+        input("%s", kind);
+        if (hci_handler) timed(replay, kind, hci_handler, packet, size);
+    }
+}
+
+// ACL: handle + flags, length, then L2CAP length, channel and the ATT PDU
+void deliver_acl(Replay &replay, uint8_t *packet, uint16_t size) {
+    if (size < 11) return;
+    uint16_t handle_flags = little_endian_read_16(packet, 0);
+    if (((handle_flags >> 12) & 0x03) == 0x01) return; // Continuation fragment
+    if (little_endian_read_16(packet, 6) != kL2capCidAtt) return;
+    uint8_t opcode = packet[8];
+    if ((opcode != kAttWriteRequest && opcode != kAttWriteCommand) || !att_write) return;
+
+    hci_con_handle_t con_handle = handle_flags & 0x0FFF;
+    uint16_t att_handle = little_endian_read_16(packet, 9);
+    uint16_t value_size = (uint16_t)(size - 11);
+    input("ATT write 0x%04x, %u bytes", att_handle, value_size);
+
+    auto start = Clock::now();
+    att_write(con_handle, att_handle, ATT_TRANSACTION_MODE_NONE, 0, packet + 11, value_size);
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    Stats &stats = replay.cost["att_write"];
+    stats.count++;
+    stats.total_ns += ns;
+    if (ns > stats.max_ns) stats.max_ns = ns;
+    replay.delivered++;
+}
+
+// The device's own scan start marks a log cycle when the client is idle
+void check_command(Replay &replay, const uint8_t *packet, uint16_t size) {
+    if (size < 4 || little_endian_read_16(packet, 0) != kOpcodeLeSetScanEnable || packet[3] != 1) return;
+    if (miflora_client_get_state() != FLORA_IDLE) return;
+    input("log cycle (device started a scan)");
+    replay.cycles++;
+    miflora_client_start();
+}
+
+void stack_ready(void) {
+    // main.c arms its log cycle timer here; the capture shows when it fired
+}
+
+void poll_cycle_complete(void) {
+    action("poll cycle complete");
+}
+
+void init_firmware(const std::vector<std::string> &macs, void (*cycle_complete_handler)(void)) {
+    std::vector<const char *> mac_strings;
+    for (const std::string &mac : macs) mac_strings.push_back(mac.c_str());
+
+    // Same order as main()
+    energy_profile_init();
+    clock_drift_init();
+    miflora_client_init(mac_strings.data(), (int)mac_strings.size(), cycle_complete_handler);
+    ble_server_init(hci_events_packet_handler);
+    hci_events_init(stack_ready);
+    hci_registration.callback = &hci_events_packet_handler;
+    hci_add_event_handler(&hci_registration);
+}
+
+bool replay_capture(const std::vector<Record> &records, const std::vector<std::string> &macs, Replay &replay) {
+    init_firmware(macs, poll_cycle_complete);
+
+    if (records.empty()) return false;
+    const uint64_t start_us = records.front().header.time_us;
+    for (const Record &record : records) {
+        advance_to(record.header.time_us >= start_us ? record.header.time_us - start_us : now_us);
+        replay.drops = record.header.drops;
+        if (record.header.included_length < record.header.original_length) {
+            replay.truncated++;
+            continue;
+        }
+
+        std::vector<uint8_t> packet(record.data.begin() + 1, record.data.end());
+        uint16_t size = (uint16_t)packet.size();
+        bool received = record.header.flags & BTSNOOP_FLAG_RECEIVED;
+        switch (record.data[0]) {
+            case BTSNOOP_H4_EVENT:
+                if (received && size >= 2) deliver_event(replay, packet.data(), size);
+                break;
+            case BTSNOOP_H4_ACL:
+                if (received) deliver_acl(replay, packet.data(), size);
+                break;
+            case BTSNOOP_H4_COMMAND:
+                if (!received) check_command(replay, packet.data(), size);
+                break;
+            default:
+                break;
+        }
+        if (!quiet) trace_drain(1 << 30);
+    }
+    advance_to(now_us);
+    return true;
+}
+
+void print_summary(const std::vector<Record> &records, const Replay &replay) {
+    std::fprintf(stderr, "%zu packets, %zu handed to the firmware, %zu log cycles, %zu cut (snaplen), %lu dropped on the device\n",
+                 records.size(), replay.delivered, replay.cycles, replay.truncated, (unsigned long)replay.drops);
+}
+
+int cmd_run(const char *path, int argc, char **argv) {
+    std::vector<Record> records;
+    if (!load_capture(path, records)) return 1;
+    Replay replay;
+    replay_capture(records, std::vector<std::string>(argv, argv + argc), replay);
+    std::fflush(stdout);
+    print_summary(records, replay);
+    return 0;
+}
+
+int cmd_bench(const char *path, int argc, char **argv) {
+    std::vector<Record> records;
+    if (!load_capture(path, records)) return 1;
+
+    // The firmware's printf output would dominate; send it nowhere while replaying
+    std::fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    std::FILE *null_out = std::freopen("/dev/null", "w", stdout);
+    quiet = true;
+    Replay replay;
+    replay_capture(records, std::vector<std::string>(argv, argv + argc), replay);
+    std::fflush(stdout);
+    if (null_out) dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    std::printf("%-16s %8s %10s %10s\n", "event", "count", "avg_ns", "max_ns");
+    for (const auto &entry : replay.cost) {
+        const Stats &stats = entry.second;
+        std::printf("%-16s %8llu %10llu %10llu\n", entry.first.c_str(), (unsigned long long)stats.count,
+                    (unsigned long long)(stats.total_ns / stats.count), (unsigned long long)stats.max_ns);
+    }
+    std::fflush(stdout);
+    print_summary(records, replay);
+    return 0;
+}
+
+// --- Poll Cycle Simulation ---
+
+// Radio timing. A MiFlora advertises about once a second and a connection
+// is set up at its next advertisement. It answers a GATT request after
+// about a quarter second (characteristic discovery takes two requests), so a
+// read holds the link for about 1.5 s, as in miflora_energy's model. The
+// link closes one connection interval after the disconnect.
+const uint64_t kAdvIntervalUs = 1000000;
+const uint64_t kResponseUs = 250000;
+const uint64_t kConnIntervalUs = 30000;
+const uint64_t kConnectSetupUs = 2500;
+const uint8_t kStatusUnknownConnection = 0x02; // Completion of a cancelled connect
+const uint8_t kReasonLocalHost = 0x16;
+
+// Characteristics of the MiFlora's data service (0x1204)
+const uint16_t kServiceStart = 0x0031;
+const uint16_t kServiceEnd = 0x0040;
+const uint16_t kHandleMode = 0x0033;
+const uint16_t kHandleData = 0x0035;
+const uint16_t kHandleBattery = 0x0038;
+
+// The phone's link: one 64-byte stream notification takes about a millisecond
+// on air with its empty acknowledgement, and up to 4 go out per connection event
+const hci_con_handle_t kPhoneHandle = 0x0100;
+const uint64_t kPhoneIntervalUs = 30000;
+const uint64_t kNotifyAirUs = 1000;
+const uint64_t kNotifyPerEvent = 4;
+const char *const kDownloadDay = "2025-06-01.txt";
+
+struct SimSensor {
+    bd_addr_t addr;
+    bool present;                 // Advertising and in range
+    uint64_t next_adv_us;
+    hci_con_handle_t con_handle;  // HCI_CON_HANDLE_INVALID if not connected
+    miflora_state_t stall;        // Never answers what the client waits for in this state (FLORA_IDLE: none)
+};
+
+struct SimEvent {
+    btstack_packet_handler_t handler;
+    std::vector<uint8_t> packet;
+};
+
+struct SimResult {
+    bool complete;
+    uint64_t cycle_us;
+    uint32_t readings;
+    uint32_t peak_links;
+    uint32_t successes; // Recorded by sensor_health.c over all sensors
+    uint32_t failures;
+    uint64_t streamed;  // Bytes the phone received by the end of the cycle
+};
+
+bool simulating = false;
+std::vector<SimSensor> sim_sensors;
+std::multimap<uint64_t, SimEvent> sim_events; // Equal times keep their order
+bool sim_scanning = false;
+int sim_connecting = -1;                      // Sensor of the pending gap_connect
+uint64_t sim_connect_at_us = 0;
+hci_con_handle_t sim_next_handle = 0x0040;
+uint32_t sim_links = 0;
+SimResult sim_result = {};
+std::string sim_day;                          // Day file the phone downloads, empty if none
+std::map<uint64_t, uint64_t> sim_phone_air;   // Start -> end of each notification on air
+uint64_t sim_phone_free_us = 0;               // When the phone's link can take the next one
+
+// A sensor packet due while the radio sends to the phone waits until it is done
+uint64_t sim_radio_free(uint64_t at_us) {
+    for (auto it = sim_phone_air.upper_bound(at_us); it != sim_phone_air.begin() && std::prev(it)->second > at_us;
+         it = sim_phone_air.upper_bound(at_us)) {
+        at_us = std::prev(it)->second;
+    }
+    return at_us;
+}
+
+void sim_queue(uint64_t at_us, btstack_packet_handler_t handler, std::vector<uint8_t> packet) {
+    packet[1] = (uint8_t)(packet.size() - 2);
+    sim_events.insert({ sim_radio_free(at_us), SimEvent{ handler, std::move(packet) } });
+}
+
+SimSensor *sim_sensor_by_addr(const uint8_t *addr) {
+    for (SimSensor &sensor : sim_sensors) {
+        if (std::memcmp(sensor.addr, addr, 6) == 0) return &sensor;
+    }
+    return nullptr;
+}
+
+SimSensor *sim_sensor_by_handle(hci_con_handle_t con_handle) {
+    for (SimSensor &sensor : sim_sensors) {
+        if (sensor.con_handle == con_handle) return &sensor;
+    }
+    return nullptr;
+}
+
+// Next advertisement at or after the given time
+uint64_t sim_next_adv(SimSensor &sensor, uint64_t after_us) {
+    while (sensor.next_adv_us < after_us) sensor.next_adv_us += kAdvIntervalUs;
+    return sensor.next_adv_us;
+}
+
+void sim_put_addr(std::vector<uint8_t> &packet, const uint8_t *addr) {
+    for (int i = 5; i >= 0; i--) packet.push_back(addr[i]); // Little endian on air
+}
+
+// Flags and Xiaomi service data, like a real MiFlora
+std::vector<uint8_t> sim_advertising_report(const SimSensor &sensor) {
+    std::vector<uint8_t> packet = { GAP_EVENT_ADVERTISING_REPORT, 0, 0x00, BD_ADDR_TYPE_LE_PUBLIC };
+    sim_put_addr(packet, sensor.addr);
+    const uint8_t data[] = { 0x02, 0x01, 0x06, 0x0A, 0x16, 0x95, 0xFE, 0x71, 0x20, 0x98, 0x00, 0x01, 0x02, 0x03 };
+    packet.push_back((uint8_t)-62); // RSSI
+    packet.push_back(sizeof(data));
+    packet.insert(packet.end(), data, data + sizeof(data));
+    return packet;
+}
+
+std::vector<uint8_t> sim_connection_complete(uint8_t status, hci_con_handle_t con_handle, const uint8_t *addr) {
+    std::vector<uint8_t> packet = { HCI_EVENT_LE_META, 0, HCI_SUBEVENT_LE_CONNECTION_COMPLETE, status,
+                                    (uint8_t)con_handle, (uint8_t)(con_handle >> 8), HCI_ROLE_MASTER, BD_ADDR_TYPE_LE_PUBLIC };
+    sim_put_addr(packet, addr);
+    const uint8_t params[] = { 0x18, 0x00, 0x00, 0x00, 0xC8, 0x00, 0x00 }; // Interval, latency, timeout, accuracy
+    packet.insert(packet.end(), params, params + sizeof(params));
+    return packet;
+}
+
+void sim_put_uuid16(std::vector<uint8_t> &packet, uint16_t uuid16) {
+    // 128-bit Bluetooth base UUID, little endian
+    const uint8_t base[] = { 0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00 };
+    packet.insert(packet.end(), base, base + sizeof(base));
+    packet.push_back((uint8_t)uuid16);
+    packet.push_back((uint8_t)(uuid16 >> 8));
+    packet.push_back(0);
+    packet.push_back(0);
+}
+
+std::vector<uint8_t> sim_gatt_event(uint8_t type, hci_con_handle_t con_handle) {
+    return { type, 0, (uint8_t)con_handle, (uint8_t)(con_handle >> 8) };
+}
+
+void sim_query_complete(uint64_t at_us, btstack_packet_handler_t callback, hci_con_handle_t con_handle) {
+    std::vector<uint8_t> packet = sim_gatt_event(GATT_EVENT_QUERY_COMPLETE, con_handle);
+    packet.push_back(ATT_ERROR_SUCCESS);
+    sim_queue(at_us, callback, packet);
+}
+
+// Whether the sensor on the link ignores the request made in the given state
+bool sim_stalls(hci_con_handle_t con_handle, miflora_state_t state) {
+    SimSensor *sensor = sim_sensor_by_handle(con_handle);
+    return sensor && sensor->stall == state;
+}
+
+void sim_discover_service(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t uuid16) {
+    if (sim_stalls(con_handle, FLORA_W4_SERVICE_RESULT)) return;
+    uint64_t at_us = now_us + kResponseUs;
+    std::vector<uint8_t> packet = sim_gatt_event(GATT_EVENT_SERVICE_QUERY_RESULT, con_handle);
+    const uint8_t range[] = { (uint8_t)kServiceStart, kServiceStart >> 8, (uint8_t)kServiceEnd, kServiceEnd >> 8 };
+    packet.insert(packet.end(), range, range + sizeof(range));
+    sim_put_uuid16(packet, uuid16);
+    sim_queue(at_us, callback, packet);
+    sim_query_complete(at_us, callback, con_handle);
+}
+
+void sim_discover_characteristics(btstack_packet_handler_t callback, hci_con_handle_t con_handle) {
+    if (sim_stalls(con_handle, FLORA_W4_CHARACTERISTICS_RESULT)) return;
+    uint64_t at_us = now_us + 2 * kResponseUs;
+    const uint16_t characteristics[][2] = { { kHandleMode, 0x1A00 }, { kHandleData, 0x1A01 }, { kHandleBattery, 0x1A02 } };
+    for (const auto &c : characteristics) {
+        std::vector<uint8_t> packet = sim_gatt_event(GATT_EVENT_CHARACTERISTIC_QUERY_RESULT, con_handle);
+        uint16_t fields[] = { (uint16_t)(c[0] - 1), c[0], (uint16_t)(c[0] + 1), 0x0A };
+        for (uint16_t field : fields) {
+            packet.push_back((uint8_t)field);
+            packet.push_back((uint8_t)(field >> 8));
+        }
+        sim_put_uuid16(packet, c[1]);
+        sim_queue(at_us, callback, packet);
+    }
+    sim_query_complete(at_us, callback, con_handle);
+}
+
+void sim_write(btstack_packet_handler_t callback, hci_con_handle_t con_handle) {
+    if (sim_stalls(con_handle, FLORA_W4_WRITE_MODE_COMPLETE)) return;
+    sim_query_complete(now_us + kResponseUs, callback, con_handle);
+}
+
+void sim_read(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle) {
+    if (sim_stalls(con_handle, value_handle == kHandleData ? FLORA_W4_READ_DATA_COMPLETE : FLORA_W4_READ_BATT_COMPLETE)) {
+        return;
+    }
+    uint64_t at_us = now_us + kResponseUs;
+    std::vector<uint8_t> value;
+    if (value_handle == kHandleData) {
+        // 21.4 C, 1250 lux, 38 % moisture, 420 uS/cm
+        value = { 0xD6, 0x00, 0x00, 0xE2, 0x04, 0x00, 0x00, 0x26, 0xA4, 0x01, 0x02, 0x3C, 0x00, 0xFB, 0x34, 0x9B };
+    } else {
+        value = { 0x5F, 0x15, '3', '.', '2', '.', '2' }; // Battery, firmware version
+    }
+    std::vector<uint8_t> packet = sim_gatt_event(GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT, con_handle);
+    const uint8_t header[] = { (uint8_t)value_handle, (uint8_t)(value_handle >> 8), (uint8_t)value.size(), 0 };
+    packet.insert(packet.end(), header, header + sizeof(header));
+    packet.insert(packet.end(), value.begin(), value.end());
+    sim_queue(at_us, callback, packet);
+    sim_query_complete(at_us, callback, con_handle);
+}
+
+void sim_connect(const uint8_t *addr) {
+    SimSensor *sensor = sim_sensor_by_addr(addr);
+    sim_connecting = sensor && sensor->present && sensor->stall != FLORA_W4_CONNECT && sensor->stall != FLORA_W4_CANCEL
+                     ? (int)(sensor - sim_sensors.data()) : -1;
+    if (sim_connecting >= 0) sim_connect_at_us = sim_radio_free(sim_next_adv(*sensor, now_us + 1) + kConnectSetupUs);
+}
+
+void sim_connect_cancel(void) {
+    static const bd_addr_t none = {};
+    sim_connecting = -1;
+    for (const SimSensor &sensor : sim_sensors) {
+        if (sensor.stall == FLORA_W4_CANCEL) return; // The controller loses the cancel
+    }
+    sim_queue(now_us + 1000, nullptr, sim_connection_complete(kStatusUnknownConnection, 0, none));
+}
+
+void sim_disconnect(hci_con_handle_t con_handle) {
+    SimSensor *sensor = sim_sensor_by_handle(con_handle);
+    if (!sensor) return;
+    sensor->con_handle = HCI_CON_HANDLE_INVALID;
+    sim_links--;
+    if (sensor->stall == FLORA_W4_DISCONNECT) return;
+    std::vector<uint8_t> packet = { HCI_EVENT_DISCONNECTION_COMPLETE, 0, ERROR_CODE_SUCCESS,
+                                    (uint8_t)con_handle, (uint8_t)(con_handle >> 8), kReasonLocalHost };
+    sim_queue(now_us + kConnIntervalUs, nullptr, packet);
+}
+
+// One notification to the phone, in the next free slot of a connection event
+void sim_notify(hci_con_handle_t con_handle, const uint8_t *value, uint16_t value_len) {
+    if (con_handle != kPhoneHandle) return;
+    uint64_t slot = std::max(now_us, sim_phone_free_us);
+    uint64_t event_start = slot - slot % kPhoneIntervalUs;
+    if (slot + kNotifyAirUs > event_start + kNotifyPerEvent * kNotifyAirUs) slot = event_start + kPhoneIntervalUs;
+    sim_phone_air[slot] = slot + kNotifyAirUs;
+    sim_phone_free_us = slot + kNotifyAirUs;
+    if (value_len != 7 || std::memcmp(value, "$$EOT$$", 7) != 0) sim_result.streamed += value_len;
+}
+
+void sim_request_can_send(hci_con_handle_t con_handle) {
+    if (con_handle != kPhoneHandle) return;
+    sim_queue(std::max(now_us, sim_phone_free_us), att_handler, { ATT_EVENT_CAN_SEND_NOW, 0 });
+}
+
+// A phone connects and asks for a busy day's file: 32 sensors, one reading every 5 minutes
+void sim_phone_download(void) {
+    char line[128];
+    for (int minute = 0; minute < 24 * 60; minute += 5) {
+        for (int sensor = 0; sensor < 32; sensor++) {
+            std::snprintf(line, sizeof(line), "%.10sT%02d:%02d:%02d,Temp:21.4,Moisture:38,Light:1250,Conductivity:420,"
+                          "Battery:95,Sensor:C47C8D6A00%02X\n", kDownloadDay, minute / 60, minute % 60, sensor, sensor);
+            sim_day += line;
+        }
+    }
+
+    static const bd_addr_t phone = { 0x5C, 0xF3, 0x70, 0x11, 0x22, 0x33 };
+    std::vector<uint8_t> packet = sim_connection_complete(ERROR_CODE_SUCCESS, kPhoneHandle, phone);
+    packet[6] = HCI_ROLE_SLAVE; // The phone is central
+    packet[1] = (uint8_t)(packet.size() - 2);
+    hci_handler(HCI_EVENT_PACKET, 0, packet.data(), (uint16_t)packet.size());
+
+    std::string command = std::string("GET:") + kDownloadDay;
+    att_write(kPhoneHandle, ATT_CHARACTERISTIC_0xAAA2_01_VALUE_HANDLE, ATT_TRANSACTION_MODE_NONE, 0,
+              (uint8_t *)command.data(), (uint16_t)command.size());
+}
+
+void sim_cycle_complete(void) {
+    sim_result.complete = true;
+    sim_result.cycle_us = now_us;
+}
+
+// Steps the simulated radio and the firmware's scheduler until the cycle ends
+void sim_run(uint64_t limit_us) {
+    while (!sim_result.complete) {
+        // The earliest of: a scheduler task, a connection, a queued event, an advertisement
+        enum { NONE, TASK, CONNECT, EVENT, ADVERT } next = NONE;
+        uint64_t next_us = limit_us;
+        SimSensor *advertiser = nullptr;
+        if (run_requested && run_at_us < next_us) {
+            next = TASK;
+            next_us = run_at_us;
+        }
+        if (sim_connecting >= 0 && sim_connect_at_us < next_us) {
+            next = CONNECT;
+            next_us = sim_connect_at_us;
+        }
+        if (!sim_events.empty() && sim_events.begin()->first < next_us) {
+            next = EVENT;
+            next_us = sim_events.begin()->first;
+        }
+        if (sim_scanning) {
+            for (SimSensor &sensor : sim_sensors) {
+                if (sensor.present && sim_next_adv(sensor, now_us) < next_us) {
+                    next = ADVERT;
+                    next_us = sensor.next_adv_us;
+                    advertiser = &sensor;
+                }
+            }
+        }
+        if (next == NONE) return;
+        if (next_us > now_us) now_us = next_us;
+
+        switch (next) {
+            case TASK:
+                run_requested = false;
+                scheduler_run();
+                break;
+            case CONNECT: {
+                SimSensor &sensor = sim_sensors[sim_connecting];
+                sim_connecting = -1;
+                sensor.con_handle = sim_next_handle++;
+                if (++sim_links > sim_result.peak_links) sim_result.peak_links = sim_links;
+                std::vector<uint8_t> packet = sim_connection_complete(ERROR_CODE_SUCCESS, sensor.con_handle, sensor.addr);
+                packet[1] = (uint8_t)(packet.size() - 2);
+                hci_handler(HCI_EVENT_PACKET, 0, packet.data(), (uint16_t)packet.size());
+                break;
+            }
+            case EVENT: {
+                SimEvent event = std::move(sim_events.begin()->second);
+                sim_events.erase(sim_events.begin());
+                btstack_packet_handler_t handler = event.handler ? event.handler : hci_handler;
+                handler(HCI_EVENT_PACKET, 0, event.packet.data(), (uint16_t)event.packet.size());
+                break;
+            }
+            case ADVERT: {
+                std::vector<uint8_t> packet = sim_advertising_report(*advertiser);
+                packet[1] = (uint8_t)(packet.size() - 2);
+                advertiser->next_adv_us += kAdvIntervalUs;
+                if (sim_radio_free(now_us) != now_us) break; // Radio busy with the phone: missed
+                hci_handler(HCI_EVENT_PACKET, 0, packet.data(), (uint16_t)packet.size());
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+// One poll cycle on a fresh firmware: its state is all static, so each
+// configuration runs in a child process. Every sensor stalls in the given state.
+// With download, a phone streams a day file over a second link all cycle long.
+SimResult simulate_cycle(int sensors, int missing, int max_connections, miflora_state_t stall = FLORA_IDLE,
+                         bool download = false) {
+    int fds[2];
+    SimResult result = {};
+    if (pipe(fds) != 0) return result;
+    std::fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        if (!std::freopen("/dev/null", "w", stdout)) _exit(1);
+        quiet = true;
+        simulating = true;
+
+        std::mt19937 rng((uint32_t)sensors);
+        std::vector<std::string> macs;
+        for (int i = 0; i < sensors; i++) {
+            // Missing sensors spread over the list, not all waited for at the end
+            bool present = (missing == 0 || i % (sensors / missing) != 0 || i / (sensors / missing) >= missing) &&
+                           stall != FLORA_W4_SCAN_RESULT;
+            SimSensor sensor = { { 0xC4, 0x7C, 0x8D, 0x6A, 0x00, (uint8_t)i }, present,
+                                 rng() % kAdvIntervalUs, HCI_CON_HANDLE_INVALID, stall };
+            sim_sensors.push_back(sensor);
+            macs.push_back(addr_text(sensor.addr));
+        }
+        init_firmware(macs, sim_cycle_complete);
+        miflora_client_set_max_connections(max_connections);
+
+        uint8_t working[] = { BTSTACK_EVENT_STATE, 1, HCI_STATE_WORKING };
+        hci_handler(HCI_EVENT_PACKET, 0, working, sizeof(working));
+        if (download) sim_phone_download();
+        miflora_client_start();
+        sim_run((uint64_t)sensors * MIFLORA_SCAN_TIMEOUT_MS * 1000u * 2);
+        for (int i = 0; i < sensors; i++) {
+            const sensor_health_t *health = sensor_health_get(i);
+            sim_result.successes += health->successes;
+            sim_result.failures += health->attempts - health->successes;
+        }
+
+        ssize_t written = write(fds[1], &sim_result, sizeof(sim_result));
+        _exit(written == (ssize_t)sizeof(sim_result) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid > 0) {
+        if (read(fds[0], &result, sizeof(result)) != (ssize_t)sizeof(result)) result = {};
+        waitpid(pid, nullptr, 0);
+    }
+    close(fds[0]);
+    return result;
+}
+
+std::string cycle_text(const SimResult &result) {
+    if (!result.complete) return "no end";
+    char text[48];
+    std::snprintf(text, sizeof(text), "%7.1f s %2u/%u", result.cycle_us / 1e6,
+                  (unsigned)result.readings, (unsigned)result.peak_links);
+    return text;
+}
+
+int cmd_simulate(int missing) {
+    std::printf("Poll cycle time, %d sensor(s) missing (time, readings/peak links)\n", missing);
+    std::printf("%-8s %-20s %-20s %s\n", "sensors", "sequential", "overlapped", "speedup");
+    for (int sensors : { 8, 16, 32 }) {
+        if (missing > sensors) continue;
+        SimResult sequential = simulate_cycle(sensors, missing, 1);
+        SimResult overlapped = simulate_cycle(sensors, missing, MIFLORA_MAX_CONNECTIONS);
+        std::printf("%-8d %-20s %-20s", sensors, cycle_text(sequential).c_str(), cycle_text(overlapped).c_str());
+        if (sequential.complete && overlapped.complete && overlapped.cycle_us > 0) {
+            std::printf(" %.2fx", (double)sequential.cycle_us / overlapped.cycle_us);
+        }
+        std::printf("\n");
+    }
+    std::printf("Advertising every %.1f s, GATT responses after %llu ms, %d connections overlapped\n",
+                kAdvIntervalUs / 1e6, (unsigned long long)(kResponseUs / 1000), MIFLORA_MAX_CONNECTIONS);
+
+    std::printf("\nPoll cycle time while a phone downloads a day file (GET:%s), idle -> downloading\n", kDownloadDay);
+    std::printf("%-8s %-22s %-22s %s\n", "sensors", "sequential", "overlapped", "download");
+    for (int sensors : { 8, 16, 32 }) {
+        if (missing > sensors) continue;
+        double rate = 0;
+        std::printf("%-8d", sensors);
+        for (int connections : { 1, MIFLORA_MAX_CONNECTIONS }) {
+            SimResult idle = simulate_cycle(sensors, missing, connections);
+            SimResult busy = simulate_cycle(sensors, missing, connections, FLORA_IDLE, true);
+            char text[32] = "no end";
+            if (idle.complete && busy.complete) {
+                double growth = 100.0 * ((double)busy.cycle_us - (double)idle.cycle_us) / (double)idle.cycle_us;
+                std::snprintf(text, sizeof(text), "%.1f -> %.1f s (%+.0f%%)", idle.cycle_us / 1e6, busy.cycle_us / 1e6,
+                              std::round(growth) + 0.0); // No "-0%"
+                rate = busy.streamed / 1024.0 / (busy.cycle_us / 1e6);
+            }
+            std::printf(" %-22s", text);
+        }
+        std::printf(" %.1f KB/s\n", rate);
+    }
+    std::printf("Phone link: %llu ms connection interval, up to %llu notifications of %d bytes per event\n",
+                (unsigned long long)(kPhoneIntervalUs / 1000), (unsigned long long)kNotifyPerEvent, 64);
+    return 0;
+}
+
+// A sensor that stops answering in each state, and the deadline that must end the wait
+struct StallCase {
+    miflora_state_t state;
+    const char *name;
+    uint32_t timeout_ms;
+};
+
+const StallCase kStallCases[] = {
+    { FLORA_W4_SCAN_RESULT, "scan", MIFLORA_SCAN_TIMEOUT_MS },
+    { FLORA_W4_CONNECT, "connect", MIFLORA_CONNECT_TIMEOUT_MS },
+    { FLORA_W4_CANCEL, "cancel", MIFLORA_CONNECT_TIMEOUT_MS + MIFLORA_CANCEL_TIMEOUT_MS },
+    { FLORA_W4_SERVICE_RESULT, "service", MIFLORA_GATT_TIMEOUT_MS },
+    { FLORA_W4_CHARACTERISTICS_RESULT, "characteristics", MIFLORA_GATT_TIMEOUT_MS },
+    { FLORA_W4_WRITE_MODE_COMPLETE, "write_mode", MIFLORA_GATT_TIMEOUT_MS },
+    { FLORA_W4_READ_DATA_COMPLETE, "read_data", MIFLORA_GATT_TIMEOUT_MS },
+    { FLORA_W4_READ_BATT_COMPLETE, "read_battery", MIFLORA_GATT_TIMEOUT_MS },
+    { FLORA_W4_DISCONNECT, "disconnect", MIFLORA_DISCONNECT_TIMEOUT_MS },
+};
+
+int cmd_check() {
+    // The steps before a state take at most an advertising interval plus a few responses
+    const uint64_t kSlackUs = kAdvIntervalUs + 8 * kResponseUs;
+    bool ok = true;
+    std::printf("%-16s %10s %10s %s\n", "stall", "timeout_s", "cycle_s", "result");
+    for (const StallCase &c : kStallCases) {
+        SimResult r = simulate_cycle(1, 0, 1, c.state);
+        uint64_t timeout_us = (uint64_t)c.timeout_ms * 1000u;
+        // Only the last step fails to answer the disconnect: the reading counts
+        bool read = c.state == FLORA_W4_DISCONNECT;
+        const char *error = !r.complete ? "cycle never ended"
+                            : r.cycle_us < timeout_us ? "ended before the deadline"
+                            : r.cycle_us > timeout_us + kSlackUs ? "ended long after the deadline"
+                            : r.readings != (read ? 1u : 0u) || r.successes != (read ? 1u : 0u) ? "wrong reading count"
+                            : r.failures != (read ? 0u : 1u) ? "failure not recorded"
+                            : nullptr;
+        std::printf("%-16s %10.1f %10.1f %s\n", c.name, c.timeout_ms / 1e3, r.cycle_us / 1e6, error ? error : "ok");
+        ok = ok && !error;
+    }
+
+    SimResult healthy = simulate_cycle(1, 0, 1);
+    bool healthy_ok = healthy.complete && healthy.readings == 1 && healthy.successes == 1 && healthy.failures == 0;
+    std::printf("%-16s %10s %10.1f %s\n", "none", "-", healthy.cycle_us / 1e6, healthy_ok ? "ok" : "not read");
+    ok = ok && healthy_ok;
+
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+}  // namespace
+
+// --- Fake BTstack ---
+
+extern "C" {
+
+void hci_add_event_handler(btstack_packet_callback_registration_t *registration) {
+    hci_handler = registration->callback;
+}
+
+uint32_t btstack_run_loop_get_time_ms(void) {
+    return (uint32_t)(now_us / 1000u);
+}
+
+void gap_local_bd_addr(bd_addr_t address) {
+    static const bd_addr_t replay_addr = { 0x28, 0xCD, 0xC1, 0x00, 0x00, 0x01 };
+    std::memcpy(address, replay_addr, sizeof(bd_addr_t));
+}
+
+void gap_set_scan_parameters(uint8_t scan_type, uint16_t scan_interval, uint16_t scan_window) {
+    action("gap_set_scan_parameters(%u, 0x%04x, 0x%04x)", scan_type, scan_interval, scan_window);
+}
+
+void gap_start_scan(void) {
+    action("gap_start_scan");
+    sim_scanning = true;
+}
+
+void gap_stop_scan(void) {
+    action("gap_stop_scan");
+    sim_scanning = false;
+}
+
+uint8_t gap_connect(const bd_addr_t addr, bd_addr_type_t addr_type) {
+    action("gap_connect(%s, type %u)", addr_text(addr).c_str(), (unsigned)addr_type);
+    if (simulating) sim_connect(addr);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_connect_cancel(void) {
+    action("gap_connect_cancel");
+    if (simulating) sim_connect_cancel();
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_disconnect(hci_con_handle_t handle) {
+    action("gap_disconnect(0x%04x)", handle);
+    if (simulating) sim_disconnect(handle);
+    return ERROR_CODE_SUCCESS;
+}
+
+void gap_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max, uint8_t adv_type,
+                                   uint8_t direct_address_type, bd_addr_t direct_address,
+                                   uint8_t channel_map, uint8_t filter_policy) {
+    UNUSED(adv_type);
+    UNUSED(direct_address_type);
+    UNUSED(direct_address);
+    UNUSED(channel_map);
+    UNUSED(filter_policy);
+    action("gap_advertisements_set_params(0x%04x, 0x%04x)", adv_int_min, adv_int_max);
+}
+
+void gap_advertisements_set_data(uint8_t advertising_data_length, uint8_t *advertising_data) {
+    UNUSED(advertising_data);
+    action("gap_advertisements_set_data(%u bytes)", advertising_data_length);
+}
+
+void gap_advertisements_enable(int enabled) {
+    action("gap_advertisements_enable(%d)", enabled);
+}
+
+uint8_t gatt_client_discover_primary_services_by_uuid16(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t uuid16) {
+    gatt_callback = callback;
+    action("gatt_client_discover_primary_services_by_uuid16(0x%04x, 0x%04x)", con_handle, uuid16);
+    if (simulating) sim_discover_service(callback, con_handle, uuid16);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gatt_client_discover_characteristics_for_service(btstack_packet_handler_t callback, hci_con_handle_t con_handle, gatt_client_service_t *service) {
+    gatt_callback = callback;
+    action("gatt_client_discover_characteristics_for_service(0x%04x, 0x%04x-0x%04x)",
+           con_handle, service->start_group_handle, service->end_group_handle);
+    if (simulating) sim_discover_characteristics(callback, con_handle);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gatt_client_write_value_of_characteristic(btstack_packet_handler_t callback, hci_con_handle_t con_handle,
+                                                  uint16_t value_handle, uint16_t value_length, uint8_t *value) {
+    UNUSED(value);
+    gatt_callback = callback;
+    action("gatt_client_write_value_of_characteristic(0x%04x, 0x%04x, %u bytes)", con_handle, value_handle, value_length);
+    if (simulating) sim_write(callback, con_handle);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gatt_client_read_value_of_characteristic(btstack_packet_handler_t callback, hci_con_handle_t con_handle,
+                                                 gatt_client_characteristic_t *characteristic) {
+    gatt_callback = callback;
+    action("gatt_client_read_value_of_characteristic(0x%04x, 0x%04x)", con_handle, characteristic->value_handle);
+    if (simulating) sim_read(callback, con_handle, characteristic->value_handle);
+    return ERROR_CODE_SUCCESS;
+}
+
+// GATT client (gatt_client.c): service and characteristic events carry the
+// 128-bit UUID, little endian; 16-bit UUIDs are in the Bluetooth base UUID
+static uint16_t uuid16_from_uuid128(const uint8_t *uuid128_le) {
+    static const uint8_t base[] = { 0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00 };
+    if (std::memcmp(uuid128_le, base, sizeof(base)) != 0 || uuid128_le[14] || uuid128_le[15]) return 0;
+    return little_endian_read_16(uuid128_le, 12);
+}
+
+void gatt_client_deserialize_service(const uint8_t *packet, int offset, gatt_client_service_t *service) {
+    service->start_group_handle = little_endian_read_16(packet, offset);
+    service->end_group_handle = little_endian_read_16(packet, offset + 2);
+    for (int i = 0; i < 16; i++) service->uuid128[i] = packet[offset + 4 + 15 - i];
+    service->uuid16 = uuid16_from_uuid128(packet + offset + 4);
+}
+
+void gatt_client_deserialize_characteristic(const uint8_t *packet, int offset, gatt_client_characteristic_t *characteristic) {
+    characteristic->start_handle = little_endian_read_16(packet, offset);
+    characteristic->value_handle = little_endian_read_16(packet, offset + 2);
+    characteristic->end_handle = little_endian_read_16(packet, offset + 4);
+    characteristic->properties = little_endian_read_16(packet, offset + 6);
+    for (int i = 0; i < 16; i++) characteristic->uuid128[i] = packet[offset + 8 + 15 - i];
+    characteristic->uuid16 = uuid16_from_uuid128(packet + offset + 8);
+}
+
+void att_server_init(uint8_t const *db, att_read_callback_t read_callback, att_write_callback_t write_callback) {
+    UNUSED(db);
+    UNUSED(read_callback);
+    att_write = write_callback;
+}
+
+void att_server_register_packet_handler(btstack_packet_handler_t handler) {
+    att_handler = handler;
+}
+
+uint8_t att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len) {
+    action("att_server_notify(0x%04x, 0x%04x, %u bytes)", con_handle, attribute_handle, value_len);
+    if (simulating) sim_notify(con_handle, value, value_len);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t att_server_request_can_send_now_event(hci_con_handle_t con_handle) {
+    action("att_server_request_can_send_now_event(0x%04x)", con_handle);
+    if (simulating) sim_request_can_send(con_handle);
+    return ERROR_CODE_SUCCESS;
+}
+
+bool att_server_can_send_packet_now(hci_con_handle_t con_handle) {
+    UNUSED(con_handle);
+    if (simulating) return now_us >= sim_phone_free_us;
+    return true; // The ATT_EVENT_CAN_SEND_NOW events in the capture still drive stalls
+}
+
+uint16_t att_read_callback_handle_blob(const uint8_t *blob, uint16_t blob_size, uint16_t offset, uint8_t *buffer, uint16_t buffer_size) {
+    if (offset > blob_size) return 0;
+    uint16_t size = btstack_min(blob_size - offset, buffer_size);
+    if (buffer) std::memcpy(buffer, blob + offset, size);
+    return size;
+}
+
+// BTstack's debug log (btstack_util.c)
+void hci_dump_log(int log_level, const char *format, ...) {
+    UNUSED(log_level);
+    UNUSED(format);
+}
+
+// --- Fake Platform ---
+
+uint32_t scheduler_port_now_ms(void) {
+    return (uint32_t)(now_us / 1000u);
+}
+
+uint32_t scheduler_port_now_us(void) {
+    return (uint32_t)now_us;
+}
+
+void scheduler_port_request_run(uint32_t delay_ms) {
+    run_requested = true;
+    run_at_us = now_us + delay_ms * 1000ull;
+}
+
+uint64_t energy_profile_port_now_us(void) {
+    return now_us;
+}
+
+bool rtc_set_datetime(const datetime_t *t) {
+    rtc_epoch = time_util_to_epoch(t->year, t->month, t->day, t->hour, t->min, t->sec);
+    rtc_set_at_us = now_us;
+    rtc_set = true;
+    return true;
+}
+
+bool rtc_get_datetime(datetime_t *t) {
+    if (!rtc_set) return false;
+    int year, month, day, hour, min, sec;
+    time_util_from_epoch(rtc_epoch + (uint32_t)((now_us - rtc_set_at_us) / 1000000u), &year, &month, &day, &hour, &min, &sec);
+    *t = { (int16_t)year, (int8_t)month, (int8_t)day, 0, (int8_t)hour, (int8_t)min, (int8_t)sec };
+    return true;
+}
+
+// The drift estimate runs for real on the fake RTC; only the card is missing
+static bool rtc_now(uint32_t *epoch) {
+    datetime_t t;
+    if (!rtc_get_datetime(&t)) return false;
+    *epoch = time_util_to_epoch(t.year, t.month, t.day, t.hour, t.min, t.sec);
+    return true;
+}
+
+bool clock_drift_port_now(uint32_t *epoch) {
+    uint32_t local;
+    if (!rtc_now(&local)) return false;
+    *epoch = clock_drift_correct(local);
+    return true;
+}
+
+uint32_t clock_drift_port_error_ms(void) {
+    uint32_t local;
+    return rtc_now(&local) ? clock_drift_error_ms(local) : UINT32_MAX;
+}
+
+size_t clock_drift_port_format(char *buffer, size_t buffer_size) {
+    uint32_t local;
+    return clock_drift_format(rtc_now(&local) ? local : 0, buffer, buffer_size);
+}
+
+bool clock_drift_port_sync(int year, int month, int day, int hour, int min, int sec, uint16_t ms) {
+    uint32_t local = 0;
+    bool had_time = rtc_now(&local);
+    datetime_t t = { (int16_t)year, (int8_t)month, (int8_t)day, 0, (int8_t)hour, (int8_t)min, (int8_t)sec };
+    rtc_set_datetime(&t);
+    clock_drift_sync(time_util_to_epoch(year, month, day, hour, min, sec), ms, local, had_time);
+    return true;
+}
+
+bool clock_drift_port_save(void) {
+    return true;
+}
+
+const char *FRESULT_str(FRESULT result) {
+    return result == FR_OK ? "ok" : "no card in replay";
+}
+
+// No card in a replay; simulate serves the phone's download from RAM
+FRESULT log_store_open_day(const char *filename, log_store_day_t *day) {
+    day->left = 0;
+    action("log_store_open_day(%s)", filename);
+    if (sim_day.empty() || std::strcmp(filename, kDownloadDay) != 0) return FR_NO_FILE;
+    day->fil.fptr = 0;
+    day->left = day->part_left = (uint32_t)sim_day.size();
+    return FR_OK;
+}
+
+FRESULT log_store_read_day(log_store_day_t *day, void *buffer, UINT size, UINT *bytes_read) {
+    *bytes_read = (UINT)std::min<uint32_t>(size, day->left);
+    std::memcpy(buffer, sim_day.data() + day->fil.fptr, *bytes_read);
+    day->fil.fptr += *bytes_read;
+    day->left -= *bytes_read;
+    return FR_OK;
+}
+
+FRESULT log_store_read_line(log_store_day_t *day, char *line, int size) {
+    UNUSED(day);
+    UNUSED(size);
+    line[0] = '\0';
+    return FR_DISK_ERR;
+}
+
+void log_store_close_day(log_store_day_t *day) {
+    UNUSED(day);
+}
+
+void log_store_list_begin(void) {
+}
+
+bool log_store_list_next(char *name, size_t name_size) {
+    UNUSED(name);
+    UNUSED(name_size);
+    return false;
+}
+
+void sd_logger_log_reading(miflora_reading_t *reading) {
+    int32_t values[READING_NUM_FIELDS];
+    char text[READING_TEXT_MAX];
+    reading_to_array(&reading->values, values);
+    reading_format_text(values, text);
+    action("log reading %s%s", addr_text(reading->address).c_str(), text);
+    sim_result.readings++;
+}
+
+size_t sd_logger_read_file(const char *name, uint8_t *buffer, size_t buffer_size) {
+    UNUSED(name);
+    UNUSED(buffer);
+    UNUSED(buffer_size);
+    return 0;
+}
+
+bool sd_logger_write_file(const char *name, const uint8_t *data, size_t size) {
+    UNUSED(data);
+    action("write %s, %zu bytes", name, size);
+    return true;
+}
+
+bool sd_logger_is_ready(void) {
+    return true; // No card to mount
+}
+
+void start_pump(void) {
+    action("pump on");
+}
+
+void hci_capture_app_event(uint8_t packet_type, const uint8_t *packet, uint16_t size) {
+    // Already captured
+    UNUSED(packet_type);
+    UNUSED(packet);
+    UNUSED(size);
+}
+
+bool hci_capture_set_mode(bool on) {
+    action("capture mode %s", on ? "on" : "off");
+    return true;
+}
+
+size_t hci_capture_format_status(char *buffer, size_t buffer_size) {
+    int n = std::snprintf(buffer, buffer_size, "capture,replay\n");
+    return n > 0 ? (size_t)n : 0;
+}
+
+size_t warm_restart_format_status(char *buffer, size_t buffer_size) {
+    int n = std::snprintf(buffer, buffer_size, "boot,replay\n");
+    return n > 0 ? (size_t)n : 0;
+}
+
+void boot_profile_mark(boot_phase_t phase) {
+    UNUSED(phase);
+}
+
+size_t boot_profile_format(char *buffer, size_t buffer_size) {
+    int n = std::snprintf(buffer, buffer_size, "phase,replay\n");
+    return n > 0 ? (size_t)n : 0;
+}
+
+void irrigation_port_reading(int sensor, const uint8_t addr[6], uint8_t moisture) {
+    UNUSED(sensor);
+    UNUSED(addr);
+    UNUSED(moisture);
+}
+
+bool irrigation_port_save(void) {
+    return true;
+}
+
+size_t stack_probe_format(char *buffer, size_t buffer_size) {
+    int n = std::snprintf(buffer, buffer_size, "core,replay\n");
+    return n > 0 ? (size_t)n : 0;
+}
+
+}  // extern "C"
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && std::strcmp(argv[1], "run") == 0) return cmd_run(argv[2], argc - 3, argv + 3);
+    if (argc >= 3 && std::strcmp(argv[1], "bench") == 0) return cmd_bench(argv[2], argc - 3, argv + 3);
+    if ((argc == 2 || argc == 3) && std::strcmp(argv[1], "simulate") == 0) return cmd_simulate(argc == 3 ? std::atoi(argv[2]) : 0);
+    if (argc == 2 && std::strcmp(argv[1], "check") == 0) return cmd_check();
+
+    std::fprintf(stderr,
+                 "usage: %s run <HCI.LOG> <sensor-mac>...\n"
+                 "       %s bench <HCI.LOG> <sensor-mac>...\n"
+                 "       %s simulate [missing]\n"
+                 "       %s check\n",
+                 argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,16 @@
+#ifndef REPLAY_F_UTIL_H
+#define REPLAY_F_UTIL_H
+
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char *FRESULT_str(FRESULT result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REPLAY_F_UTIL_H
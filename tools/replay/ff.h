@@ -0,0 +1,37 @@
+// FatFs surface used by the firmware's BLE server, for the host replay build.
+// There is no card in a replay: file operations fail (see miflora_replay.cpp).
+#ifndef REPLAY_FF_H
+#define REPLAY_FF_H
+
+#include <stdint.h>
+
+typedef unsigned int UINT;
+typedef uint64_t FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+} FRESULT;
+
+typedef struct {
+    FSIZE_t fptr;
+    uint8_t err;
+} FIL;
+
+#define f_error(fp) ((fp)->err)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+char *f_gets(char *buff, int len, FIL *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REPLAY_FF_H
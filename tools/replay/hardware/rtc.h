@@ -0,0 +1,19 @@
+#ifndef REPLAY_HARDWARE_RTC_H
+#define REPLAY_HARDWARE_RTC_H
+
+#include <stdbool.h>
+#include "pico/util/datetime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs on the replay clock once set
+bool rtc_set_datetime(const datetime_t *t);
+bool rtc_get_datetime(datetime_t *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REPLAY_HARDWARE_RTC_H
@@ -0,0 +1,17 @@
+#ifndef REPLAY_PICO_UTIL_DATETIME_H
+#define REPLAY_PICO_UTIL_DATETIME_H
+
+#include <stdint.h>
+
+// Same layout as the Pico SDK's datetime_t
+typedef struct {
+    int16_t year;
+    int8_t month;
+    int8_t day;
+    int8_t dotw;
+    int8_t hour;
+    int8_t min;
+    int8_t sec;
+} datetime_t;
+
+#endif // REPLAY_PICO_UTIL_DATETIME_H
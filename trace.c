@@ -0,0 +1,182 @@
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include "scheduler.h" // scheduler_port_now_us()
+
+#if (TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) != 0
+#error "TRACE_RING_SIZE must be a power of two"
+#endif
+
+static const char * const event_formats[TRACE_NUM_EVENTS] = {
+#define TRACE_X_FORMAT(name, text) text,
+    TRACE_EVENTS(TRACE_X_FORMAT)
+#undef TRACE_X_FORMAT
+};
+
+static const char * const callback_names[TRACE_NUM_CALLBACKS] = {
+#define TRACE_X_NAME(name, text) text,
+    TRACE_CALLBACKS(TRACE_X_NAME)
+#undef TRACE_X_NAME
+};
+
+// --- Ring ---
+static trace_event_t ring[TRACE_RING_SIZE];
+static volatile uint32_t ring_head = 0; // Events recorded; written by the producer only
+static uint32_t drain_next = 0;         // Next event to print; consumer only
+static uint32_t dropped = 0;            // Overwritten before they were printed
+
+// --- Callback Latency ---
+typedef struct {
+    uint32_t runs;
+    uint32_t total_us;
+    uint32_t max_us;
+} latency_stats_t;
+static latency_stats_t latency[TRACE_NUM_CALLBACKS];
+
+void trace_record(uint16_t id, int32_t arg0, int32_t arg1) {
+    uint32_t sequence = ring_head;
+    trace_event_t *event = &ring[sequence & (TRACE_RING_SIZE - 1)];
+    event->time_us = scheduler_port_now_us();
+    event->id = id;
+    event->sequence = (uint16_t)sequence;
+    event->args[0] = arg0;
+    event->args[1] = arg1;
+    __atomic_thread_fence(__ATOMIC_RELEASE); // Event is complete before it is published
+    ring_head = sequence + 1;
+}
+
+void trace_print_now(uint16_t id, int32_t arg0, int32_t arg1) {
+    trace_event_t event = { scheduler_port_now_us(), id, 0, { arg0, arg1 } };
+    char text[TRACE_TEXT_MAX];
+    trace_format_event(&event, text, sizeof(text));
+    printf("%s\n", text);
+}
+
+/**
+ * @brief Copy the event with the given sequence number if it is still in the ring.
+ */
+static bool read_event(uint32_t sequence, trace_event_t *out) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    *out = ring[sequence & (TRACE_RING_SIZE - 1)];
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return ring_head - sequence <= TRACE_RING_SIZE; // Not overwritten while copying
+}
+
+bool trace_drain(int max_events) {
+    for (int printed = 0; printed < max_events; printed++) {
+        uint32_t head = ring_head;
+        if (drain_next == head) return false;
+        if (head - drain_next > TRACE_RING_SIZE) {
+            dropped += head - drain_next - TRACE_RING_SIZE;
+            drain_next = head - TRACE_RING_SIZE;
+        }
+
+        trace_event_t event;
+        if (!read_event(drain_next, &event)) continue; // Lapped while copying, resync above
+        drain_next++;
+
+        char text[TRACE_TEXT_MAX];
+        trace_format_event(&event, text, sizeof(text));
+        printf("%s\n", text);
+    }
+    return drain_next != ring_head;
+}
+
+void trace_dump(void) {
+    uint32_t head = ring_head;
+    uint32_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    for (uint32_t sequence = first; sequence != head; sequence++) {
+        trace_event_t event;
+        if (!read_event(sequence, &event)) continue;
+        uint8_t bytes[TRACE_EVENT_SIZE];
+        trace_event_pack(&event, bytes);
+        printf(TRACE_DUMP_PREFIX);
+        for (int i = 0; i < TRACE_EVENT_SIZE; i++) printf("%02X", bytes[i]);
+        printf("\n");
+    }
+}
+
+size_t trace_format_event(const trace_event_t *event, char *buffer, size_t buffer_size) {
+    int n = snprintf(buffer, buffer_size, "[%4lu.%06lu] ",
+                     (unsigned long)(event->time_us / 1000000u), (unsigned long)(event->time_us % 1000000u));
+    if (n < 0 || (size_t)n >= buffer_size) return 0;
+
+    int m;
+    if (event->id < TRACE_NUM_EVENTS) {
+        m = snprintf(buffer + n, buffer_size - (size_t)n, event_formats[event->id],
+                     (long)event->args[0], (long)event->args[1]);
+    } else {
+        m = snprintf(buffer + n, buffer_size - (size_t)n, "event %u (%ld, %ld)",
+                     event->id, (long)event->args[0], (long)event->args[1]);
+    }
+    if (m < 0) return (size_t)n;
+    return (size_t)n + ((size_t)m < buffer_size - (size_t)n ? (size_t)m : buffer_size - (size_t)n - 1);
+}
+
+static void put_le(uint8_t *p, uint32_t v, int width) {
+    for (int i = 0; i < width; i++, v >>= 8) p[i] = (uint8_t)v;
+}
+
+static uint32_t get_le(const uint8_t *p, int width) {
+    uint32_t v = 0;
+    for (int i = width - 1; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+void trace_event_pack(const trace_event_t *event, uint8_t out[TRACE_EVENT_SIZE]) {
+    put_le(out, event->time_us, 4);
+    put_le(out + 4, event->id, 2);
+    put_le(out + 6, event->sequence, 2);
+    put_le(out + 8, (uint32_t)event->args[0], 4);
+    put_le(out + 12, (uint32_t)event->args[1], 4);
+}
+
+void trace_event_unpack(trace_event_t *event, const uint8_t in[TRACE_EVENT_SIZE]) {
+    event->time_us = get_le(in, 4);
+    event->id = (uint16_t)get_le(in + 4, 2);
+    event->sequence = (uint16_t)get_le(in + 6, 2);
+    event->args[0] = (int32_t)get_le(in + 8, 4);
+    event->args[1] = (int32_t)get_le(in + 12, 4);
+}
+
+// --- Callback Latency ---
+
+uint32_t trace_latency_begin(void) {
+    return scheduler_port_now_us();
+}
+
+void trace_latency_end(int callback, uint32_t start_us) {
+    uint32_t run_us = scheduler_port_now_us() - start_us;
+    latency_stats_t *stats = &latency[callback];
+    stats->runs++;
+    stats->total_us += run_us;
+    if (run_us > stats->max_us) stats->max_us = run_us;
+}
+
+void trace_latency_reset(void) {
+    memset(latency, 0, sizeof(latency));
+    dropped = 0;
+}
+
+size_t trace_format_latency(char *buffer, size_t buffer_size) {
+    size_t used = 0;
+    int n = snprintf(buffer, buffer_size, "callback,runs,avg_us,max_us\n");
+    if (n < 0) return 0;
+    used = (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+
+    for (int c = 0; c < TRACE_NUM_CALLBACKS && used < buffer_size - 1; c++) {
+        uint32_t runs = latency[c].runs ? latency[c].runs : 1;
+        n = snprintf(buffer + used, buffer_size - used, "%s,%lu,%lu,%lu\n", callback_names[c],
+                     (unsigned long)latency[c].runs,
+                     (unsigned long)(latency[c].total_us / runs),
+                     (unsigned long)latency[c].max_us);
+        if (n < 0) return used;
+        used += (size_t)n < buffer_size - used ? (size_t)n : buffer_size - used - 1;
+    }
+    if (used < buffer_size - 1) {
+        n = snprintf(buffer + used, buffer_size - used, "mode,%s\ndropped,%lu\n",
+                     TRACE_DIRECT_PRINTF ? "printf" : "ring", (unsigned long)dropped);
+        if (n > 0) used += (size_t)n < buffer_size - used ? (size_t)n : buffer_size - used - 1;
+    }
+    return used;
+}
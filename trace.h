@@ -0,0 +1,180 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Deferred binary trace.
+ *
+ * Hot paths (BTstack callbacks, the stream task) record a 16-byte event with
+ * TRACE() instead of calling printf, which can block on USB stdio. Events go
+ * into a RAM ring; a low-priority task formats them to stdio later
+ * (trace_drain), and the last TRACE_RING_SIZE events can be dumped on demand
+ * as hex lines (trace_dump) for tools/miflora_trace to decode.
+ *
+ * The ring is lock-free for one producer context and one consumer: the
+ * producer never waits, it overwrites the oldest event and the consumer
+ * counts what it missed. With pico_cyw43_arch_none every BTstack callback and
+ * scheduler task runs in the same run loop, so that always holds.
+ *
+ * Build with TRACE_DIRECT_PRINTF=1 to format every event with printf at the
+ * call site instead (the old behaviour), e.g. to compare callback latency.
+ */
+
+// Event ids and their text; each event carries two int32 arguments
+#define TRACE_EVENTS(X) \
+    X(FLORA_STATE,            "MiFlora %ld: state %ld") \
+    X(FLORA_FOUND,            "MiFlora %ld: found, RSSI %ld") \
+    X(FLORA_CONNECTED,        "MiFlora %ld: connected, handle 0x%04lx") \
+    X(FLORA_CONNECT_FAILED,   "MiFlora %ld: connection failed, status 0x%02lx") \
+    X(FLORA_DISCONNECTED,     "MiFlora %ld: disconnected, reason 0x%02lx") \
+    X(FLORA_TIMEOUT,          "MiFlora %ld: timeout in state %ld") \
+    X(FLORA_GATT_ERROR,       "MiFlora %ld: GATT error 0x%02lx, disconnecting") \
+    X(FLORA_NO_CHARACTERISTICS, "MiFlora %ld: required characteristics missing, disconnecting") \
+    X(FLORA_BATTERY_FAILED,   "MiFlora %ld: battery read failed, error 0x%02lx") \
+    X(FLORA_READING,          "MiFlora %ld: reading, temperature %ld (0.1 C)") \
+    X(POLL_CYCLE_COMPLETE,    "Poll cycle complete") \
+    X(LOG_APPENDED,           "Logged reading, %ld bytes") \
+    X(ADV_START,              "Advertising started") \
+    X(SERVER_CONNECTED,       "Phone connected, handle 0x%04lx") \
+    X(SERVER_DISCONNECTED,    "Phone disconnected, handle 0x%04lx") \
+    X(LIVE_SUBSCRIBED,        "Live readings subscribed: %ld") \
+    X(LIVE_DEFERRED,          "Live notification of sensor %ld deferred") \
+    X(STREAM_START,           "Stream start, source %ld, %ld bytes") \
+    X(STREAM_STALL,           "Stream waiting for the ATT server, %ld bytes sent") \
+    X(STREAM_END,             "Stream complete, %ld bytes sent") \
+    X(STREAM_ABORT,           "Stream abort, reason %ld, %ld bytes sent") \
+    X(FLORA_DISCOVERED,       "New MiFlora discovered, RSSI %ld, %ld discovered")
+
+enum {
+#define TRACE_X_ENUM(name, text) TRACE_##name,
+    TRACE_EVENTS(TRACE_X_ENUM)
+#undef TRACE_X_ENUM
+    TRACE_NUM_EVENTS
+};
+
+// Reasons for STREAM_ABORT
+#define TRACE_ABORT_DISCONNECTED 1
+#define TRACE_ABORT_READ_ERROR   2
+
+// Callbacks whose run time is measured (trace_latency_begin/end)
+#define TRACE_CALLBACKS(X) \
+    X(HCI_EVENT,   "hci_event") \
+    X(GATT_EVENT,  "gatt_event") \
+    X(ATT_WRITE,   "att_write") \
+    X(STREAM_TASK, "stream_task")
+
+enum {
+#define TRACE_X_CALLBACK(name, text) TRACE_CALLBACK_##name,
+    TRACE_CALLBACKS(TRACE_X_CALLBACK)
+#undef TRACE_X_CALLBACK
+    TRACE_NUM_CALLBACKS
+};
+
+// Events kept in RAM (power of two); 16 bytes each
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 256
+#endif
+
+#ifndef TRACE_DIRECT_PRINTF
+#define TRACE_DIRECT_PRINTF 0
+#endif
+
+// Longest text of one formatted event
+#define TRACE_TEXT_MAX 96
+
+// Dump line prefix: "TRACE:" followed by the 16 event bytes as hex
+#define TRACE_DUMP_PREFIX "TRACE:"
+
+/**
+ * Event layout (little endian, as dumped):
+ *   u32 time (us, wraps every ~71 minutes), u16 id, u16 sequence (low bits),
+ *   i32 arg0, i32 arg1
+ */
+typedef struct {
+    uint32_t time_us;
+    uint16_t id;
+    uint16_t sequence;
+    int32_t args[2];
+} trace_event_t;
+
+#define TRACE_EVENT_SIZE 16
+
+#if TRACE_DIRECT_PRINTF
+#define TRACE(event, a0, a1) trace_print_now(TRACE_##event, (int32_t)(a0), (int32_t)(a1))
+#else
+#define TRACE(event, a0, a1) trace_record(TRACE_##event, (int32_t)(a0), (int32_t)(a1))
+#endif
+
+/**
+ * @brief Record an event. Never blocks; overwrites the oldest event when full.
+ */
+void trace_record(uint16_t id, int32_t arg0, int32_t arg1);
+
+/**
+ * @brief Format and print an event immediately (TRACE_DIRECT_PRINTF builds).
+ */
+void trace_print_now(uint16_t id, int32_t arg0, int32_t arg1);
+
+/**
+ * @brief Print up to max_events recorded events that were not printed yet.
+ * @return true if more are waiting.
+ */
+bool trace_drain(int max_events);
+
+/**
+ * @brief Print the events still in the ring as hex dump lines, oldest first.
+ */
+void trace_dump(void);
+
+/**
+ * @brief Format one event as "[  seconds.micros] text" (no newline).
+ * @return Length of the text.
+ */
+size_t trace_format_event(const trace_event_t *event, char *buffer, size_t buffer_size);
+
+/**
+ * @brief Serialize an event in the dump layout (TRACE_EVENT_SIZE bytes).
+ */
+void trace_event_pack(const trace_event_t *event, uint8_t out[TRACE_EVENT_SIZE]);
+
+/**
+ * @brief Read an event from the dump layout.
+ */
+void trace_event_unpack(trace_event_t *event, const uint8_t in[TRACE_EVENT_SIZE]);
+
+// --- Callback Latency ---
+
+/**
+ * @brief Start timing a callback.
+ * @return Start time to pass to trace_latency_end().
+ */
+uint32_t trace_latency_begin(void);
+
+/**
+ * @brief Account the run time of a callback since start_us.
+ */
+void trace_latency_end(int callback, uint32_t start_us);
+
+/**
+ * @brief Clear the latency statistics and the dropped-event count.
+ */
+void trace_latency_reset(void);
+
+/**
+ * @brief Format latency per callback and trace drops as CSV text.
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t trace_format_latency(char *buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
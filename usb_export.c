@@ -0,0 +1,358 @@
+#include "usb_export.h"
+#include <string.h>
+#include "ff.h"
+#include "export_frame.h"
+#include "energy_profile.h"
+
+_Static_assert(USB_EXPORT_CHUNK_SIZE <= EXPORT_FRAME_MAX_DATA, "USB_EXPORT_CHUNK_SIZE is larger than a DATA frame");
+_Static_assert(USB_EXPORT_WINDOW >= 2 && USB_EXPORT_WINDOW <= 255, "USB_EXPORT_WINDOW must fit the u8 credit field");
+
+#define REQUEST_MAX_PAYLOAD (8 + EXPORT_FRAME_MAX_NAME) // READ / CRC: offset, length, name
+#define FRAME_BUFFER_SIZE (EXPORT_FRAME_OVERHEAD + 4 + USB_EXPORT_CHUNK_SIZE)
+#define END_PAYLOAD_SIZE 9
+#define RX_BATCH 64
+
+typedef enum {
+    OP_NONE,
+    OP_LIST,
+    OP_READ,
+    OP_CRC,
+    OP_END,  // Done, the END frame is waiting for a free buffer
+} export_op_t;
+
+// --- Session ---
+static bool session_active = false;
+static bool session_closing = false; // BYE answered, the session ends once the reply is out
+static uint32_t last_rx_ms = 0;
+static uint8_t rx_buffer[EXPORT_FRAME_OVERHEAD + REQUEST_MAX_PAYLOAD];
+static export_frame_parser_t parser;
+static bool parser_ready = false;
+
+// --- Running Request ---
+static export_op_t op = OP_NONE;
+static uint8_t op_tag;
+static FIL op_file;
+static DIR op_dir;
+static uint32_t op_offset;  // Next file offset to read
+static uint32_t op_left;    // Bytes of the range still to read
+static uint32_t op_count;   // Bytes or entries so far
+static uint32_t op_crc;
+static uint8_t end_status;
+static uint8_t credits;     // ENTRY/DATA frames the host can still take
+
+// --- Double Buffer ---
+// Frames in send order: the head drains into the USB FIFO while the next
+// chunk is read from the card into the other buffer
+static uint8_t tx_frames[2][FRAME_BUFFER_SIZE];
+static size_t tx_len[2];
+static int tx_head = 0;
+static int tx_queued = 0;
+static size_t tx_sent = 0; // Bytes of the head frame already taken by the port
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * @brief The buffer behind the queued frames, or NULL if both are taken.
+ */
+static uint8_t *free_buffer(void) {
+    return tx_queued < 2 ? tx_frames[(tx_head + tx_queued) % 2] : NULL;
+}
+
+static void queue_frame(size_t length) {
+    tx_len[(tx_head + tx_queued) % 2] = length;
+    tx_queued++;
+}
+
+/**
+ * @brief Drop queued frames the port has not started on. A frame partly
+ * written stays, so the host never sees a cut frame.
+ */
+static void drop_unsent(void) {
+    if (tx_queued == 0) return;
+    tx_queued = tx_sent > 0 ? 1 : 0;
+}
+
+static bool send_end(uint8_t tag, uint8_t status, uint32_t count, uint32_t crc) {
+    uint8_t *frame = free_buffer();
+    if (!frame) return false;
+    uint8_t *payload = frame + EXPORT_FRAME_HEADER_SIZE;
+    payload[0] = status;
+    put_le32(payload + 1, count);
+    put_le32(payload + 5, crc);
+    queue_frame(export_frame_seal(EXPORT_END, tag, END_PAYLOAD_SIZE, frame));
+    return true;
+}
+
+/**
+ * @brief Close what the request had open; its END goes out with the next free buffer.
+ */
+static void finish_op(uint8_t status) {
+    if (op == OP_READ || op == OP_CRC) f_close(&op_file);
+    if (op == OP_LIST) f_closedir(&op_dir);
+    end_status = status;
+    op = OP_END;
+}
+
+/**
+ * @brief Parse "offset, length, name" and open the range for READ / CRC.
+ */
+static uint8_t open_range(const uint8_t *payload, uint16_t length) {
+    if (length <= 8 || length > REQUEST_MAX_PAYLOAD) return EXPORT_STATUS_BAD_REQUEST;
+    char name[EXPORT_FRAME_MAX_NAME + 1];
+    memcpy(name, payload + 8, length - 8u);
+    name[length - 8] = '\0';
+    uint32_t offset = get_le32(payload);
+    uint32_t range = get_le32(payload + 4);
+
+    FRESULT fr = f_open(&op_file, name, FA_READ);
+    if (fr == FR_NO_FILE || fr == FR_NO_PATH || fr == FR_INVALID_NAME) return EXPORT_STATUS_NO_FILE;
+    if (fr != FR_OK) return EXPORT_STATUS_IO_ERROR;
+
+    uint32_t size = (uint32_t)f_size(&op_file);
+    if (offset > size || f_lseek(&op_file, offset) != FR_OK) {
+        f_close(&op_file);
+        return offset > size ? EXPORT_STATUS_BAD_REQUEST : EXPORT_STATUS_IO_ERROR;
+    }
+    op_offset = offset;
+    op_left = range < size - offset ? range : size - offset;
+    return EXPORT_STATUS_OK;
+}
+
+static void start_request(uint8_t type, uint8_t tag, const uint8_t *payload, uint16_t length) {
+    if (op != OP_NONE) {
+        send_end(tag, EXPORT_STATUS_BUSY, 0, 0); // The host aborts first; no buffer, no answer
+        return;
+    }
+    op_tag = tag;
+    op_count = 0;
+    op_crc = 0;
+    credits = USB_EXPORT_WINDOW;
+
+    if (type == EXPORT_LIST) {
+        op = OP_LIST;
+        if (f_opendir(&op_dir, "") != FR_OK) {
+            op = OP_NONE;
+            finish_op(EXPORT_STATUS_IO_ERROR);
+        }
+        return;
+    }
+    uint8_t status = open_range(payload, length);
+    op = status == EXPORT_STATUS_OK ? (type == EXPORT_READ ? OP_READ : OP_CRC) : OP_NONE;
+    if (status != EXPORT_STATUS_OK) finish_op(status);
+}
+
+static void end_session(void) {
+    drop_unsent();
+    if (op != OP_NONE && op != OP_END) finish_op(EXPORT_STATUS_ABORTED);
+    op = OP_NONE;
+    tx_queued = 0;
+    tx_sent = 0;
+    session_active = false;
+    session_closing = false;
+    usb_export_port_session(false);
+}
+
+static void handle_frame(uint32_t now_ms) {
+    uint8_t type = export_frame_type(&parser);
+    uint8_t tag = export_frame_tag(&parser);
+    uint16_t length = export_frame_length(&parser);
+    const uint8_t *payload = export_frame_payload(&parser);
+
+    if (type == EXPORT_HELLO) {
+        if (!session_active) {
+            if (!usb_export_port_session(true)) {
+                // Nothing is queued outside a session, so there is a buffer
+                uint8_t end[EXPORT_FRAME_OVERHEAD + END_PAYLOAD_SIZE];
+                uint8_t status[END_PAYLOAD_SIZE] = { EXPORT_STATUS_NOT_READY };
+                size_t size = export_frame_encode(EXPORT_END, tag, status, sizeof(status), end);
+                usb_export_port_write(end, size);
+                return;
+            }
+            session_active = true;
+        } else if (op != OP_NONE) {
+            // The host started over: forget the old request
+            drop_unsent();
+            finish_op(EXPORT_STATUS_ABORTED);
+            op = OP_NONE;
+        }
+        session_closing = false;
+        last_rx_ms = now_ms;
+        uint8_t *frame = free_buffer();
+        if (frame) {
+            uint8_t hello[4] = { EXPORT_PROTOCOL_VERSION, USB_EXPORT_WINDOW,
+                                 (uint8_t)USB_EXPORT_CHUNK_SIZE, (uint8_t)(USB_EXPORT_CHUNK_SIZE >> 8) };
+            queue_frame(export_frame_encode(EXPORT_REPLY_HELLO, tag, hello, sizeof(hello), frame));
+        }
+        return;
+    }
+    if (!session_active) return; // Stray bytes that happen to look like a frame
+    last_rx_ms = now_ms;
+
+    switch (type) {
+        case EXPORT_ACK:
+            if (length >= 1) {
+                unsigned total = credits + payload[0];
+                credits = (uint8_t)(total < USB_EXPORT_WINDOW ? total : USB_EXPORT_WINDOW);
+            }
+            break;
+        case EXPORT_ABORT:
+            if (op == OP_NONE) {
+                send_end(tag, EXPORT_STATUS_ABORTED, 0, 0); // Already over: confirm, so the host can go on
+            } else if (op != OP_END) {
+                drop_unsent();
+                finish_op(EXPORT_STATUS_ABORTED);
+            }
+            break;
+        case EXPORT_BYE:
+            if (op != OP_NONE && op != OP_END) {
+                drop_unsent();
+                finish_op(EXPORT_STATUS_ABORTED);
+            }
+            op = OP_NONE;
+            send_end(tag, EXPORT_STATUS_OK, 0, 0);
+            session_closing = true;
+            break;
+        case EXPORT_LIST:
+        case EXPORT_READ:
+        case EXPORT_CRC:
+            start_request(type, tag, payload, length);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Write as much of the queued frames as the port takes.
+ */
+static bool drain(void) {
+    bool progress = false;
+    while (tx_queued > 0) {
+        size_t n = usb_export_port_write(tx_frames[tx_head] + tx_sent, tx_len[tx_head] - tx_sent);
+        if (n == 0) break;
+        progress = true;
+        tx_sent += n;
+        if (tx_sent == tx_len[tx_head]) {
+            tx_head ^= 1;
+            tx_queued--;
+            tx_sent = 0;
+        }
+    }
+    return progress;
+}
+
+/**
+ * @brief One step of the running request: at most one card read.
+ */
+static bool fill(void) {
+    uint8_t *frame = free_buffer();
+    if (op == OP_NONE || !frame) return false;
+
+    if (op == OP_END) {
+        if (!send_end(op_tag, end_status, op_count, op_crc)) return false;
+        op = OP_NONE;
+        return true;
+    }
+
+    if (op == OP_LIST) {
+        if (credits == 0) return false;
+        FILINFO fno;
+        energy_profile_set(ENERGY_SD_READ, true);
+        FRESULT fr = f_readdir(&op_dir, &fno);
+        energy_profile_set(ENERGY_SD_READ, false);
+        if (fr != FR_OK || fno.fname[0] == '\0') {
+            finish_op(fr == FR_OK ? EXPORT_STATUS_OK : EXPORT_STATUS_IO_ERROR);
+            return true;
+        }
+        size_t name_len = strlen(fno.fname);
+        if ((fno.fattrib & AM_DIR) || name_len > EXPORT_FRAME_MAX_NAME) return true;
+
+        uint8_t *payload = frame + EXPORT_FRAME_HEADER_SIZE;
+        put_le32(payload, (uint32_t)fno.fsize);
+        payload[4] = (uint8_t)fno.fdate;
+        payload[5] = (uint8_t)(fno.fdate >> 8);
+        payload[6] = (uint8_t)fno.ftime;
+        payload[7] = (uint8_t)(fno.ftime >> 8);
+        memcpy(payload + 8, fno.fname, name_len);
+        queue_frame(export_frame_seal(EXPORT_ENTRY, op_tag, (uint16_t)(8 + name_len), frame));
+        credits--;
+        op_count++;
+        return true;
+    }
+
+    // READ and CRC
+    if (op_left == 0) {
+        finish_op(EXPORT_STATUS_OK);
+        return true;
+    }
+    if (op == OP_READ && credits == 0) return false;
+
+    // A CRC sends nothing, so it borrows the free buffer for the read
+    uint8_t *data = frame + EXPORT_FRAME_HEADER_SIZE + 4;
+    UINT chunk = op_left < USB_EXPORT_CHUNK_SIZE ? op_left : USB_EXPORT_CHUNK_SIZE;
+    UINT bytes_read = 0;
+    energy_profile_set(ENERGY_SD_READ, true);
+    FRESULT fr = f_read(&op_file, data, chunk, &bytes_read);
+    energy_profile_set(ENERGY_SD_READ, false);
+    if (fr != FR_OK || bytes_read == 0) {
+        finish_op(EXPORT_STATUS_IO_ERROR);
+        return true;
+    }
+    op_crc = export_frame_crc32(op_crc, data, bytes_read);
+    if (op == OP_READ) {
+        put_le32(frame + EXPORT_FRAME_HEADER_SIZE, op_offset);
+        queue_frame(export_frame_seal(EXPORT_DATA, op_tag, (uint16_t)(4 + bytes_read), frame));
+        credits--;
+    }
+    op_offset += bytes_read;
+    op_left -= bytes_read;
+    op_count += bytes_read;
+    return true;
+}
+
+// --- Public Function Implementations ---
+
+uint32_t usb_export_poll(uint32_t now_ms) {
+    if (!parser_ready) {
+        export_frame_parser_init(&parser, rx_buffer, sizeof(rx_buffer));
+        parser_ready = true;
+    }
+
+    uint8_t rx[RX_BATCH];
+    size_t received;
+    while ((received = usb_export_port_read(rx, sizeof(rx))) > 0) {
+        for (size_t i = 0; i < received; i++) {
+            if (export_frame_push(&parser, rx[i])) handle_frame(now_ms);
+        }
+    }
+    if (!session_active) return USB_EXPORT_IDLE_POLL_MS;
+
+    // Fill while the FIFO drains what was written before
+    bool progress = drain();
+    progress = fill() || progress;
+    progress = drain() || progress;
+
+    if (session_closing && tx_queued == 0) {
+        end_session();
+        return USB_EXPORT_IDLE_POLL_MS;
+    }
+    if (op == OP_CRC) last_rx_ms = now_ms; // A long CRC sends nothing; the host is waiting, not gone
+    if ((uint32_t)(now_ms - last_rx_ms) > USB_EXPORT_SESSION_TIMEOUT_MS) {
+        end_session();
+        return USB_EXPORT_IDLE_POLL_MS;
+    }
+    return progress ? 0 : USB_EXPORT_BLOCKED_POLL_MS;
+}
+
+bool usb_export_is_active(void) {
+    return session_active;
+}
@@ -0,0 +1,91 @@
+#ifndef USB_EXPORT_H
+#define USB_EXPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bulk export of the card over the USB serial port (CDC).
+ *
+ * Pulling a season of logs over BLE notifications takes hours. Over USB the
+ * host runs tools/miflora_export, which speaks a framed binary protocol
+ * (export_frame.h):
+ * - list the files on the card;
+ * - read any byte range of a file;
+ * - get the CRC-32 of a range, so the host can check that its copy is still a
+ *   prefix of the card's file and fetch only the new bytes.
+ *
+ * A session starts when the host sends HELLO. Until then USB serial carries
+ * the usual printf output, and the export only looks for frames in what the
+ * host sends. During a session printf is switched off on USB, so the text
+ * cannot break into the frames.
+ *
+ * Flow control is by credit. The device sends at most USB_EXPORT_WINDOW
+ * ENTRY/DATA frames ahead of the host's ACKs, so a slow host never makes it
+ * block or drop bytes. Card reads are double-buffered: while one frame drains
+ * into the USB FIFO, the next chunk is read from the card into the other
+ * buffer. The work runs in short slices from a low-priority scheduler task,
+ * so BLE keeps running during an export.
+ *
+ * The engine (usb_export.c) only needs FatFs and the three port hooks below.
+ * The firmware port is usb_export_port.c. tools/miflora_export runs the same
+ * engine on a PC behind a pseudo-terminal, as a stand-in for the board.
+ */
+
+// File bytes per DATA frame. Two frame buffers of this size are kept in RAM.
+#ifndef USB_EXPORT_CHUNK_SIZE
+#define USB_EXPORT_CHUNK_SIZE 1024
+#endif
+
+// Frames the device may send ahead of the host's ACKs
+#ifndef USB_EXPORT_WINDOW
+#define USB_EXPORT_WINDOW 8
+#endif
+
+// A session ends when the host has sent nothing for this long
+#ifndef USB_EXPORT_SESSION_TIMEOUT_MS
+#define USB_EXPORT_SESSION_TIMEOUT_MS 10000
+#endif
+
+#define USB_EXPORT_IDLE_POLL_MS 50    // Waiting for a HELLO
+#define USB_EXPORT_BLOCKED_POLL_MS 1  // In a session, waiting for the host or the FIFO
+
+/**
+ * @brief Start polling the USB serial port for a session (usb_export_port.c).
+ */
+void usb_export_init(void);
+
+/**
+ * @brief Take received bytes, send what the link accepts and read the next chunk.
+ * @param now_ms Millisecond clock, for the session timeout.
+ * @return Milliseconds until the next call is useful (0 = more work right away).
+ */
+uint32_t usb_export_poll(uint32_t now_ms);
+
+/**
+ * @brief Whether a host session is open.
+ */
+bool usb_export_is_active(void);
+
+// --- Port Hooks (implemented per platform) ---
+
+// Received bytes, without blocking. Returns the number read.
+size_t usb_export_port_read(uint8_t *buffer, size_t size);
+
+// Queue bytes for the host, without blocking. Returns how many were taken.
+size_t usb_export_port_write(const uint8_t *data, size_t size);
+
+// Take the link for a session (printf off, files held) or give it back.
+// Returns false if a session cannot start yet (card not ready).
+bool usb_export_port_session(bool active);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // USB_EXPORT_H
@@ -0,0 +1,43 @@
+#include "usb_export.h"
+#include "pico/stdlib.h"
+#include "pico/stdio_usb.h"
+#include "tusb.h"
+#include "scheduler.h"
+#include "log_store.h"
+#include "sd_logger.h"
+
+// USB export port: frames go through the stdio USB driver's raw character
+// functions, which skip the CR/LF translation of printf.
+
+static scheduler_task_t export_task;
+
+static void export_task_handler(scheduler_task_t *task) {
+    scheduler_run_in(task, usb_export_poll(to_ms_since_boot(get_absolute_time())));
+}
+
+void usb_export_init(void) {
+    scheduler_task_init(&export_task, "usb_export", SCHEDULER_PRIORITY_LOW, export_task_handler, NULL);
+    scheduler_run_in(&export_task, USB_EXPORT_IDLE_POLL_MS);
+}
+
+size_t usb_export_port_read(uint8_t *buffer, size_t size) {
+    int n = stdio_usb.in_chars((char *)buffer, (int)size);
+    return n > 0 ? (size_t)n : 0;
+}
+
+size_t usb_export_port_write(const uint8_t *data, size_t size) {
+    if (!stdio_usb_connected()) return 0;
+
+    // Only what fits the CDC FIFO, so the driver never waits for the host
+    size_t room = tud_cdc_write_available();
+    size_t n = size < room ? size : room;
+    if (n > 0) stdio_usb.out_chars((const char *)data, (int)n);
+    return n;
+}
+
+bool usb_export_port_session(bool active) {
+    if (active && !sd_logger_is_ready()) return false;
+    stdio_set_driver_enabled(&stdio_usb, !active); // printf text would land inside the frames
+    log_store_hold(active); // Compaction must not delete or replace a file being read
+    return true;
+}
@@ -0,0 +1,223 @@
+#include "warm_restart.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/rtc.h"
+#include "hardware/watchdog.h"
+#include "pico/util/datetime.h"
+#include "scheduler.h"
+#include "clock_drift.h"
+#include "time_util.h"
+#include "log_frame.h"
+
+#define WARM_STATE_MAGIC 0x4D524157u // "WARM"
+
+typedef struct {
+    uint32_t epoch;
+    miflora_reading_t reading;
+} held_reading_t;
+
+// Lives in RAM the C runtime leaves alone; only trusted if the CRC matches
+typedef struct {
+    uint32_t magic;
+    uint32_t size;               // sizeof(warm_state_t): new firmware with a new layout starts cold
+    uint32_t restarts;           // Warm restarts since power-on
+    uint64_t uptime_ms;          // Since power-on, at the last save
+    uint32_t epoch;              // Wall clock at the last save, 0 if the RTC was not set
+    uint32_t clock_error_ms;     // Error earlier restores added since the last sync
+    uint64_t log_due_uptime_ms;  // Next log cycle on the uptime clock, 0 if none is due
+    uint8_t held_first;
+    uint8_t held_count;
+    held_reading_t held[WARM_RESTART_HELD_READINGS];
+    uint16_t crc;                // Over everything above
+} warm_state_t;
+
+static warm_state_t __uninitialized_ram(warm_state);
+
+static warm_restart_kind_t boot_kind = WARM_RESTART_POWER_ON;
+static bool clock_restored = false;
+static uint32_t clock_error_ms = 0;     // Of the restored clock, see warm_restart_clock_error_ms()
+static uint64_t uptime_base_ms = 0;     // Uptime before this boot
+static int32_t restored_log_due_ms = -1;
+static scheduler_task_t save_task;
+
+static const char * const kind_names[] = {
+    [WARM_RESTART_POWER_ON] = "power_on",
+    [WARM_RESTART_WATCHDOG] = "watchdog",
+    [WARM_RESTART_SOFTWARE] = "software",
+    [WARM_RESTART_EXTERNAL] = "external",
+};
+
+static uint16_t state_crc(void) {
+    return log_frame_crc16((const char *)&warm_state, offsetof(warm_state_t, crc));
+}
+
+/**
+ * @brief Recompute the CRC after a change, so a reset at any point finds a consistent block.
+ */
+static void seal(void) {
+    warm_state.crc = state_crc();
+}
+
+static bool state_valid(void) {
+    return warm_state.magic == WARM_STATE_MAGIC && warm_state.size == sizeof(warm_state_t) &&
+           warm_state.held_first < WARM_RESTART_HELD_READINGS && warm_state.held_count <= WARM_RESTART_HELD_READINGS &&
+           warm_state.crc == state_crc();
+}
+
+static uint32_t rtc_epoch(void) {
+    datetime_t t;
+    if (!rtc_get_datetime(&t)) return 0;
+    return time_util_to_epoch(t.year, t.month, t.day, t.hour, t.min, t.sec);
+}
+
+/**
+ * @brief Set the RTC from the last saved time, advanced by this boot and the
+ * time between the save and the reset.
+ */
+static bool restore_clock(void) {
+    if (warm_state.epoch == 0) return false;
+
+    // The watchdog fired a full timeout after the feed that came with the last
+    // save; a software reset came anywhere within the save interval. Both
+    // times had whole seconds.
+    uint32_t gap_ms, error_ms;
+    if (boot_kind == WARM_RESTART_WATCHDOG) {
+        gap_ms = WARM_RESTART_WATCHDOG_MS;
+        error_ms = 1000;
+    } else {
+        gap_ms = WARM_RESTART_SAVE_INTERVAL_MS / 2;
+        error_ms = WARM_RESTART_SAVE_INTERVAL_MS / 2 + 1000;
+    }
+    uint32_t epoch = warm_state.epoch + (gap_ms + to_ms_since_boot(get_absolute_time())) / 1000;
+    int year, month, day, hour, min, sec;
+    time_util_from_epoch(epoch, &year, &month, &day, &hour, &min, &sec);
+    // 1970-01-01 was a Thursday; dotw counts from Sunday
+    datetime_t t = { (int16_t)year, (int8_t)month, (int8_t)day, (int8_t)((epoch / 86400u + 4) % 7),
+                     (int8_t)hour, (int8_t)min, (int8_t)sec };
+    if (!rtc_set_datetime(&t)) return false;
+    clock_error_ms = warm_state.clock_error_ms + error_ms;
+    return true;
+}
+
+/**
+ * @brief Feeds the watchdog and saves the clock. Starving this task for
+ * WARM_RESTART_WATCHDOG_MS resets the device.
+ */
+static void save_handler(scheduler_task_t *task) {
+    watchdog_update();
+    warm_state.epoch = rtc_epoch();
+    warm_state.clock_error_ms = clock_drift_added_error_ms();
+    warm_state.uptime_ms = warm_restart_uptime_ms();
+    seal();
+    scheduler_run_in(task, WARM_RESTART_SAVE_INTERVAL_MS);
+}
+
+// --- Public Function Implementations ---
+
+warm_restart_kind_t warm_restart_init(void) {
+    if (!state_valid()) {
+        boot_kind = WARM_RESTART_POWER_ON;
+        memset(&warm_state, 0, sizeof(warm_state));
+        warm_state.magic = WARM_STATE_MAGIC;
+        warm_state.size = sizeof(warm_state_t);
+        seal();
+        printf("Cold start. Waiting for time sync from app...\n");
+        return boot_kind;
+    }
+
+    if (watchdog_enable_caused_reboot()) {
+        boot_kind = WARM_RESTART_WATCHDOG;
+    } else if (watchdog_caused_reboot()) {
+        boot_kind = WARM_RESTART_SOFTWARE;
+    } else {
+        boot_kind = WARM_RESTART_EXTERNAL;
+    }
+
+    uptime_base_ms = warm_state.uptime_ms;
+    warm_state.restarts++;
+    if (boot_kind != WARM_RESTART_EXTERNAL) {
+        clock_restored = restore_clock();
+        if (warm_state.log_due_uptime_ms != 0) {
+            int64_t left = (int64_t)(warm_state.log_due_uptime_ms - warm_restart_uptime_ms());
+            restored_log_due_ms = left > 0 ? (int32_t)left : 0;
+        }
+    }
+    if (!clock_restored) {
+        warm_state.epoch = 0;
+        warm_state.clock_error_ms = 0;
+        warm_state.log_due_uptime_ms = 0;
+    }
+    seal();
+
+    printf("Warm restart #%lu (%s): clock %s, %u readings held",
+           (unsigned long)warm_state.restarts, kind_names[boot_kind],
+           clock_restored ? "restored" : "lost, waiting for time sync", warm_state.held_count);
+    if (restored_log_due_ms >= 0) {
+        printf(", next log cycle in %ld s", (long)(restored_log_due_ms / 1000));
+    }
+    printf("\n");
+    return boot_kind;
+}
+
+bool warm_restart_clock_restored(void) {
+    return clock_restored;
+}
+
+uint32_t warm_restart_clock_error_ms(void) {
+    return clock_error_ms;
+}
+
+void warm_restart_start(void) {
+    scheduler_task_init(&save_task, "warm_save", SCHEDULER_PRIORITY_HIGH, save_handler, NULL);
+    watchdog_enable(WARM_RESTART_WATCHDOG_MS, true); // Paused while a debugger halts the cores
+    scheduler_run_in(&save_task, 0);
+}
+
+uint64_t warm_restart_uptime_ms(void) {
+    return uptime_base_ms + to_ms_since_boot(get_absolute_time());
+}
+
+void warm_restart_set_log_due(uint32_t delay_ms) {
+    warm_state.log_due_uptime_ms = warm_restart_uptime_ms() + delay_ms;
+    seal();
+}
+
+int32_t warm_restart_log_due_in_ms(void) {
+    return restored_log_due_ms;
+}
+
+void warm_restart_hold_reading(const miflora_reading_t *reading, uint32_t epoch) {
+    if (warm_state.held_count == WARM_RESTART_HELD_READINGS) {
+        warm_restart_drop_reading(); // Keep the newest
+    }
+    held_reading_t *held = &warm_state.held[(warm_state.held_first + warm_state.held_count) % WARM_RESTART_HELD_READINGS];
+    held->epoch = epoch;
+    held->reading = *reading;
+    warm_state.held_count++;
+    seal();
+}
+
+bool warm_restart_peek_reading(miflora_reading_t *reading, uint32_t *epoch) {
+    if (warm_state.held_count == 0) return false;
+    const held_reading_t *held = &warm_state.held[warm_state.held_first];
+    *reading = held->reading;
+    *epoch = held->epoch;
+    return true;
+}
+
+void warm_restart_drop_reading(void) {
+    if (warm_state.held_count == 0) return;
+    warm_state.held_first = (uint8_t)((warm_state.held_first + 1) % WARM_RESTART_HELD_READINGS);
+    warm_state.held_count--;
+    seal();
+}
+
+size_t warm_restart_format_status(char *buffer, size_t buffer_size) {
+    int n = snprintf(buffer, buffer_size, "boot,restarts,uptime_s,clock,held\n%s,%lu,%lu,%s,%u\n",
+                     kind_names[boot_kind], (unsigned long)warm_state.restarts,
+                     (unsigned long)(warm_restart_uptime_ms() / 1000),
+                     clock_restored ? "restored" : rtc_epoch() ? "synced" : "unset", warm_state.held_count);
+    if (n < 0) return 0;
+    return (size_t)n < buffer_size ? (size_t)n : buffer_size - 1;
+}
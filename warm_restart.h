@@ -0,0 +1,120 @@
+#ifndef WARM_RESTART_H
+#define WARM_RESTART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "miflora_client.h" // For miflora_reading_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Watchdog, and state that survives a watchdog or software reset.
+ *
+ * A block of RAM that the C runtime does not clear at boot (__uninitialized_ram)
+ * holds the wall-clock time, the uptime since power-on, when the next log
+ * cycle is due, and readings the card could not take yet. The task that feeds
+ * the watchdog refreshes it every WARM_RESTART_SAVE_INTERVAL_MS, and every
+ * change to it is sealed with a CRC.
+ *
+ * At boot the block is checked (magic, size, CRC). After a power-on it holds
+ * noise, so the device starts cold and waits for a phone to set the clock, as
+ * before. After a watchdog or software reset the clock is set again straight
+ * away, from the last save plus the boot time: a watchdog reset came
+ * WARM_RESTART_WATCHDOG_MS after the last save, a software reset at some point
+ * within a save interval. warm_restart_clock_error_ms() tells how far off the
+ * clock can be by then, for clock_drift_add_error(). Logging then resumes on
+ * the old schedule and the held readings go to the card with the next
+ * reading. A reset from the RUN pin or a debugger keeps the held
+ * readings, but not the clock, since nobody knows how long the reset took.
+ */
+
+// Longest a task or callback may hold up the run loop (the RP2040 allows up to 8.3 s)
+#ifndef WARM_RESTART_WATCHDOG_MS
+#define WARM_RESTART_WATCHDOG_MS 8000
+#endif
+
+#define WARM_RESTART_SAVE_INTERVAL_MS 1000 // Watchdog feed and clock refresh
+
+// Readings held in RAM while the card cannot be written; the oldest is dropped when full
+#ifndef WARM_RESTART_HELD_READINGS
+#define WARM_RESTART_HELD_READINGS 8
+#endif
+
+// How the device came up
+typedef enum {
+    WARM_RESTART_POWER_ON,     // No valid state: power-on, new firmware or corrupted RAM
+    WARM_RESTART_WATCHDOG,     // Watchdog timeout, state restored
+    WARM_RESTART_SOFTWARE,     // watchdog_reboot(), state restored
+    WARM_RESTART_EXTERNAL,     // RUN pin or debugger: held readings kept, clock lost
+} warm_restart_kind_t;
+
+/**
+ * @brief Check the saved state, restore the clock if it can be trusted and
+ * print how the device came up. Call right after rtc_init().
+ */
+warm_restart_kind_t warm_restart_init(void);
+
+/**
+ * @brief Whether warm_restart_init() set the RTC from the saved state.
+ */
+bool warm_restart_clock_restored(void);
+
+/**
+ * @brief How far off the restored clock can be, in ms, on top of the error it
+ * had before the reset (kept across restarts until the next sync). 0 if the
+ * clock was not restored.
+ */
+uint32_t warm_restart_clock_error_ms(void);
+
+/**
+ * @brief Enable the watchdog and start the task that feeds it and saves the
+ * state. Call once the scheduler runs on the BTstack run loop.
+ */
+void warm_restart_start(void);
+
+/**
+ * @brief Milliseconds since power-on, carried across warm restarts.
+ */
+uint64_t warm_restart_uptime_ms(void);
+
+/**
+ * @brief Record when the next log cycle is due.
+ */
+void warm_restart_set_log_due(uint32_t delay_ms);
+
+/**
+ * @brief Time left until the log cycle that was due before the reset.
+ * @return Milliseconds (0 if already overdue), or -1 after a cold start.
+ */
+int32_t warm_restart_log_due_in_ms(void);
+
+/**
+ * @brief Hold a reading the card could not take, with its time.
+ */
+void warm_restart_hold_reading(const miflora_reading_t *reading, uint32_t epoch);
+
+/**
+ * @brief Oldest held reading.
+ * @return false if none is held.
+ */
+bool warm_restart_peek_reading(miflora_reading_t *reading, uint32_t *epoch);
+
+/**
+ * @brief Drop the oldest held reading, once it is on the card.
+ */
+void warm_restart_drop_reading(void);
+
+/**
+ * @brief Format how the device came up as CSV text.
+ * @return Number of characters written (excluding the terminator).
+ */
+size_t warm_restart_format_status(char *buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WARM_RESTART_H